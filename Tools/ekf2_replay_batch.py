@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+"""Replay a directory of sdlog2 logs through ekf2 on all cores
+
+Usage: python ekf2_replay_batch.py [-j <jobs>] [-p <replay_params.txt>]
+           [-o <summary.csv>] [-b <build dir>] [-t <timeout s>] <log dir>
+
+    Every *.px4log in <log dir> is replayed by its own px4 process (and
+    therefore its own uORB), in its own working directory below
+    <build dir>/src/firmware/posix/batch/. The replayed logs are left there.
+
+    -j  number of parallel replays (default: number of cores)
+    -p  ekf2 parameter overrides, applied to every log (see ekf2_replay)
+    -o  summary file, one line of innovation and timing statistics per log
+        (default: <log dir>/ekf2_replay_summary.csv)
+    -b  build directory of posix_sitl_replay (default: build_posix_sitl_replay)
+    -t  timeout per log in seconds (default: 3600)
+
+    Build with 'make posix_sitl_replay' first."""
+
+import argparse
+import multiprocessing
+import multiprocessing.pool
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+RC_SCRIPT = """uorb start
+ekf2 start --replay
+sleep 0.2
+ekf2_replay start replay.px4log -x
+"""
+
+STATS_FILE = 'rootfs/replay_replay_stats.csv'
+
+
+def prepare(work_dir, log_file, params_file):
+    """Create the working directory of one replay"""
+    if os.path.isdir(work_dir):
+        shutil.rmtree(work_dir)
+
+    os.makedirs(os.path.join(work_dir, 'rootfs', 'fs', 'microsd'))
+    os.makedirs(os.path.join(work_dir, 'rootfs', 'eeprom'))
+    open(os.path.join(work_dir, 'rootfs', 'eeprom', 'parameters'), 'w').close()
+    os.symlink(os.path.abspath(log_file), os.path.join(work_dir, 'rootfs', 'replay.px4log'))
+
+    # ekf2_replay fills an empty parameter file with the values from the log
+    params = os.path.join(work_dir, 'rootfs', 'replay_params.txt')
+    if params_file:
+        shutil.copyfile(params_file, params)
+    else:
+        open(params, 'w').close()
+
+    with open(os.path.join(work_dir, 'rcS'), 'w') as f:
+        f.write(RC_SCRIPT)
+
+
+def read_stats(work_dir):
+    """Return the statistics written by ekf2_replay as a list of (name, value)"""
+    try:
+        with open(os.path.join(work_dir, STATS_FILE)) as f:
+            lines = f.read().splitlines()
+    except IOError:
+        return None
+
+    if len(lines) < 2:
+        return None
+
+    return list(zip(lines[0].split(','), lines[1].split(',')))
+
+
+def replay(job):
+    px4, work_dir, log_file, params_file, timeout = job
+
+    prepare(work_dir, log_file, params_file)
+
+    start = time.time()
+    with open(os.path.join(work_dir, 'out.log'), 'w') as out:
+        process = subprocess.Popen([px4, '-d', 'rcS'], cwd=work_dir,
+                                   stdin=subprocess.PIPE, stdout=out, stderr=subprocess.STDOUT)
+
+        while process.poll() is None and time.time() - start < timeout:
+            time.sleep(0.1)
+
+        timed_out = process.poll() is None
+        if timed_out:
+            process.kill()
+            process.wait()
+
+    stats = None if timed_out else read_stats(work_dir)
+    return log_file, time.time() - start, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay a directory of sdlog2 logs through ekf2 on all cores')
+    parser.add_argument('log_dir', help='directory with the .px4log files')
+    parser.add_argument('-j', '--jobs', type=int, default=multiprocessing.cpu_count(),
+                        help='number of parallel replays')
+    parser.add_argument('-p', '--params', help='ekf2 parameter overrides (replay_params.txt format)')
+    parser.add_argument('-o', '--output', help='summary file')
+    parser.add_argument('-b', '--build', default='build_posix_sitl_replay', help='posix_sitl_replay build directory')
+    parser.add_argument('-t', '--timeout', type=float, default=3600, help='timeout per log [s]')
+    args = parser.parse_args()
+
+    posix_dir = os.path.abspath(os.path.join(args.build, 'src', 'firmware', 'posix'))
+    px4 = os.path.join(posix_dir, 'px4')
+    if not os.path.isfile(px4):
+        print('%s not found, build with make posix_sitl_replay' % px4, file=sys.stderr)
+        sys.exit(1)
+
+    logs = sorted(f for f in os.listdir(args.log_dir) if f.endswith('.px4log'))
+    if len(logs) == 0:
+        print('no .px4log files in %s' % args.log_dir, file=sys.stderr)
+        sys.exit(1)
+
+    params = os.path.abspath(args.params) if args.params else None
+    output = args.output or os.path.join(args.log_dir, 'ekf2_replay_summary.csv')
+
+    jobs = []
+    for i, log in enumerate(logs):
+        work_dir = os.path.join(posix_dir, 'batch', '%03i_%s' % (i, os.path.splitext(log)[0]))
+        jobs.append((px4, work_dir, os.path.join(args.log_dir, log), params, args.timeout))
+
+    print('replaying %i logs with %i jobs' % (len(jobs), args.jobs))
+
+    start = time.time()
+    pool = multiprocessing.pool.ThreadPool(max(1, args.jobs))
+    results = []
+    for log_file, elapsed, stats in pool.imap(replay, jobs):
+        print('%-50s %s (%.1f s)' % (os.path.basename(log_file), 'ok' if stats else 'FAILED', elapsed))
+        results.append((log_file, stats))
+    pool.close()
+    pool.join()
+    wall_time = time.time() - start
+
+    failed = 0
+    log_time = 0.0
+    header_written = False
+    with open(output, 'w') as f:
+        for log_file, stats in results:
+            if stats is None:
+                failed += 1
+                continue
+            if not header_written:
+                f.write('log,' + ','.join(name for name, _ in stats) + '\n')
+                header_written = True
+            f.write(os.path.basename(log_file) + ',' + ','.join(value for _, value in stats) + '\n')
+            log_time += float(dict(stats)['log_duration_s'])
+
+    print('%i logs, %i failed, summary written to %s' % (len(results), failed, output))
+    print('%.2f log hours in %.2f min: %.2f log hours per minute' %
+          (log_time / 3600.0, wall_time / 60.0, log_time / 3600.0 / (wall_time / 60.0)))
+
+    if failed > 0:
+        sys.exit(2)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+"""Measure the boot time of the POSIX build
+
+Usage: python posix_boot_time.py [-n <runs>] [-b <build dir>] [-t <timeout s>] <startup file>
+
+    Starts px4 <runs> times with <startup file> (e.g.
+    posix-configs/SITL/init/rcS_gazebo_iris) and reports the time until the
+    startup script has started all the modules, as printed by px4, and the time
+    from launching the process to that line. px4 is stopped after each run.
+
+    -n  number of runs (default: 10)
+    -b  build directory of the posix target (default: build_posix_sitl_default)
+    -t  timeout per run in seconds (default: 30)"""
+
+import argparse
+import os
+import re
+import signal
+import subprocess
+import sys
+import time
+
+DONE_RE = re.compile(r'Startup script done in ([0-9.]+) ms')
+
+
+def run(px4, posix_dir, startup, timeout):
+    """Boot px4 once, return (script ms, launch to done ms) or None"""
+    start = time.time()
+    process = subprocess.Popen([px4, '-d', startup], cwd=posix_dir,
+                               stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                               universal_newlines=True)
+    result = None
+
+    try:
+        for line in iter(process.stdout.readline, ''):
+            match = DONE_RE.search(line)
+            if match:
+                result = (float(match.group(1)), (time.time() - start) * 1000.0)
+                break
+            if time.time() - start > timeout:
+                break
+    finally:
+        process.send_signal(signal.SIGINT)
+        time.sleep(0.5)
+        if process.poll() is None:
+            process.kill()
+        process.wait()
+
+    return result
+
+
+def stats(values):
+    values = sorted(values)
+    return values[0], values[len(values) // 2], values[-1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the boot time of the POSIX build')
+    parser.add_argument('startup', help='startup file')
+    parser.add_argument('-n', '--runs', type=int, default=10, help='number of runs')
+    parser.add_argument('-b', '--build', default='build_posix_sitl_default', help='posix build directory')
+    parser.add_argument('-t', '--timeout', type=float, default=30, help='timeout per run [s]')
+    args = parser.parse_args()
+
+    posix_dir = os.path.abspath(os.path.join(args.build, 'src', 'firmware', 'posix'))
+    px4 = os.path.join(posix_dir, 'px4')
+    if not os.path.isfile(px4):
+        print('%s not found, build the posix target first' % px4, file=sys.stderr)
+        sys.exit(1)
+
+    startup = os.path.abspath(args.startup)
+    for d in ['rootfs/fs/microsd', 'rootfs/eeprom']:
+        if not os.path.isdir(os.path.join(posix_dir, d)):
+            os.makedirs(os.path.join(posix_dir, d))
+
+    script = []
+    total = []
+    for i in range(args.runs):
+        result = run(px4, posix_dir, startup, args.timeout)
+        if result is None:
+            print('run %i: no startup time reported' % i, file=sys.stderr)
+            continue
+        print('run %i: startup script %.1f ms, launch to done %.1f ms' % (i, result[0], result[1]))
+        script.append(result[0])
+        total.append(result[1])
+
+    if len(script) == 0:
+        sys.exit(2)
+
+    print('startup script [ms]: min %.1f median %.1f max %.1f' % stats(script))
+    print('launch to done [ms]: min %.1f median %.1f max %.1f' % stats(total))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,211 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+"""Decode the ENCODED_DATA messages of an ULog file written by the PX4 logger
+
+Usage: python ulog_decode.py <in.ulg> [<out.ulg>] [-s]
+
+    Writes a copy of the log where every ENCODED_DATA message is replaced by
+    the DATA message it encodes, so that it can be read by any ULog reader.
+
+    -s  Print the compression ratio per logged message."""
+
+import struct
+import sys
+
+MSG_HEADER_LEN = 3
+FILE_HEADER_LEN = 16
+
+MSG_TYPE_DATA = ord('D')
+MSG_TYPE_ADD_LOGGED_MSG = ord('A')
+MSG_TYPE_ENCODED_DATA = ord('E')
+
+ENCODING_DELTA = 0x01
+ENCODING_LZ = 0x02
+
+
+class DecodeError(Exception):
+    pass
+
+
+def lz_decompress(src, size):
+    """Decompress an LZ block (see src/modules/logger/encoding.h)"""
+    dst = bytearray()
+    pos = 0
+
+    while pos < len(src):
+        token = src[pos]
+        pos += 1
+        literals = token >> 4
+
+        if literals == 15:
+            while True:
+                if pos >= len(src):
+                    raise DecodeError('truncated literal length')
+                b = src[pos]
+                pos += 1
+                literals += b
+                if b != 255:
+                    break
+
+        if pos + literals > len(src):
+            raise DecodeError('truncated literals')
+        dst += src[pos:pos + literals]
+        pos += literals
+
+        if pos == len(src):
+            break
+
+        if pos + 2 > len(src):
+            raise DecodeError('truncated offset')
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        match = (token & 0xf) + 4
+
+        if (token & 0xf) == 15:
+            while True:
+                if pos >= len(src):
+                    raise DecodeError('truncated match length')
+                b = src[pos]
+                pos += 1
+                match += b
+                if b != 255:
+                    break
+
+        if offset == 0 or offset > len(dst):
+            raise DecodeError('invalid offset')
+
+        # byte by byte: the match can overlap the output
+        for _ in range(match):
+            dst.append(dst[-offset])
+
+    if len(dst) != size:
+        raise DecodeError('decoded size %i, expected %i' % (len(dst), size))
+    return dst
+
+
+class ULogDecoder:
+    def __init__(self):
+        self.previous = {}  # msg_id -> last decoded payload
+        self.names = {}  # msg_id -> 'topic_name[multi_id]'
+        self.raw_bytes = {}
+        self.encoded_bytes = {}
+        self.errors = 0
+
+    def decode(self, data):
+        """Decode a complete file, return the decoded file content"""
+        if len(data) < FILE_HEADER_LEN or data[0:4] != b'ULog':
+            raise DecodeError('not an ULog file')
+
+        out = bytearray(data[0:FILE_HEADER_LEN])
+        pos = FILE_HEADER_LEN
+
+        while pos + MSG_HEADER_LEN <= len(data):
+            msg_size, msg_type = struct.unpack_from('<HB', data, pos)
+            end = pos + MSG_HEADER_LEN + msg_size
+            if end > len(data):
+                break  # truncated last message
+            body = data[pos + MSG_HEADER_LEN:end]
+
+            if msg_type == MSG_TYPE_ENCODED_DATA:
+                msg = self._decode_message(body)
+                if msg is not None:
+                    out += msg
+
+            else:
+                if msg_type == MSG_TYPE_DATA:
+                    msg_id = struct.unpack_from('<H', body, 0)[0]
+                    self.previous[msg_id] = bytearray(body[2:])
+                    self._count(msg_id, len(body) + MSG_HEADER_LEN, len(body) + MSG_HEADER_LEN)
+
+                elif msg_type == MSG_TYPE_ADD_LOGGED_MSG:
+                    multi_id, msg_id = struct.unpack_from('<BH', body, 0)
+                    name = bytes(body[3:]).split(b'\0')[0].decode('ascii', 'replace')
+                    self.names[msg_id] = '%s[%i]' % (name, multi_id)
+                    self.previous.pop(msg_id, None)
+
+                out += data[pos:end]
+
+            pos = end
+
+        return out
+
+    def _decode_message(self, body):
+        msg_id, encoding, size = struct.unpack_from('<HBH', body, 0)
+        payload = bytearray(body[5:])
+
+        try:
+            if encoding & ENCODING_LZ:
+                payload = lz_decompress(payload, size)
+            elif len(payload) != size:
+                raise DecodeError('wrong size')
+
+            if encoding & ENCODING_DELTA:
+                previous = self.previous.get(msg_id)
+                if previous is None or len(previous) != size:
+                    raise DecodeError('delta without previous sample')
+                payload = bytearray(a ^ b for a, b in zip(payload, previous))
+
+        except DecodeError as e:
+            # the following deltas are lost as well, until the next keyframe
+            self.previous.pop(msg_id, None)
+            self.errors += 1
+            print('msg_id %i: %s' % (msg_id, e), file=sys.stderr)
+            return None
+
+        self.previous[msg_id] = payload
+        self._count(msg_id, size + 2 + MSG_HEADER_LEN, len(body) + MSG_HEADER_LEN)
+        return struct.pack('<HBH', size + 2, MSG_TYPE_DATA, msg_id) + payload
+
+    def _count(self, msg_id, raw, encoded):
+        self.raw_bytes[msg_id] = self.raw_bytes.get(msg_id, 0) + raw
+        self.encoded_bytes[msg_id] = self.encoded_bytes.get(msg_id, 0) + encoded
+
+    def print_statistics(self):
+        total_raw = 0
+        total_encoded = 0
+        for msg_id in sorted(self.raw_bytes):
+            raw = self.raw_bytes[msg_id]
+            encoded = self.encoded_bytes[msg_id]
+            total_raw += raw
+            total_encoded += encoded
+            print('%-36s %10i B -> %10i B  ratio %5.3f' %
+                  (self.names.get(msg_id, 'msg_id %i' % msg_id), raw, encoded, float(encoded) / raw))
+        if total_raw > 0:
+            print('%-36s %10i B -> %10i B  ratio %5.3f' %
+                  ('total data', total_raw, total_encoded, float(total_encoded) / total_raw))
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith('-')]
+    show_statistics = '-s' in sys.argv[1:]
+
+    if len(args) < 1 or len(args) > 2 or (len(args) == 1 and not show_statistics):
+        print(__doc__)
+        sys.exit(1)
+
+    with open(args[0], 'rb') as f:
+        data = bytearray(f.read())
+
+    decoder = ULogDecoder()
+    try:
+        out = decoder.decode(data)
+    except DecodeError as e:
+        print('%s: %s' % (args[0], e), file=sys.stderr)
+        sys.exit(1)
+
+    if len(args) == 2:
+        with open(args[1], 'wb') as f:
+            f.write(out)
+
+    if show_statistics:
+        decoder.print_statistics()
+
+    if decoder.errors > 0:
+        print('%i messages could not be decoded' % decoder.errors, file=sys.stderr)
+        sys.exit(2)
+
+
+if __name__ == '__main__':
+    main()
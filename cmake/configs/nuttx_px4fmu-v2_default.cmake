@@ -106,6 +106,7 @@ set(config_module_list
 	modules/impact_detection
 	modules/impact_characterization
 	modules/recovery_stage
+	modules/impact_recovery
 
 	#
 	# Vehicle Control
@@ -121,6 +122,7 @@ set(config_module_list
 	#
 	#modules/logger
 	modules/sdlog2
+	modules/flight_recorder
 
 	#
 	# Library modules
@@ -148,6 +150,7 @@ set(config_module_list
 	lib/tailsitter_recovery
 	lib/DriverFramework/framework
 	lib/eFLL
+	lib/impact_recovery
 	platforms/nuttx
 
 	# had to add for cmake, not sure why wasn't in original config
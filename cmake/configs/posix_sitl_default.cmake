@@ -38,6 +38,7 @@ set(config_module_list
 	modules/dataman
 	modules/ekf2
 	modules/ekf_att_pos_estimator
+	modules/flight_recorder
 	modules/fw_att_control
 	modules/fw_pos_control_l1
 	modules/land_detector
@@ -58,8 +59,15 @@ set(config_module_list
 	modules/systemlib
 	modules/systemlib/mixer
 	modules/uORB
+	modules/ulog_export
 	modules/vtol_att_control
 
+	#custom
+	modules/impact_detection
+	modules/impact_characterization
+	modules/recovery_stage
+	modules/impact_recovery
+
 	lib/controllib
 	lib/conversion
 	lib/DriverFramework/framework
@@ -74,6 +82,8 @@ set(config_module_list
 	lib/runway_takeoff
 	lib/tailsitter_recovery
 	lib/terrain_estimation
+	lib/eFLL
+	lib/impact_recovery
 
 	examples/px4_simple_app
 
@@ -88,6 +98,8 @@ set(config_module_list
 	modules/unit_test
 	modules/uORB/uORB_tests
 	systemcmds/tests
+	platforms/posix/tests/hrt_test
+	platforms/posix/tests/wqueue
 
 	)
 
@@ -57,8 +57,9 @@ int px4_errno;
 struct px4_dev_t {
 	char *name;
 	void *cdev;
+	uint32_t hash;
 
-	px4_dev_t(const char *n, void *c) : cdev(c)
+	px4_dev_t(const char *n, void *c, uint32_t h) : cdev(c), hash(h)
 	{
 		name = strdup(n);
 	}
@@ -73,6 +74,124 @@ private:
 static px4_dev_t *devmap[PX4_MAX_DEV];
 pthread_mutex_t devmutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Name index of devmap, protected by devmutex: open addressing with linear
+ * probing. The entries are devmap slots, or one of the markers below. The
+ * index is at most half full, plus a quarter of deleted entries, so a probe
+ * always ends on an empty entry.
+ */
+#define PX4_DEV_INDEX_SIZE 1024
+#define DEV_INDEX_EMPTY -1
+#define DEV_INDEX_DELETED -2
+static int16_t devindex[PX4_DEV_INDEX_SIZE];
+static unsigned devindex_deleted = 0;
+
+/* free devmap slots, lowest on top */
+static int16_t devfree[PX4_MAX_DEV];
+static int devfree_count = -1;
+
+static void dev_registry_init()
+{
+	if (devfree_count >= 0) {
+		return;
+	}
+
+	for (int i = 0; i < PX4_DEV_INDEX_SIZE; ++i) {
+		devindex[i] = DEV_INDEX_EMPTY;
+	}
+
+	for (int i = 0; i < PX4_MAX_DEV; ++i) {
+		devfree[i] = PX4_MAX_DEV - 1 - i;
+	}
+
+	devfree_count = PX4_MAX_DEV;
+}
+
+/* FNV-1a */
+static uint32_t dev_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	for (const char *c = name; *c != '\0'; c++) {
+		hash ^= (uint8_t)(*c);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**
+ * Find a device by name
+ * @return position in devindex, -1 if not registered
+ */
+static int dev_index_find(const char *name, uint32_t hash)
+{
+	for (unsigned i = hash % PX4_DEV_INDEX_SIZE;; i = (i + 1) % PX4_DEV_INDEX_SIZE) {
+		int slot = devindex[i];
+
+		if (slot == DEV_INDEX_EMPTY) {
+			return -1;
+		}
+
+		if (slot >= 0 && devmap[slot]->hash == hash && strcmp(devmap[slot]->name, name) == 0) {
+			return i;
+		}
+	}
+}
+
+static void dev_index_insert(int slot)
+{
+	unsigned i = devmap[slot]->hash % PX4_DEV_INDEX_SIZE;
+
+	while (devindex[i] >= 0) {
+		i = (i + 1) % PX4_DEV_INDEX_SIZE;
+	}
+
+	if (devindex[i] == DEV_INDEX_DELETED) {
+		devindex_deleted--;
+	}
+
+	devindex[i] = slot;
+}
+
+/**
+ * Unregister a device by name
+ * @return true if it was registered
+ */
+static bool dev_remove(const char *name)
+{
+	dev_registry_init();
+
+	int i = dev_index_find(name, dev_name_hash(name));
+
+	if (i < 0) {
+		return false;
+	}
+
+	int slot = devindex[i];
+	delete devmap[slot];
+	devmap[slot] = NULL;
+	devindex[i] = DEV_INDEX_DELETED;
+	devfree[devfree_count++] = slot;
+
+	// rebuild the index when deleted entries start to lengthen the probes
+	if (++devindex_deleted > PX4_DEV_INDEX_SIZE / 4) {
+		for (int j = 0; j < PX4_DEV_INDEX_SIZE; ++j) {
+			devindex[j] = DEV_INDEX_EMPTY;
+		}
+
+		devindex_deleted = 0;
+
+		for (int j = 0; j < PX4_MAX_DEV; ++j) {
+			if (devmap[j]) {
+				dev_index_insert(j);
+			}
+		}
+	}
+
+	return true;
+}
+
 /*
  * The standard NuttX operation dispatch table can't call C++ member functions
  * directly, so we have to bounce them through this dispatch table.
@@ -145,25 +264,24 @@ VDev::register_driver(const char *name, void *data)
 		return -EINVAL;
 	}
 
-	// Make sure the device does not already exist
-	// FIXME - convert this to a map for efficiency
-
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && (strcmp(devmap[i]->name, name) == 0)) {
-			pthread_mutex_unlock(&devmutex);
-			return -EEXIST;
-		}
+	dev_registry_init();
+
+	const uint32_t hash = dev_name_hash(name);
+
+	// Make sure the device does not already exist
+	if (dev_index_find(name, hash) >= 0) {
+		pthread_mutex_unlock(&devmutex);
+		return -EEXIST;
 	}
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] == NULL) {
-			devmap[i] = new px4_dev_t(name, (void *)data);
-			PX4_DEBUG("Registered DEV %s", name);
-			ret = PX4_OK;
-			break;
-		}
+	if (devfree_count > 0) {
+		int slot = devfree[--devfree_count];
+		devmap[slot] = new px4_dev_t(name, (void *)data, hash);
+		dev_index_insert(slot);
+		PX4_DEBUG("Registered DEV %s", name);
+		ret = PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -187,14 +305,9 @@ VDev::unregister_driver(const char *name)
 
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && (strcmp(name, devmap[i]->name) == 0)) {
-			delete devmap[i];
-			devmap[i] = NULL;
-			PX4_DEBUG("Unregistered DEV %s", name);
-			ret = PX4_OK;
-			break;
-		}
+	if (dev_remove(name)) {
+		PX4_DEBUG("Unregistered DEV %s", name);
+		ret = PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -211,14 +324,10 @@ VDev::unregister_class_devname(const char *class_devname, unsigned class_instanc
 
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && strcmp(devmap[i]->name, name) == 0) {
-			delete devmap[i];
-			PX4_DEBUG("Unregistered class DEV %s", name);
-			devmap[i] = NULL;
-			pthread_mutex_unlock(&devmutex);
-			return PX4_OK;
-		}
+	if (dev_remove(name)) {
+		PX4_DEBUG("Unregistered class DEV %s", name);
+		pthread_mutex_unlock(&devmutex);
+		return PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -410,6 +519,7 @@ VDev::poll(file_t *filep, px4_pollfd_struct_t *fds, bool setup)
 
 			/* yes? post the notification */
 			if (fds->revents != 0) {
+				px4_poll_lockstep_notify();
 				px4_sem_post(fds->sem);
 			}
 
@@ -460,6 +570,7 @@ VDev::poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events)
 	/* if the state is now interesting, wake the waiter if it's still asleep */
 	/* XXX semcount check here is a vile hack; counting semphores should not be abused as cvars */
 	if ((fds->revents != 0) && (value <= 0)) {
+		px4_poll_lockstep_notify();
 		px4_sem_post(fds->sem);
 	}
 }
@@ -514,23 +625,21 @@ VDev::remove_poll_waiter(px4_pollfd_struct_t *fds)
 VDev *VDev::getDev(const char *path)
 {
 	PX4_DEBUG("VDev::getDev");
-	int i = 0;
+	VDev *dev = NULL;
 
 	pthread_mutex_lock(&devmutex);
 
-	for (; i < PX4_MAX_DEV; ++i) {
-		//if (devmap[i]) {
-		//	printf("%s %s\n", devmap[i]->name, path);
-		//}
-		if (devmap[i] && (strcmp(devmap[i]->name, path) == 0)) {
-			pthread_mutex_unlock(&devmutex);
-			return (VDev *)(devmap[i]->cdev);
-		}
+	dev_registry_init();
+
+	int i = dev_index_find(path, dev_name_hash(path));
+
+	if (i >= 0) {
+		dev = (VDev *)(devmap[devindex[i]]->cdev);
 	}
 
 	pthread_mutex_unlock(&devmutex);
 
-	return NULL;
+	return dev;
 }
 
 void VDev::showDevices()
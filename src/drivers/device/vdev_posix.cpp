@@ -57,36 +57,65 @@ px4_sem_t lockstep_sem;
 bool sim_lockstep = false;
 bool sim_delay = false;
 
+/* poll lockstep: number of poll wakeups whose thread has not yet returned to px4_poll() */
+static bool poll_lockstep = false;
+static int poll_lockstep_pending = 0;
+static pthread_mutex_t poll_lockstep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poll_lockstep_cond = PTHREAD_COND_INITIALIZER;
+static __thread int poll_lockstep_owed = 0; ///< wakeups this thread handled since its last px4_poll()
+
 extern "C" {
 
 #define PX4_MAX_FD 300
+	/*
+	 * An fd is valid while its filemap entry is set, which is read without a
+	 * lock. The file_t of an fd is reused by the next open of the fd. The free
+	 * fds are kept as a stack, lowest on top, protected by filemutex.
+	 */
 	static device::file_t *filemap[PX4_MAX_FD] = {};
+	static device::file_t filetable[PX4_MAX_FD];
+	static int fdfree[PX4_MAX_FD];
+	static int fdfree_count = -1;
 
 	int px4_errno;
 
-	inline bool valid_fd(int fd)
+	inline device::file_t *get_file(int fd)
 	{
-		pthread_mutex_lock(&filemutex);
-		bool ret = (fd < PX4_MAX_FD && fd >= 0 && filemap[fd] != NULL);
-		pthread_mutex_unlock(&filemutex);
-		return ret;
+		if (fd < 0 || fd >= PX4_MAX_FD) {
+			return nullptr;
+		}
+
+		return __atomic_load_n(&filemap[fd], __ATOMIC_ACQUIRE);
 	}
 
-	inline VDev *get_vdev(int fd)
+	static int alloc_fd()
 	{
+		int fd = -1;
+
 		pthread_mutex_lock(&filemutex);
-		bool valid = (fd < PX4_MAX_FD && fd >= 0 && filemap[fd] != NULL);
-		VDev *dev;
 
-		if (valid) {
-			dev = (VDev *)(filemap[fd]->vdev);
+		if (fdfree_count < 0) {
+			for (int i = 0; i < PX4_MAX_FD; ++i) {
+				fdfree[i] = PX4_MAX_FD - 1 - i;
+			}
 
-		} else {
-			dev = nullptr;
+			fdfree_count = PX4_MAX_FD;
+		}
+
+		if (fdfree_count > 0) {
+			fd = fdfree[--fdfree_count];
 		}
 
 		pthread_mutex_unlock(&filemutex);
-		return dev;
+
+		return fd;
+	}
+
+	static void free_fd(int fd)
+	{
+		pthread_mutex_lock(&filemutex);
+		fdfree[fdfree_count++] = fd;
+		pthread_mutex_unlock(&filemutex);
 	}
 
 	int px4_open(const char *path, int flags, ...)
@@ -94,7 +123,7 @@ extern "C" {
 		PX4_DEBUG("px4_open");
 		VDev *dev = VDev::getDev(path);
 		int ret = 0;
-		int i;
+		int fd = -1;
 		mode_t mode;
 
 		if (!dev && (flags & (PX4_F_WRONLY | PX4_F_CREAT)) != 0 &&
@@ -112,19 +141,19 @@ extern "C" {
 
 		if (dev) {
 
-			pthread_mutex_lock(&filemutex);
+			fd = alloc_fd();
 
-			for (i = 0; i < PX4_MAX_FD; ++i) {
-				if (filemap[i] == 0) {
-					filemap[i] = new device::file_t(flags, dev, i);
-					break;
-				}
-			}
+			if (fd >= 0) {
+				device::file_t *filep = &filetable[fd];
+				*filep = device::file_t(flags, dev, fd);
+				ret = dev->open(filep);
 
-			pthread_mutex_unlock(&filemutex);
+				if (ret < 0) {
+					free_fd(fd);
 
-			if (i < PX4_MAX_FD) {
-				ret = dev->open(filemap[i]);
+				} else {
+					__atomic_store_n(&filemap[fd], filep, __ATOMIC_RELEASE);
+				}
 
 			} else {
 
@@ -155,21 +184,24 @@ extern "C" {
 			return -1;
 		}
 
-		PX4_DEBUG("px4_open fd = %d", filemap[i]->fd);
-		return filemap[i]->fd;
+		PX4_DEBUG("px4_open fd = %d", fd);
+		return fd;
 	}
 
 	int px4_close(int fd)
 	{
 		int ret;
 
-		VDev *dev = get_vdev(fd);
+		// only one of concurrent closes gets the file
+		device::file_t *filep = nullptr;
 
-		if (dev) {
-			pthread_mutex_lock(&filemutex);
-			ret = dev->close(filemap[fd]);
-			filemap[fd] = nullptr;
-			pthread_mutex_unlock(&filemutex);
+		if (fd >= 0 && fd < PX4_MAX_FD) {
+			filep = __atomic_exchange_n(&filemap[fd], nullptr, __ATOMIC_ACQ_REL);
+		}
+
+		if (filep) {
+			ret = ((VDev *)filep->vdev)->close(filep);
+			free_fd(fd);
 			PX4_DEBUG("px4_close fd = %d", fd);
 
 		} else {
@@ -188,11 +220,11 @@ extern "C" {
 	{
 		int ret;
 
-		VDev *dev = get_vdev(fd);
+		device::file_t *filep = get_file(fd);
 
-		if (dev) {
+		if (filep) {
 			PX4_DEBUG("px4_read fd = %d", fd);
-			ret = dev->read(filemap[fd], (char *)buffer, buflen);
+			ret = ((VDev *)filep->vdev)->read(filep, (char *)buffer, buflen);
 
 		} else {
 			ret = -EINVAL;
@@ -210,11 +242,11 @@ extern "C" {
 	{
 		int ret;
 
-		VDev *dev = get_vdev(fd);
+		device::file_t *filep = get_file(fd);
 
-		if (dev) {
+		if (filep) {
 			PX4_DEBUG("px4_write fd = %d", fd);
-			ret = dev->write(filemap[fd], (const char *)buffer, buflen);
+			ret = ((VDev *)filep->vdev)->write(filep, (const char *)buffer, buflen);
 
 		} else {
 			ret = -EINVAL;
@@ -233,10 +265,10 @@ extern "C" {
 		PX4_DEBUG("px4_ioctl fd = %d", fd);
 		int ret = 0;
 
-		VDev *dev = get_vdev(fd);
+		device::file_t *filep = get_file(fd);
 
-		if (dev) {
-			ret = dev->ioctl(filemap[fd], cmd, arg);
+		if (filep) {
+			ret = ((VDev *)filep->vdev)->ioctl(filep, cmd, arg);
 
 		} else {
 			ret = -EINVAL;
@@ -249,71 +281,180 @@ extern "C" {
 		return ret;
 	}
 
-	int px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout)
+	/**
+	 * Name of the calling thread, only used for error messages
+	 */
+	static const char *poll_thread_name(char *name, size_t len)
 	{
-		if (nfds == 0) {
-			PX4_WARN("px4_poll with no fds");
-			return -1;
+		name[0] = '\0';
+#ifndef __PX4_QURT
+		pthread_getname_np(pthread_self(), name, len);
+#endif
+		return name;
+	}
+
+	/**
+	 * The thread is done with the data of its previous wakeups
+	 */
+	static void poll_lockstep_settle()
+	{
+		if (poll_lockstep_owed > 0) {
+			pthread_mutex_lock(&poll_lockstep_mutex);
+			poll_lockstep_pending -= poll_lockstep_owed;
+
+			if (poll_lockstep_pending <= 0) {
+				poll_lockstep_pending = 0;
+				pthread_cond_broadcast(&poll_lockstep_cond);
+			}
+
+			pthread_mutex_unlock(&poll_lockstep_mutex);
+			poll_lockstep_owed = 0;
 		}
+	}
 
-		px4_sem_t sem;
-		int count = 0;
-		int ret = -1;
-		unsigned int i;
+	/**
+	 * Take all the pending posts of the set's semaphore
+	 * @return number of posts taken
+	 */
+	static int pollset_drain(px4_pollset_t *set)
+	{
+		int value = 0;
+		px4_sem_getvalue(&set->sem, &value);
+
+		for (int i = 0; i < value; i++) {
+			px4_sem_wait(&set->sem);
+		}
 
-		const unsigned NAMELEN = 32;
-		char thread_name[NAMELEN] = {};
+		return value > 0 ? value : 0;
+	}
 
-#ifndef __PX4_QURT
-		int nret = pthread_getname_np(pthread_self(), thread_name, NAMELEN);
+	/**
+	 * Count the ready fds. revents is only written by the device under its
+	 * lock, a stale read is caught by the semaphore post that follows it.
+	 */
+	static int pollset_count(const px4_pollset_t *set)
+	{
+		int count = 0;
 
-		if (nret || thread_name[0] == 0) {
-			PX4_WARN("failed getting thread name");
+		for (nfds_t i = 0; i < set->nfds; ++i) {
+			if (__atomic_load_n(&set->fds[i].revents, __ATOMIC_ACQUIRE) != 0) {
+				count++;
+			}
 		}
 
-#endif
+		return count;
+	}
 
-		while (sim_delay) {
-			usleep(100);
+	int px4_pollset_init(px4_pollset_t *set, px4_pollfd_struct_t *fds, nfds_t nfds)
+	{
+		if (nfds == 0) {
+			PX4_WARN("px4_poll with no fds");
+			return -1;
 		}
 
-		PX4_DEBUG("Called px4_poll timeout = %d", timeout);
-		px4_sem_init(&sem, 0, 0);
+		set->fds = fds;
+		set->nfds = nfds;
+		set->rearm = false;
+		px4_sem_init(&set->sem, 0, 0);
 
-		// Go through all fds and check them for a pollable state
+		int ret = -1;
 		bool fd_pollable = false;
 
-		for (i = 0; i < nfds; ++i) {
-			fds[i].sem     = &sem;
+		for (nfds_t i = 0; i < nfds; ++i) {
+			fds[i].sem     = &set->sem;
 			fds[i].revents = 0;
 			fds[i].priv    = NULL;
 
-			VDev *dev = get_vdev(fds[i].fd);
+			file_t *filep = get_file(fds[i].fd);
 
 			// If fd is valid
-			if (dev) {
-				PX4_DEBUG("%s: px4_poll: VDev->poll(setup) %d", thread_name, fds[i].fd);
-				ret = dev->poll(filemap[fds[i].fd], &fds[i], true);
+			if (filep) {
+				PX4_DEBUG("px4_pollset_init: VDev->poll(setup) %d", fds[i].fd);
+				ret = ((VDev *)filep->vdev)->poll(filep, &fds[i], true);
 
 				if (ret < 0) {
+					char thread_name[32];
 					PX4_WARN("%s: px4_poll() error: %s",
-						 thread_name, strerror(errno));
-					break;
-				}
+						 poll_thread_name(thread_name, sizeof(thread_name)), strerror(errno));
+
+					// not registered, the fd is skipped by wait and destroy
+					fds[i].priv = NULL;
 
-				if (ret >= 0) {
+				} else {
 					fd_pollable = true;
 				}
 			}
 		}
 
-		// If any FD can be polled, lock the semaphore and
-		// check for new data
-		if (fd_pollable) {
-			if (timeout > 0) {
+		if (!fd_pollable) {
+			px4_sem_destroy(&set->sem);
+			return ret < 0 ? ret : -1;
+		}
+
+		return 0;
+	}
 
-				// Get the current time
-				struct timespec ts;
+	int px4_pollset_wait(px4_pollset_t *set, int timeout)
+	{
+		while (sim_delay) {
+			usleep(100);
+		}
+
+		poll_lockstep_settle();
+
+		int rearm_error = 0;
+
+		// re-arm the fds returned by the previous call, the others are still armed
+		if (set->rearm) {
+			for (nfds_t i = 0; i < set->nfds; ++i) {
+				px4_pollfd_struct_t *fds = &set->fds[i];
+
+				if (fds->priv == NULL || __atomic_load_n(&fds->revents, __ATOMIC_ACQUIRE) == 0) {
+					continue;
+				}
+
+				file_t *filep = (file_t *)fds->priv;
+				VDev *dev = (VDev *)filep->vdev;
+				dev->poll(filep, fds, false);
+				fds->revents = 0;
+				int ret = dev->poll(filep, fds, true);
+
+				if (ret < 0) {
+					char thread_name[32];
+					PX4_WARN("%s: px4_poll() re-arm error: %s",
+						 poll_thread_name(thread_name, sizeof(thread_name)), strerror(-ret));
+
+					// not registered anymore, the fd is skipped by wait and destroy
+					fds->priv = NULL;
+					rearm_error = ret;
+				}
+			}
+		}
+
+		set->rearm = true;
+
+		// the fd would silently never become ready again
+		if (rearm_error < 0) {
+			errno = -rearm_error;
+			return rearm_error;
+		}
+
+		// every post of the semaphore was counted as a pending wakeup
+		int posts = pollset_drain(set);
+		int count = pollset_count(set);
+
+		if (count == 0 && timeout != 0) {
+			// going to sleep: the posts taken so far led to no data
+			if (poll_lockstep) {
+				poll_lockstep_owed += posts;
+				poll_lockstep_settle();
+			}
+
+			posts = 0;
+
+			struct timespec ts;
+
+			if (timeout > 0) {
 				// FIXME: check if QURT should probably be using CLOCK_MONOTONIC
 				px4_clock_gettime(CLOCK_REALTIME, &ts);
 
@@ -324,55 +465,85 @@ extern "C" {
 				ts.tv_sec += nsecs / billion;
 				nsecs -= (nsecs / billion) * billion;
 				ts.tv_nsec = nsecs;
+			}
 
-				// Execute a blocking wait for that time in the future
-				errno = 0;
-				ret = px4_sem_timedwait(&sem, &ts);
+			// a post can be left over from an fd that was ready before it was re-armed
+			while (count == 0) {
+				if (timeout > 0) {
+					errno = 0;
+					int ret = px4_sem_timedwait(&set->sem, &ts);
 #ifndef __PX4_DARWIN
-				ret = errno;
+					ret = errno;
 #endif
 
-				// Ensure ret is negative on failure
-				if (ret > 0) {
-					ret = -ret;
-				}
+					if (ret == ETIMEDOUT || ret == -ETIMEDOUT) {
+						break;
 
-				if (ret && ret != -ETIMEDOUT) {
-					PX4_WARN("%s: px4_poll() sem error", thread_name);
+					} else if (ret != 0 && ret != EINTR && ret != -EINTR) {
+						char thread_name[32];
+						PX4_WARN("%s: px4_poll() sem error", poll_thread_name(thread_name, sizeof(thread_name)));
+						break;
+					}
+
+					if (ret == 0) {
+						posts++;
+					}
+
+				} else {
+					px4_sem_wait(&set->sem);
+					posts++;
 				}
 
-			} else if (timeout < 0) {
-				px4_sem_wait(&sem);
+				count = pollset_count(set);
 			}
 
-			// We have waited now (or not, depending on timeout),
-			// go through all fds and count how many have data
-			for (i = 0; i < nfds; ++i) {
+			// the fds that became ready while we were waking up
+			posts += pollset_drain(set);
+		}
 
-				VDev *dev = get_vdev(fds[i].fd);
+		if (poll_lockstep) {
+			poll_lockstep_owed += posts;
+		}
 
-				// If fd is valid
-				if (dev) {
-					PX4_DEBUG("%s: px4_poll: VDev->poll(teardown) %d", thread_name, fds[i].fd);
-					ret = dev->poll(filemap[fds[i].fd], &fds[i], false);
+		return count;
+	}
 
-					if (ret < 0) {
-						PX4_WARN("%s: px4_poll() 2nd poll fail", thread_name);
-						break;
-					}
+	void px4_pollset_destroy(px4_pollset_t *set)
+	{
+		for (nfds_t i = 0; i < set->nfds; ++i) {
+			px4_pollfd_struct_t *fds = &set->fds[i];
 
-					if (fds[i].revents) {
-						count += 1;
-					}
-				}
+			if (fds->priv == NULL) {
+				continue;
 			}
+
+			file_t *filep = (file_t *)fds->priv;
+			PX4_DEBUG("px4_pollset_destroy: VDev->poll(teardown) %d", fds->fd);
+			((VDev *)filep->vdev)->poll(filep, fds, false);
+		}
+
+		if (poll_lockstep) {
+			poll_lockstep_owed += pollset_drain(set);
+		}
+
+		px4_sem_destroy(&set->sem);
+	}
+
+	int px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout)
+	{
+		PX4_DEBUG("Called px4_poll timeout = %d", timeout);
+
+		px4_pollset_t set;
+		int ret = px4_pollset_init(&set, fds, nfds);
+
+		if (ret < 0) {
+			return ret;
 		}
 
-		px4_sem_destroy(&sem);
+		ret = px4_pollset_wait(&set, timeout);
+		px4_pollset_destroy(&set);
 
-		// Return the positive count if present,
-		// return the negative error number if failed
-		return (count) ? count : ret;
+		return ret;
 	}
 
 	int px4_fsync(int fd)
@@ -428,6 +599,47 @@ extern "C" {
 		return sim_delay;
 	}
 
+	void px4_enable_poll_lockstep(bool enable)
+	{
+		pthread_mutex_lock(&poll_lockstep_mutex);
+		poll_lockstep = enable;
+		poll_lockstep_pending = 0;
+		pthread_cond_broadcast(&poll_lockstep_cond);
+		pthread_mutex_unlock(&poll_lockstep_mutex);
+	}
+
+	void px4_poll_lockstep_notify()
+	{
+		if (!poll_lockstep) {
+			return;
+		}
+
+		pthread_mutex_lock(&poll_lockstep_mutex);
+		++poll_lockstep_pending;
+		pthread_mutex_unlock(&poll_lockstep_mutex);
+	}
+
+	bool px4_poll_lockstep_wait_idle(int timeout_ms)
+	{
+		struct timespec ts;
+		px4_clock_gettime(CLOCK_REALTIME, &ts);
+		uint64_t nsecs = ts.tv_nsec + (uint64_t)timeout_ms * 1000 * 1000;
+		ts.tv_sec += nsecs / 1000000000;
+		ts.tv_nsec = nsecs % 1000000000;
+
+		pthread_mutex_lock(&poll_lockstep_mutex);
+
+		while (poll_lockstep_pending > 0) {
+			if (pthread_cond_timedwait(&poll_lockstep_cond, &poll_lockstep_mutex, &ts) == ETIMEDOUT) {
+				break;
+			}
+		}
+
+		bool idle = poll_lockstep_pending <= 0;
+		pthread_mutex_unlock(&poll_lockstep_mutex);
+		return idle;
+	}
+
 	const char *px4_get_device_names(unsigned int *handle)
 	{
 		return VDev::devList(handle);
@@ -186,6 +186,25 @@ __EXPORT extern	void	hrt_start_delay(void);
  */
 __EXPORT extern void	hrt_stop_delay(void);
 
+/**
+ * Drive the HRT from the caller (lockstep replay).
+ *
+ * Until hrt_lockstep_disable() is called, hrt_absolute_time() returns the time
+ * set with hrt_lockstep_set_time(), starting at the current time.
+ */
+__EXPORT extern void	hrt_lockstep_enable(void);
+
+/**
+ * Advance the lockstep time and run the HRT callouts that are due.
+ * The time never goes backwards.
+ */
+__EXPORT extern void	hrt_lockstep_set_time(hrt_abstime time);
+
+/**
+ * Return to real time. The HRT continues from the last lockstep time.
+ */
+__EXPORT extern void	hrt_lockstep_disable(void);
+
 #endif
 
 __END_DECLS
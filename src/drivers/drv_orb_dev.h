@@ -93,4 +93,7 @@
 /** Get the minimum interval at which the topic can be seen to be updated for this subscription */
 #define ORBIOCGETINTERVAL	_ORBIOC(16)
 
+/** Borrow a read-only view of the next message instead of copying it, fills *(struct orb_view *)arg */
+#define ORBIOCBORROW		_ORBIOC(17)
+
 #endif /* _DRV_UORB_H */
@@ -37,6 +37,9 @@ struct fuzzyRuleArray{
 };
 
 class Fuzzy {
+	// FuzzyCompiled congela as listas ligadas em vetores fixos
+	friend class FuzzyCompiled;
+
 	public:
 		// CONSTRUTORES
 		Fuzzy();
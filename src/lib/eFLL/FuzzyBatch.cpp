@@ -0,0 +1,319 @@
+/*
+ * Robotic Research Group (RRG)
+ * State University of Piaui (UESPI), Brazil - Piauí - Teresina
+ *
+ * FuzzyBatch.cpp
+ *
+ * The block loops below select between the same expressions as
+ * FuzzyCompiled::calculatePertinence and FuzzyCompiled::evaluateNode instead
+ * of branching, so every lane produces the same float as the scalar engine.
+ * Build without FMA contraction (-ffp-contract=off) to keep it that way.
+ */
+#include "FuzzyBatch.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// CONSTRUTORES
+FuzzyBatch::FuzzyBatch(){
+	for(int i = 0; i < FUZZY_COMPILED_MAX_OUTPUTS; i++){
+		this->lastValid[i] = false;
+	}
+}
+
+// MÉTODOS PÚBLICOS
+bool FuzzyBatch::compile(Fuzzy* fuzzy){
+	for(int i = 0; i < FUZZY_COMPILED_MAX_OUTPUTS; i++){
+		this->lastValid[i] = false;
+	}
+	if(this->engine.compile(fuzzy) == false){
+		return false;
+	}
+
+	for(int i = 0; i < this->engine.numSets; i++){
+		const fuzzyCompiledSet* s = &this->engine.sets[i];
+		fuzzyBatchSet* batchSet = &this->sets[i];
+		batchSet->a = s->a;
+		batchSet->b = s->b;
+		batchSet->c = s->c;
+		batchSet->d = s->d;
+		// rampas verticais geram inf aqui, mas nunca sao selecionadas
+		batchSet->rise = 1.0 / (s->b - s->a);
+		batchSet->fall = 1.0 / (s->c - s->d);
+		if(s->a == s->b && s->b != s->c && s->c != s->d){
+			batchSet->below = 1.0;
+		}else{
+			batchSet->below = 0.0;
+		}
+		if(s->c == s->d && s->c != s->b && s->b != s->a){
+			batchSet->above = 1.0;
+		}else{
+			batchSet->above = 0.0;
+		}
+	}
+	return true;
+}
+
+bool FuzzyBatch::isCompiled(){
+	return this->engine.isCompiled();
+}
+
+int FuzzyBatch::getNumInputs(){
+	return this->engine.numInputs;
+}
+
+int FuzzyBatch::getNumOutputs(){
+	return this->engine.numOutputs;
+}
+
+bool FuzzyBatch::evaluate(const float* const* inputs, float* const* outputs, int first, int count){
+	if(this->engine.isCompiled() == false || inputs == NULL || outputs == NULL || first < 0 || count < 0){
+		return false;
+	}
+
+	for(int done = 0; done < count; done += FUZZY_BATCH_BLOCK){
+		int size = count - done;
+		if(size > FUZZY_BATCH_BLOCK){
+			size = FUZZY_BATCH_BLOCK;
+		}
+		this->evaluateBlock(inputs, outputs, first + done, size);
+	}
+	return true;
+}
+
+#if defined(__linux__)
+struct fuzzyBatchTask{
+	FuzzyBatch* batch;
+	const float* const* inputs;
+	float* const* outputs;
+	int first;
+	int count;
+	bool result;
+};
+
+static void* fuzzyBatchWorker(void* arg){
+	fuzzyBatchTask* task = (fuzzyBatchTask*) arg;
+	task->result = task->batch->evaluate(task->inputs, task->outputs, task->first, task->count);
+	return NULL;
+}
+
+bool FuzzyBatch::sweep(const float* const* inputs, float* const* outputs, int count, int numThreads){
+	if(this->engine.isCompiled() == false || count < 0){
+		return false;
+	}
+
+	if(numThreads < 1){
+		numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	// cada thread recebe ao menos um bloco inteiro
+	int maxThreads = (count + FUZZY_BATCH_BLOCK - 1) / FUZZY_BATCH_BLOCK;
+	if(numThreads > maxThreads){
+		numThreads = maxThreads;
+	}
+	if(numThreads <= 1){
+		return this->evaluate(inputs, outputs, 0, count);
+	}
+
+	int blocks = (maxThreads + numThreads - 1) / numThreads;
+	int chunk = blocks * FUZZY_BATCH_BLOCK;
+
+	fuzzyBatchTask* tasks = new fuzzyBatchTask[numThreads];
+	pthread_t* threads = new pthread_t[numThreads];
+	bool* started = new bool[numThreads];
+
+	for(int i = 0; i < numThreads; i++){
+		fuzzyBatchTask* task = &tasks[i];
+		task->inputs = inputs;
+		task->outputs = outputs;
+		task->first = i * chunk;
+		task->count = count - task->first;
+		if(task->count > chunk){
+			task->count = chunk;
+		}
+		if(task->count < 0){
+			task->count = 0;
+		}
+		task->result = false;
+		started[i] = false;
+
+		// a fatia 0 roda nesta thread, sobre este objeto
+		if(i == 0){
+			task->batch = this;
+			continue;
+		}
+		task->batch = new FuzzyBatch(*this);
+		if(pthread_create(&threads[i], NULL, fuzzyBatchWorker, task) == 0){
+			started[i] = true;
+		}else{
+			fuzzyBatchWorker(task);
+		}
+	}
+
+	fuzzyBatchWorker(&tasks[0]);
+
+	bool result = true;
+	for(int i = 0; i < numThreads; i++){
+		if(started[i]){
+			pthread_join(threads[i], NULL);
+		}
+		if(i > 0){
+			delete tasks[i].batch;
+		}
+		result = result && tasks[i].result;
+	}
+
+	delete[] started;
+	delete[] threads;
+	delete[] tasks;
+	return result;
+}
+#endif
+
+// MÉTODOS PRIVADOS
+void FuzzyBatch::evaluateBlock(const float* const* inputs, float* const* outputs, int first, int count){
+	FuzzyCompiled* engine = &this->engine;
+
+	for(int i = 0; i < engine->numSets; i++){
+		float* pertinence = this->pertinences[i];
+		for(int j = 0; j < count; j++){
+			pertinence[j] = 0.0;
+		}
+	}
+
+	// Calculando a pertinência de todos os FuzzyInputs, um set por vez para o bloco inteiro
+	for(int i = 0; i < engine->numInputs; i++){
+		const fuzzyCompiledIO* input = &engine->inputs[i];
+		for(int k = input->firstSet; k < input->firstSet + input->numSets; k++){
+			this->calculatePertinences(engine->setIndexes[k], inputs[i] + first, count);
+		}
+	}
+
+	// Avaliando os antecedentes em pos-ordem
+	for(int i = 0; i < engine->numNodes; i++){
+		this->evaluateNode(i, count);
+	}
+
+	// Aplicando a força de cada regra aos conjuntos de saída
+	for(int i = 0; i < engine->numRules; i++){
+		const fuzzyCompiledRule* rule = &engine->rules[i];
+		if(rule->root == FUZZY_COMPILED_NONE){
+			continue;
+		}
+		const float* powerOfAntecedent = this->nodeValues[rule->root];
+		for(int k = rule->firstLink; k < rule->firstLink + rule->numLinks; k++){
+			float* pertinence = this->pertinences[engine->links[k]];
+			for(int j = 0; j < count; j++){
+				pertinence[j] = (pertinence[j] < powerOfAntecedent[j]) ? powerOfAntecedent[j] : pertinence[j];
+			}
+		}
+	}
+
+	// Composição e defuzzificação, amostra por amostra
+	for(int j = 0; j < count; j++){
+		for(int o = 0; o < engine->numOutputs; o++){
+			const fuzzyCompiledIO* io = &engine->outputs[o];
+			bool active = false;
+			bool repeated = this->lastValid[o];
+			for(int k = io->firstSet; k < io->firstSet + io->numSets; k++){
+				int set = engine->setIndexes[k];
+				float pertinence = this->pertinences[set][j];
+				if(pertinence > 0.0){
+					active = true;
+				}
+				if(engine->pertinences[set] != pertinence){
+					repeated = false;
+				}
+				engine->pertinences[set] = pertinence;
+			}
+			if(!active){
+				// composição vazia, avaliate() retornaria 0.0
+				outputs[o][first + j] = 0.0;
+			}else if(repeated){
+				// mesmas pertinências da última composição, mesmo resultado
+				outputs[o][first + j] = this->lastOutputs[o];
+			}else{
+				engine->truncate(o);
+				this->lastOutputs[o] = engine->avaliate(o);
+				this->lastValid[o] = true;
+				outputs[o][first + j] = this->lastOutputs[o];
+			}
+		}
+	}
+}
+
+void FuzzyBatch::calculatePertinences(int set, const float* crispValues, int count){
+	const fuzzyBatchSet s = this->sets[set];
+	float* pertinence = this->pertinences[set];
+
+	for(int j = 0; j < count; j++){
+		float crispValue = crispValues[j];
+		// slope * (x - p) fica em [-1, 0], então a soma em float é igual à soma em double do FuzzySet
+		float rise = s.rise * (crispValue - s.b) + 1.0f;
+		float fall = s.fall * (crispValue - s.c) + 1.0f;
+		// NaN não satisfaz nenhum caso e mantém a pertinência zerada, como no FuzzySet
+		float value = (crispValue > s.d) ? s.above : 0.0f;
+		value = (crispValue > s.c && crispValue <= s.d) ? fall : value;
+		value = (crispValue >= s.b && crispValue <= s.c) ? 1.0f : value;
+		value = (crispValue >= s.a && crispValue < s.b) ? rise : value;
+		value = (crispValue < s.a) ? s.below : value;
+		pertinence[j] = value;
+	}
+}
+
+void FuzzyBatch::evaluateNode(int node, int count){
+	const fuzzyCompiledNode* n = &this->engine.nodes[node];
+	float* value = this->nodeValues[node];
+	const float* first;
+	const float* second;
+
+	switch(n->mode){
+		case MODE_FS:
+			first = this->pertinences[n->set1];
+			for(int j = 0; j < count; j++){
+				value[j] = first[j];
+			}
+			return;
+		case MODE_FS_FS:
+			first = this->pertinences[n->set1];
+			second = this->pertinences[n->set2];
+			break;
+		case MODE_FS_FRA:
+			first = this->pertinences[n->set1];
+			second = this->nodeValues[n->node1];
+			break;
+		case MODE_FRA_FRA:
+			first = this->nodeValues[n->node1];
+			second = this->nodeValues[n->node2];
+			break;
+		default:
+			first = NULL;
+			second = NULL;
+			break;
+	}
+
+	switch(first == NULL ? 0 : n->op){
+		case OP_AND:
+			for(int j = 0; j < count; j++){
+				float f = first[j];
+				float g = second[j];
+				float smaller = (f < g) ? f : g;
+				value[j] = (f > 0.0f && g > 0.0f) ? smaller : 0.0f;
+			}
+			break;
+		case OP_OR:
+			for(int j = 0; j < count; j++){
+				float f = first[j];
+				float g = second[j];
+				float bigger = (f > g) ? f : g;
+				value[j] = (f > 0.0f || g > 0.0f) ? bigger : 0.0f;
+			}
+			break;
+		default:
+			for(int j = 0; j < count; j++){
+				value[j] = 0.0;
+			}
+			break;
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Robotic Research Group (RRG)
+ * State University of Piaui (UESPI), Brazil - Piauí - Teresina
+ *
+ * FuzzyBatch.h
+ *
+ * Batch evaluation of a compiled rule base for offline sweeps. Inputs and
+ * outputs are structure-of-arrays: inputs[i][n] is the crisp value of the
+ * i-th FuzzyInput (in the order they were added to the Fuzzy object) for
+ * sample n, and outputs[o][n] receives the defuzzified value of the o-th
+ * FuzzyOutput. Samples are processed in blocks of FUZZY_BATCH_BLOCK: the
+ * trapezoid pertinences, the antecedents and the rule activations of a whole
+ * block are computed with branch-free loops over contiguous arrays the
+ * compiler can vectorize, and only the composition/defuzzification runs per
+ * sample through FuzzyCompiled. Results are identical to FuzzyCompiled and
+ * therefore to Fuzzy.
+ *
+ * An instance holds several kB of block buffers; allocate it with new.
+ */
+#ifndef FUZZYBATCH_H
+#define FUZZYBATCH_H
+
+// IMPORTANDO AS BIBLIOTECAS NECESSÁRIAS
+#include "FuzzyCompiled.h"
+
+// CONSTANTES
+#define FUZZY_BATCH_BLOCK 64
+
+// Trapezio preparado para avaliacao sem desvios
+struct fuzzyBatchSet{
+	float a;
+	float b;
+	float c;
+	float d;
+	float rise;		// 1.0 / (b - a)
+	float fall;		// 1.0 / (c - d)
+	float below;	// pertinencia para crispValue < a
+	float above;	// pertinencia para crispValue > d
+};
+
+class FuzzyBatch {
+	public:
+		// CONSTRUTORES
+		FuzzyBatch();
+		// MÉTODOS PÚBLICOS
+		bool compile(Fuzzy* fuzzy);
+		bool isCompiled();
+		int getNumInputs();
+		int getNumOutputs();
+		bool evaluate(const float* const* inputs, float* const* outputs, int first, int count);
+#if defined(__linux__)
+		// divide [0, count) entre numThreads copias deste objeto
+		bool sweep(const float* const* inputs, float* const* outputs, int count, int numThreads);
+#endif
+
+	private:
+		// VARIÁVEIS PRIVADAS
+		FuzzyCompiled engine;
+		fuzzyBatchSet sets[FUZZY_COMPILED_MAX_SETS];
+		// blocos SoA: uma linha por set/no, uma coluna por amostra
+		float pertinences[FUZZY_COMPILED_MAX_SETS][FUZZY_BATCH_BLOCK];
+		float nodeValues[FUZZY_COMPILED_MAX_NODES][FUZZY_BATCH_BLOCK];
+		// última saída composta; engine.pertinences guarda as pertinências que a geraram
+		float lastOutputs[FUZZY_COMPILED_MAX_OUTPUTS];
+		bool lastValid[FUZZY_COMPILED_MAX_OUTPUTS];
+
+		// MÉTODOS PRIVADOS
+		void evaluateBlock(const float* const* inputs, float* const* outputs, int first, int count);
+		void calculatePertinences(int set, const float* crispValues, int count);
+		void evaluateNode(int node, int count);
+};
+#endif
@@ -0,0 +1,651 @@
+/*
+ * Robotic Research Group (RRG)
+ * State University of Piaui (UESPI), Brazil - Piauí - Teresina
+ *
+ * FuzzyCompiled.cpp
+ *
+ * The inference and composition code below mirrors FuzzySet::calculatePertinence,
+ * FuzzyRuleAntecedent::evaluate, FuzzyOutput::truncate and FuzzyComposition
+ * expression by expression, so both engines produce identical floats.
+ */
+#include "FuzzyCompiled.h"
+
+// CONSTRUTORES
+FuzzyCompiled::FuzzyCompiled(){
+	this->compiled = false;
+	this->numSets = 0;
+	this->numSetIndexes = 0;
+	this->numInputs = 0;
+	this->numOutputs = 0;
+	this->numNodes = 0;
+	this->numLinks = 0;
+	this->numRules = 0;
+}
+
+// MÉTODOS PÚBLICOS
+bool FuzzyCompiled::compile(Fuzzy* fuzzy){
+	this->compiled = false;
+	this->numSets = 0;
+	this->numSetIndexes = 0;
+	this->numInputs = 0;
+	this->numOutputs = 0;
+	this->numNodes = 0;
+	this->numLinks = 0;
+	this->numRules = 0;
+
+	if(fuzzy == NULL){
+		return false;
+	}
+
+	fuzzyInputArray* fuzzyInputAux = fuzzy->fuzzyInputs;
+	while(fuzzyInputAux != NULL){
+		if(this->numInputs >= FUZZY_COMPILED_MAX_INPUTS){
+			return false;
+		}
+		if(this->compileIO(fuzzyInputAux->fuzzyInput, &this->inputs[this->numInputs], FUZZY_COMPILED_MAX_SETS) < 0){
+			return false;
+		}
+		this->numInputs++;
+		fuzzyInputAux = fuzzyInputAux->next;
+	}
+
+	fuzzyOutputArray* fuzzyOutputAux = fuzzy->fuzzyOutputs;
+	while(fuzzyOutputAux != NULL){
+		if(this->numOutputs >= FUZZY_COMPILED_MAX_OUTPUTS){
+			return false;
+		}
+		if(this->compileIO(fuzzyOutputAux->fuzzyOutput, &this->outputs[this->numOutputs], FUZZY_COMPILED_MAX_OUTPUT_SETS) < 0){
+			return false;
+		}
+		this->emptyComposition(&this->compositions[this->numOutputs]);
+		this->numOutputs++;
+		fuzzyOutputAux = fuzzyOutputAux->next;
+	}
+
+	fuzzyRuleArray* fuzzyRuleAux = fuzzy->fuzzyRules;
+	while(fuzzyRuleAux != NULL){
+		if(this->numRules >= FUZZY_COMPILED_MAX_RULES){
+			return false;
+		}
+		FuzzyRule* fuzzyRule = fuzzyRuleAux->fuzzyRule;
+		fuzzyCompiledRule* rule = &this->rules[this->numRules];
+		rule->index = fuzzyRule->index;
+		rule->fired = false;
+		rule->root = FUZZY_COMPILED_NONE;
+		rule->firstLink = this->numLinks;
+		rule->numLinks = 0;
+
+		if(fuzzyRule->fuzzyRuleAntecedent != NULL && fuzzyRule->fuzzyRuleConsequent != NULL){
+			int root = this->compileAntecedent(fuzzyRule->fuzzyRuleAntecedent, 0);
+			if(root < 0){
+				return false;
+			}
+			rule->root = root;
+
+			fuzzySetOutputArray* linkAux = fuzzyRule->fuzzyRuleConsequent->fuzzySetOutputs;
+			while(linkAux != NULL){
+				int set = this->findOrAddSet(linkAux->fuzzySet);
+				if(set < 0 || this->numLinks >= FUZZY_COMPILED_MAX_LINKS){
+					return false;
+				}
+				this->links[this->numLinks++] = set;
+				rule->numLinks++;
+				linkAux = linkAux->next;
+			}
+		}
+		this->numRules++;
+		fuzzyRuleAux = fuzzyRuleAux->next;
+	}
+
+	for(int i = 0; i < this->numSets; i++){
+		this->pertinences[i] = 0.0;
+	}
+
+	this->compiled = true;
+	return true;
+}
+
+bool FuzzyCompiled::isCompiled(){
+	return this->compiled;
+}
+
+bool FuzzyCompiled::setInput(int fuzzyInputIndex, float crispValue){
+	for(int i = 0; i < this->numInputs; i++){
+		if(this->inputs[i].index == fuzzyInputIndex){
+			this->inputs[i].crispInput = crispValue;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FuzzyCompiled::fuzzify(){
+	if(!this->compiled){
+		return false;
+	}
+
+	for(int i = 0; i < this->numSets; i++){
+		this->pertinences[i] = 0.0;
+	}
+
+	// Calculando a pertinência de todos os FuzzyInputs
+	for(int i = 0; i < this->numInputs; i++){
+		const fuzzyCompiledIO* input = &this->inputs[i];
+		for(int j = input->firstSet; j < input->firstSet + input->numSets; j++){
+			this->calculatePertinence(this->setIndexes[j], input->crispInput);
+		}
+	}
+
+	// Avaliando os antecedentes em pos-ordem, cada no uma unica vez
+	for(int i = 0; i < this->numNodes; i++){
+		this->nodeValues[i] = this->evaluateNode(&this->nodes[i]);
+	}
+
+	// Avaliando quais regras foram disparadas
+	for(int i = 0; i < this->numRules; i++){
+		fuzzyCompiledRule* rule = &this->rules[i];
+		if(rule->root == FUZZY_COMPILED_NONE){
+			continue;
+		}
+		float powerOfAntecedent = this->nodeValues[rule->root];
+
+		(powerOfAntecedent > 0.0) ? (rule->fired = true) : (rule->fired = false);
+
+		for(int j = rule->firstLink; j < rule->firstLink + rule->numLinks; j++){
+			if(this->pertinences[this->links[j]] < powerOfAntecedent){
+				this->pertinences[this->links[j]] = powerOfAntecedent;
+			}
+		}
+	}
+
+	// Truncado os conjuntos de saída
+	for(int i = 0; i < this->numOutputs; i++){
+		this->truncate(i);
+	}
+
+	return true;
+}
+
+bool FuzzyCompiled::isFiredRule(int fuzzyRuleIndex){
+	for(int i = 0; i < this->numRules; i++){
+		if(this->rules[i].index == fuzzyRuleIndex){
+			return this->rules[i].fired;
+		}
+	}
+	return false;
+}
+
+float FuzzyCompiled::defuzzify(int fuzzyOutputIndex){
+	for(int i = 0; i < this->numOutputs; i++){
+		if(this->outputs[i].index == fuzzyOutputIndex){
+			return this->avaliate(i);
+		}
+	}
+	return 0;
+}
+
+// MÉTODOS PRIVADOS
+int FuzzyCompiled::findOrAddSet(FuzzySet* fuzzySet){
+	if(fuzzySet == NULL){
+		return FUZZY_COMPILED_NONE;
+	}
+	for(int i = 0; i < this->numSets; i++){
+		if(this->setSources[i] == fuzzySet){
+			return i;
+		}
+	}
+	if(this->numSets >= FUZZY_COMPILED_MAX_SETS){
+		return FUZZY_COMPILED_NONE;
+	}
+	this->setSources[this->numSets] = fuzzySet;
+	this->sets[this->numSets].a = fuzzySet->getPointA();
+	this->sets[this->numSets].b = fuzzySet->getPointB();
+	this->sets[this->numSets].c = fuzzySet->getPointC();
+	this->sets[this->numSets].d = fuzzySet->getPointD();
+	return this->numSets++;
+}
+
+int FuzzyCompiled::compileIO(FuzzyIO* fuzzyIO, fuzzyCompiledIO* compiledIO, int maxSets){
+	compiledIO->index = fuzzyIO->getIndex();
+	compiledIO->crispInput = 0.0;
+	compiledIO->firstSet = this->numSetIndexes;
+	compiledIO->numSets = 0;
+
+	fuzzySetArray* aux = fuzzyIO->fuzzySets;
+	while(aux != NULL){
+		if(aux->fuzzySet != NULL){
+			int set = this->findOrAddSet(aux->fuzzySet);
+			int capacity = (int)(sizeof(this->setIndexes) / sizeof(this->setIndexes[0]));
+			if(set < 0 || compiledIO->numSets >= maxSets || this->numSetIndexes >= capacity){
+				return FUZZY_COMPILED_NONE;
+			}
+			this->setIndexes[this->numSetIndexes++] = set;
+			compiledIO->numSets++;
+		}
+		aux = aux->next;
+	}
+	return compiledIO->numSets;
+}
+
+int FuzzyCompiled::compileAntecedent(FuzzyRuleAntecedent* fuzzyRuleAntecedent, int depth){
+	// antecedentes compartilhados entre regras sao compilados uma unica vez
+	for(int i = 0; i < this->numNodes; i++){
+		if(this->nodeSources[i] == fuzzyRuleAntecedent){
+			return i;
+		}
+	}
+	if(depth >= FUZZY_COMPILED_MAX_NODES){
+		return FUZZY_COMPILED_NONE;
+	}
+
+	fuzzyCompiledNode node;
+	node.op = fuzzyRuleAntecedent->op;
+	node.mode = fuzzyRuleAntecedent->mode;
+	node.set1 = FUZZY_COMPILED_NONE;
+	node.set2 = FUZZY_COMPILED_NONE;
+	node.node1 = FUZZY_COMPILED_NONE;
+	node.node2 = FUZZY_COMPILED_NONE;
+
+	switch(node.mode){
+		case MODE_FS:
+			node.set1 = this->findOrAddSet(fuzzyRuleAntecedent->fuzzySet1);
+			if(node.set1 < 0){
+				return FUZZY_COMPILED_NONE;
+			}
+			break;
+		case MODE_FS_FS:
+			node.set1 = this->findOrAddSet(fuzzyRuleAntecedent->fuzzySet1);
+			node.set2 = this->findOrAddSet(fuzzyRuleAntecedent->fuzzySet2);
+			if(node.set1 < 0 || node.set2 < 0){
+				return FUZZY_COMPILED_NONE;
+			}
+			break;
+		case MODE_FS_FRA:
+			node.set1 = this->findOrAddSet(fuzzyRuleAntecedent->fuzzySet1);
+			node.node1 = this->compileAntecedent(fuzzyRuleAntecedent->fuzzyRuleAntecedent1, depth + 1);
+			if(node.set1 < 0 || node.node1 < 0){
+				return FUZZY_COMPILED_NONE;
+			}
+			break;
+		case MODE_FRA_FRA:
+			node.node1 = this->compileAntecedent(fuzzyRuleAntecedent->fuzzyRuleAntecedent1, depth + 1);
+			if(node.node1 < 0){
+				return FUZZY_COMPILED_NONE;
+			}
+			node.node2 = this->compileAntecedent(fuzzyRuleAntecedent->fuzzyRuleAntecedent2, depth + 1);
+			if(node.node2 < 0){
+				return FUZZY_COMPILED_NONE;
+			}
+			break;
+		default:
+			// antecedente vazio sempre avalia para 0.0
+			break;
+	}
+
+	if(this->numNodes >= FUZZY_COMPILED_MAX_NODES){
+		return FUZZY_COMPILED_NONE;
+	}
+	this->nodes[this->numNodes] = node;
+	this->nodeSources[this->numNodes] = fuzzyRuleAntecedent;
+	return this->numNodes++;
+}
+
+void FuzzyCompiled::calculatePertinence(int set, float crispValue){
+	const fuzzyCompiledSet* s = &this->sets[set];
+	float slope;
+
+	if (crispValue < s->a){
+		if (s->a == s->b && s->b != s->c && s->c != s->d){
+			this->pertinences[set] = 1.0;
+		}else{
+			this->pertinences[set] = 0.0;
+		}
+	}else if (crispValue >= s->a && crispValue < s->b){
+		slope = 1.0 / (s->b - s->a);
+		this->pertinences[set] = slope * (crispValue - s->b) + 1.0;
+	}else if (crispValue >= s->b && crispValue <= s->c){
+		this->pertinences[set] = 1.0;
+	}else if (crispValue > s->c && crispValue <= s->d){
+		slope = 1.0 / (s->c - s->d);
+		this->pertinences[set] = slope * (crispValue - s->c) + 1.0;
+	}else if (crispValue > s->d){
+		if (s->c == s->d && s->c != s->b && s->b != s->a){
+			this->pertinences[set] = 1.0;
+		}else{
+			this->pertinences[set] = 0.0;
+		}
+	}
+}
+
+float FuzzyCompiled::evaluateNode(const fuzzyCompiledNode* node){
+	float first;
+	float second;
+
+	switch(node->mode){
+		case MODE_FS:
+			return this->pertinences[node->set1];
+		case MODE_FS_FS:
+			first = this->pertinences[node->set1];
+			second = this->pertinences[node->set2];
+			break;
+		case MODE_FS_FRA:
+			first = this->pertinences[node->set1];
+			second = this->nodeValues[node->node1];
+			break;
+		case MODE_FRA_FRA:
+			first = this->nodeValues[node->node1];
+			second = this->nodeValues[node->node2];
+			break;
+		default:
+			return 0.0;
+	}
+
+	switch(node->op){
+		case OP_AND:
+			if(first > 0.0 && second > 0.0){
+				return (first < second) ? first : second;
+			}
+			return 0.0;
+		case OP_OR:
+			if(first > 0.0 || second > 0.0){
+				return (first > second) ? first : second;
+			}
+			return 0.0;
+		default:
+			return 0.0;
+	}
+}
+
+bool FuzzyCompiled::truncate(int output){
+	fuzzyCompiledComposition* composition = &this->compositions[output];
+	const fuzzyCompiledIO* io = &this->outputs[output];
+
+	// esvaziando a composição
+	this->emptyComposition(composition);
+
+	for(int i = io->firstSet; i < io->firstSet + io->numSets; i++){
+		int set = this->setIndexes[i];
+		const fuzzyCompiledSet* s = &this->sets[set];
+		float pertinence = this->pertinences[set];
+
+		if(pertinence > 0.0){
+			if(this->checkPoint(composition, s->a, 0.0) == false){
+				this->addPoint(composition, s->a, 0.0);
+			}
+
+			if((s->b == s->c && s->a != s->d) || s->b != s->c){
+				// se triangulo ou trapezio
+				if(pertinence == 1.0){
+					if(this->checkPoint(composition, s->b, pertinence) == false){
+						this->addPoint(composition, s->b, pertinence);
+					}
+					if(s->b != s->c){
+						if(this->checkPoint(composition, s->c, pertinence) == false){
+							this->addPoint(composition, s->c, pertinence);
+						}
+					}
+				}else{
+					float newPointB 		= s->b;
+					float newPertinenceB 	= pertinence;
+
+					intersect(s->a, 0.0, s->b, 1.0, s->a, pertinence, s->d, pertinence, &newPointB, &newPertinenceB);
+
+					if(this->checkPoint(composition, newPointB, newPertinenceB) == false){
+						this->addPoint(composition, newPointB, newPertinenceB);
+					}
+
+					float newPointC 		= s->b;
+					float newPertinenceC 	= pertinence;
+
+					intersect(s->c, 1.0, s->d, 0.0, s->a, pertinence, s->d, pertinence, &newPointC, &newPertinenceC);
+
+					if(this->checkPoint(composition, newPointC, newPertinenceC) == false){
+						this->addPoint(composition, newPointC, newPertinenceC);
+					}
+				}
+			}else{
+				//senao singleton
+				if(this->checkPoint(composition, s->b, pertinence) == false){
+					this->addPoint(composition, s->b, pertinence);
+				}
+			}
+
+			if(this->checkPoint(composition, s->d, 0.0) == false || s->d == s->a){
+				this->addPoint(composition, s->d, 0.0);
+			}
+		}
+	}
+
+	this->build(composition);
+
+	return true;
+}
+
+float FuzzyCompiled::avaliate(int output){
+	const fuzzyCompiledComposition* composition = &this->compositions[output];
+	float numerator 	= 0.0;
+	float denominator 	= 0.0;
+
+	int16_t i = composition->points;
+	while(i != FUZZY_COMPILED_NONE){
+		const fuzzyCompiledPoint* aux = &composition->pool[i];
+		if(aux->next != FUZZY_COMPILED_NONE){
+			const fuzzyCompiledPoint* next = &composition->pool[aux->next];
+			float area = 0.0;
+			float middle = 0.0;
+			if(aux->point == next->point){
+				// Se Singleton
+				area 	= aux->pertinence;
+				middle 	= aux->point;
+			}else if(aux->pertinence == 0.0 || next->pertinence == 0.0){
+				// Se triangulo
+				float pertinence;
+				if(aux->pertinence > 0.0){
+					pertinence = aux->pertinence;
+				}else{
+					pertinence = next->pertinence;
+				}
+				area 	= ((next->point - aux->point) * pertinence) / 2.0;
+				if(aux->pertinence < next->pertinence){
+					middle 	= ((next->point - aux->point) / 1.5) + aux->point;
+				}else{
+					middle 	= ((next->point - aux->point) / 3.0) + aux->point;
+				}
+			}else if((aux->pertinence > 0.0 && next->pertinence > 0.0) && (aux->pertinence == next->pertinence)){
+				// Se quadrado
+				area 	= (next->point - aux->point) * aux->pertinence;
+				middle 	= ((next->point - aux->point) / 2.0) + aux->point;
+			}else if((aux->pertinence > 0.0 && next->pertinence > 0.0) && (aux->pertinence != next->pertinence)){
+				// Se trapezio
+				area 	= ((aux->pertinence + next->pertinence) / 2.0) * (next->point - aux->point);
+				middle 	= ((next->point - aux->point) / 2.0) + aux->point;
+			}
+			numerator 	+= middle * area;
+			denominator += area;
+		}
+		i = aux->next;
+	}
+
+	if(denominator == 0.0){
+		return 0.0;
+	}else{
+		return numerator / denominator;
+	}
+}
+
+void FuzzyCompiled::emptyComposition(fuzzyCompiledComposition* composition){
+	composition->points = FUZZY_COMPILED_NONE;
+	composition->pointsCursor = FUZZY_COMPILED_NONE;
+	for(int i = 0; i < FUZZY_COMPILED_MAX_POINTS - 1; i++){
+		composition->pool[i].next = i + 1;
+	}
+	composition->pool[FUZZY_COMPILED_MAX_POINTS - 1].next = FUZZY_COMPILED_NONE;
+	composition->freeList = 0;
+}
+
+bool FuzzyCompiled::addPoint(fuzzyCompiledComposition* composition, float point, float pertinence){
+	int16_t i = composition->freeList;
+	if(i == FUZZY_COMPILED_NONE){
+		return false;
+	}
+	composition->freeList = composition->pool[i].next;
+
+	fuzzyCompiledPoint* aux = &composition->pool[i];
+	aux->previous = FUZZY_COMPILED_NONE;
+	aux->point = point;
+	aux->pertinence = pertinence;
+	aux->next = FUZZY_COMPILED_NONE;
+
+	if(composition->points == FUZZY_COMPILED_NONE){
+		composition->points = i;
+		composition->pointsCursor = i;
+	}else{
+		aux->previous = composition->pointsCursor;
+		composition->pool[composition->pointsCursor].next = i;
+		composition->pointsCursor = i;
+	}
+	return true;
+}
+
+bool FuzzyCompiled::checkPoint(fuzzyCompiledComposition* composition, float point, float pertinence){
+	int16_t i = composition->pointsCursor;
+	while(i != FUZZY_COMPILED_NONE){
+		if(composition->pool[i].point == point && composition->pool[i].pertinence == pertinence){
+			return true;
+		}
+		i = composition->pool[i].previous;
+	}
+	return false;
+}
+
+bool FuzzyCompiled::build(fuzzyCompiledComposition* composition){
+	fuzzyCompiledPoint* pool = composition->pool;
+	// cada rebuild remove ao menos um ponto, entao este limite nunca e atingido em uso normal
+	int rebuildsLeft = FUZZY_COMPILED_MAX_POINTS;
+
+	int16_t aux = composition->points;
+	while(aux != FUZZY_COMPILED_NONE){
+		int16_t temp = aux;
+		while(pool[temp].previous != FUZZY_COMPILED_NONE){
+			if(pool[temp].point < pool[pool[temp].previous].point){
+				break;
+			}
+			temp = pool[temp].previous;
+		}
+		int16_t zPoint = temp;
+		while(pool[temp].previous != FUZZY_COMPILED_NONE){
+			bool result = false;
+			int16_t previous = pool[temp].previous;
+			if(pool[previous].previous != FUZZY_COMPILED_NONE && rebuildsLeft > 0){
+				result = this->rebuild(composition, zPoint, pool[zPoint].next, previous, pool[previous].previous);
+				rebuildsLeft--;
+			}
+			if(result == true){
+				aux = composition->points;
+				break;
+			}
+			temp = pool[temp].previous;
+		}
+		aux = pool[aux].next;
+	}
+	return true;
+}
+
+bool FuzzyCompiled::rebuild(fuzzyCompiledComposition* composition, int16_t aSegmentBegin, int16_t aSegmentEnd, int16_t bSegmentBegin, int16_t bSegmentEnd){
+	fuzzyCompiledPoint* pool = composition->pool;
+	float x1 = pool[aSegmentBegin].point;
+	float y1 = pool[aSegmentBegin].pertinence;
+	float x2 = pool[aSegmentEnd].point;
+	float y2 = pool[aSegmentEnd].pertinence;
+	float x3 = pool[bSegmentBegin].point;
+	float y3 = pool[bSegmentBegin].pertinence;
+	float x4 = pool[bSegmentEnd].point;
+	float y4 = pool[bSegmentEnd].pertinence;
+	float point, pertinence;
+
+	if(intersect(x1, y1, x2, y2, x3, y3, x4, y4, &point, &pertinence) == false){
+		return false;
+	}
+
+	// Adicionando um novo ponto
+	int16_t i = composition->freeList;
+	if(i == FUZZY_COMPILED_NONE){
+		return false;
+	}
+	composition->freeList = pool[i].next;
+
+	pool[i].previous = bSegmentEnd;
+	pool[i].point = point;
+	pool[i].pertinence = pertinence;
+	pool[i].next = aSegmentEnd;
+
+	pool[bSegmentEnd].next = i;
+	pool[aSegmentEnd].previous = i;
+
+	float stopPoint = pool[bSegmentBegin].point;
+	float stopPertinence = pool[bSegmentBegin].pertinence;
+
+	int16_t temp = aSegmentBegin;
+	int16_t excl;
+
+	do{
+		float pointToCompare = pool[temp].point;
+		float pertinenceToCompare = pool[temp].pertinence;
+
+		excl = pool[temp].previous;
+
+		this->rmvPoint(composition, temp);
+
+		temp = excl;
+
+		if(stopPoint == pointToCompare && stopPertinence == pertinenceToCompare){
+			break;
+		}
+	}while(temp != FUZZY_COMPILED_NONE);
+
+	return true;
+}
+
+void FuzzyCompiled::rmvPoint(fuzzyCompiledComposition* composition, int16_t point){
+	if(point != FUZZY_COMPILED_NONE){
+		composition->pool[point].next = composition->freeList;
+		composition->freeList = point;
+	}
+}
+
+bool FuzzyCompiled::intersect(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, float* point, float* pertinence){
+	float denom, numera, numerb;
+	float mua, mub;
+
+	denom  = (y4 - y3) * (x2 - x1) - (x4 - x3) * (y2 - y1);
+	numera = (x4 - x3) * (y1 - y3) - (y4 - y3) * (x1 - x3);
+	numerb = (x2 - x1) * (y1 - y3) - (y2 - y1) * (x1 - x3);
+
+	if(denom < 0.0){
+		denom *= -1.0;
+	}
+	if(numera < 0.0){
+		numera *= -1.0;
+	}
+	if(numerb < 0.0){
+		numerb *= -1.0;
+	}
+
+	// Se os seguimentos forem paralelos, retornar falso
+	if(denom < EPS){
+		return false;
+	}
+
+	// Verificar se há interseção ao longo do seguimento
+	mua = numera / denom;
+	mub = numerb / denom;
+	if(mua < 0.0 || mua > 1.0 || mub < 0.0 || mub > 1.0){
+		return false;
+	}else{
+		// Calculando o ponto e a pertinencia do novo elemento
+		*point 		= x1 + mua * (x2 - x1);
+		*pertinence 	= y1 + mua * (y2 - y1);
+
+		return true;
+	}
+}
@@ -0,0 +1,147 @@
+/*
+ * Robotic Research Group (RRG)
+ * State University of Piaui (UESPI), Brazil - Piauí - Teresina
+ *
+ * FuzzyCompiled.h
+ *
+ * Flat, fixed-capacity copy of a Fuzzy rule base. compile() walks the linked
+ * lists of an already built Fuzzy object once; afterwards setInput(),
+ * fuzzify() and defuzzify() run on contiguous arrays without touching the
+ * heap, and reproduce the arithmetic of Fuzzy/FuzzyComposition exactly.
+ */
+#ifndef FUZZYCOMPILED_H
+#define FUZZYCOMPILED_H
+
+// IMPORTANDO AS BIBLIOTECAS NECESSÁRIAS
+#include <inttypes.h>
+#include "Fuzzy.h"
+
+// CONSTANTES
+#define FUZZY_COMPILED_MAX_INPUTS 8
+#define FUZZY_COMPILED_MAX_OUTPUTS 4
+#define FUZZY_COMPILED_MAX_SETS 48
+#define FUZZY_COMPILED_MAX_OUTPUT_SETS 12
+#define FUZZY_COMPILED_MAX_RULES 32
+#define FUZZY_COMPILED_MAX_NODES 96
+#define FUZZY_COMPILED_MAX_LINKS 48
+// every output set contributes at most 4 points, plus one spare for an intersection
+#define FUZZY_COMPILED_MAX_POINTS (4 * FUZZY_COMPILED_MAX_OUTPUT_SETS + 1)
+#define FUZZY_COMPILED_NONE -1
+
+// Trapezio de um FuzzySet congelado
+struct fuzzyCompiledSet{
+	float a;
+	float b;
+	float c;
+	float d;
+};
+
+// FuzzyInput ou FuzzyOutput: faixa [firstSet, firstSet + numSets) em setIndexes
+struct fuzzyCompiledIO{
+	int index;
+	int firstSet;
+	int numSets;
+	float crispInput;
+};
+
+// No de antecedente em pos-ordem, filhos sempre avaliados antes do pai
+struct fuzzyCompiledNode{
+	int8_t op;
+	int8_t mode;
+	int16_t set1;
+	int16_t set2;
+	int16_t node1;
+	int16_t node2;
+};
+
+// Regra: raiz do antecedente e faixa [firstLink, firstLink + numLinks) em links
+struct fuzzyCompiledRule{
+	int index;
+	int16_t root;
+	int16_t firstLink;
+	int16_t numLinks;
+	bool fired;
+};
+
+// Ponto da composicao, lista duplamente ligada por indices
+struct fuzzyCompiledPoint{
+	int16_t previous;
+	float point;
+	float pertinence;
+	int16_t next;
+};
+
+// Composicao de uma saida sobre um pool fixo de pontos
+struct fuzzyCompiledComposition{
+	fuzzyCompiledPoint pool[FUZZY_COMPILED_MAX_POINTS];
+	int16_t points;
+	int16_t pointsCursor;
+	int16_t freeList;
+};
+
+class FuzzyCompiled {
+	// FuzzyBatch avalia blocos de amostras sobre as mesmas tabelas
+	friend class FuzzyBatch;
+
+	public:
+		// CONSTRUTORES
+		FuzzyCompiled();
+		// MÉTODOS PÚBLICOS
+		bool compile(Fuzzy* fuzzy);
+		bool isCompiled();
+		bool setInput(int fuzzyInputIndex, float crispValue);
+		bool fuzzify();
+		bool isFiredRule(int fuzzyRuleIndex);
+		float defuzzify(int fuzzyOutputIndex);
+
+	private:
+		// VARIÁVEIS PRIVADAS
+		bool compiled;
+
+		fuzzyCompiledSet sets[FUZZY_COMPILED_MAX_SETS];
+		float pertinences[FUZZY_COMPILED_MAX_SETS];
+		int numSets;
+
+		// indices de sets, agrupados por entrada/saida na ordem das listas originais
+		int16_t setIndexes[FUZZY_COMPILED_MAX_SETS + FUZZY_COMPILED_MAX_OUTPUTS * FUZZY_COMPILED_MAX_OUTPUT_SETS];
+		int numSetIndexes;
+
+		fuzzyCompiledIO inputs[FUZZY_COMPILED_MAX_INPUTS];
+		int numInputs;
+
+		fuzzyCompiledIO outputs[FUZZY_COMPILED_MAX_OUTPUTS];
+		fuzzyCompiledComposition compositions[FUZZY_COMPILED_MAX_OUTPUTS];
+		int numOutputs;
+
+		fuzzyCompiledNode nodes[FUZZY_COMPILED_MAX_NODES];
+		float nodeValues[FUZZY_COMPILED_MAX_NODES];
+		// antecedente original de cada no, usado apenas durante compile()
+		FuzzyRuleAntecedent* nodeSources[FUZZY_COMPILED_MAX_NODES];
+		int numNodes;
+
+		int16_t links[FUZZY_COMPILED_MAX_LINKS];
+		int numLinks;
+
+		fuzzyCompiledRule rules[FUZZY_COMPILED_MAX_RULES];
+		int numRules;
+
+		// se o pool de sets for compartilhado entre entradas e saidas, cada FuzzySet vira um unico indice
+		FuzzySet* setSources[FUZZY_COMPILED_MAX_SETS];
+
+		// MÉTODOS PRIVADOS
+		int findOrAddSet(FuzzySet* fuzzySet);
+		int compileIO(FuzzyIO* fuzzyIO, fuzzyCompiledIO* compiledIO, int maxSets);
+		int compileAntecedent(FuzzyRuleAntecedent* fuzzyRuleAntecedent, int depth);
+		void calculatePertinence(int set, float crispValue);
+		float evaluateNode(const fuzzyCompiledNode* node);
+		bool truncate(int output);
+		float avaliate(int output);
+		void emptyComposition(fuzzyCompiledComposition* composition);
+		bool addPoint(fuzzyCompiledComposition* composition, float point, float pertinence);
+		bool checkPoint(fuzzyCompiledComposition* composition, float point, float pertinence);
+		bool build(fuzzyCompiledComposition* composition);
+		bool rebuild(fuzzyCompiledComposition* composition, int16_t aSegmentBegin, int16_t aSegmentEnd, int16_t bSegmentBegin, int16_t bSegmentEnd);
+		void rmvPoint(fuzzyCompiledComposition* composition, int16_t point);
+		static bool intersect(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, float* point, float* pertinence);
+};
+#endif
@@ -23,6 +23,9 @@ struct fuzzySetArray{
 };
 
 class FuzzyIO {
+	// FuzzyCompiled congela as listas ligadas em vetores fixos
+	friend class FuzzyCompiled;
+
 	public:
 		// CONSTRUTORES
 		FuzzyIO();
@@ -17,6 +17,9 @@
 #include "FuzzyRuleConsequent.h"
 
 class FuzzyRule {
+	// FuzzyCompiled congela as listas ligadas em vetores fixos
+	friend class FuzzyCompiled;
+
 	public:
 		// CONSTRUTORES
 		FuzzyRule();
@@ -25,6 +25,9 @@
 #define MODE_FRA_FRA 4
 
 class FuzzyRuleAntecedent {
+	// FuzzyCompiled congela as listas ligadas em vetores fixos
+	friend class FuzzyCompiled;
+
 	public:
 		// CONSTRUTORES
 		FuzzyRuleAntecedent();
@@ -23,6 +23,9 @@ struct fuzzySetOutputArray{
 };
 
 class FuzzyRuleConsequent {
+	// FuzzyCompiled congela as listas ligadas em vetores fixos
+	friend class FuzzyCompiled;
+
 	public:
 		// CONSTRUTORES
 		FuzzyRuleConsequent();
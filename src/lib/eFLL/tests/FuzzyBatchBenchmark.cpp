@@ -0,0 +1,119 @@
+// Evaluations per second of the impact rule base through Fuzzy, FuzzyCompiled,
+// FuzzyBatch::evaluate and FuzzyBatch::sweep over the same input sweep.
+//
+// usage: FuzzyBatchBenchmark.bin [samples] [threads]
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../Fuzzy.h"
+#include "../FuzzyCompiled.h"
+#include "../FuzzyBatch.h"
+#include "../../impact_recovery/initialize_fuzzylogicprocess.h"
+
+using namespace std;
+
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char* name, int count, double elapsed, double reference){
+  double rate = count / elapsed;
+  cout << name << ": " << count << " evals in " << elapsed * 1e3 << " ms, "
+       << rate << " evals/s";
+  if(reference > 0.0){
+    cout << " (" << rate / reference << "x)";
+  }
+  cout << endl;
+}
+
+int main(int argc, char *argv[]) {
+  int count = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int threads = (argc > 2) ? atoi(argv[2]) : 0;
+  if(count <= 0){
+    cerr << "samples must be positive" << endl;
+    return 1;
+  }
+
+  Fuzzy* fuzzy = new Fuzzy();
+  init_flp_params(fuzzy);
+
+  FuzzyCompiled* compiled = new FuzzyCompiled();
+  FuzzyBatch* batch = new FuzzyBatch();
+  if(!compiled->compile(fuzzy) || !batch->compile(fuzzy)){
+    cerr << "rule base does not fit the compiled engine" << endl;
+    return 1;
+  }
+
+  // uniform sweep over the universe of each input, including the out-of-range tails
+  float* in[4];
+  for(int j = 0; j < 4; j++){
+    in[j] = new float[count];
+  }
+  unsigned int seed = 1;
+  for(int i = 0; i < count; i++){
+    seed = seed * 1103515245 + 12345;
+    in[0][i] = (float)((seed >> 8) % 2400) / 200.0 - 1.0;
+    seed = seed * 1103515245 + 12345;
+    in[1][i] = (float)((seed >> 8) % 4000) / 20.0 - 100.0;
+    seed = seed * 1103515245 + 12345;
+    in[2][i] = (float)((seed >> 8) % 1900) / 10.0 - 5.0;
+    seed = seed * 1103515245 + 12345;
+    in[3][i] = (float)((seed >> 8) % 1700) / 100.0 - 1.0;
+  }
+
+  float* scalarOut = new float[count];
+  float* compiledOut = new float[count];
+  float* batchOut = new float[count];
+  float* sweepOut = new float[count];
+
+  // the linked-list engine allocates on every evaluation, so only time a slice of it
+  int scalarCount = (count < 100000) ? count : 100000;
+  double start = now();
+  for(int i = 0; i < scalarCount; i++){
+    for(int j = 0; j < 4; j++){
+      fuzzy->setInput(j + 1, in[j][i]);
+    }
+    fuzzy->fuzzify();
+    scalarOut[i] = fuzzy->defuzzify(1);
+  }
+  double scalarElapsed = now() - start;
+  double scalarRate = scalarCount / scalarElapsed;
+
+  start = now();
+  for(int i = 0; i < count; i++){
+    for(int j = 0; j < 4; j++){
+      compiled->setInput(j + 1, in[j][i]);
+    }
+    compiled->fuzzify();
+    compiledOut[i] = compiled->defuzzify(1);
+  }
+  double compiledElapsed = now() - start;
+
+  start = now();
+  batch->evaluate(in, &batchOut, 0, count);
+  double batchElapsed = now() - start;
+
+  start = now();
+  batch->sweep(in, &sweepOut, count, threads);
+  double sweepElapsed = now() - start;
+
+  report("Fuzzy              ", scalarCount, scalarElapsed, 0.0);
+  report("FuzzyCompiled      ", count, compiledElapsed, scalarRate);
+  report("FuzzyBatch::evaluate", count, batchElapsed, scalarRate);
+  report("FuzzyBatch::sweep  ", count, sweepElapsed, scalarRate);
+
+  int mismatches = 0;
+  for(int i = 0; i < count; i++){
+    if(memcmp(&compiledOut[i], &batchOut[i], sizeof(float)) != 0 || memcmp(&batchOut[i], &sweepOut[i], sizeof(float)) != 0){
+      mismatches++;
+    }else if(i < scalarCount && memcmp(&scalarOut[i], &batchOut[i], sizeof(float)) != 0){
+      mismatches++;
+    }
+  }
+  cout << "mismatches: " << mismatches << endl;
+
+  return mismatches == 0 ? 0 : 1;
+}
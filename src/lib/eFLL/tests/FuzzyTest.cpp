@@ -1,6 +1,8 @@
 #include <iostream>
+#include <string.h>
 #include "../Fuzzy.h"
 #include "../FuzzyComposition.h"
+#include "../FuzzyCompiled.h"
 #include "../FuzzyIO.h"
 #include "../FuzzyInput.h"
 #include "../FuzzyOutput.h"
@@ -8,6 +10,8 @@
 #include "../FuzzyRuleAntecedent.h"
 #include "../FuzzyRuleConsequent.h"
 #include "../FuzzySet.h"
+#include "../FuzzyBatch.h"
+#include "../../impact_recovery/initialize_fuzzylogicprocess.h"
 #include "gtest/gtest.h"
 
 // ############### FUZZYSET
@@ -1386,6 +1390,277 @@ TEST(Fuzzy, setInputAndFuzzifyAndDefuzzify09){
   EXPECT_EQ(75, output2);
 }
 
+// ############### FUZZYCOMPILED
+
+TEST(FuzzyCompiled, compile){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyCompiled* compiled = new FuzzyCompiled();
+
+  EXPECT_FALSE(compiled->isCompiled());
+  EXPECT_FALSE(compiled->fuzzify());
+
+  init_flp_params(fuzzy);
+
+  EXPECT_TRUE(compiled->compile(fuzzy));
+  EXPECT_TRUE(compiled->isCompiled());
+  EXPECT_TRUE(compiled->setInput(4, 1.0));
+  EXPECT_FALSE(compiled->setInput(5, 1.0));
+}
+
+TEST(FuzzyCompiled, matchesFuzzyOnImpactRuleBase){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyCompiled* compiled = new FuzzyCompiled();
+
+  init_flp_params(fuzzy);
+  ASSERT_TRUE(compiled->compile(fuzzy));
+
+  // deterministic sweep covering the breakpoints of every input set
+  unsigned int seed = 1;
+  for(int i = 0; i < 20000; i++){
+    float in[4];
+    seed = seed * 1103515245 + 12345;
+    in[0] = (float)((seed >> 8) % 2400) / 200.0 - 1.0;
+    seed = seed * 1103515245 + 12345;
+    in[1] = (float)((seed >> 8) % 4000) / 20.0 - 100.0;
+    seed = seed * 1103515245 + 12345;
+    in[2] = (float)((seed >> 8) % 1900) / 10.0 - 5.0;
+    seed = seed * 1103515245 + 12345;
+    in[3] = (float)((seed >> 8) % 1700) / 100.0 - 1.0;
+
+    for(int j = 0; j < 4; j++){
+      fuzzy->setInput(j + 1, in[j]);
+      compiled->setInput(j + 1, in[j]);
+    }
+    fuzzy->fuzzify();
+    compiled->fuzzify();
+
+    float expected = fuzzy->defuzzify(1);
+    float result = compiled->defuzzify(1);
+
+    ASSERT_EQ(0, memcmp(&expected, &result, sizeof(float))) << "inputs " << in[0] << " " << in[1] << " " << in[2] << " " << in[3];
+    for(int rule = 1; rule <= 10; rule++){
+      ASSERT_EQ(fuzzy->isFiredRule(rule), compiled->isFiredRule(rule));
+    }
+  }
+}
+
+// Distance/temperature rule base with two outputs sharing rules
+static void buildTwoOutputRuleBase(Fuzzy* fuzzy){
+
+  FuzzyInput* distance = new FuzzyInput(1);
+  FuzzySet* close = new FuzzySet(0, 20, 20, 40);
+  distance->addFuzzySet(close);
+  FuzzySet* safe = new FuzzySet(30, 50, 50, 70);
+  distance->addFuzzySet(safe);
+  FuzzySet* distante = new FuzzySet(60, 80, 100, 100);
+  distance->addFuzzySet(distante);
+  fuzzy->addFuzzyInput(distance);
+
+  FuzzyInput* temperature = new FuzzyInput(2);
+  FuzzySet* cold = new FuzzySet(-30, -30, -20, -10);
+  temperature->addFuzzySet(cold);
+  FuzzySet* good = new FuzzySet(-15, 0, 0, 15);
+  temperature->addFuzzySet(good);
+  FuzzySet* hot = new FuzzySet(10, 20, 30, 30);
+  temperature->addFuzzySet(hot);
+  fuzzy->addFuzzyInput(temperature);
+
+  FuzzyOutput* risk = new FuzzyOutput(1);
+  FuzzySet* minimum = new FuzzySet(0, 20, 20, 40);
+  risk->addFuzzySet(minimum);
+  FuzzySet* average = new FuzzySet(30, 50, 50, 70);
+  risk->addFuzzySet(average);
+  FuzzySet* maximum = new FuzzySet(60, 80, 80, 100);
+  risk->addFuzzySet(maximum);
+  fuzzy->addFuzzyOutput(risk);
+
+  FuzzyOutput* speed = new FuzzyOutput(2);
+  FuzzySet* stoped = new FuzzySet(0, 0, 0, 0);
+  speed->addFuzzySet(stoped);
+  FuzzySet* slow = new FuzzySet(1, 10, 10, 20);
+  speed->addFuzzySet(slow);
+  FuzzySet* quick = new FuzzySet(45, 60, 70, 70);
+  speed->addFuzzySet(quick);
+  fuzzy->addFuzzyOutput(speed);
+
+  FuzzyRuleAntecedent* ifDistanceCloseOrTemperatureCold = new FuzzyRuleAntecedent();
+  ifDistanceCloseOrTemperatureCold->joinWithOR(close, cold);
+  FuzzyRuleConsequent* thenRiskMaximumAndSpeedStoped = new FuzzyRuleConsequent();
+  thenRiskMaximumAndSpeedStoped->addOutput(maximum);
+  thenRiskMaximumAndSpeedStoped->addOutput(stoped);
+  fuzzy->addFuzzyRule(new FuzzyRule(1, ifDistanceCloseOrTemperatureCold, thenRiskMaximumAndSpeedStoped));
+
+  FuzzyRuleAntecedent* ifDistanceSafeAndTemperatureGood = new FuzzyRuleAntecedent();
+  ifDistanceSafeAndTemperatureGood->joinWithAND(safe, good);
+  FuzzyRuleConsequent* thenRiskAverageAndSpeedSlow = new FuzzyRuleConsequent();
+  thenRiskAverageAndSpeedSlow->addOutput(average);
+  thenRiskAverageAndSpeedSlow->addOutput(slow);
+  fuzzy->addFuzzyRule(new FuzzyRule(2, ifDistanceSafeAndTemperatureGood, thenRiskAverageAndSpeedSlow));
+
+  FuzzyRuleAntecedent* ifDistanceDistante = new FuzzyRuleAntecedent();
+  ifDistanceDistante->joinSingle(distante);
+  FuzzyRuleAntecedent* ifDistanceDistanteOrTemperatureHot = new FuzzyRuleAntecedent();
+  ifDistanceDistanteOrTemperatureHot->joinWithOR(hot, ifDistanceDistante);
+  FuzzyRuleConsequent* thenRiskMinimumAndSpeedQuick = new FuzzyRuleConsequent();
+  thenRiskMinimumAndSpeedQuick->addOutput(minimum);
+  thenRiskMinimumAndSpeedQuick->addOutput(quick);
+  fuzzy->addFuzzyRule(new FuzzyRule(3, ifDistanceDistanteOrTemperatureHot, thenRiskMinimumAndSpeedQuick));
+}
+
+TEST(FuzzyCompiled, matchesFuzzyWithTwoOutputs){
+  Fuzzy* fuzzy = new Fuzzy();
+  buildTwoOutputRuleBase(fuzzy);
+
+  FuzzyCompiled* compiled = new FuzzyCompiled();
+  ASSERT_TRUE(compiled->compile(fuzzy));
+
+  for(float d = -5; d <= 105; d += 2.5){
+    for(float t = -35; t <= 35; t += 2.5){
+      fuzzy->setInput(1, d);
+      fuzzy->setInput(2, t);
+      compiled->setInput(1, d);
+      compiled->setInput(2, t);
+      fuzzy->fuzzify();
+      compiled->fuzzify();
+
+      EXPECT_EQ(fuzzy->defuzzify(1), compiled->defuzzify(1));
+      EXPECT_EQ(fuzzy->defuzzify(2), compiled->defuzzify(2));
+    }
+  }
+}
+
+
+// ############### FUZZYBATCH
+
+TEST(FuzzyBatch, compile){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyBatch* batch = new FuzzyBatch();
+  float in[4] = {0.0, 0.0, 0.0, 0.0};
+  float out[1];
+  const float* inputs[4] = {&in[0], &in[1], &in[2], &in[3]};
+  float* outputs[1] = {out};
+
+  EXPECT_FALSE(batch->isCompiled());
+  EXPECT_FALSE(batch->evaluate(inputs, outputs, 0, 1));
+
+  init_flp_params(fuzzy);
+
+  EXPECT_TRUE(batch->compile(fuzzy));
+  EXPECT_TRUE(batch->isCompiled());
+  EXPECT_EQ(4, batch->getNumInputs());
+  EXPECT_EQ(1, batch->getNumOutputs());
+  EXPECT_FALSE(batch->evaluate(inputs, outputs, -1, 1));
+  EXPECT_TRUE(batch->evaluate(inputs, outputs, 0, 0));
+}
+
+TEST(FuzzyBatch, matchesCompiledOnImpactRuleBase){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyCompiled* compiled = new FuzzyCompiled();
+  FuzzyBatch* batch = new FuzzyBatch();
+
+  init_flp_params(fuzzy);
+  ASSERT_TRUE(compiled->compile(fuzzy));
+  ASSERT_TRUE(batch->compile(fuzzy));
+
+  // not a multiple of FUZZY_BATCH_BLOCK, so the last block is partial
+  const int count = 20000 + FUZZY_BATCH_BLOCK / 2 + 1;
+  float* in[4];
+  for(int j = 0; j < 4; j++){
+    in[j] = new float[count];
+  }
+  float* out = new float[count];
+
+  unsigned int seed = 1;
+  for(int i = 0; i < count; i++){
+    seed = seed * 1103515245 + 12345;
+    in[0][i] = (float)((seed >> 8) % 2400) / 200.0 - 1.0;
+    seed = seed * 1103515245 + 12345;
+    in[1][i] = (float)((seed >> 8) % 4000) / 20.0 - 100.0;
+    seed = seed * 1103515245 + 12345;
+    in[2][i] = (float)((seed >> 8) % 1900) / 10.0 - 5.0;
+    seed = seed * 1103515245 + 12345;
+    in[3][i] = (float)((seed >> 8) % 1700) / 100.0 - 1.0;
+  }
+
+  ASSERT_TRUE(batch->evaluate(in, &out, 0, count));
+
+  for(int i = 0; i < count; i++){
+    for(int j = 0; j < 4; j++){
+      compiled->setInput(j + 1, in[j][i]);
+    }
+    compiled->fuzzify();
+    float expected = compiled->defuzzify(1);
+
+    ASSERT_EQ(0, memcmp(&expected, &out[i], sizeof(float))) << "sample " << i << " inputs " << in[0][i] << " " << in[1][i] << " " << in[2][i] << " " << in[3][i];
+  }
+}
+
+TEST(FuzzyBatch, matchesFuzzyWithTwoOutputs){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyBatch* batch = new FuzzyBatch();
+
+  buildTwoOutputRuleBase(fuzzy);
+  ASSERT_TRUE(batch->compile(fuzzy));
+  ASSERT_EQ(2, batch->getNumOutputs());
+
+  float distance[45 * 29];
+  float temperature[45 * 29];
+  float risk[45 * 29];
+  float speed[45 * 29];
+  int count = 0;
+  for(float d = -5; d <= 105; d += 2.5){
+    for(float t = -35; t <= 35; t += 2.5){
+      distance[count] = d;
+      temperature[count] = t;
+      count++;
+    }
+  }
+  ASSERT_EQ(45 * 29, count);
+
+  const float* inputs[2] = {distance, temperature};
+  float* outputs[2] = {risk, speed};
+  ASSERT_TRUE(batch->evaluate(inputs, outputs, 0, count));
+
+  for(int i = 0; i < count; i++){
+    fuzzy->setInput(1, distance[i]);
+    fuzzy->setInput(2, temperature[i]);
+    fuzzy->fuzzify();
+
+    EXPECT_EQ(fuzzy->defuzzify(1), risk[i]);
+    EXPECT_EQ(fuzzy->defuzzify(2), speed[i]);
+  }
+}
+
+TEST(FuzzyBatch, sweepMatchesEvaluate){
+  Fuzzy* fuzzy = new Fuzzy();
+  FuzzyBatch* batch = new FuzzyBatch();
+
+  init_flp_params(fuzzy);
+  ASSERT_TRUE(batch->compile(fuzzy));
+
+  const int count = 10 * FUZZY_BATCH_BLOCK + 7;
+  float* in[4];
+  for(int j = 0; j < 4; j++){
+    in[j] = new float[count];
+  }
+  float* expected = new float[count];
+  float* result = new float[count];
+
+  for(int i = 0; i < count; i++){
+    in[0][i] = (float)(i % 23) * 0.5 - 1.0;
+    in[1][i] = (float)(i % 41) * 5.0 - 100.0;
+    in[2][i] = (float)(i % 19) * 10.0 - 5.0;
+    in[3][i] = (float)(i % 17) - 1.0;
+  }
+
+  ASSERT_TRUE(batch->evaluate(in, &expected, 0, count));
+  ASSERT_TRUE(batch->sweep(in, &result, count, 4));
+  EXPECT_EQ(0, memcmp(expected, result, count * sizeof(float)));
+
+  // more threads than blocks
+  ASSERT_TRUE(batch->sweep(in, &result, count, 64));
+  EXPECT_EQ(0, memcmp(expected, result, count * sizeof(float)));
+}
 
 // ############### MAIN
 
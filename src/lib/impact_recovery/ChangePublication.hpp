@@ -0,0 +1,135 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ChangePublication.hpp
+ *
+ * Publication that only reaches uORB when the payload differs from the last
+ * published sample, or when the heartbeat interval has elapsed so loggers
+ * and late subscribers still see the state regularly.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <string.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+#include <uORB/uORB.h>
+
+namespace impact_recovery
+{
+
+template<class T>
+class ChangePublication
+{
+public:
+	/**
+	 * @param meta		topic metadata, ORB_ID(...)
+	 * @param heartbeat_us	republish an unchanged sample after this interval, 0 disables the heartbeat
+	 */
+	ChangePublication(const struct orb_metadata *meta, hrt_abstime heartbeat_us) :
+		_meta(meta),
+		_handle(nullptr),
+		_heartbeat(heartbeat_us),
+		_last_publish(0),
+		_publications(nullptr)
+	{
+		memset(&_last, 0, sizeof(_last));
+	}
+
+	ChangePublication(const ChangePublication &) = delete;
+	ChangePublication operator=(const ChangePublication &) = delete;
+
+	~ChangePublication()
+	{
+		if (_handle != nullptr) {
+			orb_unadvertise(_handle);
+		}
+	}
+
+	void set_heartbeat(hrt_abstime heartbeat_us) { _heartbeat = heartbeat_us; }
+
+	/** count publications in an existing perf counter */
+	void set_perf(perf_counter_t publications) { _publications = publications; }
+
+	/**
+	 * Publish data if it changed since the last publication or the heartbeat is due.
+	 * The leading timestamp field is excluded from the comparison and published as now.
+	 *
+	 * @return true if the sample was published
+	 */
+	bool update(const T &data, hrt_abstime now)
+	{
+		const size_t offset = sizeof(data.timestamp);
+		const bool changed = memcmp(((const uint8_t *)&data) + offset, ((const uint8_t *)&_last) + offset,
+					    sizeof(T) - offset) != 0;
+		const bool heartbeat = _heartbeat > 0 && now - _last_publish >= _heartbeat;
+
+		if (_handle != nullptr && !changed && !heartbeat) {
+			return false;
+		}
+
+		memcpy(&_last, &data, sizeof(T));
+		_last.timestamp = now;
+
+		if (_handle == nullptr) {
+			_handle = orb_advertise(_meta, &_last);
+
+		} else {
+			orb_publish(_meta, _handle, &_last);
+		}
+
+		_last_publish = now;
+
+		if (_publications != nullptr) {
+			perf_count(_publications);
+		}
+
+		return true;
+	}
+
+	/** last published sample */
+	const T &get() const { return _last; }
+
+private:
+	const struct orb_metadata *_meta;
+	orb_advert_t _handle;
+	hrt_abstime _heartbeat;
+	hrt_abstime _last_publish;
+	perf_counter_t _publications;
+	T _last;
+};
+
+} // namespace impact_recovery
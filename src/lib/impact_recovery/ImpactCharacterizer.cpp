@@ -0,0 +1,293 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ImpactCharacterizer.cpp
+ *
+ * @author Gareth Dicker<dicker.gareth@gmail.com>
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include "ImpactCharacterizer.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <px4_defines.h>
+#include <px4_log.h>
+
+namespace impact_recovery
+{
+
+// CLASS FUNCTIONS
+QuaternionQueue::QuaternionQueue()
+{
+	head = tail = 0;
+}
+
+void QuaternionQueue::quatqueue(math::Quaternion quat){
+	if (tail + 1 == head || ((tail + 1 == QUATQUEUESIZE) && !head)){
+		//queue is full
+		head ++;
+		if (head == QUATQUEUESIZE) head = 0;
+	}
+	tail ++;
+	if (tail == QUATQUEUESIZE) tail = 0;
+	queue[tail] = quat;
+	return;
+}
+
+math::Quaternion QuaternionQueue::readquatqueue(int queueidx){
+	if (queueidx >= QUATQUEUESIZE){
+		PX4_INFO("ERROR: requested to access quat queue out of range");
+		math::Quaternion tempquat(1,0,0,0);
+		return tempquat;
+	}
+	else{
+		if (head+queueidx >= QUATQUEUESIZE) return queue[head+queueidx-QUATQUEUESIZE];
+		else return queue[head+queueidx];
+	}
+
+}
+
+// CUSTOM FUNCTIONS
+math::Vector<3> crossProduct(const math::Vector<3> v1, const math::Vector<3> v2){
+	/**
+	 * cross product (added by Fiona)
+	 */
+ 	math::Vector<3> res;
+	res.data[0] = v1.data[1]*v2.data[2] - v1.data[2]*v2.data[1];
+	res.data[1] = v1.data[2]*v2.data[0] - v1.data[0]*v2.data[2];
+	res.data[2] = v1.data[0]*v2.data[1] - v1.data[1]*v2.data[0];
+	return res;
+
+}
+
+float signf(const float number){
+	if (number < 0.0f) return -1.0f;
+	else return 1.0f;
+}
+
+float rad2deg(const float angle){
+	return angle*180.0f/(float)M_PI;
+}
+
+// DECLARE CONSTANTS
+static const int fuzzyInputCalcCycleDelay_array[4] = {2,0,2,3};
+// const int fuzzyInputCalcCycleDelay_array[4] = {0,200,400,200};
+
+static const math::Vector<3> inertialFrameGravityDirection(0.0f,0.0f,1.0f); //Navi's inertial frame is NED
+static const math::Vector<3> inertialFrameNegGravityDirection(0.0f,0.0f,-1.0f);
+static const math::Vector<3> bodyFrameGravityDirection(0.0f,0.0f,1.0f); //Navi's body frame is also NED
+static const math::Vector<3> bodyFrameNegGravityDirection(0.0f,0.0f,-1.0f);
+
+ImpactCharacterizer::ImpactCharacterizer() :
+	_fuzzyEngine(nullptr),
+	_fuzzyTable(nullptr)
+{
+	reset();
+}
+
+ImpactCharacterizer::~ImpactCharacterizer()
+{
+	delete _fuzzyTable;
+	delete _fuzzyEngine;
+}
+
+bool ImpactCharacterizer::init()
+{
+	/////////////// INITIALIZE FUZZY LOGIC PROCESS /////////////
+	Fuzzy *fuzzy = new Fuzzy();
+	init_flp_params(fuzzy);
+
+	// freeze the rule base into flat arrays so the impact path never touches the heap
+	_fuzzyEngine = new FuzzyCompiled();
+	bool compiled = _fuzzyEngine->compile(fuzzy);
+
+	// the compiled engine is a flat copy, the rule base is not needed anymore
+	delete fuzzy;
+
+	if (!compiled){
+		PX4_ERR("fuzzy rule base exceeds FuzzyCompiled capacity");
+		return false;
+	}
+
+#ifdef IMPACT_CHARACTERIZATION_LUT
+	_fuzzyTable = new FuzzyLookupTable();
+
+	if (!_fuzzyTable->generate(*_fuzzyEngine)){
+		PX4_WARN("lookup table error %.3f over %.3f, using the fuzzy engine", (double)_fuzzyTable->max_error(),
+			 (double)FUZZY_LUT_MAX_ERROR);
+		delete _fuzzyTable;
+		_fuzzyTable = nullptr;
+	}
+#endif
+
+	return true;
+}
+
+void ImpactCharacterizer::reset()
+{
+	_q_att_log = QuaternionQueue();
+	clear_impact();
+}
+
+void ImpactCharacterizer::clear_impact()
+{
+	_cyclesAfterImpactDetected = 0;
+	memset(_fuzzyInputCalculated_array, 0, sizeof(_fuzzyInputCalculated_array));
+	_wallNormal_vect.zero();
+	memset(&_characterization, 0, sizeof(_characterization));
+}
+
+const impact_characterization_s &ImpactCharacterizer::update(const sensor_accel_s &accel, const sensor_gyro_s &gyro,
+		const control_state_s &ctrl_state, const impact_detection_s &detection,
+		const impact_recovery_stage_s &recovery_stage)
+{
+	math::Quaternion q_att(ctrl_state.q[0], ctrl_state.q[1], ctrl_state.q[2], ctrl_state.q[3]);
+
+	if (detection.inRecovery){
+		if(!_characterization.accelRefIsComputed){					
+			if (_cyclesAfterImpactDetected == 0){
+				// calculate pre-impact rotation matrix							
+				_quat_preImpact = _q_att_log.readquatqueue(QUATQUEUESIZE-PREIMPACTCYCLES-1);
+				_R_preImpact = _quat_preImpact.to_dcm();
+				
+				// calculate wallNormalDirection --> may move this to another time step
+				math::Matrix<3, 3> R = q_att.to_dcm();
+				math::Vector<3> accel_in_gs(accel.x/9.81f, accel.y/9.81f, accel.z/9.81f);
+				math::Vector<3> inertialAcceleration = R*accel_in_gs + inertialFrameGravityDirection;
+				math::Vector<3> wallNormalDirectionWorld(inertialAcceleration(0),inertialAcceleration(1),0.0f);
+				_wallNormal_vect = wallNormalDirectionWorld.normalized();
+				_characterization.wallNormal[0] = _wallNormal_vect(0);
+				_characterization.wallNormal[1] = _wallNormal_vect(1);
+				_characterization.wallNormal[2] = _wallNormal_vect(2);
+			}	
+
+			for (int iInput = 0; iInput < 4; iInput ++){
+				if (_fuzzyInputCalculated_array[iInput] == 0 ){ //make sure input has not been calculated yet
+					if(fuzzyInputCalcCycleDelay_array[iInput] <= _cyclesAfterImpactDetected ){ //calculation delays required for some inputs
+						if (iInput == 0){  //accelerometer horizontal magnitude
+							math::Vector<2> accelHorizontalComponents(accel.x,accel.y);
+							_characterization.fuzzyInput[0] = accelHorizontalComponents.length()/9.81f;
+							_fuzzyEngine->setInput(1,_characterization.fuzzyInput[0]);
+							_fuzzyInputCalculated_array[iInput] = 1;
+						}
+						else if (iInput == 1){  //inclination
+							math::Vector<3> wallTangentWorld = crossProduct(inertialFrameGravityDirection,_wallNormal_vect);
+							math::Vector<3> rotatedNegBodyZ = _R_preImpact*bodyFrameNegGravityDirection;
+							math::Vector<3> bodyZProjection = rotatedNegBodyZ-wallTangentWorld*(rotatedNegBodyZ*wallTangentWorld); //check dot product
+							float dotProductWithWorldZ = bodyZProjection*inertialFrameNegGravityDirection;
+							float inclinationAngle = acosf(dotProductWithWorldZ / bodyZProjection.length());
+
+							float dotProductWithWorldNormal = bodyZProjection*_wallNormal_vect;
+							float angleWithWorldNormal = acosf(dotProductWithWorldNormal/(bodyZProjection.length()*_wallNormal_vect.length()));
+							float inclinationSign = signf(angleWithWorldNormal - (float)M_PI/2);
+
+							_characterization.fuzzyInput[1] = inclinationSign*rad2deg(inclinationAngle);
+
+							_fuzzyEngine->setInput(2, _characterization.fuzzyInput[1] );
+							_fuzzyInputCalculated_array[iInput] = 1;
+						}
+						else if (iInput == 2){  //flipping direction angle
+							math::Matrix<3, 3> R = q_att.to_dcm();
+							math::Vector<3> gyro_body(gyro.x,gyro.y,gyro.z);
+							math::Vector<3> angVelWorld = R*gyro_body;
+							math::Vector<3> angVelWorldPerp = crossProduct(angVelWorld,inertialFrameNegGravityDirection);
+							math::Vector<2> angVelWorldPerpHoriz(angVelWorldPerp(0),angVelWorldPerp(1));
+							math::Vector<2> wallNormalWorldHoriz(_wallNormal_vect(0),_wallNormal_vect(1));
+							_characterization.fuzzyInput[2] = rad2deg(acosf((angVelWorldPerpHoriz*wallNormalWorldHoriz)/(angVelWorldPerpHoriz.length()*wallNormalWorldHoriz.length())));
+					
+							_fuzzyEngine->setInput(3, _characterization.fuzzyInput[2]);
+							_fuzzyInputCalculated_array[iInput] = 1;
+						}
+						else if (iInput == 3){  //gyro horizontal magnitude
+							math::Vector<2> gyroHorizontalComponents(gyro.x,gyro.y);
+							_characterization.fuzzyInput[3] = gyroHorizontalComponents.length();
+							_fuzzyEngine->setInput(4,_characterization.fuzzyInput[3]);
+							_fuzzyInputCalculated_array[iInput] = 1;
+						}
+					}
+				}
+
+			} // end fuzzyInput calculation for loop
+
+			int sum = 0;
+			for(auto& num : _fuzzyInputCalculated_array)   sum += num;
+			if(sum == 4){ //check all four fuzzy inputs have been calculated
+			   
+				// calculate fuzzy output
+#ifdef IMPACT_CHARACTERIZATION_LUT
+				// a non-finite input zeroes all its memberships in the live engine, which the table cannot represent
+				if (_fuzzyTable != nullptr && PX4_ISFINITE(_characterization.fuzzyInput[0]) && PX4_ISFINITE(_characterization.fuzzyInput[1]) &&
+				    PX4_ISFINITE(_characterization.fuzzyInput[2]) && PX4_ISFINITE(_characterization.fuzzyInput[3])){
+					_characterization.fuzzyOutput = _fuzzyTable->evaluate(_characterization.fuzzyInput);
+				}
+				else{
+					_fuzzyEngine->fuzzify();
+					_characterization.fuzzyOutput = _fuzzyEngine->defuzzify(1);
+				}
+#else
+				_fuzzyEngine->fuzzify();
+				_characterization.fuzzyOutput = _fuzzyEngine->defuzzify(1);
+#endif
+
+				//# TODO: confirm with Gareth accelRef calculation
+				math::Vector<3> accelReference_vect = _wallNormal_vect*(-0.75f*9.81f*_characterization.fuzzyOutput);
+				// math::Vector<3> accelReference_vect = _wallNormal_vect*(9.81f*_characterization.fuzzyOutput);
+				if (_characterization.fuzzyOutput < 0.0f){
+					// accelReference_vect = accelReference_vect/10.0f;
+					accelReference_vect.zero();
+				}
+				
+				_characterization.accelReference[0] = accelReference_vect(0);
+				_characterization.accelReference[1] = accelReference_vect(1);
+				_characterization.accelReference[2] = accelReference_vect(2);
+				_characterization.accelRefIsComputed = true;
+			}
+
+			_cyclesAfterImpactDetected ++;
+			
+		} // end if(!accelRefCalculated)	
+
+	} //end if(_impact.impactIsDetected)
+
+	//reset condition
+	if (_characterization.accelRefIsComputed && recovery_stage.recoveryIsReset){
+		clear_impact();
+	}
+	_q_att_log.quatqueue(q_att); //record attitude history
+
+	return _characterization;
+}
+
+} // namespace impact_recovery
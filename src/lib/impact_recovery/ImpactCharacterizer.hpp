@@ -0,0 +1,143 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ImpactCharacterizer.hpp
+ *
+ * Second stage of the impact recovery pipeline: once an impact is detected,
+ * gathers the four fuzzy inputs over the following accel samples and turns
+ * the fuzzy output into the accelReference used by the recovery controller.
+ *
+ * @author Gareth Dicker<dicker.gareth@gmail.com>
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <mathlib/mathlib.h>
+
+#include <uORB/topics/sensor_accel.h>
+#include <uORB/topics/sensor_gyro.h>
+#include <uORB/topics/control_state.h>
+#include <uORB/topics/impact_detection.h>
+#include <uORB/topics/impact_characterization.h>
+#include <uORB/topics/impact_recovery_stage.h>
+
+//fuzzy logic libraries
+#include <lib/eFLL/Fuzzy.h>
+#include <lib/eFLL/FuzzyComposition.h>
+#include <lib/eFLL/FuzzyInput.h>
+#include <lib/eFLL/FuzzyIO.h>
+#include <lib/eFLL/FuzzyOutput.h>
+#include <lib/eFLL/FuzzyRule.h>
+#include <lib/eFLL/FuzzyRuleAntecedent.h>
+#include <lib/eFLL/FuzzyRuleConsequent.h>
+#include <lib/eFLL/FuzzySet.h>
+#include <lib/eFLL/FuzzyCompiled.h>
+
+#include "fuzzy_lookup_table.h"
+#include "initialize_fuzzylogicprocess.h"
+
+#define QUATQUEUESIZE 5
+#define PREIMPACTCYCLES 2
+
+namespace impact_recovery
+{
+
+//class definitions
+class QuaternionQueue
+{
+	math::Quaternion queue[QUATQUEUESIZE];
+	int head, tail;
+public:
+	QuaternionQueue();
+	void quatqueue(math::Quaternion quat);
+	math::Quaternion readquatqueue(int queueidx);
+};
+
+//custom math functions
+math::Vector<3> crossProduct(const math::Vector<3> vect1, const math::Vector<3> vect2);
+float signf(const float number);
+float rad2deg(const float angle);
+
+class __EXPORT ImpactCharacterizer
+{
+public:
+	ImpactCharacterizer();
+	ImpactCharacterizer(const ImpactCharacterizer &) = delete;
+	ImpactCharacterizer operator=(const ImpactCharacterizer &) = delete;
+	~ImpactCharacterizer();
+
+	/**
+	 * Build and compile the fuzzy rule base, and sample the lookup table
+	 * when built with IMPACT_CHARACTERIZATION_LUT. A table that does not match
+	 * the engine within FUZZY_LUT_MAX_ERROR is dropped, the engine answers
+	 * instead. Allocates, call once at startup.
+	 *
+	 * @return false if the rule base does not fit FuzzyCompiled
+	 */
+	bool init();
+
+	/** Forget the current impact and the attitude history */
+	void reset();
+
+	/**
+	 * Step the characterization on one accel sample.
+	 *
+	 * @return the updated characterization
+	 */
+	const impact_characterization_s &update(const sensor_accel_s &accel, const sensor_gyro_s &gyro,
+						const control_state_s &ctrl_state, const impact_detection_s &detection,
+						const impact_recovery_stage_s &recovery_stage);
+
+	const impact_characterization_s &get() const { return _characterization; }
+
+private:
+	void clear_impact();
+
+	impact_characterization_s _characterization;
+
+	int _cyclesAfterImpactDetected;
+	int _fuzzyInputCalculated_array[4];
+
+	QuaternionQueue _q_att_log;
+	math::Quaternion _quat_preImpact;
+	math::Matrix<3, 3> _R_preImpact;
+
+	math::Vector<3> _wallNormal_vect;
+
+	FuzzyCompiled *_fuzzyEngine;
+	FuzzyLookupTable *_fuzzyTable;
+};
+
+} // namespace impact_recovery
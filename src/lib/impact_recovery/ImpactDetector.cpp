@@ -0,0 +1,93 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ImpactDetector.cpp
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include "ImpactDetector.hpp"
+
+#include <string.h>
+#include <mathlib/mathlib.h>
+
+namespace impact_recovery
+{
+
+ImpactDetector::ImpactDetector()
+{
+	reset();
+}
+
+void ImpactDetector::reset()
+{
+	memset(&_detection, 0, sizeof(_detection));
+	_accel_is_done_spike = true;
+}
+
+const impact_detection_s &ImpactDetector::update(const sensor_accel_s &accel, const control_state_s &ctrl_state,
+		const impact_recovery_stage_s &recovery_stage, const actuator_armed_s &armed)
+{
+	math::Vector<3> accel_body(accel.x, accel.y, accel.z);
+	math::Quaternion q_att(ctrl_state.q[0], ctrl_state.q[1], ctrl_state.q[2], ctrl_state.q[3]);
+	//get rotation matrix
+	math::Matrix<3, 3> R = q_att.to_dcm();
+	//rotate accelerometer readings into world frame
+	math::Vector<3> accelWorldFrame = R * accel_body;
+	math::Vector<2> accelHorizontalComponents(accelWorldFrame(0), accelWorldFrame(1));
+
+	if (armed.armed) {
+		if (!_accel_is_done_spike) {
+			if (accelHorizontalComponents.length() <= 9.81f) {
+				_accel_is_done_spike = true;
+			}
+		}
+
+		if (!_detection.inRecovery && _accel_is_done_spike) {
+			if (accelHorizontalComponents.length() > 9.81f) {
+				_detection.inRecovery = true;
+				_accel_is_done_spike = false;
+			}
+
+		} else if (_detection.inRecovery) { // could just do 'else'
+			if (recovery_stage.recoveryIsReset) {
+				_detection.inRecovery = false;
+			}
+		}
+	}
+
+	return _detection;
+}
+
+} // namespace impact_recovery
@@ -0,0 +1,77 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ImpactDetector.hpp
+ *
+ * First stage of the impact recovery pipeline: flags an impact when the
+ * world-horizontal specific force exceeds 1 g while armed, and clears the
+ * flag once the recovery stage machine reports a reset.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <uORB/topics/sensor_accel.h>
+#include <uORB/topics/control_state.h>
+#include <uORB/topics/actuator_armed.h>
+#include <uORB/topics/impact_detection.h>
+#include <uORB/topics/impact_recovery_stage.h>
+
+namespace impact_recovery
+{
+
+class __EXPORT ImpactDetector
+{
+public:
+	ImpactDetector();
+
+	void reset();
+
+	/**
+	 * Step the detector on one accel sample.
+	 *
+	 * @return the updated detection state
+	 */
+	const impact_detection_s &update(const sensor_accel_s &accel, const control_state_s &ctrl_state,
+					  const impact_recovery_stage_s &recovery_stage, const actuator_armed_s &armed);
+
+	const impact_detection_s &get() const { return _detection; }
+
+private:
+	impact_detection_s _detection;
+	bool _accel_is_done_spike;
+};
+
+} // namespace impact_recovery
@@ -0,0 +1,147 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file Reactor.cpp
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include "Reactor.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <px4_log.h>
+
+namespace impact_recovery
+{
+
+Reactor::Reactor(const char *stage_name) :
+	_count(0),
+	_updated_mask(0)
+{
+	// perf counters keep a pointer to their name, so the names live in the reactor
+	snprintf(_perf_names[0], sizeof(_perf_names[0]), "%s: wakeups", stage_name);
+	snprintf(_perf_names[1], sizeof(_perf_names[1]), "%s: copies", stage_name);
+	snprintf(_perf_names[2], sizeof(_perf_names[2]), "%s: latency", stage_name);
+
+	_wakeups = perf_alloc(PC_COUNT, _perf_names[0]);
+	_copies = perf_alloc(PC_COUNT, _perf_names[1]);
+	_latency = perf_alloc(PC_ELAPSED, _perf_names[2]);
+}
+
+Reactor::~Reactor()
+{
+	for (int i = 0; i < _count; i++) {
+		orb_unsubscribe(_topics[i].handle);
+	}
+
+	perf_free(_wakeups);
+	perf_free(_copies);
+	perf_free(_latency);
+}
+
+int Reactor::add_topic(const struct orb_metadata *meta, void *buffer, TopicCallback callback, void *context)
+{
+	if (_count >= MAX_TOPICS) {
+		PX4_ERR("reactor full, dropping %s", meta->o_name);
+		return -1;
+	}
+
+	int handle = orb_subscribe(meta);
+
+	if (handle < 0) {
+		PX4_ERR("subscribe to %s failed", meta->o_name);
+		return -1;
+	}
+
+	Topic &topic = _topics[_count];
+	topic.meta = meta;
+	topic.handle = handle;
+	topic.buffer = buffer;
+	topic.callback = callback;
+	topic.context = context;
+
+	_fds[_count].fd = handle;
+	_fds[_count].events = POLLIN;
+
+	return _count++;
+}
+
+int Reactor::spin_once(int timeout_ms)
+{
+	_updated_mask = 0;
+
+	int ret = px4_poll(_fds, _count, timeout_ms);
+
+	if (ret <= 0) {
+		return ret;
+	}
+
+	perf_count(_wakeups);
+
+	int updated = 0;
+
+	for (int i = 0; i < _count; i++) {
+		if (_fds[i].revents & POLLIN) {
+			orb_copy(_topics[i].meta, _topics[i].handle, _topics[i].buffer);
+			perf_count(_copies);
+			_updated_mask |= (1u << i);
+			updated++;
+		}
+	}
+
+	for (int i = 0; i < _count; i++) {
+		if ((_updated_mask & (1u << i)) && _topics[i].callback != nullptr) {
+			_topics[i].callback(_topics[i].context);
+		}
+	}
+
+	return updated;
+}
+
+void Reactor::record_latency(hrt_abstime sample_timestamp)
+{
+	if (sample_timestamp > 0) {
+		perf_set_elapsed(_latency, hrt_elapsed_time(&sample_timestamp));
+	}
+}
+
+void Reactor::print_status()
+{
+	perf_print_counter(_wakeups);
+	perf_print_counter(_copies);
+	perf_print_counter(_latency);
+}
+
+} // namespace impact_recovery
@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file Reactor.hpp
+ *
+ * Small poll reactor shared by the impact detection, characterization and
+ * recovery stage daemons. Every registered topic is part of the poll set;
+ * only topics that actually changed are copied, and their callbacks run
+ * after all ready topics of a wakeup have been copied, so a callback always
+ * sees the freshest state of every other topic.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <px4_posix.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+#include <uORB/uORB.h>
+
+namespace impact_recovery
+{
+
+typedef void (*TopicCallback)(void *context);
+
+class __EXPORT Reactor
+{
+public:
+	static const int MAX_TOPICS = 8;
+
+	/**
+	 * @param stage_name	prefix of the perf counters, e.g. "impact_detection"
+	 */
+	Reactor(const char *stage_name);
+	Reactor(const Reactor &) = delete;
+	Reactor operator=(const Reactor &) = delete;
+	~Reactor();
+
+	/**
+	 * Subscribe to a topic and add it to the poll set.
+	 *
+	 * @param meta		topic metadata, ORB_ID(...)
+	 * @param buffer	local copy, refreshed whenever the topic is updated
+	 * @param callback	called after the copy, may be nullptr for state-only topics
+	 * @param context	passed to callback
+	 * @return topic slot, or -1 if the poll set is full or the subscription failed
+	 */
+	int add_topic(const struct orb_metadata *meta, void *buffer, TopicCallback callback = nullptr,
+		      void *context = nullptr);
+
+	/**
+	 * Wait for any registered topic, copy the updated ones and dispatch their callbacks.
+	 *
+	 * @return number of updated topics, 0 on timeout, negative on poll error
+	 */
+	int spin_once(int timeout_ms);
+
+	/** true if the topic in slot was copied during the current/last wakeup */
+	bool updated(int slot) const { return slot >= 0 && slot < _count && (_updated_mask & (1u << slot)); }
+
+	/** Record the latency from a source sample (e.g. sensor_accel.timestamp) to now, call right after publishing. */
+	void record_latency(hrt_abstime sample_timestamp);
+
+	void print_status();
+
+private:
+	struct Topic {
+		const struct orb_metadata *meta;
+		int handle;
+		void *buffer;
+		TopicCallback callback;
+		void *context;
+	};
+
+	Topic _topics[MAX_TOPICS];
+	px4_pollfd_struct_t _fds[MAX_TOPICS];
+	int _count;
+	uint32_t _updated_mask;
+
+	perf_counter_t _wakeups;
+	perf_counter_t _copies;
+	perf_counter_t _latency;
+	char _perf_names[3][40];
+};
+
+} // namespace impact_recovery
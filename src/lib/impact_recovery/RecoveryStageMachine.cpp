@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file RecoveryStageMachine.cpp
+ *
+ * @author Gareth Dicker<dicker.gareth@gmail.com>
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include "RecoveryStageMachine.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <mathlib/mathlib.h>
+
+namespace impact_recovery
+{
+
+RecoveryStageMachine::RecoveryStageMachine()
+{
+	reset();
+}
+
+void RecoveryStageMachine::reset()
+{
+	memset(&_recovery_stage, 0, sizeof(_recovery_stage));
+	_switchStage[0] = false;
+	_switchStage[1] = false;
+	_RS1counter = 0;
+}
+
+const impact_recovery_stage_s &RecoveryStageMachine::update(const control_state_s &ctrl_state,
+		const impact_detection_s &detection, const impact_characterization_s &characterization,
+		const recovery_control_s &recovery_control)
+{
+	if (characterization.accelRefIsComputed && _recovery_stage.recoveryIsReset == false) {
+
+		if (_recovery_stage.recoveryStage == 1) {
+			if (fabs(recovery_control.quatError[1]) < 0.17 && fabs(recovery_control.quatError[2]) < 0.17
+			    && fabs(ctrl_state.roll_rate) < 1.0 && fabs(ctrl_state.pitch_rate) < 1.0) {
+				_RS1counter += 1;
+			}
+
+			if (_RS1counter >= 3) {
+				_switchStage[0] = true;
+				_RS1counter = 0;
+			}
+
+			if (_switchStage[0]) {
+				_recovery_stage.recoveryStage = 2;
+			}
+
+		} else if (_recovery_stage.recoveryStage == 2) {
+			math::Quaternion q_att(ctrl_state.q[0], ctrl_state.q[1], ctrl_state.q[2], ctrl_state.q[3]);
+			math::Vector<3> angles = q_att.to_euler();
+			double RP_SWITCH = 0.2;
+			double RATES_SWITCH = 1.0;
+			float roll = angles(0);
+			float pitch = angles(1);
+			float roll_rate = ctrl_state.roll_rate;
+			float pitch_rate = ctrl_state.pitch_rate;
+			_switchStage[1] = fabs(roll) < RP_SWITCH && fabs(pitch) < RP_SWITCH &&
+					  fabs(roll_rate) < RATES_SWITCH  && fabs(pitch_rate) < RATES_SWITCH;
+
+			if (_switchStage[1]) {
+				_recovery_stage.recoveryIsReset = true;
+				_recovery_stage.recoveryStage = 0;
+				_switchStage[0] = false;
+				_switchStage[1] = false;
+			}
+
+		} else {
+			_recovery_stage.recoveryStage = 1; // executes upon opening this loop
+		}
+	}
+
+	if (characterization.accelRefIsComputed == false && detection.inRecovery == false
+	    && _recovery_stage.recoveryIsReset == true) {
+		_recovery_stage.recoveryIsReset = false;
+	}
+
+	return _recovery_stage;
+}
+
+} // namespace impact_recovery
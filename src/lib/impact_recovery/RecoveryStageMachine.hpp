@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file RecoveryStageMachine.hpp
+ *
+ * Last stage of the impact recovery pipeline:
+ *
+ * Stage 1: Point away from the wall based on impact characterization
+ * Stage 2: Go to hover
+ * Stage 0: Normal flight
+ *
+ * @author Gareth Dicker<dicker.gareth@gmail.com>
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <uORB/topics/control_state.h>
+#include <uORB/topics/impact_detection.h>
+#include <uORB/topics/impact_characterization.h>
+#include <uORB/topics/impact_recovery_stage.h>
+#include <uORB/topics/recovery_control.h>
+
+namespace impact_recovery
+{
+
+class __EXPORT RecoveryStageMachine
+{
+public:
+	RecoveryStageMachine();
+
+	void reset();
+
+	/**
+	 * Step the stage machine on one accel sample.
+	 *
+	 * @return the updated recovery stage
+	 */
+	const impact_recovery_stage_s &update(const control_state_s &ctrl_state, const impact_detection_s &detection,
+					      const impact_characterization_s &characterization,
+					      const recovery_control_s &recovery_control);
+
+	const impact_recovery_stage_s &get() const { return _recovery_stage; }
+
+private:
+	impact_recovery_stage_s _recovery_stage;
+	bool _switchStage[2];
+	int _RS1counter;
+};
+
+} // namespace impact_recovery
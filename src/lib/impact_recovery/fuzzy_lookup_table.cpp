@@ -0,0 +1,166 @@
+/**
+ * @file fuzzy_lookup_table.cpp
+ *
+ * Grid surrogate of the impact characterization fuzzy controller.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+#include "fuzzy_lookup_table.h"
+
+#include <math.h>
+
+// grid nodes, each axis contains every breakpoint of the input sets in initialize_fuzzylogicprocess.cpp
+static const float accNodes[FUZZY_LUT_N0] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 8.0f, 10.0f};
+static const float inclinationNodes[FUZZY_LUT_N1] = {
+	-90.0f, -75.0f, -60.0f, -37.5f, -15.0f, -9.5f, -8.0f, -5.5f, -2.0f, -1.5f, 0.0f,
+	1.5f, 2.0f, 5.5f, 8.0f, 9.5f, 15.0f, 37.5f, 60.0f, 75.0f, 90.0f
+};
+static const float gammaNodes[FUZZY_LUT_N2] = {0.0f, 25.0f, 50.0f, 70.0f, 80.0f, 90.0f, 100.0f, 110.0f, 130.0f, 155.0f, 180.0f};
+static const float gyroNodes[FUZZY_LUT_N3] = {0.0f, 0.5f, 1.0f, 1.5f, 2.25f, 3.0f, 3.5f, 4.5f, 9.75f, 15.0f};
+
+static const float *const axisNodes[FUZZY_LUT_INPUTS] = {accNodes, inclinationNodes, gammaNodes, gyroNodes};
+static const int axisCounts[FUZZY_LUT_INPUTS] = {FUZZY_LUT_N0, FUZZY_LUT_N1, FUZZY_LUT_N2, FUZZY_LUT_N3};
+
+// strides of the row-major table, the last input varies fastest
+static const int stride0 = FUZZY_LUT_N1 * FUZZY_LUT_N2 * FUZZY_LUT_N3;
+static const int stride1 = FUZZY_LUT_N2 * FUZZY_LUT_N3;
+static const int stride2 = FUZZY_LUT_N3;
+
+static const float q15Scale = 32767.0f;
+
+FuzzyLookupTable::FuzzyLookupTable() :
+	_max_error(0.0f),
+	_valid(false)
+{
+}
+
+const float *FuzzyLookupTable::axis(int input, int *count)
+{
+	if (input < 0 || input >= FUZZY_LUT_INPUTS) {
+		*count = 0;
+		return nullptr;
+	}
+
+	*count = axisCounts[input];
+	return axisNodes[input];
+}
+
+bool FuzzyLookupTable::generate(FuzzyCompiled &engine)
+{
+	_valid = false;
+	int idx = 0;
+
+	for (int i0 = 0; i0 < FUZZY_LUT_N0; i0++) {
+		engine.setInput(1, accNodes[i0]);
+
+		for (int i1 = 0; i1 < FUZZY_LUT_N1; i1++) {
+			engine.setInput(2, inclinationNodes[i1]);
+
+			for (int i2 = 0; i2 < FUZZY_LUT_N2; i2++) {
+				engine.setInput(3, gammaNodes[i2]);
+
+				for (int i3 = 0; i3 < FUZZY_LUT_N3; i3++) {
+					engine.setInput(4, gyroNodes[i3]);
+					engine.fuzzify();
+
+					float out = engine.defuzzify(1);
+
+					if (out > 1.0f) {
+						out = 1.0f;
+
+					} else if (out < -1.0f) {
+						out = -1.0f;
+					}
+
+					_table[idx++] = (int16_t)lroundf(out * q15Scale);
+				}
+			}
+		}
+	}
+
+	// deterministic sweep, the same inputs on every boot
+	uint32_t seed = 1;
+	_max_error = 0.0f;
+
+	for (int i = 0; i < FUZZY_LUT_CHECK_SAMPLES; i++) {
+		float input[FUZZY_LUT_INPUTS];
+
+		for (int iInput = 0; iInput < FUZZY_LUT_INPUTS; iInput++) {
+			seed = seed * 1664525u + 1013904223u;
+			const float *nodes = axisNodes[iInput];
+			const float lo = nodes[0];
+			const float hi = nodes[axisCounts[iInput] - 1];
+			input[iInput] = lo + (hi - lo) * (float)(seed >> 8) / 16777216.0f;
+			engine.setInput(iInput + 1, input[iInput]);
+		}
+
+		engine.fuzzify();
+		const float error = fabsf(engine.defuzzify(1) - evaluate(input));
+
+		if (error > _max_error) {
+			_max_error = error;
+		}
+	}
+
+	_valid = _max_error <= FUZZY_LUT_MAX_ERROR;
+	return _valid;
+}
+
+int FuzzyLookupTable::locate(const float *nodes, int count, float value, float *fraction)
+{
+	if (value <= nodes[0]) {
+		*fraction = 0.0f;
+		return 0;
+	}
+
+	if (value >= nodes[count - 1]) {
+		*fraction = 1.0f;
+		return count - 2;
+	}
+
+	// binary search for nodes[lo] <= value < nodes[lo + 1]
+	int lo = 0;
+	int hi = count - 1;
+
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+
+		if (value < nodes[mid]) {
+			hi = mid;
+
+		} else {
+			lo = mid;
+		}
+	}
+
+	*fraction = (value - nodes[lo]) / (nodes[lo + 1] - nodes[lo]);
+	return lo;
+}
+
+float FuzzyLookupTable::evaluate(const float input[FUZZY_LUT_INPUTS]) const
+{
+	float t[FUZZY_LUT_INPUTS];
+	const int i0 = locate(accNodes, FUZZY_LUT_N0, input[0], &t[0]);
+	const int i1 = locate(inclinationNodes, FUZZY_LUT_N1, input[1], &t[1]);
+	const int i2 = locate(gammaNodes, FUZZY_LUT_N2, input[2], &t[2]);
+	const int i3 = locate(gyroNodes, FUZZY_LUT_N3, input[3], &t[3]);
+
+	const int16_t *base = &_table[i0 * stride0 + i1 * stride1 + i2 * stride2 + i3];
+
+	// collapse one axis at a time: 16 corners -> 8 -> 4 -> 2 -> 1
+	float c[8];
+
+	for (int k = 0; k < 8; k++) {
+		const int16_t *corner = base + ((k & 4) ? stride0 : 0) + ((k & 2) ? stride1 : 0) + ((k & 1) ? stride2 : 0);
+		c[k] = corner[0] + t[3] * (corner[1] - corner[0]);
+	}
+
+	for (int k = 0; k < 4; k++) {
+		c[k] = c[2 * k] + t[2] * (c[2 * k + 1] - c[2 * k]);
+	}
+
+	c[0] = c[0] + t[1] * (c[1] - c[0]);
+	c[1] = c[2] + t[1] * (c[3] - c[2]);
+
+	return (c[0] + t[0] * (c[1] - c[0])) / q15Scale;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file fuzzy_lookup_table.h
+ *
+ * Grid surrogate of the impact characterization fuzzy controller.
+ *
+ * The mapping (accel spike, inclination, flip direction, spin magnitude) ->
+ * fuzzyOutput is fixed once init_flp_params() has run, so it is sampled once
+ * at boot on a non-uniform 4-D grid whose nodes sit on the breakpoints of the
+ * input membership functions, and answered afterwards with multilinear
+ * interpolation. Values are stored as Q15 since the output lives in [-1, 1].
+ *
+ * The min/max operators of the rule base switch inside the grid cells, where
+ * the interpolation can be far off (even of the wrong sign), so generate()
+ * checks the table against the engine and only accepts it if the error stays
+ * within FUZZY_LUT_MAX_ERROR.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+#ifndef FUZZY_LOOKUP_TABLE_H
+#define FUZZY_LOOKUP_TABLE_H
+
+#include <stdint.h>
+#include <lib/eFLL/FuzzyCompiled.h>
+
+#define FUZZY_LUT_INPUTS 4
+#define FUZZY_LUT_N0 9	// accelerometer horizontal magnitude [g]
+#define FUZZY_LUT_N1 21	// inclination [deg]
+#define FUZZY_LUT_N2 11	// flipping direction angle [deg]
+#define FUZZY_LUT_N3 10	// gyro horizontal magnitude [rad/s]
+#define FUZZY_LUT_SIZE (FUZZY_LUT_N0 * FUZZY_LUT_N1 * FUZZY_LUT_N2 * FUZZY_LUT_N3)
+
+#define FUZZY_LUT_MAX_ERROR 0.05f	// largest accepted deviation from the engine, output range is [-1, 1]
+#define FUZZY_LUT_CHECK_SAMPLES 4096	// random inputs compared against the engine by generate()
+
+class FuzzyLookupTable
+{
+public:
+	FuzzyLookupTable();
+
+	/**
+	 * Sample the compiled rule base on every grid node, then compare the table
+	 * with the engine on FUZZY_LUT_CHECK_SAMPLES inputs spread over the grid.
+	 * Fuzzy input indexes 1..4 map to fuzzyInput[0..3] of impact_characterization.
+	 * @return true if the table is valid: its error stays within FUZZY_LUT_MAX_ERROR
+	 */
+	bool generate(FuzzyCompiled &engine);
+
+	bool is_valid() const { return _valid; }
+
+	/** largest error found by generate() */
+	float max_error() const { return _max_error; }
+
+	/**
+	 * Multilinear interpolation of the sampled controller.
+	 * Inputs outside the grid are clamped to its border, where every
+	 * membership function of the rule base is already saturated.
+	 */
+	float evaluate(const float input[FUZZY_LUT_INPUTS]) const;
+
+	static const float *axis(int input, int *count);
+
+private:
+	/** Locate the grid cell of value on one axis, returns lower node and fills fraction in [0,1]. */
+	static int locate(const float *nodes, int count, float value, float *fraction);
+
+	int16_t _table[FUZZY_LUT_SIZE];
+	float _max_error;
+	bool _valid;
+};
+
+#endif
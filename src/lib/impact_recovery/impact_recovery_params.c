@@ -0,0 +1,67 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file impact_recovery_params.c
+ *
+ * Parameters shared by impact_detection, impact_characterization and recovery_stage
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+/**
+ * Impact recovery heartbeat interval
+ *
+ * The impact_detection, impact_characterization and impact_recovery_stage
+ * topics are published when their content changes, and at least once per
+ * this interval. Set to 0 to publish on change only.
+ *
+ * @unit ms
+ * @min 0
+ * @max 5000
+ * @group Impact Recovery
+ */
+PARAM_DEFINE_INT32(IMP_PUB_HB, 100);
+
+/**
+ * Fused impact recovery pipeline
+ *
+ * If enabled, the startup script runs impact detection, characterization
+ * and the recovery stage machine in the single impact_recovery task instead
+ * of the impact_detection, impact_characterization and recovery_stage tasks.
+ *
+ * @boolean
+ * @reboot_required true
+ * @group Impact Recovery
+ */
+PARAM_DEFINE_INT32(IMP_FUSED, 0);
@@ -1,5 +1,4 @@
-#include <modules/impact_characterization/impact_characterization.h> 
-void init_flp_params(Fuzzy*& fuzzy);
+#include "initialize_fuzzylogicprocess.h"
 
 void init_flp_params(Fuzzy* &fuzzy){ // to call: init_flp_params(fuzzy);
 	// Fuzzy Input 1
@@ -0,0 +1,24 @@
+/**
+ * @file initialize_fuzzylogicprocess.h
+ *
+ * Rule base of the impact characterization fuzzy controller. Only depends on
+ * eFLL, so that the eFLL tests can check FuzzyCompiled against Fuzzy on the
+ * rule base that flies.
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#pragma once
+
+#include <lib/eFLL/Fuzzy.h>
+#include <lib/eFLL/FuzzyComposition.h>
+#include <lib/eFLL/FuzzyInput.h>
+#include <lib/eFLL/FuzzyIO.h>
+#include <lib/eFLL/FuzzyOutput.h>
+#include <lib/eFLL/FuzzyRule.h>
+#include <lib/eFLL/FuzzyRuleAntecedent.h>
+#include <lib/eFLL/FuzzyRuleConsequent.h>
+#include <lib/eFLL/FuzzySet.h>
+
+/** Build the impact characterization rule base, see initialize_fuzzylogicprocess.cpp */
+void init_flp_params(Fuzzy *&fuzzy);
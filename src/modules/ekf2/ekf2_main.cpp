@@ -405,6 +405,16 @@ void Ekf2::task_main()
 	fds[1].fd = _params_sub;
 	fds[1].events = POLLIN;
 
+	// register the fds once instead of on every wait
+	px4_pollset_t pollset;
+
+	if (px4_pollset_init(&pollset, fds, sizeof(fds) / sizeof(fds[0])) < 0) {
+		warnx("poll setup failed");
+		delete ekf2::instance;
+		ekf2::instance = nullptr;
+		return;
+	}
+
 	// initialise parameter cache
 	updateParams();
 
@@ -421,7 +431,7 @@ void Ekf2::task_main()
 	vehicle_status_s _vehicle_status = {};
 
 	while (!_task_should_exit) {
-		int ret = px4_poll(fds, sizeof(fds) / sizeof(fds[0]), 1000);
+		int ret = px4_pollset_wait(&pollset, 1000);
 
 		if (ret < 0) {
 			// Poll error, sleep and try again
@@ -1011,6 +1021,8 @@ void Ekf2::task_main()
 		}
 	}
 
+	px4_pollset_destroy(&pollset);
+
 	delete ekf2::instance;
 	ekf2::instance = nullptr;
 }
@@ -72,6 +72,7 @@
 #include <uORB/topics/airspeed.h>
 #include <uORB/topics/vision_position_estimate.h>
 
+#include <drivers/drv_hrt.h>
 #include <sdlog2/sdlog2_messages.h>
 
 
@@ -111,7 +112,8 @@ class Ekf2Replay
 {
 public:
 	// Constructor
-	Ekf2Replay(char *logfile);
+	// @exit_when_done	exit the process after the replay (batch runs, see Tools/ekf2_replay_batch.py)
+	Ekf2Replay(char *logfile, bool exit_when_done);
 
 	// Destructor, also kills task
 	~Ekf2Replay();
@@ -168,6 +170,38 @@ private:
 	int _write_fd = -1;
 	px4_pollfd_struct_t _fds[1];
 
+	bool _exit_when_done;
+
+	// groups of ekf2_innovations fields for the replay statistics
+	enum InnovationGroup {
+		INNOV_VEL_NE = 0,
+		INNOV_VEL_D,
+		INNOV_POS_NE,
+		INNOV_POS_D,
+		INNOV_MAG,
+		INNOV_HEADING,
+		INNOV_AIRSPEED,
+		INNOV_FLOW,
+		INNOV_HAGL,
+		INNOV_GROUP_COUNT
+	};
+
+	struct InnovationStatistics {
+		unsigned count;			// samples with a nonzero innovation (the others were not fused)
+		double sum_sq;			// sum of innovation^2
+		double sum_test_ratio;		// sum of innovation^2 / variance
+		float max_abs;
+	};
+
+	InnovationStatistics _innov_stats[INNOV_GROUP_COUNT];
+
+	uint64_t _first_imu_timestamp;		// log time of the first and last imu sample [us]
+	uint64_t _last_imu_timestamp;
+	unsigned _imu_samples;
+	unsigned _estimator_timeouts;
+	hrt_abstime _wait_time_total;		// time spent waiting for the estimator output [us]
+	hrt_abstime _wait_time_max;
+
 	// parse replay message from buffer
 	// @source 			pointer to log message data (excluding header)
 	// @destination 	pointer to message struct of type @type
@@ -203,9 +237,17 @@ private:
 	void publishAndWaitForEstimator();
 
 	void setUserParams(const char *filename);
+
+	// accumulate an innovation into the statistics of a group
+	void addInnovation(InnovationGroup group, float innovation, float variance);
+
+	// write the innovation and timing statistics as a csv header and one line
+	// @filename 	output file
+	// @wall_time 	duration of the replay [us]
+	void writeStatistics(const char *filename, hrt_abstime wall_time);
 };
 
-Ekf2Replay::Ekf2Replay(char *logfile) :
+Ekf2Replay::Ekf2Replay(char *logfile, bool exit_when_done) :
 	_sensors_pub(nullptr),
 	_gps_pub(nullptr),
 	_landed_pub(nullptr),
@@ -234,7 +276,15 @@ Ekf2Replay::Ekf2Replay(char *logfile) :
 	_read_part4(false),
 	_read_part6(false),
 	_read_part5(false),
-	_write_fd(-1)
+	_write_fd(-1),
+	_exit_when_done(exit_when_done),
+	_innov_stats{},
+	_first_imu_timestamp(0),
+	_last_imu_timestamp(0),
+	_imu_samples(0),
+	_estimator_timeouts(0),
+	_wait_time_total(0),
+	_wait_time_max(0)
 {
 	// build the path to the log
 	char tmp[] = "./rootfs/";
@@ -675,6 +725,23 @@ void Ekf2Replay::logIfUpdated()
 		log_message.body.innov3.s[4] = innov.hagl_innov;
 		log_message.body.innov3.s[5] = innov.hagl_innov_var;
 		writeMessage(_write_fd, (void *)&log_message.head1, _formats[LOG_EST6_MSG].length);
+
+		for (unsigned i = 0; i < 2; i++) {
+			addInnovation(INNOV_VEL_NE, innov.vel_pos_innov[i], innov.vel_pos_innov_var[i]);
+			addInnovation(INNOV_POS_NE, innov.vel_pos_innov[i + 3], innov.vel_pos_innov_var[i + 3]);
+			addInnovation(INNOV_FLOW, innov.flow_innov[i], innov.flow_innov_var[i]);
+		}
+
+		addInnovation(INNOV_VEL_D, innov.vel_pos_innov[2], innov.vel_pos_innov_var[2]);
+		addInnovation(INNOV_POS_D, innov.vel_pos_innov[5], innov.vel_pos_innov_var[5]);
+
+		for (unsigned i = 0; i < 3; i++) {
+			addInnovation(INNOV_MAG, innov.mag_innov[i], innov.mag_innov_var[i]);
+		}
+
+		addInnovation(INNOV_HEADING, innov.heading_innov, innov.heading_innov_var);
+		addInnovation(INNOV_AIRSPEED, innov.airspeed_innov, innov.airspeed_innov_var);
+		addInnovation(INNOV_HAGL, innov.hagl_innov, innov.hagl_innov_var);
 	}
 
 	// update control state
@@ -704,11 +771,27 @@ void Ekf2Replay::publishAndWaitForEstimator()
 
 	publishEstimatorInput();
 
+	if (_imu_samples == 0) {
+		_first_imu_timestamp = _sensors.timestamp;
+	}
+
+	_last_imu_timestamp = _sensors.timestamp;
+	_imu_samples++;
+
 	// wait for estimator output to arrive
+	hrt_abstime wait_start = hrt_absolute_time();
 	int pret = px4_poll(&_fds[0], (sizeof(_fds) / sizeof(_fds[0])), 1000);
+	hrt_abstime wait_time = hrt_elapsed_time(&wait_start);
+
+	_wait_time_total += wait_time;
+
+	if (wait_time > _wait_time_max) {
+		_wait_time_max = wait_time;
+	}
 
 	if (pret == 0) {
 		PX4_WARN("timeout");
+		_estimator_timeouts++;
 	}
 
 	if (pret < 0) {
@@ -761,6 +844,61 @@ void Ekf2Replay::setUserParams(const char *filename)
 	}
 }
 
+void Ekf2Replay::addInnovation(InnovationGroup group, float innovation, float variance)
+{
+	if (innovation == 0.0f || !PX4_ISFINITE(innovation)) {
+		return;
+	}
+
+	InnovationStatistics &stats = _innov_stats[group];
+	stats.count++;
+	stats.sum_sq += (double)innovation * (double)innovation;
+
+	if (variance > FLT_EPSILON) {
+		stats.sum_test_ratio += (double)innovation * (double)innovation / (double)variance;
+	}
+
+	if (fabsf(innovation) > stats.max_abs) {
+		stats.max_abs = fabsf(innovation);
+	}
+}
+
+void Ekf2Replay::writeStatistics(const char *filename, hrt_abstime wall_time)
+{
+	static const char *const group_names[INNOV_GROUP_COUNT] = {
+		"vel_ne", "vel_d", "pos_ne", "pos_d", "mag", "heading", "airspeed", "flow", "hagl"
+	};
+
+	FILE *file = fopen(filename, "w");
+
+	if (file == nullptr) {
+		PX4_WARN("failed to open %s", filename);
+		return;
+	}
+
+	double duration = (double)(_last_imu_timestamp - _first_imu_timestamp) / 1e6;
+
+	fprintf(file, "log_duration_s,wall_time_s,imu_samples,estimator_timeouts,wait_mean_us,wait_max_us");
+
+	for (unsigned i = 0; i < INNOV_GROUP_COUNT; i++) {
+		fprintf(file, ",%s_n,%s_rms,%s_max,%s_test_ratio", group_names[i], group_names[i], group_names[i], group_names[i]);
+	}
+
+	fprintf(file, "\n%.3f,%.3f,%u,%u,%.1f,%llu", duration, (double)wall_time / 1e6, _imu_samples, _estimator_timeouts,
+		_imu_samples > 0 ? (double)_wait_time_total / _imu_samples : 0.0, (unsigned long long)_wait_time_max);
+
+	for (unsigned i = 0; i < INNOV_GROUP_COUNT; i++) {
+		const InnovationStatistics &stats = _innov_stats[i];
+		double n = stats.count > 0 ? (double)stats.count : 1.0;
+		fprintf(file, ",%u,%.6g,%.6g,%.6g", stats.count, sqrt(stats.sum_sq / n), (double)stats.max_abs, stats.sum_test_ratio / n);
+	}
+
+	fprintf(file, "\n");
+	fclose(file);
+
+	PX4_INFO("%.1f s of log replayed in %.1f s, statistics written to %s", duration, (double)wall_time / 1e6, filename);
+}
+
 void Ekf2Replay::task_main()
 {
 	// formats
@@ -784,10 +922,17 @@ void Ekf2Replay::task_main()
 	// create path which tells user location of replay file
 	char tmp2[] = "./build_posix_sitl_replay/src/firmware/posix";
 	char *replay_file_location = (char *) malloc(1 + strlen(tmp) + strlen(tmp2) + strlen(replay_log_name));
-	strcat(replay_file_location, tmp2);
+	strcpy(replay_file_location, tmp2);
 	strcat(replay_file_location, replay_log_name);
 	strcat(replay_file_location, tmp);
 
+	// create path to write the replay statistics
+	char tmp3[] = "_replay_stats.csv";
+	char *path_to_stats = (char *) malloc(1 + strlen(tmp3) + strlen(replay_log_name) + 1);
+	strcpy(path_to_stats, ".");
+	strcat(path_to_stats, replay_log_name);
+	strcat(path_to_stats, tmp3);
+
 	// open logfile to write
 	_write_fd = ::open(path_to_replay_log, O_WRONLY | O_CREAT, S_IRWXU);
 
@@ -827,6 +972,8 @@ void Ekf2Replay::task_main()
 	PX4_INFO("Replay in progress... \n");
 	PX4_INFO("Log data will be written to %s\n", replay_file_location);
 
+	hrt_abstime replay_start = hrt_absolute_time();
+
 	while (!_task_should_exit) {
 		_message_counter++;
 		uint8_t header[3] = {};
@@ -981,8 +1128,20 @@ void Ekf2Replay::task_main()
 
 	::close(_write_fd);
 	::close(fd);
+
+	writeStatistics(path_to_stats, hrt_elapsed_time(&replay_start));
+
+	free(path_to_stats);
+	free(path_to_replay_log);
+	free(replay_file_location);
+
+	bool exit_when_done = _exit_when_done;
 	delete ekf2_replay::instance;
 	ekf2_replay::instance = nullptr;
+
+	if (exit_when_done) {
+		px4_systemreset(false);
+	}
 }
 
 void Ekf2Replay::task_main_trampoline(int argc, char *argv[])
@@ -1013,7 +1172,7 @@ int Ekf2Replay::start()
 int ekf2_replay_main(int argc, char *argv[])
 {
 	if (argc < 1) {
-		PX4_WARN("usage: ekf2_replay {start|stop|status}");
+		PX4_WARN("usage: ekf2_replay {start <log file> [-x]|stop|status}");
 		return 1;
 	}
 
@@ -1024,7 +1183,15 @@ int ekf2_replay_main(int argc, char *argv[])
 			return 1;
 		}
 
-		ekf2_replay::instance = new Ekf2Replay(argv[2]);
+		if (argc < 3) {
+			PX4_WARN("usage: ekf2_replay start <log file> [-x]");
+			return 1;
+		}
+
+		// -x: exit the process when the replay is done
+		bool exit_when_done = (argc > 3 && !strcmp(argv[3], "-x"));
+
+		ekf2_replay::instance = new Ekf2Replay(argv[2], exit_when_done);
 
 		if (ekf2_replay::instance == nullptr) {
 			PX4_WARN("alloc failed");
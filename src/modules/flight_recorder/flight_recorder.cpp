@@ -0,0 +1,965 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "flight_recorder.h"
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <px4_getopt.h>
+#include <px4_posix.h>
+#include <uORB/uORB.h>
+#include <uORB/uORBTopics.h>
+#include <systemlib/git_version.h>
+#include <systemlib/param/param.h>
+
+using namespace px4::logger;
+
+static FlightRecorder *recorder_ptr = nullptr;
+static int recorder_task = -1;
+
+int flight_recorder_main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		FlightRecorder::usage(nullptr);
+		return 1;
+	}
+
+	//Check if thread exited, but the object has not been destroyed yet (happens in case of an error)
+	if (recorder_task == -1 && recorder_ptr) {
+		delete recorder_ptr;
+		recorder_ptr = nullptr;
+	}
+
+	if (!strcmp(argv[1], "start")) {
+
+		if (recorder_ptr != nullptr) {
+			PX4_INFO("already running");
+			return 1;
+		}
+
+		if (OK != FlightRecorder::start((char *const *)argv)) {
+			PX4_WARN("start failed");
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		if (recorder_ptr == nullptr) {
+			PX4_INFO("not running");
+			return 1;
+		}
+
+		delete recorder_ptr;
+		recorder_ptr = nullptr;
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		if (recorder_ptr) {
+			recorder_ptr->status();
+			return 0;
+
+		} else {
+			PX4_INFO("not running");
+			return 1;
+		}
+	}
+
+	if (!strcmp(argv[1], "trigger")) {
+		if (recorder_ptr) {
+			recorder_ptr->request_trigger();
+			return 0;
+
+		} else {
+			PX4_INFO("not running");
+			return 1;
+		}
+	}
+
+	FlightRecorder::usage("unrecognized command");
+	return 1;
+}
+
+/**
+ * Size of a builtin type of an o_fields entry
+ * @return size in bytes, 0 for nested types
+ */
+static int field_type_size(const char *type, size_t len)
+{
+	static const struct {
+		const char *name;
+		int size;
+	} types[] = {
+		{"int8_t", 1}, {"uint8_t", 1}, {"bool", 1}, {"char", 1},
+		{"int16_t", 2}, {"uint16_t", 2},
+		{"int32_t", 4}, {"uint32_t", 4}, {"float", 4},
+		{"int64_t", 8}, {"uint64_t", 8}, {"double", 8}
+	};
+
+	for (unsigned i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		if (strlen(types[i].name) == len && strncmp(types[i].name, type, len) == 0) {
+			return types[i].size;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Find a field in the format of a topic. The fields are in memory order,
+ * padding included, so the offset is the sum of the sizes before it.
+ * @return 0 on success
+ */
+static int find_field(const orb_metadata *meta, const char *field, int &offset, int &size)
+{
+	const char *entry = meta->o_fields;
+	offset = 0;
+
+	while (*entry) {
+		const char *end = strchr(entry, ';');
+
+		if (!end) {
+			end = entry + strlen(entry);
+		}
+
+		const char *space = (const char *)memchr(entry, ' ', end - entry);
+
+		if (!space) {
+			return -1;
+		}
+
+		/* "type name" or "type[N] name" */
+		const char *bracket = (const char *)memchr(entry, '[', space - entry);
+		int type_size = field_type_size(entry, (bracket ? bracket : space) - entry);
+		int count = bracket ? atoi(bracket + 1) : 1;
+
+		if ((size_t)(end - space - 1) == strlen(field) && strncmp(space + 1, field, end - space - 1) == 0) {
+			size = type_size * count;
+			return size > 0 ? 0 : -1;
+		}
+
+		if (type_size == 0) {
+			/* nested type, the offsets behind it are unknown */
+			return -1;
+		}
+
+		offset += type_size * count;
+		entry = *end ? end + 1 : end;
+	}
+
+	return -1;
+}
+
+namespace px4
+{
+namespace logger
+{
+
+void FlightRecorder::usage(const char *reason)
+{
+	if (reason) {
+		PX4_WARN("%s\n", reason);
+	}
+
+	PX4_INFO("usage: flight_recorder {start|stop|status|trigger} [-t <topics>] [-T <trigger>]\n"
+		 "\t-t\tComma separated list of recorded topics, default sensor_accel,sensor_gyro,control_state\n"
+		 "\t-T\tTrigger topic or topic.field, default impact_detection.inRecovery\n"
+		 "\tThe ring size and the window are set by SDLOG_FR_BUF, SDLOG_FR_PRE and SDLOG_FR_POST");
+}
+
+int FlightRecorder::start(char *const *argv)
+{
+	ASSERT(recorder_task == -1);
+
+	/* the writer thread does the file I/O, the task itself only copies */
+	recorder_task = px4_task_spawn_cmd("flight_recorder",
+					   SCHED_DEFAULT,
+					   SCHED_PRIORITY_MAX - 10,
+					   1800,
+					   (px4_main_t)&FlightRecorder::run_trampoline,
+					   (char *const *)argv);
+
+	if (recorder_task < 0) {
+		recorder_task = -1;
+		PX4_WARN("task start failed");
+		return -errno;
+	}
+
+	return OK;
+}
+
+void FlightRecorder::run_trampoline(int argc, char *argv[])
+{
+	const char *topics = "sensor_accel,sensor_gyro,control_state";
+	const char *trigger = "impact_detection.inRecovery";
+	bool error_flag = false;
+
+	int myoptind = 1;
+	int ch;
+	const char *myoptarg = NULL;
+
+	while ((ch = px4_getopt(argc, argv, "t:T:", &myoptind, &myoptarg)) != EOF) {
+		switch (ch) {
+		case 't':
+			topics = myoptarg;
+			break;
+
+		case 'T':
+			trigger = myoptarg;
+			break;
+
+		case '?':
+			error_flag = true;
+			break;
+
+		default:
+			PX4_WARN("unrecognized flag");
+			error_flag = true;
+			break;
+		}
+	}
+
+	int32_t buffer_kib = 16;
+	int32_t pre_trigger_ms = 80;
+	int32_t post_trigger_ms = 40;
+	param_t handle = param_find("SDLOG_FR_BUF");
+
+	if (handle != PARAM_INVALID) {
+		param_get(handle, &buffer_kib);
+	}
+
+	handle = param_find("SDLOG_FR_PRE");
+
+	if (handle != PARAM_INVALID) {
+		param_get(handle, &pre_trigger_ms);
+	}
+
+	handle = param_find("SDLOG_FR_POST");
+
+	if (handle != PARAM_INVALID) {
+		param_get(handle, &post_trigger_ms);
+	}
+
+	if (buffer_kib == 0) {
+		PX4_INFO("disabled (SDLOG_FR_BUF = 0)");
+		error_flag = true;
+
+	} else if (buffer_kib < 0 || pre_trigger_ms < 0 || post_trigger_ms < 0) {
+		PX4_ERR("invalid SDLOG_FR_* parameters");
+		error_flag = true;
+	}
+
+	if (error_flag) {
+		recorder_task = -1;
+		return;
+	}
+
+	recorder_ptr = new FlightRecorder(buffer_kib * 1024, pre_trigger_ms * 1000, post_trigger_ms * 1000);
+
+	if (recorder_ptr == nullptr) {
+		PX4_ERR("alloc failed");
+
+	} else {
+		char topic_list[128];
+		strncpy(topic_list, topics, sizeof(topic_list) - 1);
+		topic_list[sizeof(topic_list) - 1] = '\0';
+		char *saveptr;
+		int ntopics = 0;
+
+		for (char *name = strtok_r(topic_list, ",", &saveptr); name; name = strtok_r(nullptr, ",", &saveptr)) {
+			if (recorder_ptr->add_topic(name) == 0) {
+				++ntopics;
+			}
+		}
+
+		if (ntopics == 0) {
+			PX4_ERR("no topics to record");
+
+		} else if (recorder_ptr->set_trigger(trigger) == 0) {
+			recorder_ptr->run();
+		}
+	}
+
+	recorder_task = -1;
+}
+
+FlightRecorder::FlightRecorder(size_t buffer_size, uint32_t pre_trigger, uint32_t post_trigger) :
+	_ring_size(buffer_size),
+	_pre_trigger(pre_trigger),
+	_post_trigger(post_trigger)
+{
+	pthread_mutex_init(&_mtx, nullptr);
+	pthread_cond_init(&_cv, nullptr);
+	_perf_write = perf_alloc(PC_ELAPSED, "recorder write");
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	if (recorder_task != -1) {
+		/* task wakes up every POLL_TIMEOUT at the longest, a pending window is written first */
+		_task_should_exit = true;
+
+		unsigned int i = 0;
+
+		do {
+			/* wait 20ms */
+			usleep(20000);
+
+			/* if we have given up, kill it */
+			if (++i > 500) {
+				px4_task_delete(recorder_task);
+				recorder_task = -1;
+				break;
+			}
+		} while (recorder_task != -1);
+	}
+
+	for (unsigned i = 0; i < _num_subscriptions; i++) {
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (_subscriptions[i].fd[instance] >= 0) {
+				orb_unsubscribe(_subscriptions[i].fd[instance]);
+			}
+		}
+	}
+
+	if (_trigger_fd >= 0) {
+		orb_unsubscribe(_trigger_fd);
+	}
+
+	delete[](_ring);
+	delete[](_msg_buffer);
+	delete[](_trigger_buffer);
+
+	pthread_mutex_destroy(&_mtx);
+	pthread_cond_destroy(&_cv);
+	perf_free(_perf_write);
+}
+
+int FlightRecorder::add_topic(const char *name)
+{
+	if (_num_subscriptions >= MAX_TOPICS_NUM) {
+		PX4_WARN("too many topics, skipping %s", name);
+		return -1;
+	}
+
+	const orb_metadata **topics = orb_get_topics();
+
+	for (size_t i = 0; i < orb_topics_count(); i++) {
+		if (strcmp(name, topics[i]->o_name) == 0) {
+			RecorderSubscription &sub = _subscriptions[_num_subscriptions++];
+			sub.metadata = topics[i];
+
+			for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+				sub.fd[instance] = -1;
+			}
+
+			return 0;
+		}
+	}
+
+	PX4_WARN("unknown topic %s", name);
+	return -1;
+}
+
+int FlightRecorder::set_trigger(const char *spec)
+{
+	char topic_name[64];
+	const char *dot = strchr(spec, '.');
+	size_t name_len = dot ? (size_t)(dot - spec) : strlen(spec);
+
+	if (name_len >= sizeof(topic_name) || strlen(spec) >= sizeof(_trigger_spec)) {
+		PX4_ERR("trigger %s too long", spec);
+		return -1;
+	}
+
+	memcpy(topic_name, spec, name_len);
+	topic_name[name_len] = '\0';
+
+	const orb_metadata **topics = orb_get_topics();
+
+	for (size_t i = 0; i < orb_topics_count(); i++) {
+		if (strcmp(topic_name, topics[i]->o_name) == 0) {
+			_trigger_topic = topics[i];
+			break;
+		}
+	}
+
+	if (!_trigger_topic) {
+		PX4_ERR("unknown trigger topic %s", topic_name);
+		return -1;
+	}
+
+	_trigger_offset = -1;
+
+	if (dot && find_field(_trigger_topic, dot + 1, _trigger_offset, _trigger_size) != 0) {
+		PX4_ERR("trigger field %s not found", dot + 1);
+		return -1;
+	}
+
+	strcpy(_trigger_spec, spec);
+	return 0;
+}
+
+void FlightRecorder::status()
+{
+	static const char *state_names[] = {"recording", "post-trigger", "writing"};
+
+	/* the writer thread resets the ring */
+	pthread_mutex_lock(&_mtx);
+	State state = _state;
+	size_t used = _used;
+	hrt_abstime oldest_timestamp = _oldest_timestamp;
+	pthread_mutex_unlock(&_mtx);
+
+	PX4_INFO("%s, trigger %s, window -%.3f s / +%.3f s", state_names[(int)state], _trigger_spec,
+		 (double)(_pre_trigger * 1e-6f), (double)(_post_trigger * 1e-6f));
+
+	if (used > 0) {
+		PX4_INFO("ring: %zu / %zu B, oldest sample %.3f s ago", used, _ring_size,
+			 (double)(hrt_elapsed_time(&oldest_timestamp) * 1e-6f));
+	}
+
+	for (unsigned i = 0; i < _num_subscriptions; i++) {
+		PX4_INFO("%-28s %" PRIu32 " samples", _subscriptions[i].metadata->o_name, _subscriptions[i].samples);
+	}
+
+	PX4_INFO("recordings: %u, last pre-trigger window %.3f s, max trigger latency %" PRIu32 " us", _recordings,
+		 (double)(_last_pre_window * 1e-6f), _max_trigger_latency);
+	PX4_INFO("overwritten msgs: %zu, not recorded while writing: %zu", _overwritten, _discarded);
+	perf_print_counter(_perf_write);
+}
+
+void FlightRecorder::run()
+{
+	int mkdir_ret = mkdir(LOG_ROOT, S_IRWXU | S_IRWXG | S_IRWXO);
+
+	if (mkdir_ret != 0 && errno != EEXIST) {
+		PX4_ERR("failed creating log root dir: %s", LOG_ROOT);
+		return;
+	}
+
+	mkdir_ret = mkdir(RECORDER_DIR, S_IRWXU | S_IRWXG | S_IRWXO);
+
+	if (mkdir_ret != 0 && errno != EEXIST) {
+		PX4_ERR("failed creating recorder dir: %s", RECORDER_DIR);
+		return;
+	}
+
+	size_t max_msg_size = 0;
+
+	for (unsigned i = 0; i < _num_subscriptions; i++) {
+		//use o_size, because that's what orb_copy will use
+		if (_subscriptions[i].metadata->o_size > max_msg_size) {
+			max_msg_size = _subscriptions[i].metadata->o_size;
+		}
+	}
+
+	_ring = new uint8_t[_ring_size];
+	_msg_buffer = new uint8_t[sizeof(ulog_message_data_header_s) + max_msg_size];
+	_trigger_buffer = new uint8_t[_trigger_topic->o_size];
+
+	if (!_ring || !_msg_buffer || !_trigger_buffer) {
+		PX4_ERR("failed to allocate %zu B ring", _ring_size);
+		return;
+	}
+
+	_trigger_fd = orb_subscribe(_trigger_topic);
+
+	if (_trigger_fd < 0) {
+		PX4_ERR("trigger subscription failed");
+		return;
+	}
+
+	pthread_attr_t thr_attr;
+	pthread_attr_init(&thr_attr);
+
+	sched_param param;
+	/* low priority, as this is expensive disk I/O */
+	param.sched_priority = SCHED_PRIORITY_DEFAULT - 40;
+	(void)pthread_attr_setschedparam(&thr_attr, &param);
+
+	pthread_attr_setstacksize(&thr_attr, 1400);
+
+	int ret = pthread_create(&_writer_thread, &thr_attr, &FlightRecorder::writer_helper, this);
+	pthread_attr_destroy(&thr_attr);
+
+	if (ret != 0) {
+		PX4_ERR("writer thread start failed: %i", ret);
+		return;
+	}
+
+	_writer_running = true;
+
+	PX4_INFO("recording %u topics in %zu KiB, trigger %s", _num_subscriptions, _ring_size / 1024, _trigger_spec);
+
+	px4_pollfd_struct_t fds[MAX_TOPICS_NUM * ORB_MULTI_MAX_INSTANCES + 1];
+	int nfds = 0;
+	hrt_abstime next_subscribe = 0;
+
+	while (!_task_should_exit) {
+		hrt_abstime now = hrt_absolute_time();
+
+		if (now >= next_subscribe) {
+			next_subscribe = now + 1000 * 1000;
+
+			if (subscribe_instances() || nfds == 0) {
+				/* the trigger wakes us up as well, it bounds the trigger latency */
+				nfds = 0;
+				fds[nfds].fd = _trigger_fd;
+				fds[nfds++].events = POLLIN;
+
+				for (unsigned i = 0; i < _num_subscriptions; i++) {
+					for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+						if (_subscriptions[i].fd[instance] >= 0) {
+							fds[nfds].fd = _subscriptions[i].fd[instance];
+							fds[nfds++].events = POLLIN;
+						}
+					}
+				}
+			}
+		}
+
+		int pret = px4_poll(fds, nfds, POLL_TIMEOUT);
+
+		if (pret < 0) {
+			PX4_WARN("poll error %d, %d", pret, errno);
+			usleep(10000);
+			continue;
+		}
+
+		now = hrt_absolute_time();
+
+		pthread_mutex_lock(&_mtx);
+		State state = _state;
+		pthread_mutex_unlock(&_mtx);
+
+		/* while the writer owns the ring the samples are copied and dropped */
+		const bool store = state != State::Writing;
+
+		for (unsigned i = 0; i < _num_subscriptions; i++) {
+			for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+				bool updated = false;
+
+				if (_subscriptions[i].fd[instance] >= 0 && orb_check(_subscriptions[i].fd[instance], &updated) == 0
+				    && updated) {
+					record(_subscriptions[i], instance, store);
+				}
+			}
+		}
+
+		hrt_abstime trigger_time;
+
+		if (check_trigger(now, trigger_time) && state == State::Recording) {
+			pthread_mutex_lock(&_mtx);
+			_trigger_time = trigger_time;
+			_state = State::PostTrigger;
+			pthread_mutex_unlock(&_mtx);
+			state = State::PostTrigger;
+		}
+
+		if (state == State::PostTrigger && now >= _trigger_time + _post_trigger) {
+			pthread_mutex_lock(&_mtx);
+			_state = State::Writing;
+			pthread_cond_signal(&_cv);
+			pthread_mutex_unlock(&_mtx);
+		}
+	}
+
+	/* keep a window that was triggered already, even if it is shorter */
+	pthread_mutex_lock(&_mtx);
+
+	if (_state == State::PostTrigger) {
+		_state = State::Writing;
+	}
+
+	pthread_cond_signal(&_cv);
+	pthread_mutex_unlock(&_mtx);
+
+	pthread_join(_writer_thread, nullptr);
+	_writer_running = false;
+}
+
+bool FlightRecorder::subscribe_instances()
+{
+	bool subscribed = false;
+
+	for (unsigned i = 0; i < _num_subscriptions; i++) {
+		RecorderSubscription &sub = _subscriptions[i];
+
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (sub.fd[instance] < 0 && orb_exists(sub.metadata, instance) == 0) {
+				sub.fd[instance] = orb_subscribe_multi(sub.metadata, instance);
+				subscribed = subscribed || sub.fd[instance] >= 0;
+			}
+		}
+	}
+
+	return subscribed;
+}
+
+void FlightRecorder::record(RecorderSubscription &sub, int instance, bool store)
+{
+	orb_copy(sub.metadata, sub.fd[instance], _msg_buffer + sizeof(ulog_message_data_header_s));
+
+	if (!store) {
+		++_discarded;
+		return;
+	}
+
+	/* the same DATA message as the logger writes, msg_id is fixed per topic and instance */
+	size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+	uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+	uint16_t write_msg_id = static_cast<uint16_t>((&sub - _subscriptions) * ORB_MULTI_MAX_INSTANCES + instance);
+	_msg_buffer[0] = (uint8_t)write_msg_size;
+	_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
+	_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
+	_msg_buffer[3] = (uint8_t)write_msg_id;
+	_msg_buffer[4] = (uint8_t)(write_msg_id >> 8);
+
+	push(_msg_buffer, msg_size);
+	++sub.samples;
+}
+
+bool FlightRecorder::check_trigger(hrt_abstime now, hrt_abstime &trigger_time)
+{
+	bool edge = false;
+	bool updated = false;
+
+	if (orb_check(_trigger_fd, &updated) == 0 && updated) {
+		orb_copy(_trigger_topic, _trigger_fd, _trigger_buffer);
+		bool active = true;
+
+		if (_trigger_offset >= 0) {
+			active = false;
+
+			for (int i = 0; i < _trigger_size; i++) {
+				active = active || _trigger_buffer[_trigger_offset + i] != 0;
+			}
+		}
+
+		edge = active && (!_trigger_active || _trigger_offset < 0);
+		_trigger_active = active;
+
+		if (edge) {
+			/* the window is centered on the trigger sample, not on when we saw it */
+			hrt_abstime sample_time;
+			memcpy(&sample_time, _trigger_buffer, sizeof(sample_time));
+
+			if (sample_time == 0 || sample_time > now) {
+				sample_time = now;
+			}
+
+			if (now - sample_time > _max_trigger_latency) {
+				_max_trigger_latency = now - sample_time;
+			}
+
+			trigger_time = sample_time;
+		}
+	}
+
+	if (_trigger_requested) {
+		_trigger_requested = false;
+		trigger_time = now;
+		edge = true;
+	}
+
+	return edge;
+}
+
+void FlightRecorder::push(const uint8_t *msg, size_t size)
+{
+	if (size > _ring_size) {
+		return;
+	}
+
+	size_t used = _used;
+
+	while (_ring_size - used < size) {
+		size_t oldest = message_size(_tail);
+		_tail = (_tail + oldest) % _ring_size;
+		used -= oldest;
+		++_overwritten;
+	}
+
+	size_t first = _ring_size - _head;
+
+	if (first > size) {
+		first = size;
+	}
+
+	memcpy(_ring + _head, msg, first);
+	memcpy(_ring, msg + first, size - first);
+	_head = (_head + size) % _ring_size;
+	hrt_abstime oldest_timestamp = message_timestamp(_tail);
+
+	/* for status() */
+	pthread_mutex_lock(&_mtx);
+	_used = used + size;
+	_oldest_timestamp = oldest_timestamp;
+	pthread_mutex_unlock(&_mtx);
+}
+
+void FlightRecorder::read(size_t pos, uint8_t *dst, size_t size) const
+{
+	for (size_t i = 0; i < size; i++) {
+		dst[i] = _ring[(pos + i) % _ring_size];
+	}
+}
+
+size_t FlightRecorder::message_size(size_t pos) const
+{
+	uint8_t header[2];
+	read(pos, header, sizeof(header));
+	return (size_t)(header[0] | (header[1] << 8)) + ULOG_MSG_HEADER_LEN;
+}
+
+hrt_abstime FlightRecorder::message_timestamp(size_t pos) const
+{
+	/* every topic starts with its timestamp */
+	hrt_abstime timestamp;
+	read(pos + sizeof(ulog_message_data_header_s), (uint8_t *)&timestamp, sizeof(timestamp));
+	return timestamp;
+}
+
+void FlightRecorder::reset_ring()
+{
+	_head = 0;
+	_tail = 0;
+	_used = 0;
+}
+
+void *FlightRecorder::writer_helper(void *context)
+{
+	px4_prctl(PR_SET_NAME, "flight_recorder_writer", px4_getpid());
+	static_cast<FlightRecorder *>(context)->writer_run();
+	return nullptr;
+}
+
+void FlightRecorder::writer_run()
+{
+	while (true) {
+		pthread_mutex_lock(&_mtx);
+
+		while (_state != State::Writing && !_task_should_exit) {
+			pthread_cond_wait(&_cv, &_mtx);
+		}
+
+		bool write = _state == State::Writing;
+		pthread_mutex_unlock(&_mtx);
+
+		if (!write) {
+			break;
+		}
+
+		if (write_segment() == 0) {
+			++_recordings;
+		}
+
+		pthread_mutex_lock(&_mtx);
+		reset_ring();
+		_state = State::Recording;
+		pthread_mutex_unlock(&_mtx);
+
+		if (_task_should_exit) {
+			break;
+		}
+	}
+}
+
+int FlightRecorder::open_file(char *file_name, size_t file_name_size)
+{
+	struct stat buffer;
+
+	/* look for the next file that does not exist */
+	for (unsigned file_number = 1; file_number <= MAX_NO_FILE; file_number++) {
+		snprintf(file_name, file_name_size, "%s/rec%03u.ulg", RECORDER_DIR, file_number);
+
+		if (stat(file_name, &buffer) != 0) {
+			return ::open(file_name, O_CREAT | O_WRONLY | O_TRUNC, PX4_O_MODE_666);
+		}
+	}
+
+	PX4_ERR("all %u recording file names in use", MAX_NO_FILE);
+	return -1;
+}
+
+int FlightRecorder::write_segment()
+{
+	char file_name[128];
+	int fd = open_file(file_name, sizeof(file_name));
+
+	if (fd < 0) {
+		PX4_ERR("can't open recording file");
+		return -1;
+	}
+
+	perf_begin(_perf_write);
+
+	/* skip what is older than the pre-trigger window */
+	hrt_abstime window_start = (_trigger_time > _pre_trigger) ? _trigger_time - _pre_trigger : 0;
+	size_t pos = _tail;
+	size_t remaining = _used;
+
+	while (remaining > 0 && message_timestamp(pos) < window_start) {
+		size_t size = message_size(pos);
+		pos = (pos + size) % _ring_size;
+		remaining -= size;
+	}
+
+	hrt_abstime first_timestamp = (remaining > 0) ? message_timestamp(pos) : _trigger_time;
+	_last_pre_window = (_trigger_time > first_timestamp) ? _trigger_time - first_timestamp : 0;
+
+	ulog_file_header_s header;
+	header.magic[0] = 'U';
+	header.magic[1] = 'L';
+	header.magic[2] = 'o';
+	header.magic[3] = 'g';
+	header.magic[4] = 0x01;
+	header.magic[5] = 0x12;
+	header.magic[6] = 0x35;
+	header.magic[7] = 0x00; //file version 0
+	header.timestamp = first_timestamp;
+
+	bool ok = write_all(fd, &header, sizeof(header));
+	ok = ok && write_info(fd, "ver_sw", PX4_GIT_VERSION_STR);
+	ok = ok && write_info(fd, "sys_name", "PX4");
+	ok = ok && write_info(fd, "recorder_trigger", _trigger_spec);
+
+	/* all formats, as the logger does: nested types need theirs as well.
+	 * The message does not fit on the writer stack. */
+	ulog_message_format_s *format = new ulog_message_format_s;
+	const orb_metadata **topics = orb_get_topics();
+	ok = ok && format != nullptr;
+
+	for (size_t i = 0; ok && i < orb_topics_count(); i++) {
+		int format_len = snprintf(format->format, sizeof(format->format), "%s:%s", topics[i]->o_name, topics[i]->o_fields);
+		size_t msg_size = sizeof(*format) - sizeof(format->format) + format_len;
+		format->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+		ok = write_all(fd, format, msg_size);
+	}
+
+	delete format;
+
+	ulog_message_add_logged_s add;
+
+	for (unsigned i = 0; ok && i < _num_subscriptions; i++) {
+		for (int instance = 0; ok && instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (_subscriptions[i].fd[instance] < 0) {
+				continue;
+			}
+
+			int message_name_len = strlen(_subscriptions[i].metadata->o_name);
+			memcpy(add.message_name, _subscriptions[i].metadata->o_name, message_name_len);
+			add.multi_id = instance;
+			add.msg_id = i * ORB_MULTI_MAX_INSTANCES + instance;
+			size_t msg_size = sizeof(add) - sizeof(add.message_name) + message_name_len;
+			add.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+			ok = write_all(fd, &add, msg_size);
+		}
+	}
+
+	/* the window is at most two contiguous pieces of the ring */
+	size_t first = _ring_size - pos;
+
+	if (first > remaining) {
+		first = remaining;
+	}
+
+	ok = ok && write_all(fd, _ring + pos, first);
+	ok = ok && write_all(fd, _ring, remaining - first);
+
+	fsync(fd);
+	::close(fd);
+	perf_end(_perf_write);
+
+	if (!ok) {
+		PX4_ERR("writing %s failed", file_name);
+		return -1;
+	}
+
+	PX4_INFO("recorded %s: %.3f s before, %.3f s after the trigger", file_name, (double)(_last_pre_window * 1e-6f),
+		 (double)(_post_trigger * 1e-6f));
+	return 0;
+}
+
+bool FlightRecorder::write_info(int fd, const char *name, const char *value)
+{
+	uint8_t buffer[sizeof(ulog_message_info_header_s)];
+	ulog_message_info_header_s *msg = reinterpret_cast<ulog_message_info_header_s *>(buffer);
+	msg->msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
+
+	/* construct format key (type and name) */
+	size_t vlen = strlen(value);
+	msg->key_len = snprintf(msg->key, sizeof(msg->key), "char[%zu] %s", vlen, name);
+	size_t msg_size = sizeof(*msg) - sizeof(msg->key) + msg->key_len;
+
+	/* copy string value directly to buffer */
+	if (vlen >= (sizeof(*msg) - msg_size)) {
+		return true;
+	}
+
+	memcpy(&buffer[msg_size], value, vlen);
+	msg_size += vlen;
+	msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+
+	return write_all(fd, buffer, msg_size);
+}
+
+bool FlightRecorder::write_all(int fd, const void *ptr, size_t size)
+{
+	const uint8_t *data = static_cast<const uint8_t *>(ptr);
+
+	while (size > 0) {
+		ssize_t written = ::write(fd, data, size);
+
+		if (written <= 0) {
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+} //namespace logger
+} //namespace px4
@@ -0,0 +1,219 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file flight_recorder.h
+ *
+ * In-RAM pre-trigger recorder: a set of topics is kept at full rate in a fixed
+ * size ring of ULog DATA messages. When the trigger fires, recording continues
+ * for the post-trigger time, then the window around the trigger is frozen and
+ * written as a separate ULog file by a low priority thread. It runs next to
+ * logger or sdlog2 and does not depend on either of them.
+ */
+
+#pragma once
+
+#include <px4.h>
+#include <drivers/drv_hrt.h>
+#include <logger/messages.h>
+#include <systemlib/perf_counter.h>
+#include <pthread.h>
+
+extern "C" __EXPORT int flight_recorder_main(int argc, char *argv[]);
+
+namespace px4
+{
+namespace logger
+{
+
+struct RecorderSubscription {
+	const orb_metadata *metadata = nullptr;
+	int fd[ORB_MULTI_MAX_INSTANCES];
+	uint32_t samples = 0;	///< samples recorded, all instances
+};
+
+class FlightRecorder
+{
+public:
+	/**
+	 * @param buffer_size size of the ring [bytes], allocated once
+	 * @param pre_trigger recorded time before the trigger [us]
+	 * @param post_trigger recorded time after the trigger [us]
+	 */
+	FlightRecorder(size_t buffer_size, uint32_t pre_trigger, uint32_t post_trigger);
+
+	~FlightRecorder();
+
+	/**
+	 * Add a topic to record, all its instances are recorded.
+	 * @return 0 on success
+	 */
+	int add_topic(const char *name);
+
+	/**
+	 * Set the trigger: "topic" fires on every update of the topic,
+	 * "topic.field" when the field changes from zero to non-zero.
+	 * @return 0 on success
+	 */
+	int set_trigger(const char *spec);
+
+	/**
+	 * Fire the trigger from the command line
+	 */
+	void request_trigger() { _trigger_requested = true; }
+
+	static int start(char *const *argv);
+
+	static void usage(const char *reason);
+
+	void status();
+
+private:
+	enum class State {
+		Recording,	///< filling the ring, waiting for the trigger
+		PostTrigger,	///< triggered, recording the post-trigger window
+		Writing		///< ring frozen, the writer thread owns it
+	};
+
+	static void run_trampoline(int argc, char *argv[]);
+
+	void run();
+
+	static void *writer_helper(void *context);
+
+	/**
+	 * Writer thread: waits for a frozen ring and writes it to a new file
+	 */
+	void writer_run();
+
+	/**
+	 * Subscribe to instances that were published meanwhile
+	 * @return true if a new instance was subscribed
+	 */
+	bool subscribe_instances();
+
+	/**
+	 * Copy an updated instance into the ring (or discard it while writing)
+	 */
+	void record(RecorderSubscription &sub, int instance, bool store);
+
+	/**
+	 * Check the trigger topic
+	 * @param trigger_time set to the time of the trigger sample on an edge
+	 * @return true on a trigger edge
+	 */
+	bool check_trigger(hrt_abstime now, hrt_abstime &trigger_time);
+
+	/**
+	 * Append a message to the ring, dropping the oldest messages if needed
+	 */
+	void push(const uint8_t *msg, size_t size);
+
+	/** copy size bytes starting at ring position pos, wrapping at the end */
+	void read(size_t pos, uint8_t *dst, size_t size) const;
+
+	/** size of the message at ring position pos, including the header */
+	size_t message_size(size_t pos) const;
+
+	/** timestamp of the message at ring position pos */
+	hrt_abstime message_timestamp(size_t pos) const;
+
+	void reset_ring();
+
+	int open_file(char *file_name, size_t file_name_size);
+
+	/**
+	 * Write the frozen window as a ULog file
+	 * @return 0 on success
+	 */
+	int write_segment();
+
+	bool write_info(int fd, const char *name, const char *value);
+
+	static bool write_all(int fd, const void *ptr, size_t size);
+
+	static constexpr size_t		MAX_TOPICS_NUM = 8;	///< maximum number of recorded topics
+	static constexpr unsigned	MAX_NO_FILE = 999;	///< maximum number of recordings
+	static constexpr int		POLL_TIMEOUT = 20;	///< [ms], bounds the trigger latency without updates
+#ifdef __PX4_POSIX_EAGLE
+	static constexpr const char	*LOG_ROOT = PX4_ROOTFSDIR"/log";
+	static constexpr const char	*RECORDER_DIR = PX4_ROOTFSDIR"/log/recorder";
+#else
+	static constexpr const char	*LOG_ROOT = PX4_ROOTFSDIR"/fs/microsd/log";
+	static constexpr const char	*RECORDER_DIR = PX4_ROOTFSDIR"/fs/microsd/log/recorder";
+#endif
+
+	/* ring of complete ULog DATA messages, from _tail (oldest) to _head */
+	uint8_t				*_ring = nullptr;
+	const size_t			_ring_size;
+	size_t				_head = 0;
+	size_t				_tail = 0;
+	size_t				_used = 0;			///< written under _mtx, for status()
+	hrt_abstime			_oldest_timestamp = 0;	///< timestamp of the message at _tail, written under _mtx
+
+	const uint32_t			_pre_trigger;
+	const uint32_t			_post_trigger;
+
+	RecorderSubscription		_subscriptions[MAX_TOPICS_NUM];
+	unsigned			_num_subscriptions = 0;
+	uint8_t				*_msg_buffer = nullptr;	///< one DATA message of the largest topic
+
+	const orb_metadata		*_trigger_topic = nullptr;
+	int				_trigger_fd = -1;
+	int				_trigger_offset = -1;	///< offset of the trigger field, -1: any update
+	int				_trigger_size = 0;
+	bool				_trigger_active = false;
+	volatile bool			_trigger_requested = false;
+	uint8_t				*_trigger_buffer = nullptr;
+	char				_trigger_spec[64] = "";
+
+	/* shared with the writer thread, protected by _mtx */
+	State				_state = State::Recording;
+	hrt_abstime			_trigger_time = 0;
+	pthread_mutex_t			_mtx;
+	pthread_cond_t			_cv;
+	pthread_t			_writer_thread;
+	bool				_writer_running = false;
+	volatile bool			_task_should_exit = false;
+
+	// statistics
+	unsigned			_recordings = 0;
+	uint32_t			_max_trigger_latency = 0;	///< trigger sample timestamp to its detection [us]
+	uint32_t			_last_pre_window = 0;		///< pre-trigger time in the last recording [us]
+	size_t				_overwritten = 0;		///< messages dropped from the ring
+	size_t				_discarded = 0;			///< samples not recorded while writing
+	perf_counter_t			_perf_write;
+};
+
+} //namespace logger
+} //namespace px4
@@ -9,88 +9,118 @@
  * @author2 Fiona Chui<fiona.m.chui@gmail.com>
  */
 #include <modules/impact_characterization/impact_characterization.h> 
-#include <modules/impact_characterization/initialize_fuzzylogicprocess.cpp> 
 
-// CLASS FUNCTIONS
- QuaternionQueue::QuaternionQueue()
-{
-	head = tail = 0;
-}
+//DECLARE STATICS
+static bool thread_should_exit = false;		/**< daemon exit flag */
+static bool thread_running = false;			/**< daemon status flag */
+static int daemon_task;						/**< Handle of daemon task / thread */
 
-void QuaternionQueue::quatqueue(math::Quaternion quat){
-	if (tail + 1 == head || ((tail + 1 == QUATQUEUESIZE) && !head)){
-		//queue is full
-		head ++;
-		if (head == QUATQUEUESIZE) head = 0;
-	}
-	tail ++;
-	if (tail == QUATQUEUESIZE) tail = 0;
-	queue[tail] = quat;
-	return;
-}
+//MAIN FUNCTIONS
+extern "C" __EXPORT int impact_characterization_main(int argc, char *argv[]);
 
-math::Quaternion QuaternionQueue::readquatqueue(int queueidx){
-	if (queueidx >= QUATQUEUESIZE){
-		PX4_INFO("ERROR: requested to access quat queue out of range");
-		math::Quaternion tempquat(1,0,0,0);
-		return tempquat;
-	}
-	else{
-		if (head+queueidx >= QUATQUEUESIZE) return queue[head+queueidx-QUATQUEUESIZE];
-		else return queue[head+queueidx];
-	}
+static ImpactCharacterization *g_impact_characterization = nullptr;
+static pthread_mutex_t g_instance_mutex = PTHREAD_MUTEX_INITIALIZER; /**< held by status while it uses the instance, and while the task deletes it */
 
-}
+static void usage(const char *reason);
 
-// CUSTOM FUNCTIONS
-math::Vector<3> crossProduct(const math::Vector<3> v1, const math::Vector<3> v2){
-	/**
-	 * cross product (added by Fiona)
-	 */
- 	math::Vector<3> res;
-	res.data[0] = v1.data[1]*v2.data[2] - v1.data[2]*v2.data[1];
-	res.data[1] = v1.data[2]*v2.data[0] - v1.data[0]*v2.data[2];
-	res.data[2] = v1.data[0]*v2.data[1] - v1.data[1]*v2.data[0];
-	return res;
+static void usage(const char *reason)
+{
+	if (reason) {
+		warnx("%s\n", reason);
+	}
 
+	warnx("usage: impact_characterization {start|stop|status|lut_check [samples]} [-p <additional params>]\n\n");
 }
 
-float signf(const float number){
-	if (number < 0.0f) return -1.0f;
-	else return 1.0f;
-}
+/**
+ * Compare the lookup table surrogate against the live fuzzy engine over a
+ * uniform random sweep of the table domain and report error and cost.
+ * Fails if the table is off by more than FUZZY_LUT_MAX_ERROR anywhere.
+ */
+static int lut_check(int samples)
+{
+	Fuzzy* fuzzy = new Fuzzy();
+	init_flp_params(fuzzy);
 
-float rad2deg(const float angle){
-	return angle*180.0f/(float)M_PI;
-}
+	FuzzyCompiled* fuzzyEngine = new FuzzyCompiled();
+	bool compiled = fuzzyEngine->compile(fuzzy);
 
-// DECLARE CONSTANTS
-const int fuzzyInputCalcCycleDelay_array[4] = {2,0,2,3};
-// const int fuzzyInputCalcCycleDelay_array[4] = {0,200,400,200};
+	// the compiled engine is a flat copy, the rule base is not needed anymore
+	delete fuzzy;
 
-const math::Vector<3> inertialFrameGravityDirection(0.0f,0.0f,1.0f); //Navi's inertial frame is NED
-const math::Vector<3> inertialFrameNegGravityDirection(0.0f,0.0f,-1.0f);
-const math::Vector<3> bodyFrameGravityDirection(0.0f,0.0f,1.0f); //Navi's body frame is also NED 
-const math::Vector<3> bodyFrameNegGravityDirection(0.0f,0.0f,-1.0f); 
+	if (!compiled){
+		PX4_ERR("fuzzy rule base exceeds FuzzyCompiled capacity");
+		delete fuzzyEngine;
+		return 1;
+	}
 
+	FuzzyLookupTable* fuzzyTable = new FuzzyLookupTable();
+	hrt_abstime t0 = hrt_absolute_time();
+	bool tableValid = fuzzyTable->generate(*fuzzyEngine);
+	hrt_abstime generateTime = hrt_absolute_time() - t0;
+
+	float lo[FUZZY_LUT_INPUTS];
+	float hi[FUZZY_LUT_INPUTS];
+	for (int iInput = 0; iInput < FUZZY_LUT_INPUTS; iInput++){
+		int count;
+		const float *nodes = FuzzyLookupTable::axis(iInput, &count);
+		lo[iInput] = nodes[0];
+		hi[iInput] = nodes[count - 1];
+	}
 
-//DECLARE STATICS
-static bool thread_should_exit = false;		/**< daemon exit flag */
-static bool thread_running = false;			/**< daemon status flag */
-static int daemon_task;						/**< Handle of daemon task / thread */
+	float maxError = 0.0f;
+	float worstInput[FUZZY_LUT_INPUTS] = {};
+	double sumError = 0.0;
+	int outliers = 0;
+	hrt_abstime liveTime = 0;
+	hrt_abstime tableTime = 0;
+
+	srand(1);
+	for (int i = 0; i < samples; i++){
+		float input[FUZZY_LUT_INPUTS];
+		for (int iInput = 0; iInput < FUZZY_LUT_INPUTS; iInput++){
+			input[iInput] = lo[iInput] + (hi[iInput] - lo[iInput]) * ((float)rand() / (float)RAND_MAX);
+		}
 
-//MAIN FUNCTIONS
-extern "C" __EXPORT int impact_characterization_main(int argc, char *argv[]);
+		t0 = hrt_absolute_time();
+		for (int iInput = 0; iInput < FUZZY_LUT_INPUTS; iInput++){
+			fuzzyEngine->setInput(iInput + 1, input[iInput]);
+		}
+		fuzzyEngine->fuzzify();
+		float live = fuzzyEngine->defuzzify(1);
+		hrt_abstime t1 = hrt_absolute_time();
+		float table = fuzzyTable->evaluate(input);
+		tableTime += hrt_absolute_time() - t1;
+		liveTime += t1 - t0;
+
+		float error = fabsf(live - table);
+		sumError += error;
+		if (error > FUZZY_LUT_MAX_ERROR){
+			outliers++;
+		}
+		if (error > maxError){
+			maxError = error;
+			memcpy(worstInput, input, sizeof(worstInput));
+		}
+	}
 
-static void usage(const char *reason);
+	PX4_INFO("table: %d nodes, %u bytes, generated in %llu us", FUZZY_LUT_SIZE, (unsigned)sizeof(FuzzyLookupTable),
+		 (unsigned long long)generateTime);
+	PX4_INFO("samples: %d, max error: %.4f at (%.3f, %.3f, %.3f, %.3f)", samples, (double)maxError,
+		 (double)worstInput[0], (double)worstInput[1], (double)worstInput[2], (double)worstInput[3]);
+	PX4_INFO("mean error: %.5f, error > %.2f: %.2f%%", samples > 0 ? sumError / samples : 0.0,
+		 (double)FUZZY_LUT_MAX_ERROR, samples > 0 ? 100.0 * outliers / samples : 0.0);
+	PX4_INFO("total time live: %llu us, table: %llu us", (unsigned long long)liveTime, (unsigned long long)tableTime);
 
-static void usage(const char *reason)
-{
-	if (reason) {
-		warnx("%s\n", reason);
+	delete fuzzyTable;
+	delete fuzzyEngine;
+
+	if (!tableValid || maxError > FUZZY_LUT_MAX_ERROR){
+		PX4_ERR("table error over %.3f, the fuzzy engine is used instead", (double)FUZZY_LUT_MAX_ERROR);
+		return 1;
 	}
 
-	warnx("usage: impact_characterization {start|stop|status} [-p <additional params>]\n\n");
+	return 0;
 }
 
 int impact_characterization_main(int argc, char *argv[]){
@@ -122,10 +152,22 @@ int impact_characterization_main(int argc, char *argv[]){
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "lut_check")) {
+		return lut_check((argc > 2) ? atoi(argv[2]) : 100000);
+	}
+
 	if (!strcmp(argv[1], "status")) {
 		if (thread_running) {
 			PX4_INFO("\trunning\n");
 
+			pthread_mutex_lock(&g_instance_mutex);
+
+			if (g_impact_characterization != nullptr) {
+				g_impact_characterization->print_status();
+			}
+
+			pthread_mutex_unlock(&g_instance_mutex);
+
 		} else {
 			PX4_INFO("\tnot started\n");
 		}
@@ -138,242 +180,93 @@ int impact_characterization_main(int argc, char *argv[]){
 }
 
 
-int impact_characterization_thread_main(int argc, char *argv[])
+ImpactCharacterization::ImpactCharacterization() :
+	_reactor("impact_characterization"),
+	_characterization_pub(ORB_ID(impact_characterization), 0)
 {
-
-	PX4_INFO("impact_characterization starting\n");
-
-	thread_running = true;
-	///////////////////// SUBSCRIPTIONS//////////////////////////
-	// set up subscribers
-	int _sensor_accel_sub = orb_subscribe(ORB_ID(sensor_accel));
-	int _sensor_gyro_sub = orb_subscribe(ORB_ID(sensor_gyro));
-	int _ctrl_state_sub = orb_subscribe(ORB_ID(control_state));
-	int _detection_sub = orb_subscribe(ORB_ID(impact_detection));
-	int _recovery_stage_sub = orb_subscribe(ORB_ID(impact_recovery_stage));
-
-	// declare local copies
-	struct sensor_accel_s             	  _sensor_accel;
-	struct sensor_gyro_s              _sensor_gyro;
-	struct control_state_s			  _ctrl_state;
-	struct impact_detection_s 				 _detection;
-	struct impact_recovery_stage_s  	_recovery_stage;
-	// struct debug_s								 _debug;
-
 	// set them to zero initially
-	memset(&_sensor_accel, 0, sizeof(_sensor_accel));	
+	memset(&_sensor_accel, 0, sizeof(_sensor_accel));
 	memset(&_sensor_gyro, 0, sizeof(_sensor_gyro));
 	memset(&_ctrl_state, 0, sizeof(_ctrl_state));
 	memset(&_detection, 0, sizeof(_detection));
 	memset(&_recovery_stage, 0, sizeof(_recovery_stage));
 
-	// declare update flags
-	bool updated_sensor_accel;
-	bool updated_sensor_gyro;
-	bool updated_ctrl_state;
-	bool updated_detection;
-	bool updated_recovery_stage;
-	////////////////////////////////////////////////////////////
+	int32_t heartbeat_ms = 0;
+	param_get(param_find("IMP_PUB_HB"), &heartbeat_ms);
+	_characterization_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
+}
 
-	////////////////////////PUBLICATIONS////////////////////////
-	struct impact_characterization_s   _characterization;
-	memset(&_characterization, 0, sizeof(_characterization));
-	orb_advert_t _characterization_pub = orb_advertise(ORB_ID(impact_characterization), &_characterization);
-	////////////////////////////////////////////////////////////
+bool ImpactCharacterization::init()
+{
+	if (!_characterizer.init()){
+		return false;
+	}
 
-	///////////////////////////POLLING///////////////////////////
-	struct pollfd fds[1];
-	fds[0].fd = _sensor_accel_sub;
-	fds[0].events = POLLIN;
-    ////////////////////////////////////////////////////////////
+	///////////////////// SUBSCRIPTIONS//////////////////////////
+	// characterization advances one cycle per accel sample, the other topics only refresh state
+	_reactor.add_topic(ORB_ID(sensor_accel), &_sensor_accel, &ImpactCharacterization::accel_callback, this);
+	_reactor.add_topic(ORB_ID(sensor_gyro), &_sensor_gyro);
+	_reactor.add_topic(ORB_ID(control_state), &_ctrl_state);
+	_reactor.add_topic(ORB_ID(impact_detection), &_detection);
+	_reactor.add_topic(ORB_ID(impact_recovery_stage), &_recovery_stage);
+	////////////////////////////////////////////////////////////
 
-    ///////////////////////LOCAL VARIABLES//////////////////////
-	int cyclesAfterImpactDetected = 0; 
-	int fuzzyInputCalculated_array[4] = {0,0,0,0};
+	// advertise the initial state so subscribers find the topic
+	_characterization_pub.update(_characterizer.get(), hrt_absolute_time());
 
-	QuaternionQueue q_att_log;
-	math::Quaternion quat_preImpact;
-	math::Matrix<3, 3> R_preImpact;
+	return true;
+}
 
-	math::Vector<3> wallNormal_vect(0.0f, 0.0f, 0.0f);
-    ////////////////////////////////////////////////////////////
+void ImpactCharacterization::run()
+{
+	while(!thread_should_exit){
+		//TODO: check if armed
+		_reactor.spin_once(100);
+	}
+}
 
-	/////////////// INITIALIZE FUZZY LOGIC PROCESS /////////////
-	Fuzzy* fuzzy = new Fuzzy();
-	init_flp_params(fuzzy);
-	
-    ////////////////////////////////////////////////////////////
+void ImpactCharacterization::on_accel()
+{
+	const impact_characterization_s &characterization = _characterizer.update(_sensor_accel, _sensor_gyro, _ctrl_state,
+			_detection, _recovery_stage);
 
-                
-    while(!thread_should_exit){  
-    	//TODO: check if armed
+	if (_characterization_pub.update(characterization, hrt_absolute_time())) {
+		_reactor.record_latency(_sensor_accel.timestamp);
+	}
+}
 
-		int ret = px4_poll(&fds[0], (sizeof(fds) / sizeof(fds[0])), 100);
-		if (ret == 0) {
-			continue;
-		}
+int impact_characterization_thread_main(int argc, char *argv[])
+{
 
-		if (fds[0].revents & POLLIN){		
-		   	// poll for subscription updates
+	PX4_INFO("impact_characterization starting\n");
 
-			orb_check(_sensor_accel_sub, &updated_sensor_accel);
-			orb_check(_sensor_gyro_sub, &updated_sensor_gyro);
-			orb_check(_ctrl_state_sub, &updated_ctrl_state);
-			orb_check(_detection_sub, &updated_detection);
-			orb_check(_recovery_stage_sub, &updated_recovery_stage);
+	g_impact_characterization = new ImpactCharacterization();
 
-			// make local copies of uORB topics
-			if(updated_sensor_accel){
-				orb_copy(ORB_ID(sensor_accel), _sensor_accel_sub, &_sensor_accel);
-			}
-			if(updated_sensor_gyro){
-				orb_copy(ORB_ID(sensor_gyro), _sensor_gyro_sub, &_sensor_gyro);
-			}			
-			if(updated_ctrl_state){
-				orb_copy(ORB_ID(control_state), _ctrl_state_sub, &_ctrl_state);
-			}
-			if(updated_detection){
-				orb_copy(ORB_ID(impact_detection), _detection_sub, &_detection);
-			}
-			if(updated_recovery_stage){
-				orb_copy(ORB_ID(impact_recovery_stage), _recovery_stage_sub, &_recovery_stage);
-			}
+	if (g_impact_characterization == nullptr) {
+		PX4_ERR("alloc failed");
+		return 1;
+	}
 
-			math::Quaternion q_att(_ctrl_state.q[0], _ctrl_state.q[1], _ctrl_state.q[2], _ctrl_state.q[3]);
-
-			if (_detection.inRecovery){
-				if(!_characterization.accelRefIsComputed){					
-					if (cyclesAfterImpactDetected == 0){
-						// calculate pre-impact rotation matrix							
-						quat_preImpact = q_att_log.readquatqueue(QUATQUEUESIZE-PREIMPACTCYCLES-1);
-						R_preImpact = quat_preImpact.to_dcm();
-						
-						// calculate wallNormalDirection --> may move this to another time step
-						math::Matrix<3, 3> R = q_att.to_dcm();
-						math::Vector<3> accel_in_gs(_sensor_accel.x/9.81f, _sensor_accel.y/9.81f, _sensor_accel.z/9.81f);
-						math::Vector<3> inertialAcceleration = R*accel_in_gs + inertialFrameGravityDirection;
-						math::Vector<3> wallNormalDirectionWorld(inertialAcceleration(0),inertialAcceleration(1),0.0f);
-						wallNormal_vect = wallNormalDirectionWorld.normalized();
-						_characterization.wallNormal[0] = wallNormal_vect(0);
-						_characterization.wallNormal[1] = wallNormal_vect(1);
-						_characterization.wallNormal[2] = wallNormal_vect(2);
-					}	
-
-					for (int iInput = 0; iInput < 4; iInput ++){
-						if (fuzzyInputCalculated_array[iInput] == 0 ){ //make sure input has not been calculated yet
-							if(fuzzyInputCalcCycleDelay_array[iInput] <= cyclesAfterImpactDetected ){ //calculation delays required for some inputs
-								if (iInput == 0){  //accelerometer horizontal magnitude
-									math::Vector<2> accelHorizontalComponents(_sensor_accel.x,_sensor_accel.y);
-									_characterization.fuzzyInput[0] = accelHorizontalComponents.length()/9.81f;
-									fuzzy->setInput(1,_characterization.fuzzyInput[0]);
-									fuzzyInputCalculated_array[iInput] = 1;
-								}
-								else if (iInput == 1){  //inclination
-									math::Vector<3> wallTangentWorld = crossProduct(inertialFrameGravityDirection,wallNormal_vect);
-									math::Vector<3> rotatedNegBodyZ = R_preImpact*bodyFrameNegGravityDirection;
-									math::Vector<3> bodyZProjection = rotatedNegBodyZ-wallTangentWorld*(rotatedNegBodyZ*wallTangentWorld); //check dot product
-									float dotProductWithWorldZ = bodyZProjection*inertialFrameNegGravityDirection;
-									float inclinationAngle = acosf(dotProductWithWorldZ / bodyZProjection.length());
-
-									float dotProductWithWorldNormal = bodyZProjection*wallNormal_vect;
-									float angleWithWorldNormal = acosf(dotProductWithWorldNormal/(bodyZProjection.length()*wallNormal_vect.length()));
-									float inclinationSign = signf(angleWithWorldNormal - (float)M_PI/2);
-
-									_characterization.fuzzyInput[1] = inclinationSign*rad2deg(inclinationAngle);
-
-									fuzzy->setInput(2, _characterization.fuzzyInput[1] );
-									fuzzyInputCalculated_array[iInput] = 1;
-								}
-								else if (iInput == 2){  //flipping direction angle
-									math::Matrix<3, 3> R = q_att.to_dcm();
-									math::Vector<3> gyro(_sensor_gyro.x,_sensor_gyro.y,_sensor_gyro.z);
-									math::Vector<3> angVelWorld = R*gyro;
-									math::Vector<3> angVelWorldPerp = crossProduct(angVelWorld,inertialFrameNegGravityDirection);
-									math::Vector<2> angVelWorldPerpHoriz(angVelWorldPerp(0),angVelWorldPerp(1));
-									math::Vector<2> wallNormalWorldHoriz(wallNormal_vect(0),wallNormal_vect(1));
-									_characterization.fuzzyInput[2] = rad2deg(acosf((angVelWorldPerpHoriz*wallNormalWorldHoriz)/(angVelWorldPerpHoriz.length()*wallNormalWorldHoriz.length())));
-							
-									fuzzy->setInput(3, _characterization.fuzzyInput[2]);
-									fuzzyInputCalculated_array[iInput] = 1;
-								}
-								else if (iInput == 3){  //gyro horizontal magnitude
-									math::Vector<2> gyroHorizontalComponents(_sensor_gyro.x,_sensor_gyro.y);
-									_characterization.fuzzyInput[3] = gyroHorizontalComponents.length();
-									fuzzy->setInput(4,_characterization.fuzzyInput[3]);
-									fuzzyInputCalculated_array[iInput] = 1;
-								}
-							}
-						}
-
-					} // end fuzzyInput calculation for loop
-
-					int sum = 0;
-					for(auto& num : fuzzyInputCalculated_array)   sum += num;
-					if(sum == 4){ //check all four fuzzy inputs have been calculated
-					   
-						// calculate fuzzy output
-						fuzzy->fuzzify();
-						_characterization.fuzzyOutput = fuzzy->defuzzify(1);
-
-						//# TODO: confirm with Gareth accelRef calculation
-						math::Vector<3> accelReference_vect = wallNormal_vect*(-0.75f*9.81f*_characterization.fuzzyOutput);
-						// math::Vector<3> accelReference_vect = wallNormal_vect*(9.81f*_characterization.fuzzyOutput);
-						if (_characterization.fuzzyOutput < 0.0f){
-							// accelReference_vect = accelReference_vect/10.0f;
-							accelReference_vect.zero();
-						}
-						
-						_characterization.accelReference[0] = accelReference_vect(0);
-						_characterization.accelReference[1] = accelReference_vect(1);
-						_characterization.accelReference[2] = accelReference_vect(2);
-						_characterization.accelRefIsComputed = true;
-					}
-
-					cyclesAfterImpactDetected ++;
-					
-				} // end if(!accelRefCalculated)	
-
-			} //end if(_impact.impactIsDetected)
-
-			//reset condition
-			if (_characterization.accelRefIsComputed && _recovery_stage.recoveryIsReset){
-				cyclesAfterImpactDetected = 0; 
-				fuzzyInputCalculated_array[0] = 0;
-				fuzzyInputCalculated_array[1] = 0;
-				fuzzyInputCalculated_array[2] = 0;
-				fuzzyInputCalculated_array[3] = 0;
-
-				wallNormal_vect(0) = 0.0f;
-				wallNormal_vect(1) = 0.0f;
-				wallNormal_vect(2) = 0.0f;
-
-			    _characterization.fuzzyInput[0] = 0.0f;
-			    _characterization.fuzzyInput[1] = 0.0f;
-			    _characterization.fuzzyInput[2] = 0.0f;
-			    _characterization.fuzzyInput[3] = 0.0f;
-				_characterization.fuzzyOutput = 0.0f;		
-			    _characterization.wallNormal[0] = 0.0f;
-			    _characterization.wallNormal[1] = 0.0f;
-			    _characterization.wallNormal[2] = 0.0f;
-			    _characterization.accelReference[0] = 0.0f; 
-			    _characterization.accelReference[1] = 0.0f;
-			    _characterization.accelReference[2] = 0.0f;
-				_characterization.accelRefIsComputed = false;	
-			}
-			q_att_log.quatqueue(q_att); //record attitude history
+	if (!g_impact_characterization->init()) {
+		pthread_mutex_lock(&g_instance_mutex);
+		delete g_impact_characterization;
+		g_impact_characterization = nullptr;
+		pthread_mutex_unlock(&g_instance_mutex);
+		return 1;
+	}
 
-        	orb_publish(ORB_ID(impact_characterization), _characterization_pub, &_characterization);
-			 
-    	} //end polling
+	thread_running = true;
 
-    } //end while
+	g_impact_characterization->run();
 
 	PX4_INFO("impact_characterization exiting.\n");
 
 	thread_running = false;
 
+	pthread_mutex_lock(&g_instance_mutex);
+	delete g_impact_characterization;
+	g_impact_characterization = nullptr;
+	pthread_mutex_unlock(&g_instance_mutex);
+
     return OK;
 } //end main
-
-
-
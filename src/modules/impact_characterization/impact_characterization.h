@@ -11,7 +11,9 @@
 #include <unistd.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 #include <lib/mathlib/mathlib.h>
+#include <drivers/drv_hrt.h>
 #include <uORB/uORB.h>
 #include <uORB/topics/sensor_accel.h>
 #include <uORB/topics/sensor_gyro.h>
@@ -26,40 +28,40 @@
 
 #include <uORB/topics/debug.h>
 
-#include <nuttx/sched.h>
 #include <systemlib/systemlib.h>
 #include <systemlib/err.h>
+#include <systemlib/param/param.h>
 
-//fuzzy logic libraries
-#include <lib/eFLL/Fuzzy.h>
-#include <lib/eFLL/FuzzyComposition.h>
-#include <lib/eFLL/FuzzyInput.h>
-#include <lib/eFLL/FuzzyIO.h>
-#include <lib/eFLL/FuzzyOutput.h>
-#include <lib/eFLL/FuzzyRule.h>
-#include <lib/eFLL/FuzzyRuleAntecedent.h>
-#include <lib/eFLL/FuzzyRuleConsequent.h>
-#include <lib/eFLL/FuzzySet.h>
-
-#define QUATQUEUESIZE 5
-#define PREIMPACTCYCLES 2
+#include <lib/impact_recovery/Reactor.hpp>
+#include <lib/impact_recovery/ChangePublication.hpp>
+#include <lib/impact_recovery/ImpactCharacterizer.hpp>
 
 //class definitions
-class QuaternionQueue{
-	math::Quaternion queue[QUATQUEUESIZE];
-	int head, tail;
+class ImpactCharacterization{
 public:
-	QuaternionQueue();
-	void quatqueue(math::Quaternion quat);
-	math::Quaternion readquatqueue(int queueidx);
+	ImpactCharacterization();
+
+	bool init();
+	void run();
+	void print_status() { _reactor.print_status(); }
+
+private:
+	static void accel_callback(void *context) { static_cast<ImpactCharacterization *>(context)->on_accel(); }
+	void on_accel();
+
+	impact_recovery::Reactor _reactor;
+	impact_recovery::ChangePublication<impact_characterization_s> _characterization_pub;
+	impact_recovery::ImpactCharacterizer _characterizer;
+
+	// local copies, refreshed by the reactor
+	struct sensor_accel_s             	  _sensor_accel;
+	struct sensor_gyro_s              _sensor_gyro;
+	struct control_state_s			  _ctrl_state;
+	struct impact_detection_s 				 _detection;
+	struct impact_recovery_stage_s  	_recovery_stage;
 };
 
 //main
 int impact_characterization_thread_main(int argc, char *argv[]);
 
-//custom math functions
-math::Vector<3> crossProduct(const math::Vector<3> vect1, const math::Vector<3> vect2);
-float signf(const float number);
-float rad2deg(const float angle);
-
 #endif
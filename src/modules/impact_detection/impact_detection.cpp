@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 #include <lib/mathlib/mathlib.h>
 #include <uORB/uORB.h>
 #include <uORB/topics/sensor_accel.h>
@@ -32,9 +33,13 @@
 
 #include <uORB/topics/debug.h>
 
-#include <nuttx/sched.h>
 #include <systemlib/systemlib.h>
 #include <systemlib/err.h>
+#include <systemlib/param/param.h>
+
+#include <lib/impact_recovery/Reactor.hpp>
+#include <lib/impact_recovery/ChangePublication.hpp>
+#include <lib/impact_recovery/ImpactDetector.hpp>
 
 static bool thread_should_exit = false;		/**< daemon exit flag */
 static bool thread_running = false;			/**< daemon status flag */
@@ -44,6 +49,32 @@ extern "C" __EXPORT int impact_detection_main(int argc, char *argv[]);
 
 int impact_detection_thread_main(int argc, char *argv[]);
 
+class ImpactDetection
+{
+public:
+	ImpactDetection();
+
+	void run();
+	void print_status() { _reactor.print_status(); }
+
+private:
+	static void accel_callback(void *context) { static_cast<ImpactDetection *>(context)->on_accel(); }
+	void on_accel();
+
+	impact_recovery::Reactor _reactor;
+	impact_recovery::ChangePublication<impact_detection_s> _detection_pub;
+	impact_recovery::ImpactDetector _detector;
+
+	// local copies, refreshed by the reactor
+	struct sensor_accel_s             	  _sensor_accel;
+	struct control_state_s					_ctrl_state;
+	struct impact_recovery_stage_s  	_recovery_stage;
+	struct actuator_armed_s						 _armed;
+};
+
+static ImpactDetection *g_impact_detection = nullptr;
+static pthread_mutex_t g_instance_mutex = PTHREAD_MUTEX_INITIALIZER; /**< held by status while it uses the instance, and while the task deletes it */
+
 static void
 usage(const char *reason)
 {
@@ -87,6 +118,14 @@ int impact_detection_main(int argc, char *argv[]){
 		if (thread_running) {
 			PX4_INFO("\trunning\n");
 
+			pthread_mutex_lock(&g_instance_mutex);
+
+			if (g_impact_detection != nullptr) {
+				g_impact_detection->print_status();
+			}
+
+			pthread_mutex_unlock(&g_instance_mutex);
+
 		} else {
 			PX4_INFO("\tnot started\n");
 		}
@@ -98,116 +137,71 @@ int impact_detection_main(int argc, char *argv[]){
 	return 1;
 }
 
-
-int impact_detection_thread_main(int argc, char *argv[])
+ImpactDetection::ImpactDetection() :
+	_reactor("impact_detection"),
+	_detection_pub(ORB_ID(impact_detection), 0)
 {
+	// set them to zero initially
+	memset(&_sensor_accel, 0, sizeof(_sensor_accel));
+	memset(&_ctrl_state, 0, sizeof(_ctrl_state));
+	memset(&_recovery_stage, 0, sizeof(_recovery_stage));
+	memset(&_armed, 0, sizeof(_armed));
 
-	PX4_INFO("impact_detection starting\n");
+	int32_t heartbeat_ms = 0;
+	param_get(param_find("IMP_PUB_HB"), &heartbeat_ms);
+	_detection_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
 
-	thread_running = true;
+	// detection runs on every accel sample, the other topics only refresh state
+	_reactor.add_topic(ORB_ID(sensor_accel), &_sensor_accel, &ImpactDetection::accel_callback, this);
+	_reactor.add_topic(ORB_ID(control_state), &_ctrl_state);
+	_reactor.add_topic(ORB_ID(impact_recovery_stage), &_recovery_stage);
+	_reactor.add_topic(ORB_ID(actuator_armed), &_armed);
+}
 
-	// set up subscribers
-	int _sensor_accel_sub = orb_subscribe(ORB_ID(sensor_accel));
-	int _ctrl_state_sub = orb_subscribe(ORB_ID(control_state));
-	int _recovery_stage_sub = orb_subscribe(ORB_ID(impact_recovery_stage));
-	int _armed_sub = orb_subscribe(ORB_ID(actuator_armed));
+void ImpactDetection::run()
+{
+	// advertise the initial state so subscribers find the topic
+	_detection_pub.update(_detector.get(), hrt_absolute_time());
 
-	// declare local copies
-	struct sensor_accel_s             	  _sensor_accel;
-	struct control_state_s					_ctrl_state;
-	struct impact_detection_s 				 _detection;
-	struct impact_recovery_stage_s  	_recovery_stage;
-	struct actuator_armed_s						 _armed;				
+	while (!thread_should_exit) {
+		//TODO: check if armed
+		_reactor.spin_once(100);
+	}
+}
 
-	// set them to zero initially
-	memset(&_sensor_accel, 0, sizeof(_sensor_accel));	
-	memset(&_ctrl_state, 0, sizeof(_ctrl_state));
-	memset(&_detection, 0, sizeof(_detection));
-	memset(&_recovery_stage, 0, sizeof(_recovery_stage));
-	memset(&_armed, 0, sizeof(_armed));
+void ImpactDetection::on_accel()
+{
+	const impact_detection_s &detection = _detector.update(_sensor_accel, _ctrl_state, _recovery_stage, _armed);
 
-	// declare update flags
-	bool updated_sensor_accel;
-	bool updated_ctrl_state;
-	bool updated_recovery_stage;
-	bool updated_armed;
-	bool accel_is_done_spike = true;
+	if (_detection_pub.update(detection, hrt_absolute_time())) {
+		_reactor.record_latency(_sensor_accel.timestamp);
+	}
+}
 
-	orb_advert_t _detection_pub = orb_advertise(ORB_ID(impact_detection), &_detection);
+int impact_detection_thread_main(int argc, char *argv[])
+{
 
-	struct pollfd fds[1];
+	PX4_INFO("impact_detection starting\n");
 
-	fds[0].fd = _sensor_accel_sub;
-	fds[0].events = POLLIN;
-                
-    while(!thread_should_exit){  
-    	//TODO: check if armed
+	g_impact_detection = new ImpactDetection();
 
-		int ret = px4_poll(&fds[0], (sizeof(fds) / sizeof(fds[0])), 100);
-		if (ret == 0) {
-			continue;
-		}
+	if (g_impact_detection == nullptr) {
+		PX4_ERR("alloc failed");
+		return 1;
+	}
 
-		if (fds[0].revents & POLLIN){		
-		   	// poll for subscription updates
-			orb_check(_sensor_accel_sub, &updated_sensor_accel);
-			orb_check(_ctrl_state_sub, &updated_ctrl_state);
-			orb_check(_recovery_stage_sub, &updated_recovery_stage);
-			orb_check(_armed_sub, &updated_armed);
-			
-			// make local copies of uORB topics
-			if(updated_sensor_accel){
-				orb_copy(ORB_ID(sensor_accel), _sensor_accel_sub, &_sensor_accel);
-			}
-			if(updated_ctrl_state){
-				orb_copy(ORB_ID(control_state), _ctrl_state_sub, &_ctrl_state);
-			}
-			if(updated_recovery_stage){
-				orb_copy(ORB_ID(impact_recovery_stage), _recovery_stage_sub, &_recovery_stage);
-			}
-			if (updated_armed) {
-				orb_copy(ORB_ID(actuator_armed), _armed_sub, &_armed);
-			}
+	thread_running = true;
 
-			math::Vector<3> accel(_sensor_accel.x, _sensor_accel.y, _sensor_accel.z);
-			math::Quaternion q_att(_ctrl_state.q[0], _ctrl_state.q[1], _ctrl_state.q[2], _ctrl_state.q[3]);
-			//get rotation matrix
-			math::Matrix<3, 3> R = q_att.to_dcm();
-			//rotate accelerometer readings into world frame
-			math::Vector<3> accelWorldFrame = R * accel;
-			math::Vector<2> accelHorizontalComponents(accelWorldFrame(0), accelWorldFrame(1));
-
-			if(_armed.armed){
-				if (!accel_is_done_spike){
-					if (accelHorizontalComponents.length() <= 9.81f){
-						accel_is_done_spike = true;
-					}
-				}
-				if(!_detection.inRecovery && accel_is_done_spike){
-					if (accelHorizontalComponents.length() > 9.81f){
-						 _detection.inRecovery = true;
-						 accel_is_done_spike = false;
-
-					}
-		        }
-		        else if(_detection.inRecovery){ // could just do 'else'
-		        	if(_recovery_stage.recoveryIsReset){
-		        		_detection.inRecovery = false;
-		        	}
-				}
-			}	
-
-        	orb_publish(ORB_ID(impact_detection), _detection_pub, &_detection);
-			 
-    	} //end polling
-
-    } //end while
+	g_impact_detection->run();
 
 	PX4_INFO("impact_detection exiting.\n");
 
 	thread_running = false;
 
+	pthread_mutex_lock(&g_instance_mutex);
+	delete g_impact_detection;
+	g_impact_detection = nullptr;
+	pthread_mutex_unlock(&g_instance_mutex);
+
     return OK;
 } //end main
-
-
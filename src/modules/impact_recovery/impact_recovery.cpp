@@ -0,0 +1,452 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file impact_recovery.cpp
+ *
+ * Fused impact recovery pipeline: runs impact detection, impact
+ * characterization and the recovery stage machine back-to-back in one task
+ * on every accel sample, so a new recoveryStage is available to
+ * mc_att_control without any intermediate topic hop or context switch.
+ * The three topics are still published for logging and for mc_att_control.
+ *
+ * Use either this module or the impact_detection, impact_characterization
+ * and recovery_stage modules, not both (see IMP_FUSED).
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include <px4_config.h>
+#include <px4_tasks.h>
+#include <px4_posix.h>
+#include <px4_defines.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/err.h>
+#include <systemlib/param/param.h>
+#include <systemlib/perf_counter.h>
+#include <uORB/uORB.h>
+#include <uORB/topics/sensor_accel.h>
+#include <uORB/topics/sensor_gyro.h>
+#include <uORB/topics/actuator_armed.h>
+#include <uORB/topics/control_state.h>
+#include <uORB/topics/impact_detection.h>
+#include <uORB/topics/impact_characterization.h>
+#include <uORB/topics/impact_recovery_stage.h>
+#include <uORB/topics/recovery_control.h>
+
+#include <lib/impact_recovery/Reactor.hpp>
+#include <lib/impact_recovery/ChangePublication.hpp>
+#include <lib/impact_recovery/ImpactDetector.hpp>
+#include <lib/impact_recovery/ImpactCharacterizer.hpp>
+#include <lib/impact_recovery/RecoveryStageMachine.hpp>
+
+static bool thread_should_exit = false;		/**< daemon exit flag */
+static bool thread_running = false;			/**< daemon status flag */
+static int daemon_task;						/**< Handle of daemon task / thread */
+
+extern "C" __EXPORT int impact_recovery_main(int argc, char *argv[]);
+
+int impact_recovery_thread_main(int argc, char *argv[]);
+
+class ImpactRecoveryPipeline
+{
+public:
+	ImpactRecoveryPipeline();
+
+	bool init();
+	void run();
+	void print_status() { _reactor.print_status(); }
+
+private:
+	static void accel_callback(void *context) { static_cast<ImpactRecoveryPipeline *>(context)->on_accel(); }
+	void on_accel();
+
+	impact_recovery::Reactor _reactor;
+
+	impact_recovery::ChangePublication<impact_detection_s> _detection_pub;
+	impact_recovery::ChangePublication<impact_characterization_s> _characterization_pub;
+	impact_recovery::ChangePublication<impact_recovery_stage_s> _recovery_stage_pub;
+
+	impact_recovery::ImpactDetector _detector;
+	impact_recovery::ImpactCharacterizer _characterizer;
+	impact_recovery::RecoveryStageMachine _stage_machine;
+
+	// local copies, refreshed by the reactor
+	struct sensor_accel_s _sensor_accel;
+	struct sensor_gyro_s _sensor_gyro;
+	struct control_state_s _ctrl_state;
+	struct actuator_armed_s _armed;
+	struct recovery_control_s _recovery_control;
+};
+
+static ImpactRecoveryPipeline *g_impact_recovery = nullptr;
+static pthread_mutex_t g_instance_mutex = PTHREAD_MUTEX_INITIALIZER; /**< held by status while it uses the instance, and while the task deletes it */
+
+static void
+usage(const char *reason)
+{
+	if (reason) {
+		warnx("%s\n", reason);
+	}
+
+	warnx("usage: impact_recovery {start|stop|status|bench [impacts]}\n\n"
+	      "bench publishes synthetic accel, attitude and armed topics and measures the\n"
+	      "latency of the running pipeline (fused or split), stop sensors and commander first");
+}
+
+ImpactRecoveryPipeline::ImpactRecoveryPipeline() :
+	_reactor("impact_recovery"),
+	_detection_pub(ORB_ID(impact_detection), 0),
+	_characterization_pub(ORB_ID(impact_characterization), 0),
+	_recovery_stage_pub(ORB_ID(impact_recovery_stage), 0)
+{
+	memset(&_sensor_accel, 0, sizeof(_sensor_accel));
+	memset(&_sensor_gyro, 0, sizeof(_sensor_gyro));
+	memset(&_ctrl_state, 0, sizeof(_ctrl_state));
+	memset(&_armed, 0, sizeof(_armed));
+	memset(&_recovery_control, 0, sizeof(_recovery_control));
+
+	int32_t heartbeat_ms = 0;
+	param_get(param_find("IMP_PUB_HB"), &heartbeat_ms);
+	_detection_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
+	_characterization_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
+	_recovery_stage_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
+}
+
+bool ImpactRecoveryPipeline::init()
+{
+	if (!_characterizer.init()) {
+		return false;
+	}
+
+	// the whole pipeline steps once per accel sample, the other topics only refresh state
+	_reactor.add_topic(ORB_ID(sensor_accel), &_sensor_accel, &ImpactRecoveryPipeline::accel_callback, this);
+	_reactor.add_topic(ORB_ID(sensor_gyro), &_sensor_gyro);
+	_reactor.add_topic(ORB_ID(control_state), &_ctrl_state);
+	_reactor.add_topic(ORB_ID(actuator_armed), &_armed);
+	_reactor.add_topic(ORB_ID(recovery_control), &_recovery_control);
+
+	// advertise the initial state so subscribers find the topics
+	hrt_abstime now = hrt_absolute_time();
+	_detection_pub.update(_detector.get(), now);
+	_characterization_pub.update(_characterizer.get(), now);
+	_recovery_stage_pub.update(_stage_machine.get(), now);
+
+	return true;
+}
+
+void ImpactRecoveryPipeline::run()
+{
+	while (!thread_should_exit) {
+		_reactor.spin_once(100);
+	}
+}
+
+void ImpactRecoveryPipeline::on_accel()
+{
+	// detection and characterization see the recovery stage of the previous sample,
+	// exactly as they would through uORB in the split modules
+	const impact_recovery_stage_s &previous_stage = _stage_machine.get();
+
+	const impact_detection_s &detection = _detector.update(_sensor_accel, _ctrl_state, previous_stage, _armed);
+	const impact_characterization_s &characterization = _characterizer.update(_sensor_accel, _sensor_gyro, _ctrl_state,
+			detection, previous_stage);
+	const impact_recovery_stage_s &recovery_stage = _stage_machine.update(_ctrl_state, detection, characterization,
+			_recovery_control);
+
+	const hrt_abstime now = hrt_absolute_time();
+
+	// the stage goes out first, it is the one mc_att_control is waiting for
+	if (_recovery_stage_pub.update(recovery_stage, now)) {
+		_reactor.record_latency(_sensor_accel.timestamp);
+	}
+
+	_characterization_pub.update(characterization, now);
+	_detection_pub.update(detection, now);
+}
+
+/**
+ * Drive whichever pipeline is running (this module, or the three split
+ * modules) with synthetic impacts and measure, for the accel sample that
+ * triggers each transition, the time until the transition is visible on uORB.
+ */
+static int bench(int impacts)
+{
+	struct actuator_armed_s armed;
+	struct control_state_s ctrl_state;
+	struct recovery_control_s recovery_control;
+	struct sensor_gyro_s gyro;
+	struct sensor_accel_s accel;
+	memset(&armed, 0, sizeof(armed));
+	memset(&ctrl_state, 0, sizeof(ctrl_state));
+	memset(&recovery_control, 0, sizeof(recovery_control));
+	memset(&gyro, 0, sizeof(gyro));
+	memset(&accel, 0, sizeof(accel));
+
+	// level attitude, no attitude error and no body rates: every impact runs stage 1 -> 2 -> 0
+	armed.armed = true;
+	ctrl_state.q[0] = 1.0f;
+	recovery_control.quatError[0] = 1.0f;
+	gyro.x = 2.0f;
+	accel.z = -9.81f;
+
+	hrt_abstime now = hrt_absolute_time();
+	armed.timestamp = ctrl_state.timestamp = recovery_control.timestamp = gyro.timestamp = now;
+
+	orb_advert_t armed_pub = orb_advertise(ORB_ID(actuator_armed), &armed);
+	orb_advert_t ctrl_state_pub = orb_advertise(ORB_ID(control_state), &ctrl_state);
+	orb_advert_t recovery_control_pub = orb_advertise(ORB_ID(recovery_control), &recovery_control);
+	orb_advert_t gyro_pub = orb_advertise(ORB_ID(sensor_gyro), &gyro);
+	orb_advert_t accel_pub = nullptr;
+
+	struct impact_detection_s detection;
+	struct impact_characterization_s characterization;
+	struct impact_recovery_stage_s recovery_stage;
+	memset(&detection, 0, sizeof(detection));
+	memset(&characterization, 0, sizeof(characterization));
+	memset(&recovery_stage, 0, sizeof(recovery_stage));
+
+	px4_pollfd_struct_t fds[3];
+	fds[0].fd = orb_subscribe(ORB_ID(impact_detection));
+	fds[1].fd = orb_subscribe(ORB_ID(impact_characterization));
+	fds[2].fd = orb_subscribe(ORB_ID(impact_recovery_stage));
+
+	for (unsigned i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+		fds[i].events = POLLIN;
+	}
+
+	perf_counter_t detection_latency = perf_alloc(PC_ELAPSED, "impact bench: sample to detection");
+	perf_counter_t characterization_latency = perf_alloc(PC_ELAPSED, "impact bench: sample to accelRef");
+	perf_counter_t stage_latency = perf_alloc(PC_ELAPSED, "impact bench: sample to stage 1");
+	perf_counter_t impact_to_stage = perf_alloc(PC_ELAPSED, "impact bench: spike to stage 1");
+
+	// quiet samples before the spike fill the pre-impact attitude history
+	const int quiet_samples = 10;
+	const int max_samples = 200;
+	int completed = 0;
+
+	for (int impact = 0; impact < impacts; impact++) {
+		bool detected = false;
+		bool characterized = false;
+		bool staged = false;
+		bool done = false;
+		hrt_abstime spike_time = 0;
+
+		for (int sample = 0; sample < max_samples && !done; sample++) {
+			accel.x = (sample == quiet_samples) ? 2.0f * 9.81f : 0.0f;
+			accel.timestamp = hrt_absolute_time();
+
+			if (sample == quiet_samples) {
+				spike_time = accel.timestamp;
+			}
+
+			if (accel_pub == nullptr) {
+				accel_pub = orb_advertise(ORB_ID(sensor_accel), &accel);
+
+			} else {
+				orb_publish(ORB_ID(sensor_accel), accel_pub, &accel);
+			}
+
+			// collect everything the pipeline publishes in response to this sample
+			while (px4_poll(fds, sizeof(fds) / sizeof(fds[0]), 5) > 0) {
+				now = hrt_absolute_time();
+
+				if (fds[0].revents & POLLIN) {
+					orb_copy(ORB_ID(impact_detection), fds[0].fd, &detection);
+				}
+
+				if (fds[1].revents & POLLIN) {
+					orb_copy(ORB_ID(impact_characterization), fds[1].fd, &characterization);
+				}
+
+				if (fds[2].revents & POLLIN) {
+					orb_copy(ORB_ID(impact_recovery_stage), fds[2].fd, &recovery_stage);
+				}
+
+				if (spike_time == 0) {
+					continue;
+				}
+
+				if (!detected && detection.inRecovery) {
+					detected = true;
+					perf_set_elapsed(detection_latency, now - accel.timestamp);
+				}
+
+				if (!characterized && characterization.accelRefIsComputed) {
+					characterized = true;
+					perf_set_elapsed(characterization_latency, now - accel.timestamp);
+				}
+
+				if (!staged && recovery_stage.recoveryStage == 1) {
+					staged = true;
+					perf_set_elapsed(stage_latency, now - accel.timestamp);
+					perf_set_elapsed(impact_to_stage, now - spike_time);
+				}
+			}
+
+			// the pipeline is idle again once the reset handshake has completed
+			done = staged && recovery_stage.recoveryStage == 0 && !recovery_stage.recoveryIsReset
+			       && !detection.inRecovery && !characterization.accelRefIsComputed;
+		}
+
+		if (!done) {
+			PX4_WARN("impact %d did not complete, is the pipeline running?", impact);
+			break;
+		}
+
+		completed++;
+	}
+
+	PX4_INFO("%d of %d impacts completed", completed, impacts);
+	perf_print_counter(detection_latency);
+	perf_print_counter(characterization_latency);
+	perf_print_counter(stage_latency);
+	perf_print_counter(impact_to_stage);
+
+	perf_free(detection_latency);
+	perf_free(characterization_latency);
+	perf_free(stage_latency);
+	perf_free(impact_to_stage);
+
+	for (unsigned i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+		orb_unsubscribe(fds[i].fd);
+	}
+
+	// leave the vehicle disarmed
+	armed.armed = false;
+	armed.timestamp = hrt_absolute_time();
+	orb_publish(ORB_ID(actuator_armed), armed_pub, &armed);
+
+	orb_unadvertise(accel_pub);
+	orb_unadvertise(gyro_pub);
+	orb_unadvertise(recovery_control_pub);
+	orb_unadvertise(ctrl_state_pub);
+	orb_unadvertise(armed_pub);
+
+	return (completed == impacts) ? 0 : 1;
+}
+
+int impact_recovery_main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		usage("missing command");
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "start")) {
+
+		if (thread_running) {
+			PX4_INFO("impact_recovery already running\n");
+			/* this is not an error */
+			return 0;
+		}
+
+		thread_should_exit = false;
+		daemon_task = px4_task_spawn_cmd("impact_recovery",
+						 SCHED_DEFAULT,
+						 SCHED_PRIORITY_DEFAULT,
+						 2000,
+						 impact_recovery_thread_main,
+						 (argv) ? (char *const *)&argv[2] : (char *const *)NULL);
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		thread_should_exit = true;
+		return 0;
+	}
+
+	if (!strcmp(argv[1], "bench")) {
+		return bench((argc > 2) ? atoi(argv[2]) : 20);
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		if (thread_running) {
+			PX4_INFO("\trunning\n");
+
+			pthread_mutex_lock(&g_instance_mutex);
+
+			if (g_impact_recovery != nullptr) {
+				g_impact_recovery->print_status();
+			}
+
+			pthread_mutex_unlock(&g_instance_mutex);
+
+		} else {
+			PX4_INFO("\tnot started\n");
+		}
+
+		return 0;
+	}
+
+	usage("unrecognized command");
+	return 1;
+}
+
+int impact_recovery_thread_main(int argc, char *argv[])
+{
+	PX4_INFO("impact_recovery starting\n");
+
+	g_impact_recovery = new ImpactRecoveryPipeline();
+
+	if (g_impact_recovery == nullptr) {
+		PX4_ERR("alloc failed");
+		return 1;
+	}
+
+	if (!g_impact_recovery->init()) {
+		pthread_mutex_lock(&g_instance_mutex);
+		delete g_impact_recovery;
+		g_impact_recovery = nullptr;
+		pthread_mutex_unlock(&g_instance_mutex);
+		return 1;
+	}
+
+	thread_running = true;
+
+	g_impact_recovery->run();
+
+	PX4_INFO("impact_recovery exiting.\n");
+
+	thread_running = false;
+
+	pthread_mutex_lock(&g_instance_mutex);
+	delete g_impact_recovery;
+	g_impact_recovery = nullptr;
+	pthread_mutex_unlock(&g_instance_mutex);
+
+	return OK;
+}
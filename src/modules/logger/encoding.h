@@ -0,0 +1,314 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file encoding.h
+ * Payload encoding of ENCODED_DATA messages, shared by the logger and the log readers.
+ *
+ * The LZ format follows LZ4 blocks: a sequence is a token (literal length in the high
+ * nibble, match length - 4 in the low nibble, 15 meaning that length bytes follow, each
+ * 255 continuing), the literals, a 16 bit little endian offset and the match length
+ * bytes. The last sequence ends after its literals.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace px4
+{
+namespace logger
+{
+
+/**
+ * XOR a sample against the previous one of the same message (encodes and decodes)
+ */
+static inline void ulog_delta(const uint8_t *src, const uint8_t *previous, uint8_t *dst, int len)
+{
+	for (int i = 0; i < len; i++) {
+		dst[i] = src[i] ^ previous[i];
+	}
+}
+
+/**
+ * Delta reference of one logged instance: the last logged sample and the number of delta
+ * samples until the next keyframe. The sample buffer is allocated with the first sample,
+ * which is always a keyframe, so it does not matter where the instance was subscribed.
+ * Plain data: init() before use and release() when done.
+ */
+struct ULogDeltaReference {
+	uint8_t *previous;
+	uint16_t generation;	///< writer generation when previous was logged
+	uint8_t countdown;	///< delta samples until the next keyframe
+
+	void init()
+	{
+		previous = nullptr;
+		generation = 0;
+		countdown = 0;
+	}
+
+	void release()
+	{
+		delete[] previous;
+		previous = nullptr;
+	}
+
+	/**
+	 * Take the next sample of the instance.
+	 * @param delta set to the XOR delta against the previous sample, if it is delta encoded
+	 * @param current_generation changes whenever logged data was lost: forces a keyframe
+	 * @param keyframe_interval delta samples between two keyframes
+	 * @return 1 if delta holds the sample to log, 0 for a keyframe, -1 if the reference
+	 *         could not be allocated (the sample can only be compressed)
+	 */
+	int encode(const uint8_t *sample, uint8_t *delta, int len, uint16_t current_generation, uint8_t keyframe_interval)
+	{
+		if (!previous) {
+			previous = new uint8_t[len];
+
+			if (!previous) {
+				return -1;
+			}
+
+			countdown = 0;
+		}
+
+		int ret = 0;
+
+		/* delta against the previous sample, unless it may not have made it to the file */
+		if (generation == current_generation && countdown > 0) {
+			ulog_delta(sample, previous, delta, len);
+			--countdown;
+			ret = 1;
+
+		} else {
+			countdown = keyframe_interval;
+		}
+
+		memcpy(previous, sample, len);
+		generation = current_generation;
+		return ret;
+	}
+};
+
+/**
+ * Decompress an LZ block.
+ * @return number of bytes written to dst, -1 if the block is corrupt or does not fit
+ */
+static inline int ulog_lz_decompress(const uint8_t *src, int src_len, uint8_t *dst, int dst_capacity)
+{
+	int in = 0;
+	int out = 0;
+
+	while (in < src_len) {
+		const uint8_t token = src[in++];
+		int literals = token >> 4;
+
+		if (literals == 15) {
+			uint8_t b;
+
+			do {
+				if (in >= src_len) {
+					return -1;
+				}
+
+				b = src[in++];
+				literals += b;
+			} while (b == 255);
+		}
+
+		if (in + literals > src_len || out + literals > dst_capacity) {
+			return -1;
+		}
+
+		memcpy(dst + out, src + in, literals);
+		in += literals;
+		out += literals;
+
+		if (in == src_len) {
+			break; // last sequence
+		}
+
+		if (in + 2 > src_len) {
+			return -1;
+		}
+
+		const int offset = src[in] | (src[in + 1] << 8);
+		in += 2;
+		int match = (token & 0xf) + 4;
+
+		if ((token & 0xf) == 15) {
+			uint8_t b;
+
+			do {
+				if (in >= src_len) {
+					return -1;
+				}
+
+				b = src[in++];
+				match += b;
+			} while (b == 255);
+		}
+
+		if (offset == 0 || offset > out || out + match > dst_capacity) {
+			return -1;
+		}
+
+		// byte by byte: the match can overlap the output (e.g. runs with offset 1)
+		for (int i = 0; i < match; i++, out++) {
+			dst[out] = dst[out - offset];
+		}
+	}
+
+	return out;
+}
+
+/**
+ * LZ block compressor. Keeps its hash table, so that it does not need to go on the stack.
+ */
+class ULogCompressor
+{
+public:
+	/**
+	 * Compress src into dst.
+	 * @return compressed size, -1 if it does not fit into dst_capacity bytes
+	 */
+	int compress(const uint8_t *src, int src_len, uint8_t *dst, int dst_capacity)
+	{
+		memset(_hash, 0, sizeof(_hash));
+		int anchor = 0;
+		int pos = 0;
+		int out = 0;
+
+		while (pos + MIN_MATCH <= src_len) {
+			uint32_t sequence;
+			memcpy(&sequence, src + pos, sizeof(sequence));
+			const uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			const int candidate = (int)_hash[h] - 1;
+			_hash[h] = pos + 1;
+
+			if (candidate < 0 || pos - candidate > 0xffff || memcmp(src + candidate, src + pos, MIN_MATCH) != 0) {
+				++pos;
+				continue;
+			}
+
+			int match = MIN_MATCH;
+
+			while (pos + match < src_len && src[candidate + match] == src[pos + match]) {
+				++match;
+			}
+
+			out = emit(src + anchor, pos - anchor, pos - candidate, match, dst, out, dst_capacity);
+
+			if (out < 0) {
+				return -1;
+			}
+
+			pos += match;
+			anchor = pos;
+		}
+
+		return emit(src + anchor, src_len - anchor, 0, 0, dst, out, dst_capacity);
+	}
+
+private:
+	static constexpr int MIN_MATCH = 4;
+	static constexpr int HASH_BITS = 8;
+
+	static int emit_length(int len, uint8_t *dst, int out, int dst_capacity)
+	{
+		for (len -= 15; len >= 255; len -= 255) {
+			if (out >= dst_capacity) {
+				return -1;
+			}
+
+			dst[out++] = 255;
+		}
+
+		if (out >= dst_capacity) {
+			return -1;
+		}
+
+		dst[out++] = (uint8_t)len;
+		return out;
+	}
+
+	/**
+	 * append a sequence. match == 0 marks the last one (literals only)
+	 */
+	static int emit(const uint8_t *literals, int num_literals, int offset, int match, uint8_t *dst, int out,
+			int dst_capacity)
+	{
+		if (out >= dst_capacity) {
+			return -1;
+		}
+
+		const int match_code = match > 0 ? match - MIN_MATCH : 0;
+		dst[out++] = (uint8_t)(((num_literals < 15 ? num_literals : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+		if (num_literals >= 15 && (out = emit_length(num_literals, dst, out, dst_capacity)) < 0) {
+			return -1;
+		}
+
+		if (out + num_literals > dst_capacity) {
+			return -1;
+		}
+
+		memcpy(dst + out, literals, num_literals);
+		out += num_literals;
+
+		if (match == 0) {
+			return out;
+		}
+
+		if (out + 2 > dst_capacity) {
+			return -1;
+		}
+
+		dst[out++] = (uint8_t)offset;
+		dst[out++] = (uint8_t)(offset >> 8);
+
+		if (match_code >= 15 && (out = emit_length(match_code, dst, out, dst_capacity)) < 0) {
+			return -1;
+		}
+
+		return out;
+	}
+
+	uint16_t _hash[1 << HASH_BITS];
+};
+
+} //namespace logger
+} //namespace px4
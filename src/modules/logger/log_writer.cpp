@@ -35,6 +35,7 @@
 #include "messages.h"
 #include <fcntl.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <mathlib/mathlib.h>
 
@@ -43,18 +44,23 @@ namespace px4
 namespace logger
 {
 constexpr size_t LogWriter::_min_write_chunk;
+constexpr size_t LogWriter::_max_write_block;
+constexpr size_t LogWriter::_fsync_interval;
 
 
 LogWriter::LogWriter(size_t buffer_size) :
 	//We always write larger chunks (orb messages) to the buffer, so the buffer
-	//needs to be larger than the minimum write chunk (300 is somewhat arbitrary)
-	_buffer_size(math::max(buffer_size, _min_write_chunk + 300))
+	//needs to be larger than the minimum write chunk. It is rounded up to whole chunks,
+	//so that the file offset and the buffer position stay chunk aligned across the wrap.
+	_buffer_size((math::max(buffer_size, 2 * _min_write_chunk) + _min_write_chunk - 1) / _min_write_chunk * _min_write_chunk)
 {
+	pthread_mutex_init(&_producer_mtx, nullptr);
 	pthread_mutex_init(&_mtx, nullptr);
 	pthread_cond_init(&_cv, nullptr);
 	/* allocate write performance counters */
 	_perf_write = perf_alloc(PC_ELAPSED, "sd write");
 	_perf_fsync = perf_alloc(PC_ELAPSED, "sd fsync");
+	_perf_header = perf_alloc(PC_ELAPSED, "sd header write");
 }
 
 bool LogWriter::init()
@@ -70,17 +76,19 @@ bool LogWriter::init()
 
 LogWriter::~LogWriter()
 {
+	pthread_mutex_destroy(&_producer_mtx);
 	pthread_mutex_destroy(&_mtx);
 	pthread_cond_destroy(&_cv);
 	perf_free(_perf_write);
 	perf_free(_perf_fsync);
+	perf_free(_perf_header);
 
 	if (_buffer) {
 		delete[] _buffer;
 	}
 }
 
-void LogWriter::start_log(const char *filename)
+void LogWriter::start_log(const char *filename, const uint8_t *header, size_t header_size)
 {
 	::strncpy(_filename, filename, sizeof(_filename));
 	_fd = ::open(_filename, O_CREAT | O_WRONLY, PX4_O_MODE_666);
@@ -92,13 +100,19 @@ void LogWriter::start_log(const char *filename)
 
 	} else {
 		PX4_INFO("Opened log file: %s", _filename);
+#ifdef __PX4_LINUX
+		/* the file is only appended to and never read back */
+		posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 		_should_run = true;
 		_running = true;
 	}
 
-	// Clear buffer and counters
-	_head = 0;
-	_count = 0;
+	// Clear buffer and counters. The writer thread is idle until notify()
+	_header = header;
+	_header_size = header ? header_size : 0;
+	_write_pos = 0;
+	__atomic_store_n(&_read_pos, 0, __ATOMIC_RELEASE);
 	_total_written = 0;
 	notify();
 }
@@ -150,7 +164,11 @@ void LogWriter::run()
 		while (!_exit_thread) {
 			bool start = false;
 			pthread_mutex_lock(&_mtx);
-			pthread_cond_wait(&_cv, &_mtx);
+
+			if (!_should_run) {
+				pthread_cond_wait(&_cv, &_mtx);
+			}
+
 			start = _should_run;
 			pthread_mutex_unlock(&_mtx);
 
@@ -159,24 +177,40 @@ void LogWriter::run()
 			}
 		}
 
-		int poll_count = 0;
+		size_t unsynced = 0;
 		int written = 0;
 
+		if (_header_size > 0) {
+			perf_begin(_perf_header);
+			written = ::write(_fd, _header, _header_size);
+			perf_end(_perf_header);
+
+			if (written != (int)_header_size) {
+				PX4_WARN("error writing log header");
+				_should_run = false;
+
+			} else {
+				_total_written += written;
+				unsynced += written;
+			}
+		}
+
 		while (true) {
 			size_t available = 0;
 			void *read_ptr = nullptr;
-			bool is_part = false;
+			bool flush = false;
 
-			/* lock _buffer
-			 * wait for sufficient data, cycle on notify()
+			/* wait for at least one whole chunk, cycle on notify().
+			 * Producers only take _mtx in notify(), to signal _cv.
 			 */
 			pthread_mutex_lock(&_mtx);
 
 			while (true) {
-				available = get_read_ptr(&read_ptr, &is_part);
+				flush = !_should_run;
+				available = get_read_block(&read_ptr, flush);
 
-				/* if sufficient data available or partial read or terminating, exit this wait loop */
-				if ((available >= _min_write_chunk) || is_part || !_should_run) {
+				/* if sufficient data available or terminating, exit this wait loop */
+				if (available > 0 || flush) {
 					/* GOTO end of block */
 					break;
 				}
@@ -191,38 +225,45 @@ void LogWriter::run()
 			written = 0;
 
 			if (available > 0) {
+				set_io_state(IOState::Write);
 				perf_begin(_perf_write);
+				const hrt_abstime write_start = hrt_absolute_time();
 				written = ::write(_fd, read_ptr, available);
+				++_write_latency[write_latency_bucket(hrt_elapsed_time(&write_start))];
 				perf_end(_perf_write);
 
-				/* call fsync periodically to minimize potential loss of data */
-				if (++poll_count >= 100) {
-					perf_begin(_perf_fsync);
-					::fsync(_fd);
-					perf_end(_perf_fsync);
-					poll_count = 0;
-				}
-
 				if (written < 0) {
+					set_io_state(IOState::Idle);
 					PX4_WARN("error writing log file");
 					_should_run = false;
 					/* GOTO end of block */
 					break;
 				}
 
-				pthread_mutex_lock(&_mtx);
-				/* subtract bytes written from number in _buffer (_count -= written) */
+				/* hand the space back to the producer before syncing */
 				mark_read(written);
-				pthread_mutex_unlock(&_mtx);
-
 				_total_written += written;
+				unsynced += written;
+
+				/* call fsync periodically to minimize potential loss of data */
+				if (unsynced >= _fsync_interval) {
+					set_io_state(IOState::Fsync);
+					perf_begin(_perf_fsync);
+					::fsync(_fd);
+					perf_end(_perf_fsync);
+#ifdef __PX4_LINUX
+					/* the synced pages are not needed anymore, keep the page cache from growing */
+					posix_fadvise(_fd, 0, _total_written, POSIX_FADV_DONTNEED);
+#endif
+					unsynced = 0;
+				}
+
+				set_io_state(IOState::Idle);
 			}
 
-			if (!_should_run && written == static_cast<int>(available) && !is_part) {
+			if (flush && get_buffer_fill_count() == 0) {
 				// Stop only when all data written
 				_running = false;
-				_head = 0;
-				_count = 0;
 
 				if (_fd >= 0) {
 					int res = ::close(_fd);
@@ -245,8 +286,8 @@ void LogWriter::run()
 bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
 {
 
-	// Bytes available to write
-	size_t available = _buffer_size - _count;
+	// Bytes available to write. _read_pos only grows, so this is a lower bound
+	size_t available = _buffer_size - (_write_pos - __atomic_load_n(&_read_pos, __ATOMIC_ACQUIRE));
 	size_t dropout_size = 0;
 
 	if (dropout_start) {
@@ -254,7 +295,11 @@ bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
 	}
 
 	if (size + dropout_size > available) {
-		// buffer overflow
+		// buffer overflow. Attribute the start of a dropout to what the writer thread is doing
+		if (!dropout_start) {
+			++_dropout_causes[__atomic_load_n(&_io_state, __ATOMIC_RELAXED)];
+		}
+
 		return false;
 	}
 
@@ -271,14 +316,15 @@ bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
 
 void LogWriter::write_no_check(void *ptr, size_t size)
 {
-	size_t n = _buffer_size - _head;	// bytes to end of the buffer
+	size_t head = _write_pos % _buffer_size;
+	size_t n = _buffer_size - head;	// bytes to end of the buffer
 
 	uint8_t *buffer_c = reinterpret_cast<uint8_t *>(ptr);
 
 	if (size > n) {
 		// Message goes over the end of the buffer
-		memcpy(&(_buffer[_head]), buffer_c, n);
-		_head = 0;
+		memcpy(&(_buffer[head]), buffer_c, n);
+		head = 0;
 
 	} else {
 		n = 0;
@@ -286,27 +332,61 @@ void LogWriter::write_no_check(void *ptr, size_t size)
 
 	// now: n = bytes already written
 	size_t p = size - n;	// number of bytes to write
-	memcpy(&(_buffer[_head]), &(buffer_c[n]), p);
-	_head = (_head + p) % _buffer_size;
-	_count += size;
+	memcpy(&(_buffer[head]), &(buffer_c[n]), p);
+
+	// publish the data to the writer thread
+	__atomic_store_n(&_write_pos, _write_pos + size, __ATOMIC_RELEASE);
 }
 
-size_t LogWriter::get_read_ptr(void **ptr, bool *is_part)
+size_t LogWriter::get_read_block(void **ptr, bool flush)
 {
-	// bytes available to read
-	int read_ptr = _head - _count;
+	size_t available = __atomic_load_n(&_write_pos, __ATOMIC_ACQUIRE) - _read_pos;
+	size_t tail = _read_pos % _buffer_size;
+	*ptr = &_buffer[tail];
 
-	if (read_ptr < 0) {
-		read_ptr += _buffer_size;
-		*ptr = &_buffer[read_ptr];
-		*is_part = true;
-		return _buffer_size - read_ptr;
+	// contiguous bytes up to the end of the buffer
+	if (available > _buffer_size - tail) {
+		available = _buffer_size - tail;
+	}
 
-	} else {
-		*ptr = &_buffer[read_ptr];
-		*is_part = false;
-		return _count;
+	if (available > _max_write_block) {
+		available = _max_write_block;
+	}
+
+	if (!flush) {
+		// end on a chunk boundary, so that the file offset stays chunk aligned
+		const size_t file_pos = _header_size + _read_pos;
+		size_t end = (file_pos + available) / _min_write_chunk * _min_write_chunk;
+		available = end > file_pos ? end - file_pos : 0;
 	}
+
+	return available;
+}
+
+int LogWriter::write_latency_bucket(hrt_abstime elapsed)
+{
+	int bucket = 0;
+
+	for (hrt_abstime limit = 1000; elapsed >= limit && bucket < WRITE_LATENCY_BUCKETS - 1; limit <<= 1) {
+		++bucket;
+	}
+
+	return bucket;
+}
+
+void LogWriter::print_statistics()
+{
+	perf_print_counter(_perf_write);
+	perf_print_counter(_perf_fsync);
+	perf_print_counter(_perf_header);
+
+	PX4_INFO("write latency [ms]: <1: %" PRIu32 ", <2: %" PRIu32 ", <4: %" PRIu32 ", <8: %" PRIu32 ", <16: %" PRIu32
+		 ", <32: %" PRIu32 ", <64: %" PRIu32 ", <128: %" PRIu32 ", <256: %" PRIu32 ", >=256: %" PRIu32,
+		 _write_latency[0], _write_latency[1], _write_latency[2], _write_latency[3], _write_latency[4],
+		 _write_latency[5], _write_latency[6], _write_latency[7], _write_latency[8], _write_latency[9]);
+	PX4_INFO("dropouts while writer idle: %" PRIu32 ", in write: %" PRIu32 ", in fsync: %" PRIu32,
+		 _dropout_causes[(int)IOState::Idle], _dropout_causes[(int)IOState::Write],
+		 _dropout_causes[(int)IOState::Fsync]);
 }
 
 }
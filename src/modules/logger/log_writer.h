@@ -61,30 +61,48 @@ public:
 
 	void thread_stop();
 
-	void start_log(const char *filename);
+	/**
+	 * open a new log file
+	 * @param header written with a single write() before the buffered data, if not null.
+	 *               It must not be modified until the next start_log().
+	 */
+	void start_log(const char *filename, const uint8_t *header = nullptr, size_t header_size = 0);
 
 	void stop_log();
 
 	/**
 	 * Write data to be logged. The caller must call lock() before calling this.
+	 * This never waits for the writer thread: the buffer is a single-producer/single-consumer
+	 * ring, the writer thread only ever advances the read position.
 	 * @param dropout_start timestamp when lastest dropout occured. 0 if no dropout at the moment.
 	 * @return true on success, false if not enough space in the buffer left
 	 */
 	bool write(void *ptr, size_t size, uint64_t dropout_start = 0);
 
+	/**
+	 * lock()/unlock() serialize producers among themselves. The writer thread never takes
+	 * this lock, so holding it cannot stall on file I/O.
+	 */
 	void lock()
 	{
-		pthread_mutex_lock(&_mtx);
+		pthread_mutex_lock(&_producer_mtx);
 	}
 
 	void unlock()
 	{
-		pthread_mutex_unlock(&_mtx);
+		pthread_mutex_unlock(&_producer_mtx);
 	}
 
+	/**
+	 * Wake up the writer thread. Signalled under _mtx, so that the wakeup cannot fall
+	 * between the writer's check for data and its wait. The writer only holds _mtx
+	 * for that check, never during file I/O.
+	 */
 	void notify()
 	{
+		pthread_mutex_lock(&_mtx);
 		pthread_cond_broadcast(&_cv);
+		pthread_mutex_unlock(&_mtx);
 	}
 
 	size_t get_total_written() const
@@ -99,43 +117,88 @@ public:
 
 	size_t get_buffer_fill_count() const
 	{
-		return _count;
+		return __atomic_load_n(&_write_pos, __ATOMIC_RELAXED) - __atomic_load_n(&_read_pos, __ATOMIC_RELAXED);
 	}
 
+	/**
+	 * print the write/fsync perf counters, the write latency histogram and the dropout causes
+	 */
+	void print_statistics();
+
 private:
 	static void *run_helper(void *);
 
 	void run();
 
-	size_t get_read_ptr(void **ptr, bool *is_part);
+	/**
+	 * State of the writer thread, used to attribute dropouts
+	 */
+	enum class IOState : uint8_t {
+		Idle = 0,	///< waiting for data: the producer outran the buffer on its own
+		Write,		///< blocked in write()
+		Fsync,		///< blocked in fsync()
+		Count
+	};
+
+	/** number of write latency buckets: [0] < 1 ms, [k] in [2^(k-1), 2^k) ms, last >= 256 ms */
+	static constexpr int WRITE_LATENCY_BUCKETS = 10;
+
+	static int write_latency_bucket(hrt_abstime elapsed);
+
+	void set_io_state(IOState state)
+	{
+		__atomic_store_n(&_io_state, (uint8_t)state, __ATOMIC_RELAXED);
+	}
+
+	/**
+	 * get the next contiguous block to write, starting at the read position
+	 * @param ptr set to the start of the block
+	 * @param flush if true, return everything available, otherwise only whole chunks
+	 * @return block size in bytes
+	 */
+	size_t get_read_block(void **ptr, bool flush);
 
 	void mark_read(size_t n)
 	{
-		_count -= n;
+		__atomic_store_n(&_read_pos, _read_pos + n, __ATOMIC_RELEASE);
 	}
 
 	/**
-	 * Write to the buffer but assuming there is enough space
+	 * Write to the buffer but assuming there is enough space. Only the producer side
+	 * advances _write_pos.
 	 */
 	inline void write_no_check(void *ptr, size_t size);
 
 	/* 512 didn't seem to work properly, 4096 should match the FAT cluster size */
 	static constexpr size_t	_min_write_chunk = 4096;
 
+	/* upper bound for a single write(), so that buffer space is handed back regularly */
+	static constexpr size_t	_max_write_block = 8 * _min_write_chunk;
+
+	/* fsync after that many bytes (100 chunks, as it used to be done every 100 writes) */
+	static constexpr size_t	_fsync_interval = 100 * _min_write_chunk;
+
+	const uint8_t	*_header = nullptr;
+	size_t		_header_size = 0; ///< file offset of the buffered data
 	char		_filename[64];
 	int			_fd = -1;
 	uint8_t 	*_buffer = nullptr;
-	const size_t	_buffer_size;
-	size_t			_head = 0; ///< next position to write to
-	size_t			_count = 0; ///< number of bytes in _buffer to be written
+	const size_t	_buffer_size; ///< multiple of _min_write_chunk
+	size_t			_write_pos = 0; ///< total bytes put into _buffer, owned by the producer
+	size_t			_read_pos = 0; ///< total bytes taken out of _buffer, owned by the writer thread
 	size_t		_total_written = 0;
 	bool		_should_run = false;
 	bool		_running = false;
 	bool 		_exit_thread = false;
-	pthread_mutex_t		_mtx;
+	uint8_t		_io_state = (uint8_t)IOState::Idle;
+	pthread_mutex_t		_producer_mtx;
+	pthread_mutex_t		_mtx; ///< only used to wait on _cv
 	pthread_cond_t		_cv;
 	perf_counter_t _perf_write;
 	perf_counter_t _perf_fsync;
+	perf_counter_t _perf_header;
+	uint32_t	_write_latency[WRITE_LATENCY_BUCKETS] = {}; ///< updated by the writer thread
+	uint32_t	_dropout_causes[(int)IOState::Count] = {}; ///< updated by the producer
 };
 
 }
@@ -37,6 +37,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -223,6 +224,31 @@ void Logger::status()
 		PX4_INFO("Running");
 		print_statistics();
 	}
+
+	perf_print_counter(_perf_stage);
+	perf_print_counter(_perf_flush);
+	perf_print_counter(_perf_header);
+
+	if (_header_cache) {
+		PX4_INFO("header cache: %zu B, %i params, built in %.1f ms", _header_cache_size, _header_num_params,
+			 (double)_header_build_time / 1.e3);
+	}
+
+	_writer.print_statistics();
+	print_encoding_statistics();
+}
+
+void Logger::print_encoding_statistics()
+{
+	for (const LoggerSubscription &sub : _subscriptions) {
+		if (sub.encoding == 0 || sub.encoded_msgs == 0) {
+			continue;
+		}
+
+		PX4_INFO("%-28s %s: %" PRIu32 " msgs, ratio %5.3f, %5.1f us/msg", sub.metadata->o_name,
+			 (sub.encoding & ULOG_ENCODING_DELTA) ? "delta" : "lz   ", sub.encoded_msgs,
+			 (double)sub.encoded_bytes / (double)sub.raw_bytes, (double)sub.encode_time / (double)sub.encoded_msgs);
+	}
 }
 void Logger::print_statistics()
 {
@@ -345,6 +371,9 @@ Logger::Logger(size_t buffer_size, uint32_t log_interval, bool log_on_start,
 	_log_interval(log_interval)
 {
 	_log_utc_offset = param_find("SDLOG_UTC_OFFSET");
+	_perf_stage = perf_alloc(PC_ELAPSED, "logger cycle");
+	_perf_flush = perf_alloc(PC_ELAPSED, "logger flush");
+	_perf_header = perf_alloc(PC_ELAPSED, "logger header");
 }
 
 Logger::~Logger()
@@ -376,6 +405,28 @@ Logger::~Logger()
 	if (_msg_buffer) {
 		delete[](_msg_buffer);
 	}
+
+	if (_encode_buffer) {
+		delete[](_encode_buffer);
+	}
+
+	if (_compressor) {
+		delete _compressor;
+	}
+
+	if (_header_cache) {
+		delete[](_header_cache);
+	}
+
+	for (LoggerSubscription &sub : _subscriptions) {
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			sub.delta[instance].release();
+		}
+	}
+
+	perf_free(_perf_stage);
+	perf_free(_perf_flush);
+	perf_free(_perf_header);
 }
 
 int Logger::add_topic(const orb_metadata *topic)
@@ -406,7 +457,7 @@ int Logger::add_topic(const orb_metadata *topic)
 	return fd;
 }
 
-int Logger::add_topic(const char *name, unsigned interval = 0)
+int Logger::add_topic(const char *name, unsigned interval = 0, int encoding = -1)
 {
 	const orb_metadata **topics = orb_get_topics();
 	int fd = -1;
@@ -419,54 +470,198 @@ int Logger::add_topic(const char *name, unsigned interval = 0)
 		}
 	}
 
-	if (fd >= 0 && interval != 0) {
-		orb_set_interval(fd, interval);
+	/* rate limit in the logger: uORB would check the interval on every orb_check() */
+	if (fd >= 0) {
+		_subscriptions[_subscriptions.size() - 1].interval = interval * 1000;
+		_subscriptions[_subscriptions.size() - 1].encoding = (encoding >= 0) ? encoding : _default_encoding;
 	}
 
 	return fd;
 }
 
-bool Logger::copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, void *buffer)
+int Logger::encoding_from_name(const char *name)
+{
+	if (strcmp(name, "raw") == 0) {
+		return 0;
+
+	} else if (strcmp(name, "lz") == 0) {
+		return ULOG_ENCODING_LZ;
+
+	} else if (strcmp(name, "delta") == 0) {
+		// the XOR delta itself does not make a sample smaller, it makes it compressible
+		return ULOG_ENCODING_DELTA | ULOG_ENCODING_LZ;
+	}
+
+	return -1;
+}
+
+bool Logger::copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, hrt_abstime now)
 {
-	bool updated = false;
 	int &handle = sub.fd[multi_instance];
 
-	// only try to subscribe to topic if this is the first time
-	// after that just check after a certain interval to avoid high cpu usage
-	if (handle < 0 && (sub.time_tried_subscribe == 0 ||
-			   hrt_elapsed_time(&sub.time_tried_subscribe) > TRY_SUBSCRIBE_INTERVAL)) {
-		sub.time_tried_subscribe = hrt_absolute_time();
+	if (now < sub.next_due[multi_instance]) {
+		return false;
+	}
 
-		if (OK == orb_exists(sub.metadata, multi_instance)) {
-			handle = orb_subscribe_multi(sub.metadata, multi_instance);
+	bool updated = false;
 
-			//PX4_INFO("subscribed to instance %d of topic %s", multi_instance, topic->o_name);
+	if (handle < 0) {
+		// check for the instance at most every TRY_SUBSCRIBE_INTERVAL to avoid high cpu usage
+		sub.next_due[multi_instance] = now + TRY_SUBSCRIBE_INTERVAL;
 
-			/* copy first data */
-			if (handle >= 0) {
-				write_add_logged_msg(sub, multi_instance);
+		if (OK != orb_exists(sub.metadata, multi_instance)) {
+			return false;
+		}
 
-				/* set to the same interval as the first instance */
-				unsigned int interval;
+		handle = orb_subscribe_multi(sub.metadata, multi_instance);
 
-				if (orb_get_interval(sub.fd[0], &interval) == 0 && interval > 0) {
-					orb_set_interval(handle, interval);
-				}
+		//PX4_INFO("subscribed to instance %d of topic %s", multi_instance, topic->o_name);
 
-				orb_copy(sub.metadata, handle, buffer);
-				updated = true;
-			}
+		if (handle < 0) {
+			return false;
 		}
 
-	} else if (handle >= 0) {
+		/* the ADD_LOGGED_MSG must precede the first data of the instance */
+		ulog_message_add_logged_s msg;
+		size_t msg_size = get_add_logged_msg(sub, multi_instance, msg);
+		memcpy(stage(msg_size, true), &msg, msg_size);
+
+		/* copy first data */
+		updated = true;
+
+	} else {
 		orb_check(handle, &updated);
+	}
 
-		if (updated) {
-			orb_copy(sub.metadata, handle, buffer);
-		}
+	if (!updated) {
+		return false;
+	}
+
+	/* each message consists of a header followed by an orb data object.
+	 * orb_copy writes o_size bytes, the padding at the end is overwritten by the next message */
+	size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+	uint8_t *buffer = stage(sizeof(ulog_message_data_header_s) + sub.metadata->o_size);
+
+	orb_copy(sub.metadata, handle, buffer + sizeof(ulog_message_data_header_s));
+
+	uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+	//write one byte after another (necessary because of alignment)
+	buffer[0] = (uint8_t)write_msg_size;
+	buffer[1] = (uint8_t)(write_msg_size >> 8);
+	buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
+	uint16_t write_msg_id = sub.msg_ids[multi_instance];
+	buffer[3] = (uint8_t)write_msg_id;
+	buffer[4] = (uint8_t)(write_msg_id >> 8);
+
+	//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
+
+	if (sub.encoding && _encode_buffer) {
+		msg_size = encode(sub, multi_instance, buffer);
 	}
 
-	return updated;
+	/* give back the padding (and what the encoding saved) */
+	_staged -= sizeof(ulog_message_data_header_s) + sub.metadata->o_size - msg_size;
+
+	sub.next_due[multi_instance] = (sub.interval > 0) ? now + sub.interval : 0;
+
+	return true;
+}
+
+size_t Logger::encode(LoggerSubscription &sub, int multi_instance, uint8_t *buffer)
+{
+	const hrt_abstime encode_start = hrt_absolute_time();
+	const int len = sub.metadata->o_size_no_padding;
+	uint8_t *payload = buffer + sizeof(ulog_message_data_header_s);
+	const uint8_t *source = payload;
+	uint8_t encoding = ULOG_ENCODING_LZ;
+	size_t msg_size = sizeof(ulog_message_data_header_s) + len;
+
+	/* without a reference (out of memory) the sample is only compressed */
+	if ((sub.encoding & ULOG_ENCODING_DELTA) &&
+	    sub.delta[multi_instance].encode(payload, _encode_buffer, len, _encoding_generation, ENCODING_KEYFRAME_INTERVAL) > 0) {
+		source = _encode_buffer;
+		encoding |= ULOG_ENCODING_DELTA;
+	}
+
+	/* only use the encoded message if it is smaller than the DATA message */
+	const int capacity = (int)msg_size - (int)sizeof(ulog_message_encoded_data_header_s) - 1;
+	const int encoded_len = (capacity > 0) ? _compressor->compress(source, len, _encode_buffer + len, capacity) : -1;
+
+	if (encoded_len >= 0) {
+		msg_size = sizeof(ulog_message_encoded_data_header_s) + encoded_len;
+		uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+		uint16_t write_msg_id = sub.msg_ids[multi_instance];
+		//write one byte after another (necessary because of alignment)
+		buffer[0] = (uint8_t)write_msg_size;
+		buffer[1] = (uint8_t)(write_msg_size >> 8);
+		buffer[2] = static_cast<uint8_t>(ULogMessageType::ENCODED_DATA);
+		buffer[3] = (uint8_t)write_msg_id;
+		buffer[4] = (uint8_t)(write_msg_id >> 8);
+		buffer[5] = encoding;
+		buffer[6] = (uint8_t)len;
+		buffer[7] = (uint8_t)(len >> 8);
+		memcpy(buffer + sizeof(ulog_message_encoded_data_header_s), _encode_buffer + len, encoded_len);
+	}
+
+	sub.raw_bytes += sizeof(ulog_message_data_header_s) + len;
+	sub.encoded_bytes += msg_size;
+	sub.encode_time += hrt_elapsed_time(&encode_start);
+	++sub.encoded_msgs;
+
+	return msg_size;
+}
+
+uint8_t *Logger::stage(size_t size, bool required)
+{
+	if (_staged + size > (size_t)_msg_buffer_len) {
+		flush_staged();
+	}
+
+	uint8_t *ptr = _msg_buffer + _staged;
+	_staged += size;
+	_staged_required = _staged_required || required;
+	return ptr;
+}
+
+bool Logger::flush_staged()
+{
+	if (_staged == 0) {
+		return false;
+	}
+
+	perf_begin(_perf_flush);
+
+	/* wait for lock on log buffer */
+	_writer.lock();
+
+	bool written;
+
+	if (_staged_required) {
+		written = write_wait(_msg_buffer, _staged);
+
+	} else {
+		written = write(_msg_buffer, _staged);
+	}
+
+	if (!_dropout_start && _writer.get_buffer_fill_count() > _high_water) {
+		_high_water = _writer.get_buffer_fill_count();
+	}
+
+	/* release the log buffer */
+	_writer.unlock();
+
+	perf_end(_perf_flush);
+
+	/* the staged samples are lost, so the next ones cannot be deltas against them */
+	if (!written) {
+		++_encoding_generation;
+	}
+
+	_staged = 0;
+	_staged_required = false;
+	_data_written = _data_written || written;
+
+	return written;
 }
 
 void Logger::add_default_topics()
@@ -505,6 +700,7 @@ void Logger::add_default_topics()
 	add_topic("control_state", 20);
 	add_topic("camera_trigger");
 	add_topic("cpuload");
+	add_topic("uorb_topic_stats"); //only published after "uorb stats start"
 	add_topic("gps_dump"); //this will only be published if GPS_DUMP_COMM is set
 
 	/* for estimator replay (need to be at full rate) */
@@ -518,6 +714,7 @@ int Logger::add_topics_from_file(const char *fname)
 	FILE		*fp;
 	char		line[80];
 	char		topic_name[80];
+	char		encoding_name[16];
 	unsigned	interval;
 	int			ntopics = 0;
 
@@ -529,7 +726,7 @@ int Logger::add_topics_from_file(const char *fname)
 	}
 
 	/* call add_topic for each topic line in the file */
-	// format is TOPIC_NAME, [interval]
+	// format is TOPIC_NAME, [interval], [encoding: raw, lz or delta]
 	for (;;) {
 
 		/* get a line, bail on error/EOF */
@@ -546,11 +743,20 @@ int Logger::add_topics_from_file(const char *fname)
 
 		// default interval to zero
 		interval = 0;
-		int nfields = sscanf(line, "%s, %u", topic_name, &interval);
+		int encoding = -1;
+		int nfields = sscanf(line, "%79[^, \t\r\n] , %u , %15s", topic_name, &interval, encoding_name);
+
+		if (nfields > 2) {
+			encoding = encoding_from_name(encoding_name);
+
+			if (encoding < 0) {
+				PX4_WARN("unknown encoding %s for %s", encoding_name, topic_name);
+			}
+		}
 
 		if (nfields > 0) {
 			/* add topic with specified interval */
-			add_topic(topic_name, interval);
+			add_topic(topic_name, interval, encoding);
 			ntopics++;
 		}
 	}
@@ -585,6 +791,15 @@ void Logger::run()
 	uORB::Subscription<parameter_update_s> parameter_update_sub(ORB_ID(parameter_update));
 	uORB::Subscription<mavlink_log_s> mavlink_log_sub(ORB_ID(mavlink_log));
 
+	param_t encode_param = param_find("SDLOG_ENCODE");
+
+	if (encode_param != PARAM_INVALID) {
+		int32_t encode_mode = 0;
+		param_get(encode_param, &encode_mode);
+		_default_encoding = (encode_mode == 2) ? encoding_from_name("delta") :
+				    (encode_mode == 1) ? encoding_from_name("lz") : 0;
+	}
+
 	int ntopics = add_topics_from_file(PX4_ROOTFSDIR "/fs/microsd/etc/logging/logger_topics.txt");
 
 	if (ntopics > 0) {
@@ -596,12 +811,31 @@ void Logger::run()
 
 	//all topics added. Get required message buffer size
 	int max_msg_size = 0;
+	int max_encoded_size = 0;
 
 	for (const auto &subscription : _subscriptions) {
 		//use o_size, because that's what orb_copy will use
 		if (subscription.metadata->o_size > max_msg_size) {
 			max_msg_size = subscription.metadata->o_size;
 		}
+
+		if (subscription.encoding && (int)subscription.metadata->o_size_no_padding > max_encoded_size) {
+			max_encoded_size = subscription.metadata->o_size_no_padding;
+		}
+	}
+
+	if (max_encoded_size > 0 && !_encode_buffer) {
+		_encode_buffer = new uint8_t[2 * max_encoded_size];
+		_compressor = new ULogCompressor();
+
+		if (!_encode_buffer || !_compressor) {
+			PX4_ERR("failed to alloc encoding buffers, logging raw data");
+
+			if (_encode_buffer) {
+				delete[](_encode_buffer);
+				_encode_buffer = nullptr;
+			}
+		}
 	}
 
 	max_msg_size += sizeof(ulog_message_data_header_s);
@@ -610,6 +844,22 @@ void Logger::run()
 		max_msg_size = sizeof(ulog_message_logging_s);
 	}
 
+	if (sizeof(ulog_message_add_logged_s) > max_msg_size) {
+		max_msg_size = sizeof(ulog_message_add_logged_s);
+	}
+
+	/* stage several messages per critical section, but never more than a fraction of the write buffer,
+	 * so that a staged batch that must not be dropped always fits eventually */
+	int staging_len = LOG_STAGING_LEN;
+
+	if (staging_len > (int)(_writer.get_buffer_size() / 4)) {
+		staging_len = _writer.get_buffer_size() / 4;
+	}
+
+	if (staging_len > max_msg_size) {
+		max_msg_size = staging_len;
+	}
+
 	if (max_msg_size > _msg_buffer_len) {
 		if (_msg_buffer) {
 			delete[](_msg_buffer);
@@ -630,6 +880,18 @@ void Logger::run()
 		return;
 	}
 
+	/* the header is static apart from the parameter values: serialize it now and not at arming */
+	param_t header_cache_param = param_find("SDLOG_HDR_CACHE");
+	int32_t header_cache = 1;
+
+	if (header_cache_param != PARAM_INVALID) {
+		param_get(header_cache_param, &header_cache);
+	}
+
+	if (header_cache && !build_header_cache()) {
+		PX4_WARN("failed to alloc header cache, writing the header message by message");
+	}
+
 	int ret = _writer.thread_start(writer_thread);
 
 	if (ret) {
@@ -641,7 +903,7 @@ void Logger::run()
 
 #ifdef DBGPRINT
 	hrt_abstime	timer_start = 0;
-	uint32_t	total_bytes = 0;
+	size_t		total_bytes = 0; ///< bytes written when timer_start was taken
 #endif /* DBGPRINT */
 
 	// we start logging immediately
@@ -674,7 +936,7 @@ void Logger::run()
 
 #ifdef DBGPRINT
 					timer_start = hrt_absolute_time();
-					total_bytes = 0;
+					total_bytes = _writer.get_total_written();
 #endif /* DBGPRINT */
 
 				} else {
@@ -685,7 +947,8 @@ void Logger::run()
 
 		if (_enabled) {
 
-			bool data_written = false;
+			perf_begin(_perf_stage);
+			_data_written = false;
 
 			/* Check if parameters have changed */
 			// this needs to change to a timestamped record to record a history of parameter changes
@@ -694,46 +957,23 @@ void Logger::run()
 				write_changed_parameters();
 			}
 
-			/* wait for lock on log buffer */
-			_writer.lock();
+			/* only instances that are due are looked at, the others cost a comparison.
+			 * Updated ones are staged without holding the writer lock. */
+			const hrt_abstime now = hrt_absolute_time();
 
 			for (LoggerSubscription &sub : _subscriptions) {
-				/* each message consists of a header followed by an orb data object
-				 */
-				size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
-
-				/* if this topic has been updated, copy the new data into the message buffer
-				 * and write a message to the log
-				 */
 				for (uint8_t instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
-					if (copy_if_updated_multi(sub, instance, _msg_buffer + sizeof(ulog_message_data_header_s))) {
-
-						uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
-						//write one byte after another (necessary because of alignment)
-						_msg_buffer[0] = (uint8_t)write_msg_size;
-						_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
-						_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
-						uint16_t write_msg_id = sub.msg_ids[instance];
-						_msg_buffer[3] = (uint8_t)write_msg_id;
-						_msg_buffer[4] = (uint8_t)(write_msg_id >> 8);
-
-						//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
-
-						if (write(_msg_buffer, msg_size)) {
-
-#ifdef DBGPRINT
-							total_bytes += msg_size;
-#endif /* DBGPRINT */
-
-							data_written = true;
-
-						} else {
-							break;	// Write buffer overflow, skip this record
-						}
-					}
+					copy_if_updated_multi(sub, instance, now);
 				}
 			}
 
+			/* sync points let readers resynchronize and split the log for parallel decoding */
+			if (now >= _next_sync) {
+				ulog_message_sync_s sync;
+				memcpy(stage(sizeof(sync)), &sync, sizeof(sync));
+				_next_sync = now + SYNC_INTERVAL;
+			}
+
 			//check for new mavlink log message
 			if (mavlink_log_sub.check_updated()) {
 				mavlink_log_sub.update();
@@ -743,26 +983,24 @@ void Logger::run()
 				if (message_len > 0) {
 					uint16_t write_msg_size = sizeof(ulog_message_logging_s) - sizeof(ulog_message_logging_s::message)
 								  - ULOG_MSG_HEADER_LEN + message_len;
-					_msg_buffer[0] = (uint8_t)write_msg_size;
-					_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
-					_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::LOGGING);
-					_msg_buffer[3] = mavlink_log_sub.get().severity + '0';
-					memcpy(_msg_buffer + 4, &mavlink_log_sub.get().timestamp, sizeof(ulog_message_logging_s::timestamp));
-					strncpy((char *)(_msg_buffer + 12), message, sizeof(ulog_message_logging_s::message));
-
-					write(_msg_buffer, write_msg_size + ULOG_MSG_HEADER_LEN);
+					uint8_t *buffer = stage(sizeof(ulog_message_logging_s));
+					buffer[0] = (uint8_t)write_msg_size;
+					buffer[1] = (uint8_t)(write_msg_size >> 8);
+					buffer[2] = static_cast<uint8_t>(ULogMessageType::LOGGING);
+					buffer[3] = mavlink_log_sub.get().severity + '0';
+					memcpy(buffer + 4, &mavlink_log_sub.get().timestamp, sizeof(ulog_message_logging_s::timestamp));
+					strncpy((char *)(buffer + 12), message, sizeof(ulog_message_logging_s::message));
+					_staged -= sizeof(ulog_message_logging_s) - (write_msg_size + ULOG_MSG_HEADER_LEN);
 				}
 			}
 
-			if (!_dropout_start && _writer.get_buffer_fill_count() > _high_water) {
-				_high_water = _writer.get_buffer_fill_count();
-			}
+			/* append everything staged in this cycle at once */
+			flush_staged();
 
-			/* release the log buffer */
-			_writer.unlock();
+			perf_end(_perf_stage);
 
 			/* notify the writer thread if data is available */
-			if (data_written) {
+			if (_data_written) {
 				_writer.notify();
 			}
 
@@ -771,14 +1009,14 @@ void Logger::run()
 
 			if (deltat > 4.0) {
 				alloc_info = mallinfo();
-				double throughput = total_bytes / deltat;
+				double throughput = (_writer.get_total_written() - total_bytes) / deltat;
 				PX4_INFO("%8.1f kB/s, %zu highWater,  %d dropouts, %5.3f sec max, free heap: %d",
 					 throughput / 1.e3, _high_water, _write_dropouts, (double)_max_dropout_duration,
 					 alloc_info.fordblks);
 
 				_high_water = 0;
 				_max_dropout_duration = 0.f;
-				total_bytes = 0;
+				total_bytes = _writer.get_total_written();
 				timer_start = hrt_absolute_time();
 			}
 
@@ -1053,13 +1291,34 @@ void Logger::start_log()
 	mavlink_log_info(&_mavlink_log_pub, "[logger] file: %s", file_name);
 	_next_topic_id = 0;
 
-	_writer.start_log(file_name);
-	write_header();
-	write_version();
-	write_formats();
-	write_parameters();
+	/* a new file: encoding starts with keyframes */
+	++_encoding_generation;
+
+	for (LoggerSubscription &sub : _subscriptions) {
+		sub.raw_bytes = 0;
+		sub.encoded_bytes = 0;
+		sub.encode_time = 0;
+		sub.encoded_msgs = 0;
+	}
+
+	perf_begin(_perf_header);
+
+	if (_header_cache && update_header_cache()) {
+		/* the writer thread writes the cached header before the buffered data */
+		_writer.start_log(file_name, _header_cache, _header_cache_size);
+		write_log_info();
+
+	} else {
+		_writer.start_log(file_name);
+		write_header();
+		write_version();
+		write_formats();
+		write_parameters();
+	}
+
 	write_all_add_logged_msg();
 	_writer.notify();
+	perf_end(_perf_header);
 	_enabled = true;
 	_start_time = hrt_absolute_time();
 }
@@ -1094,16 +1353,26 @@ void Logger::write_formats()
 
 	//write all known formats
 	for (size_t i = 0; i < orb_topics_count(); i++) {
-		int format_len = snprintf(msg.format, sizeof(msg.format), "%s:%s", topics[i]->o_name, topics[i]->o_fields);
-		size_t msg_size = sizeof(msg) - sizeof(msg.format) + format_len;
-		msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
+		size_t msg_size = get_format_msg(topics[i], msg);
 		write_wait(&msg, msg_size);
 	}
 
 	_writer.unlock();
 }
 
+size_t Logger::get_format_msg(const orb_metadata *meta, ulog_message_format_s &msg)
+{
+	int format_len = snprintf(msg.format, sizeof(msg.format), "%s:%s", meta->o_name, meta->o_fields);
+
+	if (format_len >= (int)sizeof(msg.format)) {
+		format_len = sizeof(msg.format) - 1;
+	}
+
+	size_t msg_size = sizeof(msg) - sizeof(msg.format) + format_len;
+	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
 void Logger::write_all_add_logged_msg()
 {
 	_writer.lock();
@@ -1122,7 +1391,13 @@ void Logger::write_all_add_logged_msg()
 void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance)
 {
 	ulog_message_add_logged_s msg;
+	size_t msg_size = get_add_logged_msg(subscription, instance, msg);
 
+	write_wait(&msg, msg_size);
+}
+
+size_t Logger::get_add_logged_msg(LoggerSubscription &subscription, int instance, ulog_message_add_logged_s &msg)
+{
 	msg.multi_id = instance;
 	subscription.msg_ids[instance] = _next_topic_id;
 	msg.msg_id = _next_topic_id;
@@ -1134,9 +1409,9 @@ void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance
 	size_t msg_size = sizeof(msg) - sizeof(msg.message_name) + message_name_len;
 	msg.msg_size = msg_size - ULOG_MSG_HEADER_LEN;
 
-	write_wait(&msg, msg_size);
-
 	++_next_topic_id;
+
+	return msg_size;
 }
 
 /* write info message */
@@ -1144,6 +1419,17 @@ void Logger::write_info(const char *name, const char *value)
 {
 	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_info_header_s)];
+	size_t msg_size = get_info_msg(name, value, buffer);
+
+	if (msg_size > 0) {
+		write_wait(buffer, msg_size);
+	}
+
+	_writer.unlock();
+}
+
+size_t Logger::get_info_msg(const char *name, const char *value, uint8_t *buffer)
+{
 	ulog_message_info_header_s *msg = reinterpret_cast<ulog_message_info_header_s *>(buffer);
 	msg->msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
 
@@ -1153,16 +1439,15 @@ void Logger::write_info(const char *name, const char *value)
 	size_t msg_size = sizeof(*msg) - sizeof(msg->key) + msg->key_len;
 
 	/* copy string value directly to buffer */
-	if (vlen < (sizeof(*msg) - msg_size)) {
-		memcpy(&buffer[msg_size], value, vlen);
-		msg_size += vlen;
-
-		msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
-		write_wait(buffer, msg_size);
+	if (vlen >= (sizeof(*msg) - msg_size)) {
+		return 0;
 	}
 
-	_writer.unlock();
+	memcpy(&buffer[msg_size], value, vlen);
+	msg_size += vlen;
+
+	msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
 }
 void Logger::write_info(const char *name, int32_t value)
 {
@@ -1189,6 +1474,14 @@ void Logger::write_info(const char *name, int32_t value)
 void Logger::write_header()
 {
 	ulog_file_header_s header;
+	get_file_header(header);
+	_writer.lock();
+	write_wait(&header, sizeof(header));
+	_writer.unlock();
+}
+
+void Logger::get_file_header(ulog_file_header_s &header)
+{
 	header.magic[0] = 'U';
 	header.magic[1] = 'L';
 	header.magic[2] = 'o';
@@ -1198,9 +1491,6 @@ void Logger::write_header()
 	header.magic[6] = 0x35;
 	header.magic[7] = 0x00; //file version 0
 	header.timestamp = hrt_absolute_time();
-	_writer.lock();
-	write_wait(&header, sizeof(header));
-	_writer.unlock();
 }
 
 /* write version info messages */
@@ -1209,6 +1499,11 @@ void Logger::write_version()
 	write_info("ver_sw", PX4_GIT_VERSION_STR);
 	write_info("ver_hw", HW_ARCH);
 	write_info("sys_name", "PX4");
+	write_log_info();
+}
+
+void Logger::write_log_info()
+{
 	int32_t utc_offset = 0;
 
 	if (_log_utc_offset != PARAM_INVALID) {
@@ -1225,9 +1520,6 @@ void Logger::write_parameters()
 {
 	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u)];
-	ulog_message_parameter_header_s *msg = reinterpret_cast<ulog_message_parameter_header_s *>(buffer);
-
-	msg->msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
 	int param_idx = 0;
 	param_t param = 0;
 
@@ -1240,37 +1532,11 @@ void Logger::write_parameters()
 
 		// save parameters which are valid AND used
 		if (param != PARAM_INVALID) {
-			/* get parameter type and size */
-			const char *type_str;
-			param_type_t type = param_type(param);
-			size_t value_size = 0;
-
-			switch (type) {
-			case PARAM_TYPE_INT32:
-				type_str = "int32_t";
-				value_size = sizeof(int32_t);
-				break;
-
-			case PARAM_TYPE_FLOAT:
-				type_str = "float";
-				value_size = sizeof(float);
-				break;
+			size_t msg_size = get_parameter_msg(param, buffer);
 
-			default:
-				continue;
+			if (msg_size > 0) {
+				write_wait(buffer, msg_size);
 			}
-
-			/* format parameter key (type and name) */
-			msg->key_len = snprintf(msg->key, sizeof(msg->key), "%s %s", type_str, param_name(param));
-			size_t msg_size = sizeof(*msg) - sizeof(msg->key) + msg->key_len;
-
-			/* copy parameter value directly to buffer */
-			param_get(param, &buffer[msg_size]);
-			msg_size += value_size;
-
-			msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
-
-			write_wait(buffer, msg_size);
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
@@ -1282,9 +1548,6 @@ void Logger::write_changed_parameters()
 {
 	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u)];
-	ulog_message_parameter_header_s *msg = reinterpret_cast<ulog_message_parameter_header_s *>(buffer);
-
-	msg->msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
 	int param_idx = 0;
 	param_t param = 0;
 
@@ -1297,44 +1560,231 @@ void Logger::write_changed_parameters()
 
 		// log parameters which are valid AND used AND unsaved
 		if ((param != PARAM_INVALID) && param_value_unsaved(param)) {
+			size_t msg_size = get_parameter_msg(param, buffer);
+
+			if (msg_size > 0) {
+				write_wait(buffer, msg_size);
+			}
+		}
+	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
-			/* get parameter type and size */
-			const char *type_str;
-			param_type_t type = param_type(param);
-			size_t value_size = 0;
+	_writer.unlock();
+	_writer.notify();
+}
 
-			switch (type) {
-			case PARAM_TYPE_INT32:
-				type_str = "int32_t";
-				value_size = sizeof(int32_t);
-				break;
+size_t Logger::get_parameter_msg(param_t param, uint8_t *buffer)
+{
+	ulog_message_parameter_header_s *msg = reinterpret_cast<ulog_message_parameter_header_s *>(buffer);
+	msg->msg_type = static_cast<uint8_t>(ULogMessageType::PARAMETER);
 
-			case PARAM_TYPE_FLOAT:
-				type_str = "float";
-				value_size = sizeof(float);
-				break;
+	/* get parameter type and size */
+	const char *type_str;
+	size_t value_size = 0;
+
+	switch (param_type(param)) {
+	case PARAM_TYPE_INT32:
+		type_str = "int32_t";
+		value_size = sizeof(int32_t);
+		break;
+
+	case PARAM_TYPE_FLOAT:
+		type_str = "float";
+		value_size = sizeof(float);
+		break;
+
+	default:
+		return 0;
+	}
+
+	/* format parameter key (type and name) */
+	msg->key_len = snprintf(msg->key, sizeof(msg->key), "%s %s", type_str, param_name(param));
+	size_t msg_size = sizeof(*msg) - sizeof(msg->key) + msg->key_len;
+
+	/* copy parameter value directly to buffer */
+	param_get(param, &buffer[msg_size]);
+	msg_size += value_size;
+
+	/* msg_size is now 1 (msg_type) + 2 (msg_size) + 1 (key_len) + key_len + value_size */
+	msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	return msg_size;
+}
+
+bool Logger::build_header_cache()
+{
+	hrt_abstime start = hrt_absolute_time();
+
+	if (_header_cache) {
+		delete[](_header_cache);
+		_header_cache = nullptr;
+	}
+
+	/* count first, then serialize into an exactly sized buffer */
+	int num_params = 0;
+	size_t static_size = get_static_header(nullptr);
+	size_t params_size = get_parameters(nullptr, num_params);
+
+	if (static_size == 0) {
+		return false;
+	}
+
+	_header_cache = new uint8_t[static_size + params_size];
+
+	if (!_header_cache) {
+		return false;
+	}
+
+	if (get_static_header(_header_cache) != static_size) {
+		delete[](_header_cache);
+		_header_cache = nullptr;
+		return false;
+	}
+
+	get_parameters(_header_cache + static_size, num_params);
+	_header_static_size = static_size;
+	_header_cache_size = static_size + params_size;
+	_header_num_params = num_params;
+	_header_build_time = hrt_elapsed_time(&start);
+	return true;
+}
 
-			default:
-				continue;
+bool Logger::update_header_cache()
+{
+	/* parameters are never removed from the used set: the same count means the same parameters */
+	if (count_parameters() != _header_num_params) {
+		return build_header_cache();
+	}
+
+	ulog_file_header_s header;
+	get_file_header(header);
+	memcpy(_header_cache, &header, sizeof(header));
+
+	/* overwrite the values in place, the messages keep their size */
+	size_t pos = _header_static_size;
+	int param_idx = 0;
+	param_t param = 0;
+
+	do {
+		do {
+			param = param_for_index(param_idx);
+			++param_idx;
+		} while (param != PARAM_INVALID && !param_used(param));
+
+		if (param != PARAM_INVALID) {
+			size_t value_size = (param_type(param) == PARAM_TYPE_INT32) ? sizeof(int32_t) :
+					    (param_type(param) == PARAM_TYPE_FLOAT) ? sizeof(float) : 0;
+
+			if (value_size > 0) {
+				size_t msg_size = ULOG_MSG_HEADER_LEN + (_header_cache[pos] | (_header_cache[pos + 1] << 8));
+				param_get(param, &_header_cache[pos + msg_size - value_size]);
+				pos += msg_size;
 			}
+		}
+	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
-			/* format parameter key (type and name) */
-			msg->key_len = snprintf(msg->key, sizeof(msg->key), "%s %s", type_str, param_name(param));
-			size_t msg_size = sizeof(*msg) - sizeof(msg->key) + msg->key_len;
+	return true;
+}
 
-			/* copy parameter value directly to buffer */
-			param_get(param, &buffer[msg_size]);
-			msg_size += value_size;
+size_t Logger::get_static_header(uint8_t *dst)
+{
+	size_t size = sizeof(ulog_file_header_s);
+
+	if (dst) {
+		ulog_file_header_s header;
+		get_file_header(header);
+		memcpy(dst, &header, sizeof(header));
+	}
+
+	static const char *const version_info[][2] = {
+		{"ver_sw", PX4_GIT_VERSION_STR},
+		{"ver_hw", HW_ARCH},
+		{"sys_name", "PX4"}
+	};
+
+	uint8_t buffer[sizeof(ulog_message_info_header_s)];
 
-			/* msg_size is now 1 (msg_type) + 2 (msg_size) + 1 (key_len) + key_len + value_size */
-			msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
+	for (unsigned i = 0; i < sizeof(version_info) / sizeof(version_info[0]); i++) {
+		size_t msg_size = get_info_msg(version_info[i][0], version_info[i][1], buffer);
 
-			write_wait(buffer, msg_size);
+		if (dst) {
+			memcpy(dst + size, buffer, msg_size);
+		}
+
+		size += msg_size;
+	}
+
+	/* the format message is 2 KB, do not put it on the stack */
+	ulog_message_format_s *msg = new ulog_message_format_s;
+
+	if (!msg) {
+		return 0;
+	}
+
+	const orb_metadata **topics = orb_get_topics();
+
+	for (size_t i = 0; i < orb_topics_count(); i++) {
+		size_t msg_size = get_format_msg(topics[i], *msg);
+
+		if (dst) {
+			memcpy(dst + size, msg, msg_size);
+		}
+
+		size += msg_size;
+	}
+
+	delete msg;
+	return size;
+}
+
+size_t Logger::get_parameters(uint8_t *dst, int &num_params)
+{
+	uint8_t buffer[sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u)];
+	size_t size = 0;
+	int param_idx = 0;
+	param_t param = 0;
+	num_params = 0;
+
+	do {
+		do {
+			param = param_for_index(param_idx);
+			++param_idx;
+		} while (param != PARAM_INVALID && !param_used(param));
+
+		if (param != PARAM_INVALID) {
+			size_t msg_size = get_parameter_msg(param, buffer);
+
+			if (msg_size > 0) {
+				if (dst) {
+					memcpy(dst + size, buffer, msg_size);
+				}
+
+				size += msg_size;
+				++num_params;
+			}
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
-	_writer.unlock();
-	_writer.notify();
+	return size;
+}
+
+int Logger::count_parameters()
+{
+	int num_params = 0;
+	int param_idx = 0;
+	param_t param = 0;
+
+	do {
+		do {
+			param = param_for_index(param_idx);
+			++param_idx;
+		} while (param != PARAM_INVALID && !param_used(param));
+
+		if (param != PARAM_INVALID &&
+		    (param_type(param) == PARAM_TYPE_INT32 || param_type(param) == PARAM_TYPE_FLOAT)) {
+			++num_params;
+		}
+	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
+
+	return num_params;
 }
 
 int Logger::check_free_space()
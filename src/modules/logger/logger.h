@@ -35,6 +35,8 @@
 
 #include "log_writer.h"
 #include "array.h"
+#include "messages.h"
+#include "encoding.h"
 #include <px4.h>
 #include <drivers/drv_hrt.h>
 #include <uORB/Subscription.hpp>
@@ -49,10 +51,16 @@ extern "C" __EXPORT int logger_main(int argc, char *argv[]);
 
 #ifdef __PX4_NUTTX
 #define LOG_DIR_LEN 64
+#define LOG_STAGING_LEN 2048	// messages are collected in a buffer of this size before they go to the writer
 #else
 #define LOG_DIR_LEN 256
+#define LOG_STAGING_LEN 8192
 #endif
 
+#define ENCODING_KEYFRAME_INTERVAL 50	// an encoded instance logs a sample without delta at least every N samples
+
+#define SYNC_INTERVAL 1000*1000	// interval in microseconds at which a SYNC message is logged
+
 namespace px4
 {
 namespace logger
@@ -61,20 +69,37 @@ namespace logger
 struct LoggerSubscription {
 	int fd[ORB_MULTI_MAX_INSTANCES];
 	uint16_t msg_ids[ORB_MULTI_MAX_INSTANCES];
-	uint64_t time_tried_subscribe;	// captures the time at which we checked last time if this instance existed
+	/* time at which an instance is looked at next: the next subscription attempt if it does not
+	 * exist yet, otherwise the end of the logging interval (0 to check on every cycle) */
+	hrt_abstime next_due[ORB_MULTI_MAX_INSTANCES];
+	uint32_t interval = 0;		// minimum time between two logged messages of an instance [us]
 	const orb_metadata *metadata = nullptr;
 
+	/* payload encoding: 0 or ULOG_ENCODING_* flags */
+	uint8_t encoding = 0;
+	ULogDeltaReference delta[ORB_MULTI_MAX_INSTANCES];	// previous sample of each instance (for delta encoding)
+
+	/* encoding statistics, summed over all instances */
+	uint64_t raw_bytes = 0;		// bytes the messages would have taken as DATA messages
+	uint64_t encoded_bytes = 0;	// bytes actually logged
+	uint64_t encode_time = 0;	// time spent encoding [us]
+	uint32_t encoded_msgs = 0;
+
 	LoggerSubscription() {}
 
 	LoggerSubscription(int fd_, const orb_metadata *metadata_) :
 		metadata(metadata_)
 	{
 		fd[0] = fd_;
-		time_tried_subscribe = 0;
 
 		for (int i = 1; i < ORB_MULTI_MAX_INSTANCES; i++) {
 			fd[i] = -1;
 		}
+
+		for (int i = 0; i < ORB_MULTI_MAX_INSTANCES; i++) {
+			next_due[i] = 0;
+			delta[i].init();
+		}
 	}
 };
 
@@ -98,9 +123,10 @@ public:
 	 * (because it does not write an ADD_LOGGED_MSG message).
 	 * @param name topic name
 	 * @param interval limit rate if >0, otherwise log as fast as the topic is updated.
+	 * @param encoding ULOG_ENCODING_* flags for the data, -1 for the default (SDLOG_ENCODE)
 	 * @return 0 on success
 	 */
-	int add_topic(const char *name, unsigned interval);
+	int add_topic(const char *name, unsigned interval, int encoding);
 
 	/**
 	 * add a logged topic (called by add_topic() above)
@@ -114,6 +140,11 @@ public:
 	void status();
 	void print_statistics();
 
+	/**
+	 * print compression ratio and encoding cost of each encoded topic
+	 */
+	void print_encoding_statistics();
+
 	void set_arm_override(bool override) { _arm_override = override; }
 
 private:
@@ -132,6 +163,12 @@ private:
 	 */
 	void write_add_logged_msg(LoggerSubscription &subscription, int instance);
 
+	/**
+	 * Fill an ADD_LOGGED_MSG for a given subscription and instance, assigning the next message id.
+	 * @return message size
+	 */
+	size_t get_add_logged_msg(LoggerSubscription &subscription, int instance, ulog_message_add_logged_s &msg);
+
 	/**
 	 * Create logging directory
 	 * @param tt if not null, use it for the directory name
@@ -161,18 +198,111 @@ private:
 	 */
 	void write_header();
 
+	static void get_file_header(ulog_file_header_s &header);
+
 	void write_formats();
 
+	/**
+	 * Fill a FORMAT message for a topic
+	 * @return message size
+	 */
+	static size_t get_format_msg(const orb_metadata *meta, ulog_message_format_s &msg);
+
+	/**
+	 * write all version info messages
+	 */
 	void write_version();
 
+	/**
+	 * write the info messages that can change from one log to the next
+	 */
+	void write_log_info();
+
 	void write_info(const char *name, const char *value);
 	void write_info(const char *name, int32_t value);
 
+	/**
+	 * Fill a string INFO message
+	 * @param buffer of sizeof(ulog_message_info_header_s) bytes
+	 * @return message size, 0 if the value does not fit
+	 */
+	static size_t get_info_msg(const char *name, const char *value, uint8_t *buffer);
+
 	void write_parameters();
 
+	/**
+	 * Fill a PARAMETER message
+	 * @param buffer of sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u) bytes
+	 * @return message size, 0 if the parameter type is not logged
+	 */
+	static size_t get_parameter_msg(param_t param, uint8_t *buffer);
+
+	/**
+	 * Serialize the file header, the version info, all formats and all used parameters into
+	 * _header_cache, so that starting a log is a single write of the cache.
+	 * @return true on success, false if the cache could not be allocated
+	 */
+	bool build_header_cache();
+
+	/**
+	 * Update the timestamp and the parameter values in _header_cache. Rebuilds it if
+	 * parameters were added meanwhile.
+	 * @return true if the cache can be used
+	 */
+	bool update_header_cache();
+
+	/**
+	 * Serialize the static part of the header (only count if dst is null)
+	 * @return size in bytes
+	 */
+	size_t get_static_header(uint8_t *dst);
+
+	/**
+	 * Serialize all used parameters (only count if dst is null)
+	 * @param num_params set to the number of serialized parameters
+	 * @return size in bytes
+	 */
+	size_t get_parameters(uint8_t *dst, int &num_params);
+
+	/**
+	 * @return number of parameters that get_parameters() serializes
+	 */
+	static int count_parameters();
+
 	void write_changed_parameters();
 
-	bool copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, void *buffer);
+	/**
+	 * Stage the latest message of an instance if it was updated and is due. Subscribes to
+	 * the instance first if it was published meanwhile (staging its ADD_LOGGED_MSG).
+	 * @return true if a message was staged
+	 */
+	bool copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, hrt_abstime now);
+
+	/**
+	 * Encode a staged DATA message in place, if the encoded message is smaller. Updates the
+	 * previous sample of the instance either way.
+	 * @param buffer staged DATA message, with a payload of o_size_no_padding bytes
+	 * @return size of the message in buffer
+	 */
+	size_t encode(LoggerSubscription &sub, int multi_instance, uint8_t *buffer);
+
+	/**
+	 * Get the ULOG_ENCODING_* flags for an encoding name (raw, lz or delta)
+	 * @return flags, -1 if unknown
+	 */
+	static int encoding_from_name(const char *name);
+
+	/**
+	 * Reserve size bytes at the end of the staging buffer, flushing it first if they do not fit.
+	 * @param required the message must not be dropped on a write buffer overflow
+	 */
+	uint8_t *stage(size_t size, bool required = false);
+
+	/**
+	 * Append the staged messages to the write buffer, in one short critical section.
+	 * @return true if data was written
+	 */
+	bool flush_staged();
 
 	/**
 	 * Write data to the logger. Waits if buffer is full until all data is written.
@@ -213,8 +343,23 @@ private:
 	static constexpr const char 	*LOG_ROOT = PX4_ROOTFSDIR"/fs/microsd/log";
 #endif
 
-	uint8_t						*_msg_buffer = nullptr;
+	uint8_t						*_msg_buffer = nullptr; ///< staging buffer, holds complete messages
 	int						_msg_buffer_len = 0;
+	size_t						_staged = 0; ///< bytes used in _msg_buffer
+	bool						_staged_required = false; ///< _msg_buffer holds a message that must not be dropped
+	bool						_data_written = false; ///< data was flushed in the current cycle
+	uint8_t						*_encode_buffer = nullptr; ///< delta and compressed payload, 2 x max payload size
+	ULogCompressor					*_compressor = nullptr;
+	int32_t						_default_encoding = 0; ///< ULOG_ENCODING_* flags for topics without explicit encoding
+	uint16_t					_encoding_generation = 0; ///< changes whenever logged data was lost: forces keyframes
+	perf_counter_t					_perf_stage; ///< time the logger thread spends per cycle
+	perf_counter_t					_perf_flush; ///< time the writer lock is held for staged data
+	perf_counter_t					_perf_header; ///< start_log() until the header is queued
+	uint8_t						*_header_cache = nullptr; ///< file header, version info, formats and parameters
+	size_t						_header_cache_size = 0;
+	size_t						_header_static_size = 0; ///< part of _header_cache before the parameters
+	int						_header_num_params = 0; ///< parameters in _header_cache
+	hrt_abstime					_header_build_time = 0; ///< time to build _header_cache [us]
 	bool						_task_should_exit = true;
 	char 						_log_dir[LOG_DIR_LEN];
 	bool						_has_log_dir = false;
@@ -225,6 +370,7 @@ private:
 
 	// statistics
 	hrt_abstime					_start_time; ///< Time when logging started (not the logger thread)
+	hrt_abstime					_next_sync = 0; ///< time at which the next SYNC message is logged
 	hrt_abstime					_dropout_start = 0; ///< start of current dropout (0 = no dropout)
 	float						_max_dropout_duration = 0.f; ///< max duration of dropout [s]
 	size_t						_write_dropouts = 0; ///< failed buffer writes due to buffer overflow
@@ -43,8 +43,13 @@ enum class ULogMessageType : uint8_t {
 	SYNC = 'S',
 	DROPOUT = 'O',
 	LOGGING = 'L',
+	ENCODED_DATA = 'E',
 };
 
+/** flags of ulog_message_encoded_data_header_s::encoding, applied to the payload in this order */
+#define ULOG_ENCODING_DELTA	0x01	///< XOR against the previous sample with the same msg_id
+#define ULOG_ENCODING_LZ	0x02	///< LZ block compression (see encoding.h)
+
 
 /* declare message data structs with byte alignment (no padding) */
 #pragma pack(push, 1)
@@ -84,11 +89,15 @@ struct ulog_message_remove_logged_s {
 	uint16_t msg_id;
 };
 
+/**
+ * sync message, written periodically: readers can resynchronize after corrupt data, or
+ * split the data section at the sync points to decode it in parallel
+ */
 struct ulog_message_sync_s {
-	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
+	uint16_t msg_size = sizeof(sync_magic); //size of message - ULOG_MSG_HEADER_LEN
 	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::SYNC);
 
-	uint8_t sync_magic[8];
+	uint8_t sync_magic[8] = {0x2F, 0x73, 0x13, 0x20, 0x25, 0x0C, 0xBB, 0x12};
 };
 
 struct ulog_message_dropout_s {
@@ -105,6 +114,19 @@ struct ulog_message_data_header_s {
 	uint16_t msg_id;
 };
 
+/**
+ * data message with an encoded payload. The decoded payload is the same as the one of a DATA message.
+ * Every DATA or ENCODED_DATA message sets the previous sample of its msg_id for the next delta.
+ */
+struct ulog_message_encoded_data_header_s {
+	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
+	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::ENCODED_DATA);
+
+	uint16_t msg_id;
+	uint8_t encoding; //ULOG_ENCODING_* flags
+	uint16_t decoded_size;
+};
+
 struct ulog_message_info_header_s {
 	uint16_t msg_size; //size of message - ULOG_MSG_HEADER_LEN
 	uint8_t msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
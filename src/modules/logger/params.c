@@ -48,3 +48,35 @@
  * @group SD Logging
  */
 PARAM_DEFINE_INT32(SDLOG_UTC_OFFSET, 0);
+
+/**
+ * Logged data encoding
+ *
+ * Default encoding of the logged topics. It can be set per topic in
+ * etc/logging/logger_topics.txt (TOPIC_NAME, interval, raw|lz|delta).
+ * Encoded data is written as ENCODED_DATA messages, which need a reader that
+ * supports them (replay, Tools/ulog_decode.py).
+ *
+ * @value 0 Raw
+ * @value 1 Compressed
+ * @value 2 Delta and compressed
+ * @min 0
+ * @max 2
+ * @reboot_required true
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_ENCODE, 0);
+
+/**
+ * Cache the log header
+ *
+ * Serialize the version info, all message formats and the parameters once at
+ * logger start and keep them in RAM (about 30 KB), so that starting a log is
+ * a single write of the cached header. If disabled, the header is serialized
+ * into the write buffer message by message at every log start.
+ *
+ * @boolean
+ * @reboot_required true
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_HDR_CACHE, 1);
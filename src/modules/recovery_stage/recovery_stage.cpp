@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 #include <lib/mathlib/mathlib.h>
 #include <uORB/uORB.h>
 #include <uORB/topics/sensor_accel.h>
@@ -36,6 +37,12 @@
 
 #include <uORB/topics/parameter_update.h>
 
+#include <systemlib/param/param.h>
+
+#include <lib/impact_recovery/Reactor.hpp>
+#include <lib/impact_recovery/ChangePublication.hpp>
+#include <lib/impact_recovery/RecoveryStageMachine.hpp>
+
 static bool thread_should_exit = false;		/**< daemon exit flag */
 static bool thread_running = false;			/**< daemon status flag */
 static int daemon_task;						/**< Handle of daemon task / thread */
@@ -44,6 +51,33 @@ extern "C" __EXPORT int recovery_stage_main(int argc, char *argv[]);
 
 int recovery_stage_thread_main(int argc, char *argv[]);
 
+class RecoveryStage
+{
+public:
+	RecoveryStage();
+
+	void run();
+	void print_status() { _reactor.print_status(); }
+
+private:
+	static void accel_callback(void *context) { static_cast<RecoveryStage *>(context)->on_accel(); }
+	void on_accel();
+
+	impact_recovery::Reactor _reactor;
+	impact_recovery::ChangePublication<impact_recovery_stage_s> _recovery_stage_pub;
+	impact_recovery::RecoveryStageMachine _stage_machine;
+
+	// local copies, refreshed by the reactor
+	struct sensor_accel_s            		_sensor_accel;
+	struct control_state_s					  _ctrl_state;
+	struct impact_detection_s				   _detection;
+	struct impact_characterization_s 	_characterization;
+	struct recovery_control_s           _recovery_control;
+};
+
+static RecoveryStage *g_recovery_stage = nullptr;
+static pthread_mutex_t g_instance_mutex = PTHREAD_MUTEX_INITIALIZER; /**< held by status while it uses the instance, and while the task deletes it */
+
 static void usage(const char *reason){
 	if (reason) {
 		warnx("%s\n", reason);
@@ -83,6 +117,14 @@ int recovery_stage_main(int argc, char *argv[]){
 		if (thread_running) {
 			PX4_INFO("\trunning\n");
 
+			pthread_mutex_lock(&g_instance_mutex);
+
+			if (g_recovery_stage != nullptr) {
+				g_recovery_stage->print_status();
+			}
+
+			pthread_mutex_unlock(&g_instance_mutex);
+
 		} else {
 			PX4_INFO("\tnot started\n");
 		}
@@ -93,135 +135,72 @@ int recovery_stage_main(int argc, char *argv[]){
 	return 1;
 }
 
-int recovery_stage_thread_main(int argc, char *argv[])
+RecoveryStage::RecoveryStage() :
+	_reactor("recovery_stage"),
+	_recovery_stage_pub(ORB_ID(impact_recovery_stage), 0)
 {
-
-	PX4_INFO("recovery_stage starting\n");
-
-	thread_running = true;
-	bool switchStage[2] = {0, 0};
-
-	// set up subscribers
-	int _sensor_accel_sub = orb_subscribe(ORB_ID(sensor_accel));
-	int _ctrl_state_sub = orb_subscribe(ORB_ID(control_state));
-	int _detection_sub = orb_subscribe(ORB_ID(impact_detection));
-	int _characterization_sub = orb_subscribe(ORB_ID(impact_characterization));
-	int _recovery_control_sub = orb_subscribe(ORB_ID(recovery_control));	
-
-	// declare local copies
-	struct sensor_accel_s            		_sensor_accel;
-	struct control_state_s					  _ctrl_state;
-	struct impact_detection_s				   _detection;
-	struct impact_characterization_s 	_characterization;
-	struct impact_recovery_stage_s		  _recovery_stage;
-	struct recovery_control_s           _recovery_control;	
-
 	// set them to zero initially
-	memset(&_sensor_accel, 0, sizeof(_sensor_accel));	
+	memset(&_sensor_accel, 0, sizeof(_sensor_accel));
 	memset(&_ctrl_state, 0, sizeof(_ctrl_state));
 	memset(&_detection, 0, sizeof(_detection));
 	memset(&_characterization, 0, sizeof(_characterization));
-	memset(&_recovery_stage, 0, sizeof(_recovery_stage));
-	memset(&_recovery_control, 0, sizeof(_recovery_control));	
+	memset(&_recovery_control, 0, sizeof(_recovery_control));
+
+	int32_t heartbeat_ms = 0;
+	param_get(param_find("IMP_PUB_HB"), &heartbeat_ms);
+	_recovery_stage_pub.set_heartbeat((hrt_abstime)heartbeat_ms * 1000);
+
+	// the stage machine steps once per accel sample, the other topics only refresh state
+	_reactor.add_topic(ORB_ID(sensor_accel), &_sensor_accel, &RecoveryStage::accel_callback, this);
+	_reactor.add_topic(ORB_ID(control_state), &_ctrl_state);
+	_reactor.add_topic(ORB_ID(impact_detection), &_detection);
+	_reactor.add_topic(ORB_ID(impact_characterization), &_characterization);
+	_reactor.add_topic(ORB_ID(recovery_control), &_recovery_control);
+}
 
-	// declare update flags
-	bool updated_sensor_accel;
-	bool updated_ctrl_state;
-	bool updated_detection;
-	bool updated_characterization;
-	bool updated_recovery_control;	
+void RecoveryStage::run()
+{
+	// advertise the initial state so subscribers find the topic
+	_recovery_stage_pub.update(_stage_machine.get(), hrt_absolute_time());
 
-	int RS1counter = 0;
+	while (!thread_should_exit) {
+		_reactor.spin_once(100);
+	}
+}
 
-	orb_advert_t _recovery_stage_pub = orb_advertise(ORB_ID(impact_recovery_stage), &_recovery_stage);
+void RecoveryStage::on_accel()
+{
+	const impact_recovery_stage_s &recovery_stage = _stage_machine.update(_ctrl_state, _detection, _characterization,
+			_recovery_control);
 
-	struct pollfd fds[1];
-	fds[0].fd = _sensor_accel_sub;
-	fds[0].events = POLLIN;
+	if (_recovery_stage_pub.update(recovery_stage, hrt_absolute_time())) {
+		_reactor.record_latency(_sensor_accel.timestamp);
+	}
+}
 
-    while(!thread_should_exit){  
+int recovery_stage_thread_main(int argc, char *argv[])
+{
 
-		int ret = px4_poll(&fds[0], (sizeof(fds) / sizeof(fds[0])), 100);
-		if (ret == 0) {
-			continue;
-		}
+	PX4_INFO("recovery_stage starting\n");
 
-		if (fds[0].revents & POLLIN) {
-	    	// poll for subscription updates
-			orb_check(_sensor_accel_sub, &updated_sensor_accel);
-			orb_check(_ctrl_state_sub, &updated_ctrl_state);
-			orb_check(_detection_sub, &updated_detection);
-			orb_check(_characterization_sub, &updated_characterization);
-			orb_check(_recovery_control_sub, &updated_recovery_control);	
-
-			// make local copies of uORB topics
-			if(updated_sensor_accel){
-				orb_copy(ORB_ID(sensor_accel), _sensor_accel_sub, &_sensor_accel);
-			}
-			if(updated_ctrl_state){
-				orb_copy(ORB_ID(control_state), _ctrl_state_sub, &_ctrl_state);
-			}
-			if(updated_detection){
-				orb_copy(ORB_ID(impact_detection), _detection_sub, &_detection);
-			}
-			if(updated_characterization){
-				orb_copy(ORB_ID(impact_characterization), _characterization_sub, &_characterization);
-			}
-			if(updated_recovery_control){		
-				orb_copy(ORB_ID(recovery_control), _recovery_control_sub, &_recovery_control);		
-			}
+	g_recovery_stage = new RecoveryStage();
 
-			if(_characterization.accelRefIsComputed && _recovery_stage.recoveryIsReset == false){
-
-				if (_recovery_stage.recoveryStage == 1){
-					if (fabs(_recovery_control.quatError[1]) < 0.17 && fabs(_recovery_control.quatError[2]) < 0.17 && fabs(_ctrl_state.roll_rate) < 1.0 && fabs(_ctrl_state.pitch_rate) < 1.0){
-						RS1counter += 1; 
-					}
-					if(RS1counter >= 3){
-						switchStage[0] = true;
-						RS1counter = 0;
-					}
-		            if (switchStage[0]) {
-	            		_recovery_stage.recoveryStage = 2;
-		            }
-		        } 
-		        else if (_recovery_stage.recoveryStage == 2){
-					math::Quaternion q_att(_ctrl_state.q[0], _ctrl_state.q[1], _ctrl_state.q[2], _ctrl_state.q[3]);
-					math::Vector<3> angles = q_att.to_euler();
-					double RP_SWITCH = 0.2;
-					double RATES_SWITCH = 1.0;
-					float roll = angles(0);
-					float pitch = angles(1);
-					float roll_rate = _ctrl_state.roll_rate;
-					float pitch_rate = _ctrl_state.pitch_rate;
-					switchStage[1] = fabs(roll) < RP_SWITCH && fabs(pitch) < RP_SWITCH && \
-						         fabs(roll_rate) < RATES_SWITCH  && fabs(pitch_rate) < RATES_SWITCH;
-		            if (switchStage[1]) {
-						_recovery_stage.recoveryIsReset = true;
-						_recovery_stage.recoveryStage = 0;	
-						switchStage[0] = false;
-						switchStage[1] = false;
-					}	            		
-		        }
-		        else{
-					_recovery_stage.recoveryStage = 1; // executes upon opening this loop
-		        }
-		    }
-			
-			if (_characterization.accelRefIsComputed == false && _detection.inRecovery == false &&_recovery_stage.recoveryIsReset == true){
-				_recovery_stage.recoveryIsReset = false;
-			}
+	if (g_recovery_stage == nullptr) {
+		PX4_ERR("alloc failed");
+		return 1;
+	}
 
-        	orb_publish(ORB_ID(impact_recovery_stage), _recovery_stage_pub, &_recovery_stage);
-    	}
-    }
+	thread_running = true;
+
+	g_recovery_stage->run();
 
 	PX4_INFO("recovery_stage exiting.\n");
 	thread_running = false;
 
+	pthread_mutex_lock(&g_instance_mutex);
+	delete g_recovery_stage;
+	g_recovery_stage = nullptr;
+	pthread_mutex_unlock(&g_instance_mutex);
+
     return OK;
 }
-
-
-
-
@@ -39,6 +39,8 @@ namespace replay
 {
 
 static const char *ENV_FILENAME = "replay"; ///< name for getenv()
+static const char *ENV_MODE = "replay_mode"; ///< name for getenv(), "impact" selects the impact recovery harness, "lockstep" the as fast as possible replay
+static const char *ENV_START = "replay_start"; ///< name for getenv(), time into the log to start the replay at [s]
 
 
 } //namespace replay
@@ -40,6 +40,9 @@
 #include <string>
 
 #include "definitions.hpp"
+#include "ulog_index.hpp"
+
+#include <logger/messages.h>
 
 #include <uORB/uORBTopics.h>
 
@@ -49,9 +52,9 @@ namespace px4
 /**
  * @class Replay
  * Parses an ULog file and replays it in 'real-time'. The timestamp of each replayed message is offset
- * to match the starting time of replay. It keeps a stream for each subscription to find the next message
- * to replay. This is necessary because data messages from different subscriptions don't need to be in
- * monotonic increasing order.
+ * to match the starting time of replay. The file is memory mapped and indexed once (see ULogIndex),
+ * because data messages from different subscriptions don't need to be in monotonic increasing order.
+ * The index is cached next to the log file (<log>.idx).
  */
 class Replay
 {
@@ -59,7 +62,7 @@ public:
 	Replay();
 
 	/// Destructor, also waits for task exit
-	~Replay();
+	virtual ~Replay();
 
 	/// Start task.
 	/// @param quiet silently fail if no log file found
@@ -80,16 +83,15 @@ public:
 	static void setupReplayFile(const char *file_name);
 
 	static bool isSetup() { return _replay_file; }
-private:
-	bool _task_should_exit = false;
-	std::set<std::string> _overridden_params;
-	std::map<std::string, std::string> _file_formats; ///< all formats we read from the file
 
-	uint64_t _file_start_time;
-	uint64_t _replay_start_time;
-	std::streampos _data_section_start; ///< first ADD_LOGGED_MSG message
-	std::vector<uint8_t> _read_buffer;
+	/**
+	 * Index and decode the replay file without publishing, and print the throughput
+	 * @param iterations number of passes over the data
+	 * @return 0 on success
+	 */
+	static int benchmark(int iterations);
 
+protected:
 	struct Subscription {
 
 		const orb_metadata *orb_meta = nullptr; ///< if nullptr, this subscription is invalid
@@ -97,53 +99,111 @@ private:
 		uint8_t multi_id;
 		int timestamp_offset; ///< marks the field of the timestamp
 
-		std::streampos next_read_pos;
-		uint64_t next_timestamp; ///< timestamp of the file
+		/** last decoded payload, also the previous sample for delta decoding */
+		std::vector<uint8_t> next_data;
+		bool next_data_valid = false; ///< next_data holds a decoded sample
 	};
-	std::vector<Subscription> _subscriptions;
 
-	/** keep track of file position to avoid adding a subscription multiple times. */
-	std::streampos _subscription_file_pos = 0;
+	/**
+	 * called when entering the main replay loop, after the first subscription was added
+	 */
+	virtual void onEnterMainLoop() {}
+
+	/**
+	 * called when exiting the main replay loop (also when the task is stopped)
+	 */
+	virtual void onExitMainLoop() {}
+
+	/**
+	 * Wait until the next message is due.
+	 * @param next_file_time timestamp of the next message in the file
+	 * @param timestamp_offset offset from file time to replay time
+	 * @return timestamp the message is published with
+	 */
+	virtual uint64_t handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset);
 
-	bool readFileHeader(std::ifstream &file);
+	/**
+	 * Handle a message read from the file, its timestamp is already set to the replay time.
+	 * The default publishes it.
+	 * @return true if the message was published
+	 */
+	virtual bool handleTopicUpdate(Subscription &sub, void *data);
+
+	/**
+	 * Publish a message, advertising the topic (or the correct multi-instance) if needed.
+	 * @return true if the message was published
+	 */
+	bool publishTopic(Subscription &sub, void *data);
+
+	uint64_t _file_start_time;
+	uint64_t _replay_start_time;
+
+private:
+	bool _task_should_exit = false;
+	std::set<std::string> _overridden_params;
+	std::map<std::string, std::string> _file_formats; ///< all formats we read from the file
+
+	ULogIndex _index;
+	size_t _data_section_start; ///< first ADD_LOGGED_MSG message
+	std::vector<uint8_t> _read_buffer;
+	std::vector<uint8_t> _encoded_buffer; ///< decompressed payload of an ENCODED_DATA message
+
+	std::vector<Subscription> _subscriptions;
+
+	bool readFileHeader();
 
 	/**
 	 * Read definitions section: check formats, apply parameters and store
 	 * the start of the data section.
 	 * @return true on success
 	 */
-	bool readFileDefinitions(std::ifstream &file);
+	bool readFileDefinitions();
+
+	///file parsing methods. They take the message body (after the header) and
+	///return false, when further parsing should be aborted.
+	bool readFormat(const uint8_t *message, uint16_t msg_size);
+	bool readAndAddSubscription(const uint8_t *message, uint16_t msg_size);
 
-	///file parsing methods. They return false, when further parsing should be aborted.
-	bool readFormat(std::ifstream &file, uint16_t msg_size);
-	bool readAndAddSubscription(std::ifstream &file, uint16_t msg_size);
+	/**
+	 * Map the replay file, read the file header and definitions sections. Apply the parameters
+	 * from this section and apply user-defined overridden parameters.
+	 * @return true on success
+	 */
+	bool readDefinitionsAndApplyParams();
 
 	/**
-	 * Read the file header and definitions sections. Apply the parameters from this section
-	 * and apply user-defined overridden parameters.
+	 * Load the index from the sidecar file, or build it in one pass over the data section
+	 * (and try to store it).
 	 * @return true on success
 	 */
-	bool readDefinitionsAndApplyParams(std::ifstream &file);
+	bool loadOrBuildIndex();
+	bool buildIndex();
+
+	/**
+	 * Handle an event message (subscription, parameter or dropout) at a file offset
+	 */
+	void handleEvent(uint64_t offset);
+	bool readDropout(const uint8_t *message, uint16_t msg_size);
+	bool readAndApplyParameter(const uint8_t *message, uint16_t msg_size);
+
+	/**
+	 * Decode the payload of a DATA or ENCODED_DATA message into subscription.next_data.
+	 * Messages of a subscription must be decoded in file order.
+	 * @param message message header
+	 * @return false if the message is invalid for this subscription
+	 */
+	bool readDataPayload(const uint8_t *message, Subscription &subscription);
 
 	/**
-	 * Read and handle additional messages starting at current file position, while position < end_position.
-	 * This handles dropout and parameter update messages.
-	 * We need to handle these separately, because they have no timestamp. We look at the file position instead.
-	 * @return false on file error
+	 * timestamp of the decoded message of a subscription
 	 */
-	bool readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position);
-	bool readDropout(std::ifstream &file, uint16_t msg_size);
-	bool readAndApplyParameter(std::ifstream &file, uint16_t msg_size);
+	static uint64_t dataTimestamp(const Subscription &subscription);
 
 	/**
-	 * Find next data message for this subscription, starting with the stored file offset.
-	 * Skip the first message, and if found, read the timestamp and store the new file offset.
-	 * This also takes care of new subscriptions and parameter updates. When reaching EOF,
-	 * the subscription is set to invalid.
-	 * File seek position is arbitrary after this call.
-	 * @return false on file error
+	 * pass over the index, decoding every message (for benchmark())
+	 * @return number of decoded messages
 	 */
-	bool nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id);
+	size_t decodeAll();
 
 	static const orb_metadata *findTopic(const std::string &name);
 	/** get the array size from a type. eg. float[3] -> return float */
@@ -0,0 +1,249 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file replay_impact_recovery.cpp
+ *
+ * @author Fiona Chui<fiona.m.chui@gmail.com>
+ */
+
+#include "replay_impact_recovery.hpp"
+
+#include <px4_defines.h>
+#include <px4_log.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <drivers/drv_hrt.h>
+#include <mathlib/mathlib.h>
+
+#define IMPACT_REPORT_FILE PX4_ROOTFSDIR "/impact_report.csv"
+
+namespace px4
+{
+
+ReplayImpactRecovery::ReplayImpactRecovery() :
+	_detection_pub(ORB_ID(impact_detection), 0),
+	_characterization_pub(ORB_ID(impact_characterization), 0),
+	_recovery_stage_pub(ORB_ID(impact_recovery_stage), 0)
+{
+	_step_perf = perf_alloc(PC_ELAPSED, "replay_impact: pipeline step");
+}
+
+ReplayImpactRecovery::~ReplayImpactRecovery()
+{
+	perf_free(_step_perf);
+}
+
+void ReplayImpactRecovery::onEnterMainLoop()
+{
+	_characterizer_ready = _characterizer.init();
+}
+
+uint64_t ReplayImpactRecovery::handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset)
+{
+	// the pipeline is stepped in-process, no need to wait for anyone
+	return next_file_time + timestamp_offset;
+}
+
+bool ReplayImpactRecovery::handleTopicUpdate(Subscription &sub, void *data)
+{
+	// the logged outputs are only used for comparison, the replayed ones are published instead
+	if (sub.orb_meta == ORB_ID(impact_detection)) {
+		bool in_recovery = ((impact_detection_s *)data)->inRecovery;
+
+		if (in_recovery && !_recorded_in_recovery) {
+			++_recorded_impacts;
+		}
+
+		_recorded_in_recovery = in_recovery;
+		return false;
+
+	} else if (sub.orb_meta == ORB_ID(impact_characterization) || sub.orb_meta == ORB_ID(impact_recovery_stage)) {
+		return false;
+	}
+
+	bool published = publishTopic(sub, data);
+
+	if (sub.multi_id != 0) {
+		return published;
+	}
+
+	if (sub.orb_meta == ORB_ID(sensor_gyro)) {
+		memcpy(&_sensor_gyro, data, sizeof(_sensor_gyro));
+
+	} else if (sub.orb_meta == ORB_ID(control_state)) {
+		memcpy(&_ctrl_state, data, sizeof(_ctrl_state));
+
+	} else if (sub.orb_meta == ORB_ID(actuator_armed)) {
+		memcpy(&_armed, data, sizeof(_armed));
+
+	} else if (sub.orb_meta == ORB_ID(recovery_control)) {
+		memcpy(&_recovery_control, data, sizeof(_recovery_control));
+
+	} else if (sub.orb_meta == ORB_ID(sensor_accel)) {
+		memcpy(&_sensor_accel, data, sizeof(_sensor_accel));
+
+		if (_characterizer_ready) {
+			step();
+		}
+	}
+
+	return published;
+}
+
+void ReplayImpactRecovery::step()
+{
+	const uint64_t log_time = _sensor_accel.timestamp - _replay_start_time;
+
+	// track the onset of the spike the same way the detector sees it
+	math::Vector<3> accel(_sensor_accel.x, _sensor_accel.y, _sensor_accel.z);
+	math::Quaternion q_att(_ctrl_state.q[0], _ctrl_state.q[1], _ctrl_state.q[2], _ctrl_state.q[3]);
+	math::Vector<3> accel_world = q_att.to_dcm() * accel;
+	math::Vector<2> accel_horizontal(accel_world(0), accel_world(1));
+
+	if (accel_horizontal.length() <= 9.81f) {
+		_spike_onset = 0;
+
+	} else if (_spike_onset == 0) {
+		_spike_onset = log_time;
+	}
+
+	const impact_recovery_stage_s previous_stage = _stage_machine.get();
+
+	hrt_abstime t0 = hrt_absolute_time();
+	const impact_detection_s &detection = _detector.update(_sensor_accel, _ctrl_state, previous_stage, _armed);
+	hrt_abstime t1 = hrt_absolute_time();
+	const impact_characterization_s &characterization = _characterizer.update(_sensor_accel, _sensor_gyro, _ctrl_state,
+			detection, previous_stage);
+	hrt_abstime t2 = hrt_absolute_time();
+	const impact_recovery_stage_s &recovery_stage = _stage_machine.update(_ctrl_state, detection, characterization,
+			_recovery_control);
+	perf_set_elapsed(_step_perf, hrt_absolute_time() - t0);
+
+	_recovery_stage_pub.update(recovery_stage, _sensor_accel.timestamp);
+	_characterization_pub.update(characterization, _sensor_accel.timestamp);
+	_detection_pub.update(detection, _sensor_accel.timestamp);
+
+	if (!_impact_open && detection.inRecovery) {
+		Impact impact = {};
+		impact.spike_onset = (_spike_onset != 0) ? _spike_onset : log_time;
+		impact.detected = log_time;
+		_impacts.push_back(impact);
+		_impact_open = true;
+	}
+
+	if (!_impact_open) {
+		return;
+	}
+
+	Impact &impact = _impacts.back();
+
+	if (impact.characterized == 0) {
+		impact.characterization_cpu += t2 - t1;
+		impact.characterization_samples++;
+
+		if (characterization.accelRefIsComputed) {
+			impact.characterized = log_time;
+			impact.fuzzy_output = characterization.fuzzyOutput;
+		}
+	}
+
+	if (recovery_stage.recoveryStage != previous_stage.recoveryStage && recovery_stage.recoveryStage <= 2) {
+		const int index = (recovery_stage.recoveryStage == 0) ? 2 : recovery_stage.recoveryStage - 1;
+
+		if (impact.stage_entered[index] == 0) {
+			impact.stage_entered[index] = log_time;
+		}
+	}
+
+	// the impact is over once the detector has seen the reset
+	if (!detection.inRecovery) {
+		_impact_open = false;
+	}
+}
+
+void ReplayImpactRecovery::onExitMainLoop()
+{
+	if (!_characterizer_ready) {
+		PX4_ERR("impact characterization failed to initialize, no report");
+		return;
+	}
+
+	writeReport();
+}
+
+void ReplayImpactRecovery::writeReport()
+{
+	PX4_INFO("impact recovery replay: %u impacts detected (log recorded %i)", (unsigned)_impacts.size(),
+		 _recorded_impacts);
+	perf_print_counter(_step_perf);
+
+	FILE *report = fopen(IMPACT_REPORT_FILE, "w");
+
+	if (report) {
+		fprintf(report, "impact,spike_onset_s,detected_s,detection_delay_ms,characterized_s,characterization_ms,"
+			"characterization_samples,characterization_cpu_us,fuzzy_output,stage1_s,stage2_s,stage0_s\n");
+
+	} else {
+		PX4_ERR("failed to open %s", IMPACT_REPORT_FILE);
+	}
+
+	for (size_t i = 0; i < _impacts.size(); ++i) {
+		const Impact &impact = _impacts[i];
+		const double detection_delay_ms = (impact.detected - impact.spike_onset) / 1e3;
+		const double characterization_ms = impact.characterized ? (impact.characterized - impact.detected) / 1e3 : -1.0;
+
+		PX4_INFO("#%u detected %.3f s, delay %.1f ms, characterized in %.1f ms (%i samples, %u us cpu), output %.3f",
+			 (unsigned)i, impact.detected / 1e6, detection_delay_ms, characterization_ms,
+			 impact.characterization_samples, (unsigned)impact.characterization_cpu, (double)impact.fuzzy_output);
+		PX4_INFO("   stage 1 %.3f s, stage 2 %.3f s, stage 0 %.3f s", impact.stage_entered[0] / 1e6,
+			 impact.stage_entered[1] / 1e6, impact.stage_entered[2] / 1e6);
+
+		if (report) {
+			fprintf(report, "%u,%.6f,%.6f,%.3f,%.6f,%.3f,%i,%u,%.6f,%.6f,%.6f,%.6f\n", (unsigned)i,
+				impact.spike_onset / 1e6, impact.detected / 1e6, detection_delay_ms, impact.characterized / 1e6,
+				characterization_ms, impact.characterization_samples, (unsigned)impact.characterization_cpu,
+				(double)impact.fuzzy_output, impact.stage_entered[0] / 1e6, impact.stage_entered[1] / 1e6,
+				impact.stage_entered[2] / 1e6);
+		}
+	}
+
+	if (report) {
+		fclose(report);
+		PX4_INFO("report written to %s", IMPACT_REPORT_FILE);
+	}
+}
+
+} //namespace px4
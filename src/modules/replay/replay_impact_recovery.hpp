@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+
+#include "replay.hpp"
+
+#include <systemlib/perf_counter.h>
+
+#include <uORB/topics/sensor_accel.h>
+#include <uORB/topics/sensor_gyro.h>
+#include <uORB/topics/control_state.h>
+#include <uORB/topics/actuator_armed.h>
+#include <uORB/topics/recovery_control.h>
+
+#include <lib/impact_recovery/ChangePublication.hpp>
+#include <lib/impact_recovery/ImpactDetector.hpp>
+#include <lib/impact_recovery/ImpactCharacterizer.hpp>
+#include <lib/impact_recovery/RecoveryStageMachine.hpp>
+
+namespace px4
+{
+
+/**
+ * @class ReplayImpactRecovery
+ * Replay mode for the impact recovery pipeline (replay_mode=impact). The logged
+ * inputs are fed to ImpactDetector, ImpactCharacterizer and RecoveryStageMachine
+ * in-process on every sensor_accel sample, as fast as the file can be read, and
+ * the replayed impact topics are published instead of the logged ones.
+ * At the end a per-impact report is printed and written to impact_report.csv.
+ *
+ * Do not run the impact recovery modules at the same time.
+ */
+class ReplayImpactRecovery : public Replay
+{
+public:
+	ReplayImpactRecovery();
+	virtual ~ReplayImpactRecovery();
+
+protected:
+	virtual void onEnterMainLoop();
+	virtual void onExitMainLoop();
+	virtual uint64_t handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset);
+	virtual bool handleTopicUpdate(Subscription &sub, void *data);
+
+private:
+	/** all times in us since the start of the log */
+	struct Impact {
+		uint64_t spike_onset;		///< first sample of the accel spike above 1 g
+		uint64_t detected;
+		uint64_t characterized;		///< 0 if the characterization did not complete
+		int characterization_samples;
+		uint32_t characterization_cpu;	///< time spent in ImpactCharacterizer while characterizing [us]
+		float fuzzy_output;
+		uint64_t stage_entered[3];	///< time stage 1, 2 and back to 0 was entered, 0 if never
+	};
+
+	void step();
+	void writeReport();
+
+	impact_recovery::ImpactDetector _detector;
+	impact_recovery::ImpactCharacterizer _characterizer;
+	impact_recovery::RecoveryStageMachine _stage_machine;
+	bool _characterizer_ready = false;
+
+	impact_recovery::ChangePublication<impact_detection_s> _detection_pub;
+	impact_recovery::ChangePublication<impact_characterization_s> _characterization_pub;
+	impact_recovery::ChangePublication<impact_recovery_stage_s> _recovery_stage_pub;
+
+	sensor_accel_s _sensor_accel = {};
+	sensor_gyro_s _sensor_gyro = {};
+	control_state_s _ctrl_state = {};
+	actuator_armed_s _armed = {};
+	recovery_control_s _recovery_control = {};
+
+	std::vector<Impact> _impacts;
+	bool _impact_open = false;
+	uint64_t _spike_onset = 0;
+	int _recorded_impacts = 0;
+	bool _recorded_in_recovery = false;
+
+	perf_counter_t _step_perf;
+};
+
+} //namespace px4
@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+
+/**
+ * @file replay_lockstep.cpp
+ */
+
+#include "replay_lockstep.hpp"
+
+#include <px4_defines.h>
+#include <px4_log.h>
+#include <px4_posix.h>
+
+#include <drivers/drv_hrt.h>
+
+namespace px4
+{
+
+void ReplayLockstep::onEnterMainLoop()
+{
+	px4_enable_poll_lockstep(true);
+	hrt_lockstep_enable();
+	_last_timestamp = hrt_absolute_time();
+	_wall_start = hrt_system_time();
+}
+
+void ReplayLockstep::onExitMainLoop()
+{
+	px4_enable_poll_lockstep(false);
+	hrt_lockstep_disable();
+
+	const double wall_time = (double)(hrt_system_time() - _wall_start) / 1.e6;
+	const double replay_time = (double)(_last_timestamp - _replay_start_time) / 1.e6;
+
+	PX4_INFO("Lockstep replay: %u msgs, %.3lf s of log in %.3lf s (%.1lfx real time)", _published,
+		 replay_time, wall_time, wall_time > 0. ? replay_time / wall_time : 0.);
+
+	if (_timeouts > 0) {
+		PX4_WARN("%u times the subscribers did not get idle within %i ms, the results may not be deterministic",
+			 _timeouts, WAIT_TIMEOUT_MS);
+	}
+}
+
+uint64_t ReplayLockstep::handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset)
+{
+	const uint64_t publish_timestamp = next_file_time + timestamp_offset;
+
+	if (publish_timestamp > _last_timestamp) {
+		// the tasks are idle, so this is the only thing that moves the time forward
+		hrt_lockstep_set_time(publish_timestamp);
+		_last_timestamp = publish_timestamp;
+	}
+
+	return publish_timestamp;
+}
+
+bool ReplayLockstep::handleTopicUpdate(Subscription &sub, void *data)
+{
+	if (!publishTopic(sub, data)) {
+		return false;
+	}
+
+	++_published;
+
+	if (!px4_poll_lockstep_wait_idle(WAIT_TIMEOUT_MS)) {
+		++_timeouts;
+	}
+
+	return true;
+}
+
+} //namespace px4
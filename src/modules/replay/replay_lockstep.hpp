@@ -0,0 +1,75 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+
+#pragma once
+
+#include "replay.hpp"
+
+namespace px4
+{
+
+/**
+ * @class ReplayLockstep
+ * Replay mode that runs as fast as possible (replay_mode=lockstep). The HRT is driven by
+ * the replay: hrt_absolute_time() returns the timestamp of the message being published,
+ * and after each publication the replay waits until all the tasks woken by it (and by what
+ * they published in turn, e.g. ekf2 -> mc_att_control) are back in px4_poll(), before it
+ * advances the time.
+ *
+ * The results are deterministic for tasks driven by topic updates. Tasks that run on
+ * usleep() or on poll timeouts still run in real time.
+ */
+class ReplayLockstep : public Replay
+{
+public:
+	ReplayLockstep() = default;
+	virtual ~ReplayLockstep() = default;
+
+protected:
+	virtual void onEnterMainLoop();
+	virtual void onExitMainLoop();
+	virtual uint64_t handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset);
+	virtual bool handleTopicUpdate(Subscription &sub, void *data);
+
+private:
+	static const int WAIT_TIMEOUT_MS = 500; ///< max wall time to wait for the subscribers of one message
+
+	uint64_t _wall_start = 0; ///< [us]
+	uint64_t _last_timestamp = 0;
+	uint32_t _published = 0;
+	uint32_t _timeouts = 0;
+};
+
+} //namespace px4
@@ -37,6 +37,19 @@
  * It sets the parameters from the log file and handles user-defined
  * parameter overrides.
  *
+ * The log file is memory mapped and indexed; the index is cached in <log>.idx.
+ * With the environment variable replay_start=<seconds>, the replay starts that far
+ * into the log. 'replay bench' measures the reader throughput.
+ *
+ * With the environment variable replay_mode=impact, the impact recovery
+ * pipeline is run on the replayed data as fast as possible and a per-impact
+ * report is generated, e.g.:
+ *   replay=/path/to/log.ulg replay_mode=impact make posix_sitl_default replay_impact
+ *
+ * With replay_mode=lockstep, the replay drives hrt_absolute_time() and publishes
+ * the next message as soon as the tasks that subscribe to the replayed topics
+ * are idle, so it runs as fast as they can process the data.
+ *
  * @author Beat Kueng
 */
 
@@ -58,8 +71,11 @@
 
 #include <logger/logger.h>
 #include <logger/messages.h>
+#include <logger/encoding.h>
 
 #include "replay.hpp"
+#include "replay_impact_recovery.hpp"
+#include "replay_lockstep.hpp"
 
 #define PARAMS_OVERRIDE_FILE PX4_ROOTFSDIR "/replay_params.txt"
 
@@ -159,16 +175,15 @@ void Replay::setUserParams(const char *filename)
 	}
 }
 
-bool Replay::readFileHeader(std::ifstream &file)
+bool Replay::readFileHeader()
 {
-	file.seekg(0);
-	ulog_file_header_s msg_header;
-	file.read((char *)&msg_header, sizeof(msg_header));
-
-	if (!file) {
+	if (_index.size() < sizeof(ulog_file_header_s)) {
 		return false;
 	}
 
+	ulog_file_header_s msg_header;
+	memcpy(&msg_header, _index.data(), sizeof(msg_header));
+
 	_file_start_time = msg_header.timestamp;
 	//verify it's an ULog file
 	char magic[8];
@@ -182,66 +197,62 @@ bool Replay::readFileHeader(std::ifstream &file)
 	return memcmp(magic, msg_header.magic, 7) == 0;
 }
 
-bool Replay::readFileDefinitions(std::ifstream &file)
+bool Replay::readFileDefinitions()
 {
 	PX4_INFO("Applying params from ULog file...");
 
 	ulog_message_header_s message_header;
-	file.seekg(sizeof(ulog_file_header_s));
+	size_t pos = sizeof(ulog_file_header_s);
 
 	while (true) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+		if (pos + ULOG_MSG_HEADER_LEN > _index.size()) {
+			return false;
+		}
 
-		if (!file) {
+		memcpy(&message_header, _index.data() + pos, ULOG_MSG_HEADER_LEN);
+		const uint8_t *message = _index.data() + pos + ULOG_MSG_HEADER_LEN;
+
+		if (pos + ULOG_MSG_HEADER_LEN + message_header.msg_size > _index.size()) {
 			return false;
 		}
 
 		switch (message_header.msg_type) {
 		case (int)ULogMessageType::FORMAT:
-			if (!readFormat(file, message_header.msg_size)) {
+			if (!readFormat(message, message_header.msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
+			if (!readAndApplyParameter(message, message_header.msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			_data_section_start = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
+			_data_section_start = pos;
 			return true;
 
 		case (int)ULogMessageType::INFO: //skip
-			file.seekg(message_header.msg_size, ios::cur);
 			break;
 
 		default:
 			PX4_ERR("unknown log definition type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
+				(int)message_header.msg_type, (int)message_header.msg_size, (int)pos);
 			break;
 		}
+
+		pos += ULOG_MSG_HEADER_LEN + message_header.msg_size;
 	}
 
 	return true;
 }
 
-bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
+bool Replay::readFormat(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *format = (char *)_read_buffer.data();
-	file.read(format, msg_size);
-	format[msg_size] = 0;
-
-	if (!file) {
-		return false;
-	}
-
-	string str_format(format);
+	string str_format((const char *)message, strnlen((const char *)message, msg_size));
 	size_t pos = str_format.find(':');
 
 	if (pos == string::npos) {
@@ -255,27 +266,15 @@ bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
+bool Replay::readAndAddSubscription(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *message = (char *)_read_buffer.data();
-	streampos this_message_pos = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
-	file.read(message, msg_size);
-	message[msg_size] = 0;
-
-	if (!file) {
+	if (msg_size < 3) {
 		return false;
 	}
 
-	if (file.tellg() <= _subscription_file_pos) { //already read this subscription
-		return true;
-	}
-
-	_subscription_file_pos = file.tellg();
-
-	uint8_t multi_id = *(uint8_t *)message;
+	uint8_t multi_id = message[0];
 	uint16_t msg_id = ((uint16_t) message[1]) | (((uint16_t) message[2]) << 8);
-	string topic_name(message + 3);
+	string topic_name((const char *)message + 3, strnlen((const char *)message + 3, msg_size - 3));
 	const orb_metadata *orb_meta = findTopic(topic_name);
 
 	if (!orb_meta) {
@@ -334,21 +333,7 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 		return true;
 	}
 
-
-	//find first data message (and the timestamp)
-	streampos cur_pos = file.tellg();
-	subscription.next_read_pos = this_message_pos; //this will be skipped
-
-	if (!nextDataMessage(file, subscription, msg_id)) {
-		return false;
-	}
-
-	file.seekg(cur_pos);
-
-	if (!subscription.orb_meta) {
-		//no message found. This is not a fatal error
-		return true;
-	}
+	subscription.next_data.resize(orb_meta->o_size);
 
 	PX4_DEBUG("adding subscription for %s (msg_id %i)", subscription.orb_meta->o_name, msg_id);
 
@@ -362,50 +347,43 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position)
+void Replay::handleEvent(uint64_t offset)
 {
 	ulog_message_header_s message_header;
+	memcpy(&message_header, _index.data() + offset, ULOG_MSG_HEADER_LEN);
+	const uint8_t *message = _index.data() + offset + ULOG_MSG_HEADER_LEN;
 
-	while (file.tellg() < end_position) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	switch (message_header.msg_type) {
+	case (int)ULogMessageType::ADD_LOGGED_MSG:
+		readAndAddSubscription(message, message_header.msg_size);
+		break;
 
-		if (!file) {
-			return false;
-		}
-
-		switch (message_header.msg_type) {
-		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
-				return false;
-			}
+	case (int)ULogMessageType::PARAMETER:
+		readAndApplyParameter(message, message_header.msg_size);
+		break;
 
-			break;
-
-		case (int)ULogMessageType::DROPOUT:
-			readDropout(file, message_header.msg_size);
-			break;
+	case (int)ULogMessageType::DROPOUT:
+		readDropout(message, message_header.msg_size);
+		break;
 
-		default: //skip all others
-			file.seekg(message_header.msg_size, ios::cur);
-			break;
-		}
+	default:
+		break;
 	}
-
-	return true;
 }
 
-bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
+bool Replay::readAndApplyParameter(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size);
-	uint8_t *message = (uint8_t *)_read_buffer.data();
-	file.read((char *)message, msg_size);
-
-	if (!file) {
+	if (msg_size < 1) {
 		return false;
 	}
 
 	uint8_t key_len = message[0];
-	string key((char *)message + 1, key_len);
+
+	if (1 + key_len + sizeof(int32_t) > msg_size) {
+		return false;
+	}
+
+	string key((const char *)message + 1, key_len);
 
 	size_t pos = key.find(' ');
 
@@ -435,90 +413,192 @@ bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readDropout(std::ifstream &file, uint16_t msg_size)
+bool Replay::readDropout(const uint8_t *message, uint16_t msg_size)
 {
 	uint16_t duration;
-	file.read((char *)&duration, sizeof(duration));
+
+	if (msg_size < sizeof(duration)) {
+		return false;
+	}
+
+	memcpy(&duration, message, sizeof(duration));
 
 	PX4_INFO("Dropout in replayed log, %i ms", (int)duration);
-	return file.good();
+	return true;
 }
 
-bool Replay::nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id)
+bool Replay::loadOrBuildIndex()
 {
-	ulog_message_header_s message_header;
-	file.seekg(subscription.next_read_pos);
-	//ignore the first message (it's data we already read)
-	file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	const string index_file_name = string(_replay_file) + ".idx";
+	const hrt_abstime start = hrt_absolute_time();
 
-	if (file) {
-		file.seekg(message_header.msg_size, ios::cur);
+	if (_index.load(index_file_name.c_str())) {
+		PX4_INFO("Loaded index %s (%zu messages, %.3lf s)", index_file_name.c_str(), _index.entries().size(),
+			 (double)hrt_elapsed_time(&start) / 1.e6);
+		return true;
 	}
 
-	uint16_t file_msg_id;
-	bool done = false;
+	if (!buildIndex()) {
+		return false;
+	}
 
-	while (file && !done) {
-		streampos cur_pos = file.tellg();
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	PX4_INFO("Indexed %zu messages in %.3lf s", _index.entries().size(), (double)hrt_elapsed_time(&start) / 1.e6);
 
-		if (!file) {
-			break;
+	if (!_index.save(index_file_name.c_str())) {
+		PX4_WARN("Failed to store index %s", index_file_name.c_str());
+	}
+
+	return true;
+}
+
+bool Replay::buildIndex()
+{
+	_index.clear();
+	_subscriptions.clear();
+
+	ulog_message_header_s message_header;
+	size_t pos = _data_section_start;
+
+	while (pos + ULOG_MSG_HEADER_LEN <= _index.size()) {
+		memcpy(&message_header, _index.data() + pos, ULOG_MSG_HEADER_LEN);
+		const uint8_t *message = _index.data() + pos + ULOG_MSG_HEADER_LEN;
+
+		if (pos + ULOG_MSG_HEADER_LEN + message_header.msg_size > _index.size()) {
+			break; //the last message is truncated
 		}
 
 		switch (message_header.msg_type) {
 		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			readAndAddSubscription(file, message_header.msg_size);
+			//the subscriptions are needed to decode the timestamps
+			readAndAddSubscription(message, message_header.msg_size);
+			_index.addEvent(pos);
+			break;
+
+		case (int)ULogMessageType::PARAMETER:
+		case (int)ULogMessageType::DROPOUT:
+			_index.addEvent(pos);
 			break;
 
 		case (int)ULogMessageType::DATA:
-			file.read((char *)&file_msg_id, sizeof(file_msg_id));
-
-			if (file) {
-				if (msg_id == file_msg_id) {
-					if (message_header.msg_size == subscription.orb_meta->o_size_no_padding + 2) {
-						subscription.next_read_pos = cur_pos;
-						file.seekg(subscription.timestamp_offset, ios::cur);
-						file.read((char *)&subscription.next_timestamp, sizeof(subscription.next_timestamp));
-						done = true;
-
-					} else { //sanity check failed!
-						PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
-							subscription.orb_meta->o_name, message_header.msg_size,
-							subscription.orb_meta->o_size_no_padding + 2);
-						file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
+		case (int)ULogMessageType::ENCODED_DATA:
+			if (message_header.msg_size >= sizeof(uint16_t)) {
+				const uint16_t msg_id = message[0] | (message[1] << 8);
+
+				if (msg_id < _subscriptions.size() && _subscriptions[msg_id].orb_meta &&
+				    readDataPayload(_index.data() + pos, _subscriptions[msg_id])) {
+					const uint64_t timestamp = dataTimestamp(_subscriptions[msg_id]);
+
+					//someone didn't set the timestamp properly. Consider the message invalid
+					if (timestamp != 0) {
+						_index.addData(msg_id, timestamp, pos);
+
+					} else {
+						//the logger used it as the delta reference: the following deltas
+						//cannot be decoded from the indexed messages, skip them until the next keyframe
+						_subscriptions[msg_id].next_data_valid = false;
 					}
-
-				} else { //not the one we are looking for
-					file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
 				}
 			}
 
 			break;
 
 		case (int)ULogMessageType::REMOVE_LOGGED_MSG: //skip these
-		case (int)ULogMessageType::PARAMETER:
-		case (int)ULogMessageType::DROPOUT:
+		case (int)ULogMessageType::INFO:
 		case (int)ULogMessageType::SYNC:
 		case (int)ULogMessageType::LOGGING:
-			file.seekg(message_header.msg_size, ios::cur);
 			break;
 
 		default:
 			//this really should not happen
 			PX4_ERR("unknown log message type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
+				(int)message_header.msg_type, (int)message_header.msg_size, (int)pos);
 			break;
 		}
+
+		pos += ULOG_MSG_HEADER_LEN + message_header.msg_size;
 	}
 
-	if (file.eof()) { //no more data messages for this subscription
-		subscription.orb_meta = nullptr;
-		file.clear();
+	_index.finish();
+
+	//the replay adds them again, when going over the events
+	_subscriptions.clear();
+	return true;
+}
+
+uint64_t Replay::dataTimestamp(const Subscription &subscription)
+{
+	uint64_t timestamp;
+	memcpy(&timestamp, subscription.next_data.data() + subscription.timestamp_offset, sizeof(timestamp));
+	return timestamp;
+}
+
+bool Replay::readDataPayload(const uint8_t *message, Subscription &subscription)
+{
+	ulog_message_header_s message_header;
+	memcpy(&message_header, message, ULOG_MSG_HEADER_LEN);
+	message += ULOG_MSG_HEADER_LEN + sizeof(uint16_t); //after the msg id
+
+	const int payload_size = subscription.orb_meta->o_size_no_padding;
+	const int remaining = message_header.msg_size - sizeof(uint16_t);
+
+	if (message_header.msg_type == (int)ULogMessageType::DATA) {
+		if (remaining != payload_size) { //sanity check failed!
+			PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
+				subscription.orb_meta->o_name, message_header.msg_size, payload_size + 2);
+			return false;
+		}
+
+		memcpy(subscription.next_data.data(), message, payload_size);
+		subscription.next_data_valid = true;
+		return true;
 	}
 
-	return file.good();
+	const int encoded_size = remaining - (int)(sizeof(uint8_t) + sizeof(uint16_t));
+	uint8_t encoding = 0;
+	uint16_t decoded_size = 0;
+
+	if (encoded_size >= 0) {
+		encoding = message[0];
+		memcpy(&decoded_size, message + 1, sizeof(decoded_size));
+	}
+
+	if (encoded_size < 0 || decoded_size != payload_size) {
+		PX4_ERR("encoded message %s has wrong size %i (expected %i). Skipping",
+			subscription.orb_meta->o_name, (int)decoded_size, payload_size);
+		return false;
+	}
+
+	if ((encoding & ULOG_ENCODING_DELTA) && !subscription.next_data_valid) {
+		//waiting for a keyframe (after a seek or a decoding error)
+		return false;
+	}
+
+	const uint8_t *encoded = message + sizeof(uint8_t) + sizeof(uint16_t);
+	const uint8_t *decoded = encoded;
+	bool valid;
+
+	if (encoding & ULOG_ENCODING_LZ) {
+		_encoded_buffer.resize(payload_size);
+		valid = logger::ulog_lz_decompress(encoded, encoded_size, _encoded_buffer.data(), payload_size) == payload_size;
+		decoded = _encoded_buffer.data();
+
+	} else {
+		valid = encoded_size == payload_size;
+	}
+
+	if (valid && (encoding & ULOG_ENCODING_DELTA)) {
+		logger::ulog_delta(decoded, subscription.next_data.data(), subscription.next_data.data(), payload_size);
+
+	} else if (valid) {
+		memcpy(subscription.next_data.data(), decoded, payload_size);
+
+	} else {
+		//the following deltas cannot be decoded either, until the next keyframe
+		PX4_ERR("failed to decode message %s (encoding 0x%x). Skipping", subscription.orb_meta->o_name, (int)encoding);
+	}
+
+	subscription.next_data_valid = valid;
+	return valid;
 }
 
 const orb_metadata *Replay::findTopic(const std::string &name)
@@ -588,7 +668,7 @@ size_t Replay::sizeOfFullType(const std::string &type_name_full)
 	return sizeOfType(type_name) * array_size;
 }
 
-bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
+bool Replay::readDefinitionsAndApplyParams()
 {
 	// log reader currently assumes little endian
 	int num = 1;
@@ -598,18 +678,18 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 		return false;
 	}
 
-	if (!file.is_open()) {
+	if (!_index.open(_replay_file)) {
 		PX4_ERR("Failed to open replay file");
 		return false;
 	}
 
-	if (!readFileHeader(file)) {
+	if (!readFileHeader()) {
 		PX4_ERR("Failed to read file header. Not a valid ULog file");
 		return false;
 	}
 
 	//initialize the formats and apply the parameters from the log file
-	if (!readFileDefinitions(file)) {
+	if (!readFileDefinitions()) {
 		PX4_ERR("Failed to read ULog definitions section. Broken file?");
 		return false;
 	}
@@ -620,125 +700,79 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 
 void Replay::task_main()
 {
-	ifstream replay_file(_replay_file, ios::in | ios::binary);
-
-	if (!readDefinitionsAndApplyParams(replay_file)) {
+	if (!readDefinitionsAndApplyParams()) {
 		return;
 	}
 
-	_replay_start_time = hrt_absolute_time();
-
-	PX4_INFO("Replay in progress...");
+	if (!loadOrBuildIndex()) {
+		PX4_ERR("Failed to index the replay file");
+		return;
+	}
 
-	ulog_message_header_s message_header;
-	replay_file.seekg(_data_section_start);
+	const std::vector<ULogIndex::Entry> &entries = _index.entries();
+	const std::vector<uint64_t> &events = _index.events();
+	size_t next_entry = 0;
+	size_t next_event = 0;
+	uint64_t first_file_time = _file_start_time;
 
-	//we know the next message must be an ADD_LOGGED_MSG
-	replay_file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	//optionally start later in the log. Subscriptions and parameters up to there are applied
+	const char *replay_start = getenv(replay::ENV_START);
 
-	if (!readAndAddSubscription(replay_file, message_header.msg_size)) {
-		PX4_ERR("Failed to read subscription");
-		return;
+	if (replay_start) {
+		first_file_time = _file_start_time + (uint64_t)(atof(replay_start) * 1.e6);
+		next_entry = _index.find(first_file_time);
+		PX4_INFO("Starting replay at %.3lf s", (double)(first_file_time - _file_start_time) / 1.e6);
 	}
 
+	_replay_start_time = hrt_absolute_time();
+
+	PX4_INFO("Replay in progress...");
 
 	//we update the timestamps from the file by a constant offset to match
 	//the current replay time
-	const uint64_t timestamp_offset = _replay_start_time - _file_start_time;
+	const uint64_t timestamp_offset = _replay_start_time - first_file_time;
 	uint32_t nr_published_messages = 0;
-	streampos last_additional_message_pos = _data_section_start;
-
-	while (!_task_should_exit && replay_file) {
 
-		//Find the next message to publish. Messages from different subscriptions don't need
-		//to be in chronological order, so we need to check all subscriptions
-		uint64_t next_file_time = 0;
-		int next_msg_id = -1;
+	onEnterMainLoop();
 
-		for (size_t i = 0; i < _subscriptions.size(); ++i) {
-			const Subscription &subscription = _subscriptions[i];
+	for (; next_entry < entries.size() && !_task_should_exit; ++next_entry) {
+		const ULogIndex::Entry &entry = entries[next_entry];
 
-			if (subscription.orb_meta) {
-				if (next_file_time == 0 || subscription.next_timestamp < next_file_time) {
-					next_msg_id = (int)i;
-					next_file_time = subscription.next_timestamp;
-				}
-			}
+		//handle the messages without timestamp that are before the next data in the file
+		while (next_event < events.size() && events[next_event] < entry.offset) {
+			handleEvent(events[next_event++]);
 		}
 
-		if (next_msg_id == -1) {
-			break; //no active subscription anymore. We're done.
+		if (entry.msg_id >= _subscriptions.size() || !_subscriptions[entry.msg_id].orb_meta) {
+			continue;
 		}
 
-		Subscription &sub = _subscriptions[next_msg_id];
+		Subscription &sub = _subscriptions[entry.msg_id];
 
-		if (next_file_time == 0) {
-			//someone didn't set the timestamp properly. Consider the message invalid
-			nextDataMessage(replay_file, sub, next_msg_id);
+		if (!readDataPayload(_index.data() + entry.offset, sub)) {
 			continue;
 		}
 
-
-		//handle additional messages between last and next published data
-		replay_file.seekg(last_additional_message_pos);
-		streampos next_additional_message_pos = sub.next_read_pos;
-		readAndHandleAdditionalMessages(replay_file, next_additional_message_pos);
-		last_additional_message_pos = next_additional_message_pos;
-
-
 		//wait if necessary
-		const uint64_t publish_timestamp = next_file_time + timestamp_offset;
-		uint64_t cur_time = hrt_absolute_time();
-
-		if (cur_time < publish_timestamp) {
-			usleep(publish_timestamp - cur_time);
-		}
+		const uint64_t publish_timestamp = handleTopicDelay(entry.timestamp, timestamp_offset);
 
 		//It's time to publish
 		const size_t msg_read_size = sub.orb_meta->o_size_no_padding;
 		const size_t msg_write_size = sub.orb_meta->o_size;
 		_read_buffer.reserve(msg_write_size);
-		replay_file.seekg(sub.next_read_pos + (streamoff)(ULOG_MSG_HEADER_LEN + 2)); //skip header & msg id
-		replay_file.read((char *)_read_buffer.data(), msg_read_size);
+		//copy: the timestamp is changed, but next_data is the reference for the next delta
+		memcpy(_read_buffer.data(), sub.next_data.data(), msg_read_size);
 		*(uint64_t *)(_read_buffer.data() + sub.timestamp_offset) = publish_timestamp;
 
-		if (sub.orb_advert) {
-			orb_publish(sub.orb_meta, sub.orb_advert, _read_buffer.data());
+		if (handleTopicUpdate(sub, _read_buffer.data())) {
 			++nr_published_messages;
-
-		} else {
-			if (sub.multi_id == 0) {
-				sub.orb_advert = orb_advertise(sub.orb_meta, _read_buffer.data());
-				++nr_published_messages;
-
-			} else {
-				// make sure the other instances are advertised already so that we get the correct instance
-				bool advertised = false;
-
-				for (const auto &subscription : _subscriptions) {
-					if (subscription.orb_meta) {
-						if (strcmp(sub.orb_meta->o_name, subscription.orb_meta->o_name) == 0 &&
-						    subscription.orb_advert && subscription.multi_id == sub.multi_id - 1) {
-							advertised = true;
-						}
-					}
-				}
-
-				if (advertised) {
-					int instance;
-					sub.orb_advert = orb_advertise_multi(sub.orb_meta, _read_buffer.data(),
-									     &instance, ORB_PRIO_DEFAULT);
-					++nr_published_messages;
-				}
-			}
 		}
 
-
-		nextDataMessage(replay_file, _subscriptions[next_msg_id], next_msg_id);
-
 		//TODO: output status (eg. every sec), including total duration...
 	}
 
+	onExitMainLoop();
+
 	for (auto &subscription : _subscriptions) {
 		if (subscription.orb_advert) {
 			orb_unadvertise(subscription.orb_advert);
@@ -752,11 +786,182 @@ void Replay::task_main()
 
 		//TODO: should we close the log file & exit (optionally, by adding a parameter -q) ?
 	}
+
+	_index.close();
+}
+
+size_t Replay::decodeAll()
+{
+	const std::vector<ULogIndex::Entry> &entries = _index.entries();
+	const std::vector<uint64_t> &events = _index.events();
+	size_t next_event = 0;
+	size_t decoded = 0;
+
+	_subscriptions.clear();
+
+	for (const ULogIndex::Entry &entry : entries) {
+		while (next_event < events.size() && events[next_event] < entry.offset) {
+			handleEvent(events[next_event++]);
+		}
+
+		if (entry.msg_id < _subscriptions.size() && _subscriptions[entry.msg_id].orb_meta) {
+			Subscription &sub = _subscriptions[entry.msg_id];
+
+			if (readDataPayload(_index.data() + entry.offset, sub)) {
+				//what the replay does before publishing
+				_read_buffer.reserve(sub.orb_meta->o_size);
+				memcpy(_read_buffer.data(), sub.next_data.data(), sub.orb_meta->o_size_no_padding);
+				++decoded;
+			}
+		}
+	}
+
+	return decoded;
+}
+
+int Replay::benchmark(int iterations)
+{
+	const char *logfile = getenv(replay::ENV_FILENAME);
+
+	if (logfile && !isSetup()) {
+		setupReplayFile(logfile);
+	}
+
+	if (!_replay_file) {
+		PX4_ERR("no log file given (via env variable %s)", replay::ENV_FILENAME);
+		return -1;
+	}
+
+	Replay *r = new Replay();
+
+	if (r == nullptr) {
+		PX4_ERR("alloc failed");
+		return -ENOMEM;
+	}
+
+	//the overridden parameters are applied, as in a replay
+	if (!r->readDefinitionsAndApplyParams()) {
+		delete r;
+		return -1;
+	}
+
+	const double mbytes = (double)r->_index.size() / 1.e6;
+
+	//baseline: one read() per message header and body, as the stream based reader did
+	hrt_abstime start = hrt_absolute_time();
+	size_t messages = 0;
+	{
+		ifstream file(_replay_file, ios::in | ios::binary);
+		ulog_message_header_s message_header;
+		file.seekg(r->_data_section_start);
+
+		while (file.read((char *)&message_header, ULOG_MSG_HEADER_LEN)) {
+			r->_read_buffer.reserve(message_header.msg_size);
+			file.read((char *)r->_read_buffer.data(), message_header.msg_size);
+			++messages;
+		}
+	}
+	double elapsed = (double)hrt_elapsed_time(&start) / 1.e6;
+	PX4_INFO("ifstream scan:  %8zu msgs, %8.3lf s, %8.1lf MB/s", messages, elapsed, mbytes / elapsed);
+
+	start = hrt_absolute_time();
+	r->buildIndex();
+	elapsed = (double)hrt_elapsed_time(&start) / 1.e6;
+	PX4_INFO("index build:    %8zu msgs, %8.3lf s, %8.1lf MB/s", r->_index.entries().size(), elapsed, mbytes / elapsed);
+
+	const string index_file_name = string(_replay_file) + ".idx";
+
+	if (r->_index.save(index_file_name.c_str())) {
+		start = hrt_absolute_time();
+		bool loaded = r->_index.load(index_file_name.c_str());
+		elapsed = (double)hrt_elapsed_time(&start) / 1.e6;
+		PX4_INFO("index load:     %8s, %8.3lf s", loaded ? "ok" : "failed", elapsed);
+	}
+
+	for (int i = 0; i < iterations; ++i) {
+		start = hrt_absolute_time();
+		size_t decoded = r->decodeAll();
+		elapsed = (double)hrt_elapsed_time(&start) / 1.e6;
+		PX4_INFO("indexed decode: %8zu msgs, %8.3lf s, %8.1lf MB/s", decoded, elapsed, mbytes / elapsed);
+	}
+
+	const size_t seek_index = r->_index.find(r->_file_start_time + (r->_index.entries().empty() ? 0 :
+				  (r->_index.entries().back().timestamp - r->_file_start_time) / 2));
+	PX4_INFO("seek to the middle: entry %zu of %zu", seek_index, r->_index.entries().size());
+
+	delete r;
+	return 0;
+}
+
+uint64_t Replay::handleTopicDelay(uint64_t next_file_time, uint64_t timestamp_offset)
+{
+	const uint64_t publish_timestamp = next_file_time + timestamp_offset;
+	uint64_t cur_time = hrt_absolute_time();
+
+	if (cur_time < publish_timestamp) {
+		usleep(publish_timestamp - cur_time);
+	}
+
+	return publish_timestamp;
+}
+
+bool Replay::handleTopicUpdate(Subscription &sub, void *data)
+{
+	return publishTopic(sub, data);
+}
+
+bool Replay::publishTopic(Subscription &sub, void *data)
+{
+	bool published = false;
+
+	if (sub.orb_advert) {
+		orb_publish(sub.orb_meta, sub.orb_advert, data);
+		published = true;
+
+	} else {
+		if (sub.multi_id == 0) {
+			sub.orb_advert = orb_advertise(sub.orb_meta, data);
+			published = true;
+
+		} else {
+			// make sure the other instances are advertised already so that we get the correct instance
+			bool advertised = false;
+
+			for (const auto &subscription : _subscriptions) {
+				if (subscription.orb_meta) {
+					if (strcmp(sub.orb_meta->o_name, subscription.orb_meta->o_name) == 0 &&
+					    subscription.orb_advert && subscription.multi_id == sub.multi_id - 1) {
+						advertised = true;
+					}
+				}
+			}
+
+			if (advertised) {
+				int instance;
+				sub.orb_advert = orb_advertise_multi(sub.orb_meta, data, &instance, ORB_PRIO_DEFAULT);
+				published = true;
+			}
+		}
+	}
+
+	return published;
 }
 
 void Replay::task_main_trampoline(int argc, char *argv[])
 {
-	replay::instance = new Replay();
+	const char *replay_mode = getenv(replay::ENV_MODE);
+
+	if (replay_mode && strcmp(replay_mode, "impact") == 0) {
+		PX4_INFO("Impact recovery replay mode");
+		replay::instance = new ReplayImpactRecovery();
+
+	} else if (replay_mode && strcmp(replay_mode, "lockstep") == 0) {
+		PX4_INFO("Lockstep replay mode");
+		replay::instance = new ReplayLockstep();
+
+	} else {
+		replay::instance = new Replay();
+	}
 
 	if (replay::instance == nullptr) {
 		PX4_ERR("alloc failed");
@@ -799,9 +1004,7 @@ int Replay::start(bool quiet, bool apply_params_only)
 			return -ENOMEM;
 		}
 
-		ifstream replay_file(_replay_file, ios::in | ios::binary);
-
-		if (!r->readDefinitionsAndApplyParams(replay_file)) {
+		if (!r->readDefinitionsAndApplyParams()) {
 			ret = -1;
 		}
 
@@ -834,7 +1037,7 @@ using namespace px4;
 int replay_main(int argc, char *argv[])
 {
 	if (argc < 1) {
-		PX4_WARN("usage: replay {tryapplyparams|trystart|start|stop|status}");
+		PX4_WARN("usage: replay {tryapplyparams|trystart|start|stop|status|bench [iterations]}");
 		return 1;
 	}
 
@@ -881,6 +1084,16 @@ int replay_main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "bench")) {
+		if (replay::instance != nullptr) {
+			PX4_WARN("already running");
+			return 1;
+		}
+
+		int iterations = (argc > 2) ? atoi(argv[2]) : 3;
+		return Replay::benchmark(iterations > 0 ? iterations : 1) == 0 ? 0 : 1;
+	}
+
 	if (!strcmp(argv[1], "status")) {
 		if (replay::instance) {
 			PX4_WARN("running");
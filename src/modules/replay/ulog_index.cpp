@@ -0,0 +1,240 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ulog_index.cpp
+ * Memory mapped and indexed ULog file.
+ */
+
+#include "ulog_index.hpp"
+
+#include <fcntl.h>
+#include <queue>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace px4
+{
+
+bool ULogIndex::open(const char *file_name)
+{
+	close();
+
+	int fd = ::open(file_name, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	/* the index pass and the replay both go through the file front to back */
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	_data = (const uint8_t *)data;
+	_size = st.st_size;
+	_mtime = st.st_mtime;
+	return true;
+}
+
+void ULogIndex::close()
+{
+	if (_data) {
+		munmap((void *)_data, _size);
+		_data = nullptr;
+		_size = 0;
+	}
+
+	clear();
+}
+
+void ULogIndex::clear()
+{
+	_streams.clear();
+	_entries.clear();
+	_events.clear();
+}
+
+void ULogIndex::addData(uint16_t msg_id, uint64_t timestamp, uint64_t offset)
+{
+	if (_streams.size() <= msg_id) {
+		_streams.resize(msg_id + 1);
+	}
+
+	Entry entry;
+	entry.timestamp = timestamp;
+	entry.offset = offset;
+	entry.msg_id = msg_id;
+	_streams[msg_id].push_back(entry);
+}
+
+void ULogIndex::finish()
+{
+	/* k-way merge of the streams: the heap holds the next message of each stream */
+	struct Head {
+		uint64_t timestamp;
+		uint16_t msg_id;
+		size_t next;
+
+		bool operator<(const Head &other) const
+		{
+			// std::priority_queue is a max heap
+			return timestamp > other.timestamp || (timestamp == other.timestamp && msg_id > other.msg_id);
+		}
+	};
+
+	size_t total = 0;
+	std::priority_queue<Head> heads;
+
+	for (size_t i = 0; i < _streams.size(); ++i) {
+		if (!_streams[i].empty()) {
+			heads.push(Head{_streams[i][0].timestamp, (uint16_t)i, 0});
+			total += _streams[i].size();
+		}
+	}
+
+	_entries.clear();
+	_entries.reserve(total);
+
+	while (!heads.empty()) {
+		Head head = heads.top();
+		heads.pop();
+		const std::vector<Entry> &stream = _streams[head.msg_id];
+		_entries.push_back(stream[head.next]);
+
+		if (++head.next < stream.size()) {
+			head.timestamp = stream[head.next].timestamp;
+			heads.push(head);
+		}
+	}
+
+	_streams.clear();
+	_streams.shrink_to_fit();
+}
+
+size_t ULogIndex::find(uint64_t timestamp) const
+{
+	size_t low = 0;
+	size_t high = _entries.size();
+
+	while (low < high) {
+		const size_t mid = low + (high - low) / 2;
+
+		if (_entries[mid].timestamp < timestamp) {
+			low = mid + 1;
+
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+bool ULogIndex::load(const char *index_file_name)
+{
+	FILE *fp = fopen(index_file_name, "rb");
+
+	if (!fp) {
+		return false;
+	}
+
+	SidecarHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		  memcmp(header.magic, "ULogIdx", 8) == 0 &&
+		  header.version == SIDECAR_VERSION &&
+		  header.entry_size == sizeof(Entry) &&
+		  header.file_size == _size &&
+		  header.file_mtime == _mtime;
+
+	if (ok) {
+		_entries.resize(header.num_entries);
+		_events.resize(header.num_events);
+		ok = fread(_entries.data(), sizeof(Entry), _entries.size(), fp) == _entries.size() &&
+		     fread(_events.data(), sizeof(uint64_t), _events.size(), fp) == _events.size();
+	}
+
+	fclose(fp);
+
+	if (!ok) {
+		clear();
+	}
+
+	return ok;
+}
+
+bool ULogIndex::save(const char *index_file_name) const
+{
+	FILE *fp = fopen(index_file_name, "wb");
+
+	if (!fp) {
+		return false;
+	}
+
+	SidecarHeader header;
+	memcpy(header.magic, "ULogIdx", 8);
+	header.version = SIDECAR_VERSION;
+	header.entry_size = sizeof(Entry);
+	header.file_size = _size;
+	header.file_mtime = _mtime;
+	header.num_entries = _entries.size();
+	header.num_events = _events.size();
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		  fwrite(_entries.data(), sizeof(Entry), _entries.size(), fp) == _entries.size() &&
+		  fwrite(_events.data(), sizeof(uint64_t), _events.size(), fp) == _events.size();
+
+	if (fclose(fp) != 0 || !ok) {
+		unlink(index_file_name);
+		return false;
+	}
+
+	return true;
+}
+
+} //namespace px4
@@ -0,0 +1,141 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace px4
+{
+
+/**
+ * @class ULogIndex
+ * Read-only memory mapping of an ULog file, together with an index of its data messages.
+ *
+ * The index holds the file offset of each data message in replay order: the per-msg_id
+ * message streams (each in file order) are merged by timestamp, ties going to the lower
+ * msg_id. The messages without timestamp that affect replay (ADD_LOGGED_MSG, PARAMETER,
+ * DROPOUT) are kept as events in file order. Building the index needs the log formats,
+ * so it is filled by the reader (see Replay::buildIndex()), and can be cached in a sidecar file.
+ */
+class ULogIndex
+{
+public:
+	struct Entry {
+		uint64_t timestamp;
+		uint64_t offset : 48;	///< of the message header
+		uint64_t msg_id : 16;
+	};
+
+	ULogIndex() = default;
+	~ULogIndex() { close(); }
+
+	ULogIndex(const ULogIndex &) = delete;
+	ULogIndex &operator=(const ULogIndex &) = delete;
+
+	/**
+	 * map a file (read-only). Closes a previously mapped file.
+	 * @return true on success
+	 */
+	bool open(const char *file_name);
+
+	void close();
+
+	const uint8_t *data() const { return _data; }
+	size_t size() const { return _size; }
+
+	/**
+	 * Add a data message of a msg_id. Messages of the same msg_id must be added in file order.
+	 */
+	void addData(uint16_t msg_id, uint64_t timestamp, uint64_t offset);
+
+	void addEvent(uint64_t offset) { _events.push_back(offset); }
+
+	/**
+	 * merge the data messages added with addData() into entries()
+	 */
+	void finish();
+
+	/** data messages in replay order (valid after finish() or load()) */
+	const std::vector<Entry> &entries() const { return _entries; }
+
+	/** offsets of the event messages, in file order */
+	const std::vector<uint64_t> &events() const { return _events; }
+
+	/**
+	 * Find the first entry with a timestamp >= timestamp, by binary search. If the
+	 * timestamps of a msg_id are not monotonic, the result is approximate.
+	 * @return entry index, entries().size() if there is none
+	 */
+	size_t find(uint64_t timestamp) const;
+
+	/**
+	 * Load the index from a sidecar file. It is only accepted if it was created for a file
+	 * with the size and modification time of the mapped file.
+	 * @return true on success
+	 */
+	bool load(const char *index_file_name);
+
+	/**
+	 * Store the index to a sidecar file
+	 * @return true on success
+	 */
+	bool save(const char *index_file_name) const;
+
+	void clear();
+
+private:
+	struct SidecarHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_size;
+		uint64_t file_size;
+		uint64_t file_mtime;
+		uint64_t num_entries;
+		uint64_t num_events;
+	};
+
+	static constexpr uint32_t SIDECAR_VERSION = 2; ///< 2: no deltas of skipped samples
+
+	const uint8_t *_data = nullptr;
+	size_t _size = 0;
+	uint64_t _mtime = 0; ///< modification time of the mapped file [s]
+
+	std::vector<std::vector<Entry>> _streams; ///< per msg_id, while building
+	std::vector<Entry> _entries;
+	std::vector<uint64_t> _events;
+};
+
+} //namespace px4
@@ -40,24 +40,37 @@
  */
 
 #include <px4_defines.h>
+#include <px4_log.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include <drivers/drv_hrt.h>
+
 #include "logbuffer.h"
 
-int logbuffer_init(struct logbuffer_s *lb, int size)
+int logbuffer_init(struct logbuffer_s *lb, int size, int block_size)
 {
-	lb->size  = size;
-	lb->write_ptr = 0;
-	lb->read_ptr = 0;
-	lb->data = NULL;
+	if (size < 2 * block_size) {
+		size = 2 * block_size;
+	}
+
+	lb->size = (size + block_size - 1) / block_size * block_size;
+	lb->block_size = block_size;
+	lb->data = malloc(lb->size);
+
+	if (lb->data == NULL) {
+		return PX4_ERROR;
+	}
+
 	lb->perf_dropped = perf_alloc(PC_COUNT, "sd drop");
+	logbuffer_reset(lb);
 	return PX4_OK;
 }
 
 int logbuffer_count(struct logbuffer_s *lb)
 {
-	int n = lb->write_ptr - lb->read_ptr;
+	int n = __atomic_load_n(&lb->write_ptr, __ATOMIC_ACQUIRE) - __atomic_load_n(&lb->read_ptr, __ATOMIC_ACQUIRE);
 
 	if (n < 0) {
 		n += lb->size;
@@ -68,23 +81,30 @@ int logbuffer_count(struct logbuffer_s *lb)
 
 int logbuffer_is_empty(struct logbuffer_s *lb)
 {
-	return lb->read_ptr == lb->write_ptr;
+	return logbuffer_count(lb) == 0;
 }
 
-bool logbuffer_write(struct logbuffer_s *lb, void *ptr, int size)
+static void logbuffer_end_dropout(struct logbuffer_s *lb)
 {
-	// allocate buffer if not yet present
-	if (lb->data == NULL) {
-		lb->data = malloc(lb->size);
-	}
+	uint64_t duration_ms = (hrt_absolute_time() - lb->dropout_start) / 1000;
+	int bucket = 0;
 
-	// allocation failed, bail out
-	if (lb->data == NULL) {
-		return false;
+	while (bucket < LOGBUFFER_DROPOUT_BUCKETS - 1 && duration_ms >= (1ull << bucket)) {
+		bucket++;
 	}
 
+	lb->dropout_hist[bucket]++;
+	lb->dropout_start = 0;
+}
+
+bool logbuffer_write(struct logbuffer_s *lb, void *ptr, int size)
+{
+	// the consumer frees space by advancing read_ptr, it never touches write_ptr
+	int write_ptr = lb->write_ptr;
+	int read_ptr = __atomic_load_n(&lb->read_ptr, __ATOMIC_ACQUIRE);
+
 	// bytes available to write
-	int available = lb->read_ptr - lb->write_ptr - 1;
+	int available = read_ptr - write_ptr - 1;
 
 	if (available < 0) {
 		available += lb->size;
@@ -93,16 +113,26 @@ bool logbuffer_write(struct logbuffer_s *lb, void *ptr, int size)
 	if (size > available) {
 		// buffer overflow
 		perf_count(lb->perf_dropped);
+		lb->dropped_bytes += size;
+
+		if (lb->dropout_start == 0) {
+			lb->dropout_start = hrt_absolute_time();
+		}
+
 		return false;
 	}
 
+	if (lb->dropout_start != 0) {
+		logbuffer_end_dropout(lb);
+	}
+
 	char *c = (char *) ptr;
-	int n = lb->size - lb->write_ptr;	// bytes to end of the buffer
+	int n = lb->size - write_ptr;	// bytes to end of the buffer
 
 	if (n < size) {
 		// message goes over end of the buffer
-		memcpy(&(lb->data[lb->write_ptr]), c, n);
-		lb->write_ptr = 0;
+		memcpy(&(lb->data[write_ptr]), c, n);
+		write_ptr = 0;
 
 	} else {
 		n = 0;
@@ -110,40 +140,68 @@ bool logbuffer_write(struct logbuffer_s *lb, void *ptr, int size)
 
 	// now: n = bytes already written
 	int p = size - n;	// number of bytes to write
-	memcpy(&(lb->data[lb->write_ptr]), &(c[n]), p);
-	lb->write_ptr = (lb->write_ptr + p) % lb->size;
+	memcpy(&(lb->data[write_ptr]), &(c[n]), p);
+	write_ptr = (write_ptr + p) % lb->size;
+
+	// publish the data to the consumer
+	__atomic_store_n(&lb->write_ptr, write_ptr, __ATOMIC_RELEASE);
+
+	int fill = write_ptr - read_ptr;
+
+	if (fill < 0) {
+		fill += lb->size;
+	}
+
+	if (fill > lb->high_water) {
+		lb->high_water = fill;
+	}
+
+	lb->fill_hist[fill * LOGBUFFER_FILL_BUCKETS / lb->size]++;
 	return true;
 }
 
-int logbuffer_get_ptr(struct logbuffer_s *lb, void **ptr, bool *is_part)
+int logbuffer_get_block(struct logbuffer_s *lb, void **ptr, int max_size, bool flush)
 {
-	// bytes available to read
-	int available = lb->write_ptr - lb->read_ptr;
+	int read_ptr = lb->read_ptr;
+	int write_ptr = __atomic_load_n(&lb->write_ptr, __ATOMIC_ACQUIRE);
 
-	if (available == 0) {
-		return 0;	// buffer is empty
-	}
+	// contiguous bytes available to read
+	bool wraps = write_ptr < read_ptr;
+	int available = wraps ? lb->size - read_ptr : write_ptr - read_ptr;
 
-	int n = 0;
+	// the size is a multiple of the block size, so read_ptr has the same block offset as the file position
+	int to_block_end = lb->block_size - (lb->file_offset + read_ptr) % lb->block_size;
+	int n;
 
-	if (available > 0) {
-		// read pointer is before write pointer, all available bytes can be read
-		n = available;
-		*is_part = false;
+	if (available < to_block_end) {
+		// incomplete block, unless it continues at the start of the buffer
+		n = (flush || wraps) ? available : 0;
 
 	} else {
-		// read pointer is after write pointer, read bytes from read_ptr to end of the buffer
-		n = lb->size - lb->read_ptr;
-		*is_part = lb->write_ptr > 0;
+		// complete blocks, starting with the rest of the current one
+		if (available > max_size) {
+			available = max_size;
+		}
+
+		n = to_block_end;
+
+		if (available > to_block_end) {
+			n += (available - to_block_end) / lb->block_size * lb->block_size;
+		}
 	}
 
-	*ptr = &(lb->data[lb->read_ptr]);
+	*ptr = &(lb->data[read_ptr]);
 	return n;
 }
 
+void logbuffer_set_file_offset(struct logbuffer_s *lb, int offset)
+{
+	lb->file_offset = offset % lb->block_size;
+}
+
 void logbuffer_mark_read(struct logbuffer_s *lb, int n)
 {
-	lb->read_ptr = (lb->read_ptr + n) % lb->size;
+	__atomic_store_n(&lb->read_ptr, (lb->read_ptr + n) % lb->size, __ATOMIC_RELEASE);
 }
 
 void logbuffer_free(struct logbuffer_s *lb)
@@ -162,4 +220,34 @@ void logbuffer_reset(struct logbuffer_s *lb)
 	// Keep the buffer but reset the pointers.
 	lb->write_ptr = 0;
 	lb->read_ptr = 0;
+	lb->file_offset = 0;
+
+	lb->high_water = 0;
+	memset(lb->fill_hist, 0, sizeof(lb->fill_hist));
+	memset(lb->dropout_hist, 0, sizeof(lb->dropout_hist));
+	lb->dropped_bytes = 0;
+	lb->dropout_start = 0;
+}
+
+void logbuffer_print_statistics(struct logbuffer_s *lb)
+{
+	PX4_INFO("buffer: %i bytes in blocks of %i, high water %i bytes (%i%%), dropped %u bytes",
+		 lb->size, lb->block_size, lb->high_water, lb->high_water * 100 / lb->size, lb->dropped_bytes);
+
+	char line[128];
+	int len = 0;
+
+	for (int i = 0; i < LOGBUFFER_FILL_BUCKETS; i++) {
+		len += snprintf(line + len, sizeof(line) - len, " %u", lb->fill_hist[i]);
+	}
+
+	PX4_INFO("buffer fill (1/%i steps):%s", LOGBUFFER_FILL_BUCKETS, line);
+
+	len = 0;
+
+	for (int i = 0; i < LOGBUFFER_DROPOUT_BUCKETS; i++) {
+		len += snprintf(line + len, sizeof(line) - len, " %u", lb->dropout_hist[i]);
+	}
+
+	PX4_INFO("dropouts (<1, <2, <4, ... ms):%s", line);
 }
@@ -37,6 +37,14 @@
  *
  * Ring FIFO buffer for binary log data.
  *
+ * There is one producer (the sdlog2 main thread) and one consumer (the
+ * writer thread), so the buffer needs no lock: write_ptr is only changed by
+ * the producer and read_ptr only by the consumer, both with release stores.
+ * The consumer reads the data in blocks of block_size bytes that end on
+ * block boundaries of the file, so that the file is written in aligned chunks.
+ * The buffer size is a multiple of the block size, and file_offset accounts for
+ * the data written to the file before the buffered data (the log header).
+ *
  * @author Anton Babushkin <anton.babushkin@me.com>
  */
 
@@ -44,31 +52,77 @@
 #define SDLOG2_RINGBUFFER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <systemlib/perf_counter.h>
 
+#define LOGBUFFER_FILL_BUCKETS		8	// fill histogram, in 1/8 of the buffer size
+#define LOGBUFFER_DROPOUT_BUCKETS	10	// dropout duration histogram: < 1, < 2, < 4, ... ms, the last is open-ended
+
 struct logbuffer_s {
 	// pointers and size are in bytes
 	int write_ptr;
 	int read_ptr;
 	int size;
+	int block_size;
+	int file_offset;	// file offset of the buffered data modulo block_size, owned by the consumer
 	char *data;
 	perf_counter_t perf_dropped;
+
+	// statistics, updated by the producer
+	int high_water;					// max number of bytes in the buffer
+	uint32_t fill_hist[LOGBUFFER_FILL_BUCKETS];	// buffer fill after each write
+	uint32_t dropout_hist[LOGBUFFER_DROPOUT_BUCKETS];
+	uint32_t dropped_bytes;
+	uint64_t dropout_start;				// 0 if not in a dropout
 };
 
-int logbuffer_init(struct logbuffer_s *lb, int size);
+/**
+ * Allocate the buffer.
+ * @param size buffer size, rounded up to a multiple of block_size (at least 2 blocks)
+ * @param block_size size of the aligned chunks given to the writer
+ */
+int logbuffer_init(struct logbuffer_s *lb, int size, int block_size);
 
 int logbuffer_count(struct logbuffer_s *lb);
 
 int logbuffer_is_empty(struct logbuffer_s *lb);
 
+/**
+ * Append a message. Called by the producer only.
+ * @return false if the buffer is full, the message is dropped
+ */
 bool logbuffer_write(struct logbuffer_s *lb, void *ptr, int size);
 
-int logbuffer_get_ptr(struct logbuffer_s *lb, void **ptr, bool *is_part);
+/**
+ * Set the file offset at which the buffered data starts, e.g. after a header that
+ * was written to the file directly. Called by the consumer only, before it reads.
+ */
+void logbuffer_set_file_offset(struct logbuffer_s *lb, int offset);
 
+/**
+ * Get the next contiguous data to write. Called by the consumer only.
+ * Without flush, only data up to a block boundary of the file is returned: complete
+ * blocks, or the part of a block up to the end of the buffer if the block wraps
+ * around.
+ * @param ptr set to the start of the data
+ * @param max_size maximum number of bytes to return, multiple of block_size
+ * @param flush if true, also return an incomplete block
+ * @return number of bytes at ptr, 0 if there is nothing (complete) to write
+ */
+int logbuffer_get_block(struct logbuffer_s *lb, void **ptr, int max_size, bool flush);
+
+/**
+ * Release n bytes returned by logbuffer_get_block(). Called by the consumer only.
+ */
 void logbuffer_mark_read(struct logbuffer_s *lb, int n);
 
 void logbuffer_free(struct logbuffer_s *lb);
 
+/**
+ * Empty the buffer and reset the statistics. Neither producer nor consumer may run.
+ */
 void logbuffer_reset(struct logbuffer_s *lb);
 
+void logbuffer_print_statistics(struct logbuffer_s *lb);
+
 #endif
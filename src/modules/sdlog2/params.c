@@ -93,3 +93,19 @@ PARAM_DEFINE_INT32(SDLOG_GPSTIME, 1);
  * @group SD Logging
  */
 PARAM_DEFINE_INT32(SDLOG_PRIO_BOOST, 2);
+
+/**
+ * Preallocated size of the log file
+ *
+ * The log file is allocated with this size when it is opened, so that
+ * the file system does not need to allocate blocks while logging. The
+ * unused end is released when the log is closed. Only supported on Linux.
+ *
+ * A value of 0 disables the preallocation.
+ *
+ * @unit MB
+ * @min 0
+ * @max 1024
+ * @group SD Logging
+ */
+PARAM_DEFINE_INT32(SDLOG_PREALLOC, 0);
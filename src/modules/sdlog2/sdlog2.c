@@ -134,13 +134,11 @@
 
 #define PX4_EPOCH_SECS 1234567890L
 
-#define LOGBUFFER_WRITE_AND_COUNT(_msg) pthread_mutex_lock(&logbuffer_mutex); \
-	if (logbuffer_write(&lb, &log_msg, LOG_PACKET_SIZE(_msg))) { \
+#define LOGBUFFER_WRITE_AND_COUNT(_msg) if (logbuffer_write(&lb, &log_msg, LOG_PACKET_SIZE(_msg))) { \
 		log_msgs_written++; \
 	} else { \
 		log_msgs_skipped++; \
-	} \
-	pthread_mutex_unlock(&logbuffer_mutex);
+	}
 
 #define SDLOG_MIN(X,Y) ((X) < (Y) ? (X) : (Y))
 
@@ -152,13 +150,13 @@ static const unsigned MAX_NO_LOGFOLDER = 999;	/**< Maximum number of log dirs */
 static const unsigned MAX_NO_LOGFILE = 999;		/**< Maximum number of log files */
 static const int LOG_BUFFER_SIZE_DEFAULT = 8192;
 
+/* the log file is written in aligned blocks, up to MAX_WRITE_BLOCKS at once */
 #if defined __PX4_POSIX
-static const int MAX_WRITE_CHUNK = 2048;
-static const int MIN_BYTES_TO_WRITE = 512;
+static const int LOG_BLOCK_SIZE = 2048;
 #else
-static const int MAX_WRITE_CHUNK = 512;
-static const int MIN_BYTES_TO_WRITE = 512;
+static const int LOG_BLOCK_SIZE = 512;
 #endif
+static const int MAX_WRITE_BLOCKS = 4;
 
 static bool _extended_logging = false;
 static bool _gpstime_only = false;
@@ -174,7 +172,7 @@ static const char *log_root = MOUNTPOINT "/log";
 static orb_advert_t mavlink_log_pub = NULL;
 struct logbuffer_s lb;
 
-/* mutex / condition to synchronize threads */
+/* mutex / condition to wake up the writer thread, the buffer itself needs no lock */
 static pthread_mutex_t logbuffer_mutex;
 static pthread_cond_t logbuffer_cond;
 
@@ -298,6 +296,24 @@ static int open_log_file(void);
 
 static int open_perf_file(const char* str);
 
+/**
+ * Reserve the space of SDLOG_PREALLOC in the log file.
+ * @return true if the file has to be truncated to the written size when closing it
+ */
+static bool preallocate_log_file(int fd);
+
+/**
+ * Wake up the writer thread if a block can be written.
+ */
+static void logwriter_notify(void);
+
+#ifdef __PX4_POSIX
+/**
+ * Log synthetic messages at increasing rates until the first dropout.
+ */
+int sdlog2_benchmark(int buffer_size);
+#endif
+
 static void
 sdlog2_usage(const char *reason)
 {
@@ -311,7 +327,11 @@ sdlog2_usage(const char *reason)
 		 "\t-e\tEnable logging by default (if not, can be started by command)\n"
 		 "\t-a\tLog only when armed (can be still overriden by command)\n"
 		 "\t-t\tUse date/time for naming log directories and files\n"
-		 "\t-x\tExtended logging");
+		 "\t-x\tExtended logging"
+#ifdef __PX4_POSIX
+		 "\n       sdlog2 bench [<buffer size>]\tFind the highest log rate without dropouts (sdlog2 must be stopped)"
+#endif
+		);
 }
 
 /**
@@ -391,6 +411,20 @@ int sdlog2_main(int argc, char *argv[])
 		return 0;
 	}
 
+#ifdef __PX4_POSIX
+
+	if (!strcmp(argv[1], "bench")) {
+		if (thread_running) {
+			PX4_WARN("stop sdlog2 first");
+			return 1;
+		}
+
+		int buffer_size = (argc > 2) ? strtoul(argv[2], NULL, 10) * 1024 : LOG_BUFFER_SIZE_DEFAULT;
+		return sdlog2_benchmark(buffer_size) == OK ? 0 : 1;
+	}
+
+#endif
+
 	if (!thread_running) {
 		PX4_WARN("not started\n");
 		return 1;
@@ -620,18 +654,68 @@ int open_perf_file(const char* str)
 	return fd;
 }
 
+bool preallocate_log_file(int fd)
+{
+	int32_t prealloc_mib = 0;
+	param_t prealloc_ph = param_find("SDLOG_PREALLOC");
+
+	if (prealloc_ph != PARAM_INVALID) {
+		param_get(prealloc_ph, &prealloc_mib);
+	}
+
+	if (prealloc_mib <= 0) {
+		return false;
+	}
+
+#ifdef __PX4_LINUX
+
+	/* allocate the blocks once instead of on every append */
+	int ret = posix_fallocate(fd, 0, (off_t)prealloc_mib * 1024 * 1024);
+
+	if (ret != 0) {
+		PX4_WARN("preallocating %i MiB failed: %s", prealloc_mib, strerror(ret));
+		return false;
+	}
+
+	return true;
+#else
+	/* without fallocate and ftruncate the unused end could not be released again */
+	PX4_WARN("SDLOG_PREALLOC not supported");
+	return false;
+#endif
+}
+
+void logwriter_notify()
+{
+	/* only wake the writer thread if it can write a complete block */
+	if (logbuffer_count(&lb) >= lb.block_size) {
+		pthread_mutex_lock(&logbuffer_mutex);
+		pthread_cond_signal(&logbuffer_cond);
+		pthread_mutex_unlock(&logbuffer_mutex);
+	}
+}
+
 static void *logwriter_thread(void *arg)
 {
 	/* set name */
 	px4_prctl(PR_SET_NAME, "sdlog2_writer", 0);
 
-	int log_fd = open_log_file();
+	/* the benchmark passes its own file name */
+	const char *file_path = (const char *)arg;
+	int log_fd;
+
+	if (file_path != NULL) {
+		log_fd = open(file_path, O_CREAT | O_WRONLY | O_TRUNC, PX4_O_MODE_666);
+
+	} else {
+		log_fd = open_log_file();
+	}
 
 	if (log_fd < 0) {
 		return NULL;
 	}
 
-	struct logbuffer_s *logbuf = (struct logbuffer_s *)arg;
+	bool truncate_on_close = preallocate_log_file(log_fd);
 
 	/* write log messages formats, version and parameters */
 	log_bytes_written += write_formats(log_fd);
@@ -640,89 +724,72 @@ static void *logwriter_thread(void *arg)
 
 	log_bytes_written += write_parameters(log_fd);
 
+	/* the buffered data follows the header, keep its blocks aligned in the file */
+	logbuffer_set_file_offset(&lb, log_bytes_written);
+
 	fsync(log_fd);
 
 	int poll_count = 0;
 
 	void *read_ptr;
 
-	int n = 0;
-
-	bool should_wait = false;
-
-	bool is_part = false;
-
 	while (true) {
-		/* make sure threads are synchronized */
-		pthread_mutex_lock(&logbuffer_mutex);
-
-		/* update read pointer if needed */
-		if (n > 0) {
-			logbuffer_mark_read(&lb, n);
-		}
+		/* write everything that is left when exiting */
+		bool flush = main_thread_should_exit || logwriter_should_exit;
 
-		/* only wait if no data is available to process */
-		if (should_wait && !logwriter_should_exit) {
-			/* blocking wait for new data at this line */
-			pthread_cond_wait(&logbuffer_cond, &logbuffer_mutex);
-		}
-
-		/* only get pointer to thread-safe data, do heavy I/O a few lines down */
-		int available = logbuffer_get_ptr(logbuf, &read_ptr, &is_part);
-
-		/* continue */
-		pthread_mutex_unlock(&logbuffer_mutex);
-
-		if (available > 0) {
-
-			/* do heavy IO here */
-			if (available > MAX_WRITE_CHUNK) {
-				n = MAX_WRITE_CHUNK;
-
-			} else {
-				n = available;
-			}
+		int n = logbuffer_get_block(&lb, &read_ptr, MAX_WRITE_BLOCKS * LOG_BLOCK_SIZE, flush);
 
+		if (n > 0) {
+			/* do heavy IO here, the producer keeps filling the rest of the buffer */
 			perf_begin(perf_write);
 			n = write(log_fd, read_ptr, n);
 			perf_end(perf_write);
 
-			should_wait = (n == available) && !is_part;
-
 			if (n < 0) {
 				main_thread_should_exit = true;
 				warn("error writing log file");
 				break;
 			}
 
-			if (n > 0) {
-				log_bytes_written += n;
-			}
+			logbuffer_mark_read(&lb, n);
+			log_bytes_written += n;
 
-		} else {
-			n = 0;
+			if (++poll_count == 10) {
+				fsync(log_fd);
+				poll_count = 0;
+			}
 
-			/* exit only with empty buffer */
-			if (main_thread_should_exit || logwriter_should_exit) {
-				break;
+			if (log_bytes_written - last_checked_bytes_written > 20*1024*1024) {
+				/* check if space is available, if not stop everything */
+				if (check_free_space() != OK) {
+					logwriter_should_exit = true;
+					main_thread_should_exit = true;
+				}
+				last_checked_bytes_written = log_bytes_written;
 			}
 
-			should_wait = true;
+			continue;
 		}
 
-		if (++poll_count == 10) {
-			fsync(log_fd);
-			poll_count = 0;
+		/* exit only with empty buffer */
+		if (flush) {
+			break;
+		}
+
+		/* blocking wait until a complete block is available */
+		pthread_mutex_lock(&logbuffer_mutex);
 
+		while (!logwriter_should_exit && !main_thread_should_exit && logbuffer_count(&lb) < lb.block_size) {
+			pthread_cond_wait(&logbuffer_cond, &logbuffer_mutex);
 		}
 
-		if (log_bytes_written - last_checked_bytes_written > 20*1024*1024) {
-			/* check if space is available, if not stop everything */
-			if (check_free_space() != OK) {
-				logwriter_should_exit = true;
-				main_thread_should_exit = true;
-			}
-			last_checked_bytes_written = log_bytes_written;
+		pthread_mutex_unlock(&logbuffer_mutex);
+	}
+
+	if (truncate_on_close) {
+		/* drop the unused preallocated space */
+		if (ftruncate(log_fd, log_bytes_written) != 0) {
+			PX4_WARN("truncating log file failed");
 		}
 	}
 
@@ -749,6 +816,7 @@ void sdlog2_start_log()
 	start_time = hrt_absolute_time();
 	log_msgs_written = 0;
 	log_msgs_skipped = 0;
+	logbuffer_reset(&lb);
 
 	/* initialize log buffer emptying thread */
 	pthread_attr_init(&logwriter_attr);
@@ -771,7 +839,7 @@ void sdlog2_start_log()
 	perf_write = perf_alloc(PC_ELAPSED, "sd write");
 
 	/* start log buffer emptying thread */
-	if (0 != pthread_create(&logwriter_pthread, &logwriter_attr, logwriter_thread, &lb)) {
+	if (0 != pthread_create(&logwriter_pthread, &logwriter_attr, logwriter_thread, NULL)) {
 		PX4_WARN("error creating logwriter thread");
 	}
 
@@ -1145,7 +1213,7 @@ int sdlog2_thread_main(int argc, char *argv[])
 	/* initialize log buffer with specified size */
 	PX4_DEBUG("log buffer size: %i bytes", log_buffer_size);
 
-	if (OK != logbuffer_init(&lb, log_buffer_size)) {
+	if (OK != logbuffer_init(&lb, log_buffer_size, LOG_BLOCK_SIZE)) {
 		PX4_WARN("can't allocate log buffer, exiting");
 		return 1;
 	}
@@ -2395,16 +2463,7 @@ int sdlog2_thread_main(int argc, char *argv[])
 			LOGBUFFER_WRITE_AND_COUNT(DEBG);
 		}
 
-		pthread_mutex_lock(&logbuffer_mutex);
-
-		/* signal the other thread new data, but not yet unlock */
-		if (logbuffer_count(&lb) > MIN_BYTES_TO_WRITE) {
-			/* only request write if several packets can be written at once */
-			pthread_cond_signal(&logbuffer_cond);
-		}
-
-		/* unlock, now the writer thread may run */
-		pthread_mutex_unlock(&logbuffer_mutex);
+		logwriter_notify();
 	}
 
 	if (logging_enabled) {
@@ -2436,8 +2495,130 @@ void sdlog2_status()
 
 		PX4_WARN("wrote %lu msgs, %4.2f MiB (average %5.3f KiB/s), skipped %lu msgs", log_msgs_written, (double)mebibytes, (double)(kibibytes / seconds), log_msgs_skipped);
 		mavlink_log_info(&mavlink_log_pub, "[blackbox] wrote %lu msgs, skipped %lu msgs", log_msgs_written, log_msgs_skipped);
+		logbuffer_print_statistics(&lb);
+	}
+}
+
+#ifdef __PX4_POSIX
+int sdlog2_benchmark(int buffer_size)
+{
+	const int tick_rate = 250;	/* rate at which the synthetic messages are logged, like sensor_combined */
+	const int step_duration = 2;	/* seconds per tested data rate */
+
+	int mkdir_ret = mkdir(log_root, S_IRWXU | S_IRWXG | S_IRWXO);
+
+	if (mkdir_ret != 0 && errno != EEXIST) {
+		PX4_ERR("failed creating log dir: %s", log_root);
+		return PX4_ERROR;
+	}
+
+	char file_path[64];
+	snprintf(file_path, sizeof(file_path), "%s/bench.px4log", log_root);
+
+	if (OK != logbuffer_init(&lb, buffer_size, LOG_BLOCK_SIZE)) {
+		PX4_ERR("can't allocate log buffer");
+		return PX4_ERROR;
+	}
+
+	pthread_mutex_init(&logbuffer_mutex, NULL);
+	pthread_cond_init(&logbuffer_cond, NULL);
+	perf_write = perf_alloc(PC_ELAPSED, "sd write");
+
+	main_thread_should_exit = false;
+	logwriter_should_exit = false;
+	log_bytes_written = 0;
+	last_checked_bytes_written = 0;
+
+	pthread_t writer_pthread;
+
+	if (0 != pthread_create(&writer_pthread, NULL, logwriter_thread, file_path)) {
+		PX4_ERR("error creating logwriter thread");
+		perf_free(perf_write);
+		pthread_mutex_destroy(&logbuffer_mutex);
+		pthread_cond_destroy(&logbuffer_cond);
+		logbuffer_free(&lb);
+		return PX4_ERROR;
+	}
+
+#pragma pack(push, 1)
+	struct {
+		LOG_PACKET_HEADER;
+		struct log_IMU_s body;
+	} log_msg = {
+		LOG_PACKET_HEADER_INIT(LOG_IMU_MSG)
+	};
+#pragma pack(pop)
+
+	int msg_size = LOG_PACKET_SIZE(IMU);
+	int max_rate = 0;
+	bool dropout = false;
+
+	PX4_INFO("buffer %i KiB, %i byte messages at %i Hz, %i s per step", lb.size / 1024, msg_size, tick_rate,
+		 step_duration);
+
+	/* increase the data rate by 25% per step, starting at 64 KiB/s */
+	for (int rate = 64 * 1024; !dropout && rate <= 64 * 1024 * 1024 && !main_thread_should_exit; rate += rate / 4) {
+		int msgs_per_tick = rate / tick_rate / msg_size;
+
+		if (msgs_per_tick < 1) {
+			msgs_per_tick = 1;
+		}
+
+		int actual_rate = msgs_per_tick * msg_size * tick_rate;
+		hrt_abstime step_start = hrt_absolute_time();
+		hrt_abstime next_tick = step_start;
+
+		while (!dropout && hrt_elapsed_time(&step_start) < step_duration * 1000000ULL) {
+			for (int i = 0; i < msgs_per_tick; i++) {
+				/* vary the content so the file system sees realistic data */
+				log_msg.body.acc_x = (float)i;
+				log_msg.body.gyro_z = (float)next_tick;
+
+				if (!logbuffer_write(&lb, &log_msg, msg_size)) {
+					dropout = true;
+					break;
+				}
+			}
+
+			logwriter_notify();
+
+			next_tick += 1000000 / tick_rate;
+			hrt_abstime now = hrt_absolute_time();
+
+			if (next_tick > now) {
+				usleep(next_tick - now);
+			}
+		}
+
+		PX4_INFO("%8.1f KiB/s: %s, high water %i bytes", (double)(actual_rate / 1024.0f), dropout ? "DROPOUT" : "ok",
+			 lb.high_water);
+
+		if (!dropout) {
+			max_rate = actual_rate;
+		}
 	}
+
+	PX4_INFO("highest rate without dropout: %.1f KiB/s", (double)(max_rate / 1024.0f));
+	logbuffer_print_statistics(&lb);
+	perf_print_counter(perf_write);
+
+	/* stop the writer thread, it writes the rest of the buffer */
+	pthread_mutex_lock(&logbuffer_mutex);
+	logwriter_should_exit = true;
+	pthread_cond_signal(&logbuffer_cond);
+	pthread_mutex_unlock(&logbuffer_mutex);
+
+	pthread_join(writer_pthread, NULL);
+	unlink(file_path);
+
+	perf_free(perf_write);
+	pthread_mutex_destroy(&logbuffer_mutex);
+	pthread_cond_destroy(&logbuffer_cond);
+	logbuffer_free(&lb);
+
+	return PX4_OK;
 }
+#endif
 
 /**
  * @return true if file exists
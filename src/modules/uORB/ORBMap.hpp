@@ -35,6 +35,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 
 namespace uORB
@@ -43,104 +44,286 @@ class DeviceNode;
 class ORBMap;
 }
 
+/**
+ * Node path to DeviceNode lookup table.
+ *
+ * Open addressing with linear probing. Each slot caches the FNV-1a hash of its
+ * name, so a probe only calls strcmp on a full hash match. At most 3/4 of the
+ * slots are used, which keeps probe sequences short and guarantees every lookup
+ * terminates on an empty slot.
+ *
+ * Lookups may run concurrently with an insert: a lookup sees a slot either
+ * before or after its name is set, as with the list this replaces. When the
+ * table is full, insert() moves the entries to a table of twice the size and
+ * swaps it in. The old table is kept until the map is destroyed, because a
+ * concurrent lookup may still probe it; with the doubling this costs at most
+ * as much as the current table.
+ */
 class uORB::ORBMap
 {
 public:
 	struct Node {
-		struct Node *next;
 		const char *node_name;
+		uint32_t hash;
 		uORB::DeviceNode *node;
 	};
 
+	static const unsigned DEFAULT_CAPACITY = 64;
+
 	ORBMap() :
-		_top(nullptr),
-		_end(nullptr)
+		_table(nullptr),
+		_size(0)
 	{ }
 	~ORBMap()
 	{
-		while (_top != nullptr) {
-			unlinkNext(_top);
-
-			if (_top->next == nullptr) {
-				free((void *)_top->node_name);
-				free(_top);
-				_top = nullptr;
-				_end = nullptr;
+		if (_table != nullptr) {
+			for (unsigned i = 0; i <= _table->mask; i++) {
+				free((void *)_table->slots[i].node_name);
 			}
 		}
+
+		// the names are shared with the retired tables
+		while (_table != nullptr) {
+			Table *retired = _table->retired;
+			free(_table);
+			_table = retired;
+		}
 	}
-	void insert(const char *node_name, uORB::DeviceNode *node)
+
+	/**
+	 * Allocate the slot array for at least min_entries names.
+	 * Does nothing if the table is already allocated.
+	 * @return true if the table is allocated
+	 */
+	bool reserve(unsigned min_entries)
 	{
-		Node **p;
+		if (_table != nullptr) {
+			return true;
+		}
+
+		unsigned capacity = 8;
+
+		while (capacity - capacity / 4 < min_entries) {
+			capacity <<= 1;
+		}
 
-		if (_top == nullptr) {
-			p = &_top;
+		Table *table = allocate(capacity);
 
-		} else {
-			p = &_end->next;
+		if (table == nullptr) {
+			return false;
 		}
 
-		*p = (Node *)malloc(sizeof(Node));
+		__atomic_store_n(&_table, table, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	/**
+	 * Add node_name, or replace the node of an existing entry.
+	 * Inserts must be serialized by the caller.
+	 * @return false if out of memory
+	 */
+	bool insert(const char *node_name, uORB::DeviceNode *node)
+	{
+		if (!reserve(DEFAULT_CAPACITY - DEFAULT_CAPACITY / 4)) {
+			return false;
+		}
 
-		if (_end) {
-			_end = _end->next;
+		const uint32_t h = hash(node_name);
+		Node *slot = probe(_table, node_name, h);
+
+		if (slot->node_name != nullptr) {
+			slot->node = node;
+			return true;
+		}
+
+		if (_size >= max_size()) {
+			if (!grow()) {
+				return false;
+			}
 
-		} else {
-			_end = _top;
+			slot = probe(_table, node_name, h);
 		}
 
-		_end->next = nullptr;
-		_end->node_name = strdup(node_name);
-		_end->node = node;
+		const char *name = strdup(node_name);
+
+		if (name == nullptr) {
+			return false;
+		}
+
+		slot->hash = h;
+		slot->node = node;
+		// set last: a concurrent lookup treats the slot as empty until now
+		__atomic_store_n(&slot->node_name, name, __ATOMIC_RELEASE);
+		_size++;
+		return true;
+	}
+
+	bool find(const char *node_name) const
+	{
+		return lookup(node_name) != nullptr;
+	}
+
+	uORB::DeviceNode *get(const char *node_name) const
+	{
+		const Node *p = lookup(node_name);
+		return (p != nullptr) ? p->node : nullptr;
 	}
 
-	bool find(const char *node_name)
+	/**
+	 * Remove node_name. Later entries of the probe sequence are shifted back
+	 * into the hole, so no tombstones are needed. Not safe against concurrent
+	 * lookups.
+	 */
+	bool erase(const char *node_name)
 	{
-		Node *p = _top;
+		Node *p = const_cast<Node *>(lookup(node_name));
+
+		if (p == nullptr) {
+			return false;
+		}
+
+		free((void *)p->node_name);
+
+		Node *slots = _table->slots;
+		const unsigned mask = _table->mask;
+		unsigned hole = p - slots;
+		unsigned j = hole;
+
+		for (;;) {
+			j = (j + 1) & mask;
+
+			if (slots[j].node_name == nullptr) {
+				break;
+			}
+
+			// the entry at j can fill the hole unless its home slot lies cyclically in (hole, j]
+			const unsigned home = slots[j].hash & mask;
+			const bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
 
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return true;
+			if (!stays) {
+				slots[hole] = slots[j];
+				hole = j;
 			}
+		}
+
+		slots[hole].node_name = nullptr;
+		slots[hole].node = nullptr;
+		_size--;
+		return true;
+	}
+
+	/**
+	 * Entry in slot index, for iterating over [0, capacity()).
+	 * @return nullptr if the slot is empty
+	 */
+	const Node *slot(unsigned index) const
+	{
+		const Table *table = __atomic_load_n(&_table, __ATOMIC_ACQUIRE);
+
+		if (table == nullptr || index > table->mask || table->slots[index].node_name == nullptr) {
+			return nullptr;
+		}
+
+		return &table->slots[index];
+	}
 
-			p = p->next;
+	unsigned size() const { return _size; }
+	unsigned capacity() const
+	{
+		const Table *table = __atomic_load_n(&_table, __ATOMIC_ACQUIRE);
+		return (table != nullptr) ? table->mask + 1 : 0;
+	}
+	unsigned max_size() const { return capacity() - capacity() / 4; }
+
+private:
+	struct Table {
+		unsigned mask;
+		Table *retired;	///< previous, smaller table
+		Node slots[1];
+	};
+
+	static Table *allocate(unsigned capacity)
+	{
+		Table *table = (Table *)calloc(1, sizeof(Table) + (capacity - 1) * sizeof(Node));
+
+		if (table != nullptr) {
+			table->mask = capacity - 1;
 		}
 
-		return false;
+		return table;
 	}
 
-	uORB::DeviceNode *get(const char *node_name)
+	/**
+	 * Move the entries to a table of twice the size
+	 */
+	bool grow()
 	{
-		Node *p = _top;
+		Table *table = allocate(2 * (_table->mask + 1));
 
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return p->node;
+		if (table == nullptr) {
+			return false;
+		}
+
+		for (unsigned i = 0; i <= _table->mask; i++) {
+			const Node &entry = _table->slots[i];
+
+			if (entry.node_name != nullptr) {
+				*probe(table, entry.node_name, entry.hash) = entry;
 			}
+		}
+
+		table->retired = _table;
+		__atomic_store_n(&_table, table, __ATOMIC_RELEASE);
+		return true;
+	}
 
-			p = p->next;
+	static uint32_t hash(const char *s)
+	{
+		uint32_t h = 2166136261u;
+
+		while (*s) {
+			h ^= (uint8_t)(*s++);
+			h *= 16777619u;
 		}
 
-		return nullptr;
+		return h;
 	}
 
-	void unlinkNext(Node *a)
+	/**
+	 * Slot of node_name, or the empty slot that ends its probe sequence
+	 */
+	static Node *probe(Table *table, const char *node_name, uint32_t h)
 	{
-		Node *b = a->next;
+		unsigned i = h & table->mask;
+		const char *name;
 
-		if (b != nullptr) {
-			if (_end == b) {
-				_end = a;
+		while ((name = __atomic_load_n(&table->slots[i].node_name, __ATOMIC_ACQUIRE)) != nullptr) {
+			if (table->slots[i].hash == h && strcmp(name, node_name) == 0) {
+				break;
 			}
 
-			a->next = b->next;
-			free((void *)b->node_name);
-			free(b);
+			i = (i + 1) & table->mask;
 		}
+
+		return &table->slots[i];
 	}
 
-private:
-	Node *_top;
-	Node *_end;
-};
+	const Node *lookup(const char *node_name) const
+	{
+		Table *table = __atomic_load_n(&_table, __ATOMIC_ACQUIRE);
+
+		if (table == nullptr) {
+			return nullptr;
+		}
 
+		const Node *p = probe(table, node_name, hash(node_name));
+		return (p->node_name != nullptr) ? p : nullptr;
+	}
+
+	// disable copy and assignment operators
+	ORBMap(const ORBMap &);
+	ORBMap &operator=(const ORBMap &);
+
+	Table *_table;
+	unsigned _size;
+};
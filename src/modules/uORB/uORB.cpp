@@ -89,6 +89,16 @@ int  orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const voi
 	return uORB::Manager::get_instance()->orb_publish(meta, handle, data);
 }
 
+void *orb_loan(const struct orb_metadata *meta, orb_advert_t handle)
+{
+	return uORB::Manager::get_instance()->orb_loan(meta, handle);
+}
+
+int orb_commit(const struct orb_metadata *meta, orb_advert_t handle)
+{
+	return uORB::Manager::get_instance()->orb_commit(meta, handle);
+}
+
 int  orb_subscribe(const struct orb_metadata *meta)
 {
 	return uORB::Manager::get_instance()->orb_subscribe(meta);
@@ -109,6 +119,18 @@ int  orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
 	return uORB::Manager::get_instance()->orb_copy(meta, handle, buffer);
 }
 
+int  orb_borrow(const struct orb_metadata *meta, int handle, struct orb_view *view)
+{
+	return uORB::Manager::get_instance()->orb_borrow(meta, handle, view);
+}
+
+bool orb_view_valid(const struct orb_view *view)
+{
+	/* order the caller's reads of view->data before the generation check (seqlock style) */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (*view->node_generation - view->generation) < view->queue_size;
+}
+
 int  orb_check(int handle, bool *updated)
 {
 	return uORB::Manager::get_instance()->orb_check(handle, updated);
@@ -135,6 +135,20 @@ __BEGIN_DECLS
  */
 typedef void 	*orb_advert_t;
 
+/**
+ * Read-only view of a topic message, filled by orb_borrow().
+ *
+ * The view points into the queue of the topic instead of a private copy.
+ * It stays readable until the publisher has published as many new messages
+ * as the queue holds; orb_view_valid() tells whether that has happened.
+ */
+struct orb_view {
+	const void *data;			/**< the message, meta->o_size bytes */
+	unsigned generation;			/**< generation of the topic right after this message */
+	unsigned queue_size;			/**< queue size of the topic */
+	const volatile unsigned *node_generation;	/**< live generation counter of the topic */
+};
+
 /**
  * @see uORB::Manager::orb_advertise()
  */
@@ -179,6 +193,16 @@ extern int orb_publish_auto(const struct orb_metadata *meta, orb_advert_t *handl
  */
 extern int	orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_loan()
+ */
+extern void	*orb_loan(const struct orb_metadata *meta, orb_advert_t handle) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_commit()
+ */
+extern int	orb_commit(const struct orb_metadata *meta, orb_advert_t handle) __EXPORT;
+
 /**
  * @see uORB::Manager::orb_subscribe()
  */
@@ -199,6 +223,19 @@ extern int	orb_unsubscribe(int handle) __EXPORT;
  */
 extern int	orb_copy(const struct orb_metadata *meta, int handle, void *buffer) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_borrow()
+ */
+extern int	orb_borrow(const struct orb_metadata *meta, int handle, struct orb_view *view) __EXPORT;
+
+/**
+ * Check whether a view obtained with orb_borrow() still holds the message it
+ * was borrowed for. Call it after reading the data: if it returns false the
+ * publisher may have overwritten the buffer while it was read, and the data
+ * must be discarded (borrow again, or fall back to orb_copy()).
+ */
+extern bool	orb_view_valid(const struct orb_view *view) __EXPORT;
+
 /**
  * @see uORB::Manager::orb_check()
  */
@@ -40,6 +40,7 @@
 #include "uORBUtils.hpp"
 #include "uORBManager.hpp"
 #include "uORBCommunicator.hpp"
+#include "uORBTopics.h"
 #include <px4_sem.hpp>
 #include <stdlib.h>
 
@@ -63,7 +64,8 @@ uORB::DeviceNode::DeviceNode
 	_published(false),
 	_queue_size(queue_size),
 	_IsRemoteSubscriberPresent(false),
-	_subscriber_count(0)
+	_subscriber_count(0),
+	_statistics(meta)
 {
 	// enable debug() calls
 	_debug_enabled = true;
@@ -162,6 +164,11 @@ uORB::DeviceNode::close(struct file *filp)
 			}
 
 			remove_internal_subscriber();
+
+			if (sd->skipped > 0) {
+				_statistics.lagging_closed();
+			}
+
 			delete sd;
 			sd = nullptr;
 		}
@@ -192,6 +199,9 @@ uORB::DeviceNode::read(struct file *filp, char *buffer, size_t buflen)
 
 	if (_generation > sd->generation + _queue_size) {
 		/* Reader is too far behind: some messages are lost */
+		const unsigned skipped = _generation - _queue_size - sd->generation;
+		_statistics.skipped(skipped, sd->skipped == 0);
+		sd->skipped += skipped;
 		sd->generation = _generation - _queue_size;
 	}
 
@@ -222,6 +232,8 @@ uORB::DeviceNode::read(struct file *filp, char *buffer, size_t buflen)
 
 	px4_leave_critical_section(flags);
 
+	_statistics.copy(buffer);
+
 	return _meta->o_size;
 }
 
@@ -272,6 +284,8 @@ uORB::DeviceNode::write(struct file *filp, const char *buffer, size_t buflen)
 
 	_published = true;
 
+	_statistics.publication();
+
 	px4_leave_critical_section(flags);
 
 	/* notify any poll waiters */
@@ -655,6 +669,8 @@ uORB::DeviceMaster::DeviceMaster(Flavor f) :
 	// enable debug() calls
 	_debug_enabled = true;
 
+	// room for every topic with a second instance, the map grows beyond that if needed
+	_node_map.reserve(2 * orb_topics_count());
 }
 
 uORB::DeviceMaster::~DeviceMaster()
@@ -751,9 +767,12 @@ uORB::DeviceMaster::ioctl(struct file *filp, int cmd, unsigned long arg)
 					/* also discard the name now */
 					free((void *)devpath);
 
-				} else {
-					// add to the node map;.
-					_node_map.insert(nodepath, node);
+				} else if (!_node_map.insert(nodepath, node)) {
+					/* every registered node must be reachable through the map, see GetDeviceNode() */
+					PX4_ERR("no memory for the node map (%u), dropping %s", _node_map.size(), nodepath);
+					delete node;
+					free((void *)devpath);
+					return -ENOMEM;
 				}
 
 				group_tries++;
@@ -775,11 +794,17 @@ uORB::DeviceMaster::ioctl(struct file *filp, int cmd, unsigned long arg)
 
 uORB::DeviceNode *uORB::DeviceMaster::GetDeviceNode(const char *nodepath)
 {
-	uORB::DeviceNode *rc = nullptr;
+	return _node_map.get(nodepath);
+}
+
+uORB::DeviceNode *uORB::DeviceMaster::GetDeviceNode(unsigned index, const char **node_name)
+{
+	const ORBMap::Node *entry = _node_map.slot(index);
 
-	if (_node_map.find(nodepath)) {
-		rc = _node_map.get(nodepath);
+	if (entry == nullptr) {
+		return nullptr;
 	}
 
-	return rc;
+	*node_name = entry->node_name;
+	return entry->node;
 }
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include "ORBMap.hpp"
 #include "uORBCommon.hpp"
+#include "uORBNodeStatistics.hpp"
 
 
 namespace uORB
@@ -178,6 +179,15 @@ public:
 	 */
 	int update_queue_size(unsigned int queue_size);
 
+	/**
+	 * Counters for "uorb top" and the uorb_topic_stats topic.
+	 */
+	const NodeStatistics &statistics() const { return _statistics; }
+
+	const struct orb_metadata *get_meta() const { return _meta; }
+
+	int32_t subscriber_count() const { return _subscriber_count; }
+
 protected:
 	virtual pollevent_t poll_state(struct file *filp);
 	virtual void poll_notify_one(struct pollfd *fds, pollevent_t events);
@@ -191,6 +201,7 @@ private:
 		~SubscriberData() { if (update_interval) { delete(update_interval); } }
 
 		unsigned  generation; /**< last generation the subscriber has seen */
+		unsigned  skipped; /**< generations overwritten before the subscriber read them */
 		int   flags; /**< lowest 8 bits: priority of publisher, 9. bit: update_reported bit */
 		UpdateIntervalData *update_interval; /**< if null, no update interval */
 
@@ -222,6 +233,8 @@ private: // private class methods.
 	bool    _IsRemoteSubscriberPresent;
 	int32_t _subscriber_count;
 
+	NodeStatistics _statistics;
+
 	/**
 	 * Perform a deferred update for a rate-limited subscriber.
 	 */
@@ -260,6 +273,14 @@ public:
 	virtual ~DeviceMaster();
 
 	static uORB::DeviceNode *GetDeviceNode(const char *node_name);
+
+	/**
+	 * Iterate over all nodes, for index in [0, GetNodeSlots()).
+	 * @param node_name set to the path of the node
+	 * @return nullptr for an unused index
+	 */
+	static uORB::DeviceNode *GetDeviceNode(unsigned index, const char **node_name);
+	static unsigned GetNodeSlots() { return _node_map.capacity(); }
 	virtual int   ioctl(struct file *filp, int cmd, unsigned long arg);
 private:
 	const Flavor  _flavor;
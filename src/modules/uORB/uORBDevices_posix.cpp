@@ -35,16 +35,18 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sched.h>
 #include <algorithm>
 
 #include "uORBDevices_posix.hpp"
 #include "uORBUtils.hpp"
 #include "uORBManager.hpp"
 #include "uORBCommunicator.hpp"
+#include "uORBTopics.h"
 #include <px4_sem.hpp>
 #include <stdlib.h>
 
-std::map<std::string, uORB::DeviceNode *> uORB::DeviceMaster::_node_map;
+uORB::ORBMap uORB::DeviceMaster::_node_map;
 
 
 uORB::DeviceNode::SubscriberData  *uORB::DeviceNode::filp_to_sd(device::file_t *filp)
@@ -72,7 +74,13 @@ uORB::DeviceNode::DeviceNode(const struct orb_metadata *meta, const char *name,
 	_priority(priority),
 	_published(false),
 	_queue_size(queue_size),
-	_subscriber_count(0)
+	_slots(nullptr),
+	_loaned(false),
+	_seq(0),
+	_writer(0),
+	_multi_writer(false),
+	_subscriber_count(0),
+	_statistics(meta)
 {
 	// enable debug() calls
 	//_debug_enabled = true;
@@ -84,6 +92,9 @@ uORB::DeviceNode::~DeviceNode()
 		delete[] _data;
 	}
 
+	if (_slots != nullptr) {
+		delete[] _slots;
+	}
 }
 
 int
@@ -174,6 +185,11 @@ uORB::DeviceNode::close(device::file_t *filp)
 			}
 
 			remove_internal_subscriber();
+
+			if (sd->skipped > 0) {
+				_statistics.lagging_closed();
+			}
+
 			delete sd;
 			sd = nullptr;
 		}
@@ -189,7 +205,7 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 	SubscriberData *sd = (SubscriberData *)filp_to_sd(filp);
 
 	/* if the object has not been written yet, return zero */
-	if (_data == nullptr) {
+	if (__atomic_load_n(&_data, __ATOMIC_ACQUIRE) == nullptr || _generation == 0) {
 		return 0;
 	}
 
@@ -199,41 +215,38 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 	}
 
 	/*
-	 * Perform an atomic copy & state update
+	 * Topics with a single publisher are copied without the lock: the copy is
+	 * retried if a publication overlapped it. Rate-limited subscribers share
+	 * their state with the deferred poll notification and always take the lock.
 	 */
-	lock();
+	const bool locked = _multi_writer || sd->update_interval != nullptr;
 
-	if (_generation > sd->generation + _queue_size) {
-		/* Reader is too far behind: some messages are lost */
-		sd->generation = _generation - _queue_size;
+	if (locked) {
+		lock();
 	}
 
-	if (_generation == sd->generation && sd->generation > 0) {
-		/* The subscriber already read the latest message, but nothing new was published yet.
-		 * Return the previous message
-		 */
-		--sd->generation;
-	}
+	unsigned sub_generation;
+	unsigned generation;
+	unsigned seq;
 
-	/* if the caller doesn't want the data, don't give it to them */
-	if (nullptr != buffer) {
-		memcpy(buffer, _data + (_meta->o_size * (sd->generation % _queue_size)), _meta->o_size);
-	}
+	do {
+		seq = read_begin();
+		sub_generation = sd->generation;
+		generation = collect_generation(sub_generation);
 
-	if (sd->generation < _generation) {
-		++sd->generation;
-	}
+		/* if the caller doesn't want the data, don't give it to them */
+		if (nullptr != buffer) {
+			memcpy(buffer, _slots[generation % _queue_size], _meta->o_size);
+		}
+	} while (read_retry(seq));
 
-	/* set priority */
-	sd->set_priority(_priority);
+	mark_collected(sd, generation, sub_generation);
 
-	/*
-	 * Clear the flag that indicates that an update has been reported, as
-	 * we have just collected it.
-	 */
-	sd->set_update_reported(false);
+	if (locked) {
+		unlock();
+	}
 
-	unlock();
+	_statistics.copy(buffer);
 
 	return _meta->o_size;
 }
@@ -252,18 +265,10 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 	 * Note that filp will usually be NULL.
 	 */
 	if (nullptr == _data) {
-		lock();
-
-		/* re-check size */
-		if (nullptr == _data) {
-			_data = new uint8_t[_meta->o_size * _queue_size];
-		}
+		int ret = allocate();
 
-		unlock();
-
-		/* failed or could not allocate */
-		if (nullptr == _data) {
-			return -ENOMEM;
+		if (ret != PX4_OK) {
+			return ret;
 		}
 	}
 
@@ -272,17 +277,22 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 		return -EIO;
 	}
 
-	lock();
-	memcpy(_data + (_meta->o_size * (_generation % _queue_size)), buffer, _meta->o_size);
+	/* a second publisher moves the topic to the locked path, see single_writer() */
+	const bool locked = !single_writer();
 
-	/* update the timestamp and generation count */
-	_last_update = hrt_absolute_time();
-	/* wrap-around happens after ~49 days, assuming a publisher rate of 1 kHz */
-	_generation++;
+	if (locked) {
+		lock();
+	}
 
-	_published = true;
+	write_begin();
+	/* fill the spare and swap it in, so the buffer a borrower may be reading is never written in place */
+	memcpy(_slots[_queue_size], buffer, _meta->o_size);
+	commit_slot(_queue_size);
+	write_end();
 
-	unlock();
+	if (locked) {
+		unlock();
+	}
 
 	/* notify any poll waiters */
 	poll_notify(POLLIN);
@@ -355,6 +365,38 @@ uORB::DeviceNode::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 		//and only one advertiser is allowed to open the DeviceNode at the same time.
 		return update_queue_size(arg);
 
+	case ORBIOCBORROW: {
+			orb_view *view = (orb_view *)arg;
+
+			lock();
+
+			/* nothing published yet (the buffers may already exist for a loan) */
+			if (_generation == 0) {
+				unlock();
+				return -ENODATA;
+			}
+
+			/* same generation bookkeeping as read(), without the copy */
+			unsigned sub_generation;
+			unsigned generation;
+			unsigned seq;
+
+			do {
+				seq = read_begin();
+				sub_generation = sd->generation;
+				generation = collect_generation(sub_generation);
+				view->data = _slots[generation % _queue_size];
+			} while (read_retry(seq));
+
+			mark_collected(sd, generation, sub_generation);
+			view->generation = sub_generation;
+			view->queue_size = _queue_size;
+			view->node_generation = &_generation;
+			unlock();
+			_statistics.copy(view->data);
+			return PX4_OK;
+		}
+
 	case ORBIOCGETINTERVAL:
 		if (sd->update_interval) {
 			*(unsigned *)arg = sd->update_interval->interval;
@@ -419,6 +461,204 @@ uORB::DeviceNode::publish(const orb_metadata *meta, orb_advert_t handle, const v
 	return PX4_OK;
 }
 
+void *uORB::DeviceNode::loan(const orb_metadata *meta, orb_advert_t handle)
+{
+	uORB::DeviceNode *devnode = (uORB::DeviceNode *)handle;
+
+	if (handle == nullptr || devnode->_meta != meta) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	if (devnode->_data == nullptr) {
+		int ret = devnode->allocate();
+
+		if (ret != PX4_OK) {
+			errno = -ret;
+			return nullptr;
+		}
+	}
+
+	void *buffer = nullptr;
+
+	devnode->lock();
+
+	if (!devnode->_loaned) {
+		devnode->_loaned = true;
+		buffer = devnode->_slots[devnode->_queue_size + 1];
+
+	} else {
+		errno = EBUSY;
+	}
+
+	devnode->unlock();
+
+	return buffer;
+}
+
+int uORB::DeviceNode::commit(const orb_metadata *meta, orb_advert_t handle)
+{
+	uORB::DeviceNode *devnode = (uORB::DeviceNode *)handle;
+
+	if (handle == nullptr || devnode->_meta != meta || !devnode->_loaned) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	/* send the loaned buffer over the Multi-ORB link before it becomes visible to the next loan */
+	uORBCommunicator::IChannel *ch = uORB::Manager::get_instance()->get_uorb_communicator();
+	int ret = PX4_OK;
+
+	if (ch != nullptr) {
+		if (ch->send_message(meta->o_name, meta->o_size, devnode->_slots[devnode->_queue_size + 1]) != 0) {
+			warnx("[uORB::DeviceNode::commit(%d)]: Error Sending [%s] topic data over comm_channel",
+			      __LINE__, meta->o_name);
+			ret = ERROR;
+		}
+	}
+
+	devnode->lock();
+	devnode->write_begin();
+	devnode->commit_slot(devnode->_queue_size + 1);
+	devnode->write_end();
+	devnode->_loaned = false;
+	devnode->unlock();
+
+	devnode->poll_notify(POLLIN);
+
+	return ret;
+}
+
+int
+uORB::DeviceNode::allocate()
+{
+	lock();
+
+	/* re-check, another publisher may have been first */
+	if (nullptr == _data) {
+		/* _queue_size ring slots, the spare for copying publishers and the loan buffer */
+		const unsigned num_slots = _queue_size + 2;
+		uint8_t **slots = new uint8_t *[num_slots];
+		uint8_t *data = new uint8_t[_meta->o_size * num_slots];
+
+		if (slots != nullptr && data != nullptr) {
+			for (unsigned i = 0; i < num_slots; i++) {
+				slots[i] = data + _meta->o_size * i;
+			}
+
+			_slots = slots;
+			/* lock-free readers test _data before they use _slots */
+			__atomic_store_n(&_data, data, __ATOMIC_RELEASE);
+
+		} else {
+			delete[] slots;
+			delete[] data;
+		}
+	}
+
+	unlock();
+
+	/* failed or could not allocate */
+	return (nullptr == _data) ? -ENOMEM : PX4_OK;
+}
+
+void
+uORB::DeviceNode::commit_slot(unsigned buffer_index)
+{
+	/* the buffer at buffer_index becomes the newest queue slot, the displaced
+	 * (oldest) slot takes its place as spare or loan buffer */
+	const unsigned index = _generation % _queue_size;
+	uint8_t *displaced = _slots[index];
+	_slots[index] = _slots[buffer_index];
+	_slots[buffer_index] = displaced;
+
+	/* update the timestamp and generation count */
+	_last_update = hrt_absolute_time();
+	/* wrap-around happens after ~49 days, assuming a publisher rate of 1 kHz */
+	_generation++;
+
+	_published = true;
+
+	_statistics.publication();
+}
+
+bool
+uORB::DeviceNode::single_writer()
+{
+	if (_multi_writer) {
+		return false;
+	}
+
+	/* the first thread to publish becomes the writer */
+	const unsigned long self = px4_getpid();
+	unsigned long writer = 0;
+
+	if (__atomic_compare_exchange_n(&_writer, &writer, self, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+	    || writer == self) {
+		return true;
+	}
+
+	/* another thread publishes as well: readers and writers take the lock from now on */
+	_multi_writer = true;
+	return false;
+}
+
+void
+uORB::DeviceNode::write_begin()
+{
+	/* writers exclude each other with the odd sequence number, also on the locked
+	 * path, where a lock-free writer may still be finishing its publication */
+	unsigned seq = _seq;
+	unsigned tries = 0;
+
+	while ((seq & 1) || !__atomic_compare_exchange_n(&_seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		seq_backoff(tries);
+		seq = _seq;
+	}
+
+	/* order the sequence update before the writes to the buffers */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void
+uORB::DeviceNode::write_end()
+{
+	__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELEASE);
+}
+
+unsigned
+uORB::DeviceNode::read_begin()
+{
+	unsigned seq;
+	unsigned tries = 0;
+
+	/* wait for a publication in progress to finish */
+	while ((seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE)) & 1) {
+		seq_backoff(tries);
+	}
+
+	return seq;
+}
+
+void
+uORB::DeviceNode::seq_backoff(unsigned &tries)
+{
+	if (++tries < SEQ_SPIN_TRIES) {
+		sched_yield();
+
+	} else {
+		usleep(1);
+	}
+}
+
+bool
+uORB::DeviceNode::read_retry(unsigned seq)
+{
+	/* order the reads of the buffers before the sequence check */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq;
+}
+
 int uORB::DeviceNode::unadvertise(orb_advert_t handle)
 {
 	if (handle == nullptr) {
@@ -440,6 +680,10 @@ int uORB::DeviceNode::unadvertise(orb_advert_t handle)
 	 */
 	devnode->_published = false;
 
+	/* the next publisher may be another thread, let it take the lock-free path again */
+	devnode->_writer = 0;
+	devnode->_multi_writer = false;
+
 	return PX4_OK;
 }
 
@@ -587,6 +831,53 @@ bool uORB::DeviceNode::is_published()
 	return _published;
 }
 
+unsigned
+uORB::DeviceNode::collect_generation(unsigned &sub_generation)
+{
+	const unsigned generation = _generation;
+
+	if (generation > sub_generation + _queue_size) {
+		/* Reader is too far behind: some messages are lost */
+		sub_generation = generation - _queue_size;
+	}
+
+	if (generation == sub_generation && sub_generation > 0) {
+		/* The subscriber already read the latest message, but nothing new was published yet.
+		 * Return the previous message
+		 */
+		--sub_generation;
+	}
+
+	const unsigned message_generation = sub_generation;
+
+	if (sub_generation < generation) {
+		++sub_generation;
+	}
+
+	return message_generation;
+}
+
+void
+uORB::DeviceNode::mark_collected(SubscriberData *sd, unsigned message_generation, unsigned sub_generation)
+{
+	/* the subscriber expected sd->generation next, anything before the message it got is lost */
+	if (message_generation > sd->generation) {
+		_statistics.skipped(message_generation - sd->generation, sd->skipped == 0);
+		sd->skipped += message_generation - sd->generation;
+	}
+
+	sd->generation = sub_generation;
+
+	/* set priority */
+	sd->set_priority(_priority);
+
+	/*
+	 * Clear the flag that indicates that an update has been reported, as
+	 * we have just collected it.
+	 */
+	sd->set_update_reported(false);
+}
+
 int uORB::DeviceNode::update_queue_size(unsigned int queue_size)
 {
 	if (_queue_size == queue_size) {
@@ -610,8 +901,8 @@ int16_t uORB::DeviceNode::process_add_subscription(int32_t rateInHz)
 	// send the data to the remote entity.
 	uORBCommunicator::IChannel *ch = uORB::Manager::get_instance()->get_uorb_communicator();
 
-	if (_data != nullptr && ch != nullptr) { // _data will not be null if there is a publisher.
-		ch->send_message(_meta->o_name, _meta->o_size, _data);
+	if (_data != nullptr && _generation > 0 && ch != nullptr) { // _data will not be null if there is a publisher.
+		ch->send_message(_meta->o_name, _meta->o_size, _slots[(_generation - 1) % _queue_size]);
 	}
 
 	return PX4_OK;
@@ -660,6 +951,8 @@ uORB::DeviceMaster::DeviceMaster(Flavor f) :
 	// enable debug() calls
 	//_debug_enabled = true;
 
+	// room for every topic with a second instance, the map grows beyond that if needed
+	_node_map.reserve(2 * orb_topics_count());
 }
 
 uORB::DeviceMaster::~DeviceMaster()
@@ -756,9 +1049,12 @@ uORB::DeviceMaster::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 					/* also discard the name now */
 					free((void *)devpath);
 
-				} else {
-					// add to the node map;.
-					_node_map[std::string(nodepath)] = node;
+				} else if (!_node_map.insert(nodepath, node)) {
+					/* every registered node must be reachable through the map, see GetDeviceNode() */
+					PX4_ERR("no memory for the node map (%u), dropping %s", _node_map.size(), nodepath);
+					delete node;
+					free((void *)devpath);
+					return -ENOMEM;
 				}
 
 
@@ -781,14 +1077,17 @@ uORB::DeviceMaster::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 
 uORB::DeviceNode *uORB::DeviceMaster::GetDeviceNode(const char *nodepath)
 {
-	uORB::DeviceNode *rc = nullptr;
-	std::string np(nodepath);
+	return _node_map.get(nodepath);
+}
 
-	auto iter = _node_map.find(np);
+uORB::DeviceNode *uORB::DeviceMaster::GetDeviceNode(unsigned index, const char **node_name)
+{
+	const ORBMap::Node *entry = _node_map.slot(index);
 
-	if (iter != _node_map.end()) {
-		rc = iter->second;
+	if (entry == nullptr) {
+		return nullptr;
 	}
 
-	return rc;
+	*node_name = entry->node_name;
+	return entry->node;
 }
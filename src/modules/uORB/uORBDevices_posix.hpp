@@ -35,9 +35,9 @@
 #define _uORBDevices_posix_hpp_
 
 #include <stdint.h>
-#include <string>
-#include <map>
+#include "ORBMap.hpp"
 #include "uORBCommon.hpp"
+#include "uORBNodeStatistics.hpp"
 
 namespace uORB
 {
@@ -62,6 +62,21 @@ public:
 
 	static int        unadvertise(orb_advert_t handle);
 
+	/**
+	 * Loan the publisher a buffer to fill in place instead of passing a copy
+	 * to publish(). The buffer is not visible to subscribers until commit().
+	 * Only one loan per topic can be outstanding at a time.
+	 * @return buffer of meta->o_size bytes, or nullptr with errno set
+	 *   (EBUSY if another loan is outstanding)
+	 */
+	static void      *loan(const orb_metadata *meta, orb_advert_t handle);
+
+	/**
+	 * Publish the buffer obtained with loan(). It is swapped into the queue,
+	 * nothing is copied.
+	 */
+	static int        commit(const orb_metadata *meta, orb_advert_t handle);
+
 	/**
 	 * processes a request for add subscription from remote
 	 * @param rateInHz
@@ -115,6 +130,15 @@ public:
 	 */
 	int update_queue_size(unsigned int queue_size);
 
+	/**
+	 * Counters for "uorb top" and the uorb_topic_stats topic.
+	 */
+	const NodeStatistics &statistics() const { return _statistics; }
+
+	const struct orb_metadata *get_meta() const { return _meta; }
+
+	int32_t subscriber_count() const { return _subscriber_count; }
+
 protected:
 	virtual pollevent_t poll_state(device::file_t *filp);
 	virtual void    poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events);
@@ -129,6 +153,7 @@ private:
 		~SubscriberData() { if (update_interval) { delete(update_interval); } }
 
 		unsigned  generation; /**< last generation the subscriber has seen */
+		unsigned  skipped; /**< generations overwritten before the subscriber read them */
 		int   flags; /**< lowest 8 bits: priority of publisher, 9. bit: update_reported bit */
 		UpdateIntervalData *update_interval; /**< if null, no update interval */
 
@@ -151,8 +176,85 @@ private:
 
 	static SubscriberData    *filp_to_sd(device::file_t *filp);
 
+	/**
+	 * Queue buffers, swapped instead of copied on publication:
+	 * [0, _queue_size) are the queue, indexed by generation % _queue_size,
+	 * [_queue_size] is the spare write() copies into and
+	 * [_queue_size + 1] is the buffer handed out by loan().
+	 * A buffer that left the queue is only written again after the generation
+	 * counter moved on by _queue_size, which is what orb_view_valid() checks.
+	 */
+	uint8_t **_slots;
+	bool _loaned; /**< the loan buffer is held by a publisher */
+
+	/**
+	 * Allocate _data and _slots on first use.
+	 */
+	int       allocate();
+
+	/**
+	 * Make _slots[buffer_index] the newest queue slot and bump the generation.
+	 *
+	 * Lock must already be held when calling this.
+	 */
+	void      commit_slot(unsigned buffer_index);
+
+	/**
+	 * Publications are stamped with a sequence number that is odd while a
+	 * publisher fills the spare and swaps it in (seqlock). Readers copy without
+	 * the lock and retry if the number changed meanwhile. As long as a single
+	 * thread publishes, the publisher does not take the lock either; once a
+	 * second thread publishes, both sides fall back to the lock (see
+	 * single_writer()), so readers wait instead of spinning on torn copies.
+	 */
+	volatile unsigned _seq;
+	volatile unsigned long _writer; /**< thread that publishes on the lock-free path, 0 if none yet */
+	volatile bool _multi_writer; /**< more than one thread published since the last unadvertise */
+
+	/**
+	 * Register the calling thread as the writer of the topic.
+	 * @return true if the caller may publish without the lock
+	 */
+	bool      single_writer();
+
+	/**
+	 * Start and end a publication. Writers exclude each other here, with or without the lock.
+	 */
+	void      write_begin();
+	void      write_end();
+
+	/**
+	 * Start a read of the buffers, and check afterwards whether it has to be retried.
+	 */
+	unsigned  read_begin();
+	bool      read_retry(unsigned seq);
+
+	/**
+	 * Wait for a publication in progress. sched_yield() only lets threads of the same
+	 * priority run: after SEQ_SPIN_TRIES the caller sleeps instead, so that a lower
+	 * priority publisher it preempted can finish, also on a single core.
+	 */
+	static void seq_backoff(unsigned &tries);
+
+	static constexpr unsigned SEQ_SPIN_TRIES = 16;
+
+	/**
+	 * Advance the generation of a subscriber that collects a message.
+	 *
+	 * @param sub_generation generation of the subscriber, updated in place
+	 * @return generation of the message to hand out
+	 */
+	unsigned  collect_generation(unsigned &sub_generation);
+
+	/**
+	 * Store the generation computed by collect_generation() once the message was read.
+	 */
+	void      mark_collected(SubscriberData *sd, unsigned message_generation, unsigned sub_generation);
+
 	int32_t _subscriber_count;
 
+	NodeStatistics _statistics;
+
 	/**
 	 * Perform a deferred update for a rate-limited subscriber.
 	 */
@@ -195,10 +297,18 @@ public:
 
 	static uORB::DeviceNode *GetDeviceNode(const char *node_name);
 
+	/**
+	 * Iterate over all nodes, for index in [0, GetNodeSlots()).
+	 * @param node_name set to the path of the node
+	 * @return nullptr for an unused index
+	 */
+	static uORB::DeviceNode *GetDeviceNode(unsigned index, const char **node_name);
+	static unsigned GetNodeSlots() { return _node_map.capacity(); }
+
 	virtual int   ioctl(device::file_t *filp, int cmd, unsigned long arg);
 private:
 	const Flavor      _flavor;
-	static std::map<std::string, uORB::DeviceNode *> _node_map;
+	static ORBMap _node_map;
 };
 
 #endif /* _uORBDeviceNode_posix.hpp */
@@ -32,17 +32,21 @@
  ****************************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "uORBDevices.hpp"
 #include "uORBManager.hpp"
 #include "uORB.h"
 #include "uORBCommon.hpp"
+#include "uORBStatistics.hpp"
 
 extern "C" { __EXPORT int uorb_main(int argc, char *argv[]); }
 
 static uORB::DeviceMaster *g_dev = nullptr;
+static uORB::StatisticsPublisher *g_stats = nullptr;
 static void usage()
 {
-	PX4_INFO("Usage: uorb 'start', 'status'");
+	PX4_INFO("Usage: uorb 'start', 'status', 'top' [interval_ms], 'stats' {start [interval_ms]|stop}");
 }
 
 int
@@ -103,6 +107,66 @@ uorb_main(int argc, char *argv[])
 		return OK;
 	}
 
+	/*
+	 * Print per-topic rates and latencies.
+	 */
+	if (!strcmp(argv[1], "top")) {
+		if (g_dev == nullptr) {
+			PX4_INFO("uorb is not running");
+			return -EINVAL;
+		}
+
+		unsigned interval_ms = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1000;
+		return uORB::print_top(interval_ms > 0 ? interval_ms : 1000);
+	}
+
+	/*
+	 * Publish the counters of all topics as uorb_topic_stats.
+	 */
+	if (!strcmp(argv[1], "stats") && argc > 2) {
+		if (!strcmp(argv[2], "start")) {
+			if (g_stats != nullptr) {
+				PX4_WARN("already running");
+				return 0;
+			}
+
+			unsigned interval_ms = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 20;
+			g_stats = new uORB::StatisticsPublisher(interval_ms > 0 ? interval_ms : 20);
+
+			if (g_stats == nullptr) {
+				PX4_ERR("alloc failed");
+				return -ENOMEM;
+			}
+
+			if (g_stats->start() != 0) {
+				PX4_ERR("start failed");
+				delete g_stats;
+				g_stats = nullptr;
+				return -EIO;
+			}
+
+			return OK;
+		}
+
+		if (!strcmp(argv[2], "stop")) {
+			if (g_stats == nullptr) {
+				PX4_WARN("not running");
+				return 0;
+			}
+
+			g_stats->stop();
+
+			/* wait up to 3s for the last cycle */
+			for (int i = 0; g_stats->is_running() && i < 30; i++) {
+				usleep(100000);
+			}
+
+			delete g_stats;
+			g_stats = nullptr;
+			return OK;
+		}
+	}
+
 	usage();
 	return -EINVAL;
 }
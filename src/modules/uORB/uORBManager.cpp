@@ -95,12 +95,13 @@ int uORB::Manager::orb_exists(const struct orb_metadata *meta, int instance)
 		return ERROR;
 	}
 
-#ifdef __PX4_NUTTX
-	struct stat buffer;
-	return stat(path, &buffer);
-#else
-	return px4_access(path, F_OK);
-#endif
+	/* every node is registered with the DeviceMaster, so there is no need to go through the file system */
+	if (uORB::DeviceMaster::GetDeviceNode(path) == nullptr) {
+		errno = ENOENT;
+		return ERROR;
+	}
+
+	return OK;
 }
 
 orb_advert_t uORB::Manager::orb_advertise(const struct orb_metadata *meta, const void *data, unsigned int queue_size)
@@ -220,6 +221,35 @@ int uORB::Manager::orb_publish(const struct orb_metadata *meta, orb_advert_t han
 	return uORB::DeviceNode::publish(meta, handle, data);
 }
 
+void *uORB::Manager::orb_loan(const struct orb_metadata *meta, orb_advert_t handle)
+{
+#ifdef __PX4_NUTTX
+	errno = ENOTSUP;
+	return nullptr;
+#else
+#ifdef ORB_USE_PUBLISHER_RULES
+
+	if (handle == _Instance) {
+		errno = EPERM;
+		return nullptr; // suppressed publisher, the caller falls back to orb_publish()
+	}
+
+#endif /* ORB_USE_PUBLISHER_RULES */
+
+	return uORB::DeviceNode::loan(meta, handle);
+#endif
+}
+
+int uORB::Manager::orb_commit(const struct orb_metadata *meta, orb_advert_t handle)
+{
+#ifdef __PX4_NUTTX
+	errno = ENOTSUP;
+	return ERROR;
+#else
+	return uORB::DeviceNode::commit(meta, handle);
+#endif
+}
+
 int uORB::Manager::orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
 {
 	int ret;
@@ -238,6 +268,16 @@ int uORB::Manager::orb_copy(const struct orb_metadata *meta, int handle, void *b
 	return PX4_OK;
 }
 
+int uORB::Manager::orb_borrow(const struct orb_metadata *meta, int handle, struct orb_view *view)
+{
+	/* errno is set by the ioctl on failure */
+	if (px4_ioctl(handle, ORBIOCBORROW, (unsigned long)(uintptr_t)view) < 0) {
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
 int uORB::Manager::orb_check(int handle, bool *updated)
 {
 	/* Set to false here so that if `px4_ioctl` fails to false. */
@@ -349,8 +389,11 @@ int uORB::Manager::node_open
 			return ERROR;
 		}
 
-		/* open the path as either the advertiser or the subscriber */
-		fd = px4_open(path, advertiser ? PX4_F_WRONLY : PX4_F_RDONLY);
+		/* open the path as either the advertiser or the subscriber, skipping the
+		 * failing open when the node does not exist yet */
+		if (uORB::DeviceMaster::GetDeviceNode(path) != nullptr) {
+			fd = px4_open(path, advertiser ? PX4_F_WRONLY : PX4_F_RDONLY);
+		}
 
 	} else {
 		*instance = 0;
@@ -167,6 +167,32 @@ public:
 	 */
 	int  orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data) ;
 
+	/**
+	 * Loan a buffer to publish into, instead of passing a copy to orb_publish().
+	 *
+	 * The publisher fills the returned buffer in place and publishes it with
+	 * orb_commit(); until then subscribers do not see it. Nothing is copied
+	 * on publication. Only one loan per topic can be outstanding, so a topic
+	 * with several publishers may return NULL here, in which case the caller
+	 * should fall back to orb_publish(). Loans are not available on NuttX.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  The handle returned from orb_advertise.
+	 * @return    buffer of meta->o_size bytes, or NULL with errno set.
+	 */
+	void *orb_loan(const struct orb_metadata *meta, orb_advert_t handle) ;
+
+	/**
+	 * Publish the buffer obtained with orb_loan() and notify waiting subscribers.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  The handle passed to orb_loan().
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_commit(const struct orb_metadata *meta, orb_advert_t handle) ;
+
 	/**
 	 * Subscribe to a topic.
 	 *
@@ -255,6 +281,23 @@ public:
 	 */
 	int  orb_copy(const struct orb_metadata *meta, int handle, void *buffer) ;
 
+	/**
+	 * Borrow a read-only view of a topic instead of copying it.
+	 *
+	 * Same semantics as orb_copy() (the update flag is reset and queued
+	 * messages are handed out in order), but view->data points into the
+	 * topic queue. After reading, orb_view_valid() must confirm that the
+	 * publisher did not reuse the buffer meanwhile. Not available on NuttX.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param handle  A handle returned from orb_subscribe.
+	 * @param view    Filled with the view of the message.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly
+	 *      (ENODATA if nothing was published yet).
+	 */
+	int  orb_borrow(const struct orb_metadata *meta, int handle, struct orb_view *view) ;
+
 	/**
 	 * Check whether a topic has been published to since the last orb_copy.
 	 *
@@ -0,0 +1,167 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <drivers/drv_hrt.h>
+#include "uORB.h"
+
+
+namespace uORB
+{
+class NodeStatistics;
+}
+
+/**
+ * Counters of one DeviceNode, read by "uorb top" and published as uorb_topic_stats.
+ *
+ * The counters only ever increase (and wrap), rates are computed from two
+ * snapshots. Updates are relaxed atomic increments, so lock-free readers can
+ * record copies concurrently; nothing here takes a lock or allocates.
+ * The latency of a copy is the age of the timestamp field of the message,
+ * which only exists for the generated topics.
+ * Each node carries 68 bytes of counters: about 6 KB for the 90 or so nodes of
+ * an FMUv2 setup, allocated with the nodes when the topics are advertised.
+ */
+class uORB::NodeStatistics
+{
+public:
+	/**
+	 * Latency histogram: bucket 0 counts copies younger than 16 us, bucket k
+	 * counts [2^(k+3), 2^(k+4)) us, the last one everything from 16 ms on.
+	 * Must match uorb_topic_stats_s::LATENCY_BUCKETS.
+	 */
+	static const unsigned LATENCY_BUCKETS = 12;
+
+	struct Snapshot {
+		uint32_t publications;
+		uint32_t copies;
+		uint32_t skipped;	/**< generations overwritten before a subscriber read them */
+		uint32_t lagging;	/**< open subscriptions that skipped generations */
+		uint32_t latency[LATENCY_BUCKETS];
+	};
+
+	NodeStatistics(const struct orb_metadata *meta) :
+		_timestamped(meta->o_fields != nullptr && strncmp(meta->o_fields, "uint64_t timestamp;", 19) == 0)
+	{
+		memset(&_counters, 0, sizeof(_counters));
+	}
+
+	/**
+	 * Count a publication. Publications of a node are serialized by the caller.
+	 */
+	void publication() { _counters.publications++; }
+
+	/**
+	 * Count a copy handed to a subscriber.
+	 * @param message the copied message, or nullptr if the caller did not want the data
+	 */
+	void copy(const void *message)
+	{
+		add(&_counters.copies, 1);
+
+		if (!_timestamped || message == nullptr) {
+			return;
+		}
+
+		uint64_t timestamp;
+		memcpy(&timestamp, message, sizeof(timestamp));
+
+		/* unset or not from this clock (e.g. replayed) */
+		const hrt_abstime now = hrt_absolute_time();
+
+		if (timestamp == 0 || timestamp > now) {
+			return;
+		}
+
+		add(&_counters.latency[latency_bucket(now - timestamp)], 1);
+	}
+
+	/**
+	 * Count generations a subscriber missed.
+	 * @param first true if this is the first time this subscriber missed any
+	 */
+	void skipped(unsigned generations, bool first)
+	{
+		add(&_counters.skipped, generations);
+
+		if (first) {
+			add(&_counters.lagging, 1);
+		}
+	}
+
+	/**
+	 * A subscriber that missed generations closed its subscription.
+	 */
+	void lagging_closed() { __atomic_fetch_sub(&_counters.lagging, 1, __ATOMIC_RELAXED); }
+
+	void snapshot(Snapshot &s) const
+	{
+		s.publications = __atomic_load_n(&_counters.publications, __ATOMIC_RELAXED);
+		s.copies = __atomic_load_n(&_counters.copies, __ATOMIC_RELAXED);
+		s.skipped = __atomic_load_n(&_counters.skipped, __ATOMIC_RELAXED);
+		s.lagging = __atomic_load_n(&_counters.lagging, __ATOMIC_RELAXED);
+
+		for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+			s.latency[i] = __atomic_load_n(&_counters.latency[i], __ATOMIC_RELAXED);
+		}
+	}
+
+	static unsigned latency_bucket(hrt_abstime latency_us)
+	{
+		if (latency_us < 16) {
+			return 0;
+		}
+
+		const uint32_t l = (latency_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency_us;
+		const unsigned bucket = 31 - __builtin_clz(l) - 3;
+		return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+	}
+
+	/**
+	 * @return upper bound of a latency bucket in us, 0 for the open-ended last bucket
+	 */
+	static uint32_t latency_bucket_limit(unsigned bucket)
+	{
+		return (bucket + 1 < LATENCY_BUCKETS) ? (16u << bucket) : 0;
+	}
+
+private:
+	static void add(uint32_t *counter, uint32_t value) { __atomic_fetch_add(counter, value, __ATOMIC_RELAXED); }
+
+	const bool _timestamped;
+	Snapshot _counters;
+};
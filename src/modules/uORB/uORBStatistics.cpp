@@ -0,0 +1,286 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <px4_log.h>
+#include <drivers/drv_hrt.h>
+
+#include "uORBStatistics.hpp"
+#include "uORBDevices.hpp"
+
+static_assert(uORB::NodeStatistics::LATENCY_BUCKETS == uorb_topic_stats_s::LATENCY_BUCKETS,
+	      "latency histogram size mismatch");
+
+/**
+ * Topic instance from a node path such as /obj/sensor_accel1.
+ */
+static unsigned node_instance(const char *node_name)
+{
+	const size_t len = strlen(node_name);
+
+	if (len > 0 && node_name[len - 1] >= '0' && node_name[len - 1] <= '9') {
+		return node_name[len - 1] - '0';
+	}
+
+	return 0;
+}
+
+/**
+ * Latency below which a share of the copies in a histogram delta falls, in us.
+ * @return 0 if there are no copies, UINT32_MAX for the open-ended last bucket
+ */
+static uint32_t latency_percentile(const uint32_t *before, const uint32_t *after, float share)
+{
+	uint32_t total = 0;
+
+	for (unsigned i = 0; i < uORB::NodeStatistics::LATENCY_BUCKETS; i++) {
+		total += after[i] - before[i];
+	}
+
+	if (total == 0) {
+		return 0;
+	}
+
+	uint32_t count = 0;
+
+	for (unsigned i = 0; i < uORB::NodeStatistics::LATENCY_BUCKETS; i++) {
+		count += after[i] - before[i];
+
+		if (count >= share * total) {
+			const uint32_t limit = uORB::NodeStatistics::latency_bucket_limit(i);
+			return (limit > 0) ? limit : UINT32_MAX;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void format_latency(char *buf, size_t len, uint32_t latency_us)
+{
+	if (latency_us == 0) {
+		snprintf(buf, len, "-");
+
+	} else if (latency_us == UINT32_MAX) {
+		snprintf(buf, len, ">16ms");
+
+	} else if (latency_us >= 1000) {
+		snprintf(buf, len, "<%ums", (unsigned)(latency_us / 1000));
+
+	} else {
+		snprintf(buf, len, "<%uus", (unsigned)latency_us);
+	}
+}
+
+/*
+ * Nodes sampled per interval by print_top(). The snapshots of all the nodes do not fit
+ * into the RAM of the small boards, so there the nodes are sampled in batches, one
+ * interval each.
+ */
+#ifdef __PX4_NUTTX
+static const unsigned TOP_BATCH_NODES = 16;
+#else
+static const unsigned TOP_BATCH_NODES = 256;
+#endif
+
+/**
+ * A node sampled by print_top(). Nodes and their names are never freed.
+ */
+struct TopEntry {
+	uORB::DeviceNode *node;
+	const char *node_name;
+	uORB::NodeStatistics::Snapshot before;
+};
+
+int uORB::print_top(unsigned interval_ms)
+{
+	unsigned slots = DeviceMaster::GetNodeSlots();
+
+	if (slots == 0) {
+		PX4_INFO("no topics");
+		return 0;
+	}
+
+	TopEntry *batch = new TopEntry[TOP_BATCH_NODES];
+
+	if (batch == nullptr) {
+		return -ENOMEM;
+	}
+
+	PX4_INFO("%-32s %4s %6s %8s %8s %8s %5s %7s %7s", "TOPIC", "#SUB", "PUB/s", "kB/s", "COPY/s", "SKIP/s",
+		 "#LAG", "LAT50", "LAT99");
+
+	unsigned next_slot = 0;
+
+	while (next_slot < slots) {
+		unsigned count = 0;
+
+		for (; next_slot < slots && count < TOP_BATCH_NODES; next_slot++) {
+			TopEntry &entry = batch[count];
+			entry.node = DeviceMaster::GetDeviceNode(next_slot, &entry.node_name);
+
+			if (entry.node != nullptr) {
+				entry.node->statistics().snapshot(entry.before);
+				count++;
+			}
+		}
+
+		if (count == 0) {
+			break;
+		}
+
+		const hrt_abstime start = hrt_absolute_time();
+		usleep(interval_ms * 1000);
+		const float dt = hrt_elapsed_time(&start) * 1e-6f;
+
+		for (unsigned i = 0; i < count; i++) {
+			const TopEntry &entry = batch[i];
+			const NodeStatistics::Snapshot &prev = entry.before;
+			NodeStatistics::Snapshot now;
+			entry.node->statistics().snapshot(now);
+
+			if (now.publications - prev.publications == 0 && now.copies - prev.copies == 0) {
+				continue;
+			}
+
+			const float publications = (now.publications - prev.publications) / dt;
+			char lat50[12];
+			char lat99[12];
+			format_latency(lat50, sizeof(lat50), latency_percentile(prev.latency, now.latency, 0.5f));
+			format_latency(lat99, sizeof(lat99), latency_percentile(prev.latency, now.latency, 0.99f));
+
+			/* skip the /obj/ prefix */
+			const char *name = strrchr(entry.node_name, '/');
+			name = (name != nullptr) ? name + 1 : entry.node_name;
+
+			PX4_INFO("%-32s %4d %6.1f %8.2f %8.1f %8.1f %5u %7s %7s", name, (int)entry.node->subscriber_count(),
+				 (double)publications, (double)(publications * entry.node->get_meta()->o_size / 1024.f),
+				 (double)((now.copies - prev.copies) / dt), (double)((now.skipped - prev.skipped) / dt),
+				 (unsigned)now.lagging, lat50, lat99);
+		}
+
+		/* the map grew and rehashed meanwhile, the remaining slot indices are stale */
+		if (DeviceMaster::GetNodeSlots() != slots) {
+			break;
+		}
+	}
+
+	delete[] batch;
+	return 0;
+}
+
+uORB::StatisticsPublisher::StatisticsPublisher(unsigned interval_ms) :
+	_interval_us(interval_ms * 1000),
+	_should_exit(false),
+	_running(false),
+	_work{},
+	_index(0),
+	_stats{},
+	_stats_pub(nullptr)
+{
+}
+
+uORB::StatisticsPublisher::~StatisticsPublisher()
+{
+	work_cancel(LPWORK, &_work);
+
+	if (_stats_pub != nullptr) {
+		orb_unadvertise(_stats_pub);
+	}
+}
+
+int uORB::StatisticsPublisher::start()
+{
+	_should_exit = false;
+	_running = true;
+	return work_queue(LPWORK, &_work, (worker_t)&StatisticsPublisher::cycle_trampoline, this, 0);
+}
+
+void uORB::StatisticsPublisher::cycle_trampoline(void *arg)
+{
+	StatisticsPublisher *publisher = reinterpret_cast<StatisticsPublisher *>(arg);
+
+	publisher->cycle();
+}
+
+void uORB::StatisticsPublisher::cycle()
+{
+	if (_should_exit) {
+		_running = false;
+		return;
+	}
+
+	publish_next();
+
+	work_queue(LPWORK, &_work, (worker_t)&StatisticsPublisher::cycle_trampoline, this, USEC2TICK(_interval_us));
+}
+
+void uORB::StatisticsPublisher::publish_next()
+{
+	const unsigned slots = DeviceMaster::GetNodeSlots();
+	const char *node_name = nullptr;
+	DeviceNode *node = nullptr;
+
+	for (unsigned tries = 0; tries < slots && node == nullptr; tries++) {
+		_index = (_index + 1) % slots;
+		node = DeviceMaster::GetDeviceNode(_index, &node_name);
+	}
+
+	if (node == nullptr) {
+		return;
+	}
+
+	NodeStatistics::Snapshot s;
+	node->statistics().snapshot(s);
+
+	_stats.timestamp = hrt_absolute_time();
+	strncpy((char *)_stats.topic_name, node->get_meta()->o_name, sizeof(_stats.topic_name) - 1);
+	_stats.topic_name[sizeof(_stats.topic_name) - 1] = '\0';
+	_stats.instance = node_instance(node_name);
+	_stats.subscribers = node->subscriber_count();
+	_stats.size = node->get_meta()->o_size;
+	_stats.publications = s.publications;
+	_stats.copies = s.copies;
+	_stats.skipped = s.skipped;
+	_stats.lagging_subscribers = s.lagging;
+	memcpy(_stats.latency_histogram, s.latency, sizeof(_stats.latency_histogram));
+
+	if (_stats_pub == nullptr) {
+		_stats_pub = orb_advertise(ORB_ID(uorb_topic_stats), &_stats);
+
+	} else {
+		orb_publish(ORB_ID(uorb_topic_stats), _stats_pub, &_stats);
+	}
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <px4_workqueue.h>
+#include <uORB/topics/uorb_topic_stats.h>
+#include "uORBCommon.hpp"
+
+namespace uORB
+{
+class StatisticsPublisher;
+
+/**
+ * Print the rates of all topics measured over interval_ms ("uorb top"). The nodes
+ * are sampled in batches of a fixed size, one interval per batch, so that the RAM
+ * needed does not depend on the number of nodes.
+ */
+int print_top(unsigned interval_ms);
+}
+
+/**
+ * Publishes the NodeStatistics of one topic instance per cycle as
+ * uorb_topic_stats, going round robin over all nodes, so that the logger
+ * can record them.
+ */
+class uORB::StatisticsPublisher
+{
+public:
+	StatisticsPublisher(unsigned interval_ms);
+	~StatisticsPublisher();
+
+	int start();
+	void stop() { _should_exit = true; }
+	bool is_running() const { return _running; }
+
+	static void cycle_trampoline(void *arg);
+
+private:
+	void cycle();
+
+	/**
+	 * Publish the next node after _index.
+	 */
+	void publish_next();
+
+	const unsigned _interval_us;
+	volatile bool _should_exit;
+	volatile bool _running;
+	struct work_s _work;
+	unsigned _index;
+	struct uorb_topic_stats_s _stats;
+	orb_advert_t _stats_pub;
+};
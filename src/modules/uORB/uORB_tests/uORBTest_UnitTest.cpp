@@ -33,12 +33,17 @@
 
 #include "uORBTest_UnitTest.hpp"
 #include "../uORBCommon.hpp"
+#include "../uORBTopics.h"
 #include <px4_config.h>
 #include <px4_time.h>
 #include <stdio.h>
 #include <errno.h>
 #include <poll.h>
 
+#ifdef __PX4_POSIX
+#include <pthread.h>
+#endif
+
 uORBTest::UnitTest &uORBTest::UnitTest::instance()
 {
 	static uORBTest::UnitTest t;
@@ -219,6 +224,477 @@ int uORBTest::UnitTest::info()
 	return OK;
 }
 
+int uORBTest::UnitTest::benchmark(unsigned iterations)
+{
+	test_note("benchmarking topic lookup (%u iterations)", iterations);
+
+	const size_t num_topics = orb_topics_count();
+	const struct orb_metadata **topics = orb_get_topics();
+
+	/* startup: one subscription per declared topic, creating the nodes that do not exist yet.
+	 * Each subscription is closed right away to stay within the file descriptor limit. */
+	for (int pass = 0; pass < 2; pass++) {
+		hrt_abstime start = hrt_absolute_time();
+
+		for (size_t i = 0; i < num_topics; i++) {
+			int sub = orb_subscribe(topics[i]);
+
+			if (sub < 0) {
+				return test_fail("subscribe to %s failed: %d", topics[i]->o_name, errno);
+			}
+
+			orb_unsubscribe(sub);
+		}
+
+		print_rate((pass == 0) ? "startup, first subscription" : "startup, existing nodes",
+			   num_topics, hrt_elapsed_time(&start));
+	}
+
+	hrt_abstime start = hrt_absolute_time();
+	unsigned exists = 0;
+
+	for (size_t i = 0; i < num_topics; i++) {
+		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (orb_exists(topics[i], instance) == OK) {
+				exists++;
+			}
+		}
+	}
+
+	print_rate("orb_exists", num_topics * ORB_MULTI_MAX_INSTANCES, hrt_elapsed_time(&start));
+	test_note("%u of %u topic instances exist", exists, (unsigned)(num_topics * ORB_MULTI_MAX_INSTANCES));
+
+	start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < iterations; i++) {
+		int sub = orb_subscribe(ORB_ID(orb_test));
+
+		if (sub < 0) {
+			return test_fail("subscribe failed: %d", errno);
+		}
+
+		orb_unsubscribe(sub);
+	}
+
+	print_rate("orb_subscribe+unsubscribe", iterations, hrt_elapsed_time(&start));
+
+	struct orb_test t = {};
+	start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < iterations; i++) {
+		t.val = i;
+		orb_advert_t pub = orb_advertise(ORB_ID(orb_test), &t);
+
+		if (pub == nullptr) {
+			return test_fail("advertise failed: %d", errno);
+		}
+
+		orb_unadvertise(pub);
+	}
+
+	print_rate("orb_advertise+unadvertise", iterations, hrt_elapsed_time(&start));
+
+	return OK;
+}
+
+int uORBTest::UnitTest::loan_benchmark(unsigned iterations)
+{
+	test_note("benchmarking zero-copy publish/read of %u bytes (%u iterations)",
+		  (unsigned)sizeof(orb_test_large), iterations);
+
+	struct orb_test_large t = {};
+	struct orb_test_large u;
+	orb_advert_t pub = orb_advertise(ORB_ID(orb_test_large), &t);
+
+	if (pub == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	int sub = orb_subscribe(ORB_ID(orb_test_large));
+
+	if (sub < 0) {
+		orb_unadvertise(pub);
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	int ret = OK;
+	hrt_abstime start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < iterations; i++) {
+		t.val = i;
+		orb_publish(ORB_ID(orb_test_large), pub, &t);
+		orb_copy(ORB_ID(orb_test_large), sub, &u);
+
+		if (u.val != (int)i) {
+			ret = test_fail("orb_copy returned %d, expected %u", u.val, i);
+			break;
+		}
+	}
+
+	print_rate("orb_publish+orb_copy", iterations, hrt_elapsed_time(&start));
+
+	start = hrt_absolute_time();
+
+	for (unsigned i = 0; ret == OK && i < iterations; i++) {
+		struct orb_test_large *loan = (struct orb_test_large *)orb_loan(ORB_ID(orb_test_large), pub);
+
+		if (loan == nullptr) {
+			ret = test_fail("loan failed: %d", errno);
+			break;
+		}
+
+		loan->val = i;
+		loan->time = t.time;
+
+		if (orb_commit(ORB_ID(orb_test_large), pub) != OK) {
+			ret = test_fail("commit failed: %d", errno);
+			break;
+		}
+
+		struct orb_view view;
+
+		if (orb_borrow(ORB_ID(orb_test_large), sub, &view) != OK) {
+			ret = test_fail("borrow failed: %d", errno);
+			break;
+		}
+
+		const int val = ((const struct orb_test_large *)view.data)->val;
+
+		if (!orb_view_valid(&view) || val != (int)i) {
+			ret = test_fail("borrowed %d, expected %u", val, i);
+			break;
+		}
+	}
+
+	if (ret == OK) {
+		print_rate("orb_loan+commit+borrow", iterations, hrt_elapsed_time(&start));
+
+		/* a borrowed view is invalidated once the queue (size 1) wraps */
+		struct orb_view view;
+		orb_borrow(ORB_ID(orb_test_large), sub, &view);
+		orb_publish(ORB_ID(orb_test_large), pub, &t);
+
+		if (orb_view_valid(&view)) {
+			ret = test_fail("view still valid after the queue wrapped");
+		}
+	}
+
+	orb_unsubscribe(sub);
+	orb_unadvertise(pub);
+
+	return ret;
+}
+
+int uORBTest::UnitTest::poll_benchmark(unsigned iterations)
+{
+	/* the first one is published, the others stay idle */
+	const struct orb_metadata *topics[] = {
+		ORB_ID(orb_test), ORB_ID(orb_multitest), ORB_ID(orb_test_medium), ORB_ID(orb_test_medium_multi),
+		ORB_ID(orb_test_large), ORB_ID(orb_test_contention), ORB_ID(orb_test_contention_multi)
+	};
+	const unsigned num_fds = sizeof(topics) / sizeof(topics[0]);
+
+	test_note("benchmarking poll on %u subscriptions (%u iterations)", num_fds, iterations);
+
+	struct orb_test t = {};
+	orb_advert_t pub = orb_advertise(ORB_ID(orb_test), &t);
+
+	if (pub == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	/* a registered array must not be passed to px4_poll(), the set gets a copy */
+	px4_pollfd_struct_t fds[num_fds] = {};
+	px4_pollfd_struct_t set_fds[num_fds] = {};
+	struct orb_test_large buffer;
+	int ret = OK;
+
+	for (unsigned i = 0; i < num_fds; i++) {
+		fds[i].fd = -1;
+	}
+
+	for (unsigned i = 0; i < num_fds; i++) {
+		fds[i].fd = orb_subscribe(topics[i]);
+		fds[i].events = POLLIN;
+
+		if (fds[i].fd < 0) {
+			ret = test_fail("subscribe to %s failed: %d", topics[i]->o_name, errno);
+			break;
+		}
+
+		/* start with nothing ready */
+		bool updated = false;
+		orb_check(fds[i].fd, &updated);
+
+		if (updated) {
+			orb_copy(topics[i], fds[i].fd, &buffer);
+		}
+
+		set_fds[i] = fds[i];
+	}
+
+	px4_pollset_t pollset;
+	bool pollset_valid = false;
+
+	if (ret == OK) {
+		pollset_valid = px4_pollset_init(&pollset, set_fds, num_fds) == 0;
+
+		if (!pollset_valid) {
+			ret = test_fail("px4_pollset_init failed");
+		}
+	}
+
+	/* pass 0: px4_poll, pass 1: the poll set */
+	for (int pass = 0; ret == OK && pass < 2; pass++) {
+		hrt_abstime start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < iterations; i++) {
+			int n = (pass == 0) ? px4_poll(fds, num_fds, 0) : px4_pollset_wait(&pollset, 0);
+
+			if (n != 0) {
+				ret = test_fail("idle poll returned %d", n);
+				break;
+			}
+		}
+
+		if (ret == OK) {
+			print_rate((pass == 0) ? "px4_poll, idle" : "px4_pollset_wait, idle", iterations, hrt_elapsed_time(&start));
+		}
+	}
+
+	if (ret == OK) {
+		hrt_abstime start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < iterations; i++) {
+			t.val = i;
+			orb_publish(ORB_ID(orb_test), pub, &t);
+			orb_copy(ORB_ID(orb_test), fds[0].fd, &buffer);
+		}
+
+		print_rate("publish+copy (reference)", iterations, hrt_elapsed_time(&start));
+	}
+
+	for (int pass = 0; ret == OK && pass < 2; pass++) {
+		hrt_abstime start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < iterations; i++) {
+			t.val = i;
+			orb_publish(ORB_ID(orb_test), pub, &t);
+
+			int n = (pass == 0) ? px4_poll(fds, num_fds, 0) : px4_pollset_wait(&pollset, 0);
+
+			const pollevent_t revents = (pass == 0) ? fds[0].revents : set_fds[0].revents;
+
+			if (n != 1 || !(revents & POLLIN)) {
+				ret = test_fail("poll returned %d, revents 0x%x, expected 1 ready", n, revents);
+				break;
+			}
+
+			orb_copy(ORB_ID(orb_test), fds[0].fd, &buffer);
+		}
+
+		if (ret == OK) {
+			print_rate((pass == 0) ? "publish+px4_poll+copy" : "publish+pollset_wait+copy", iterations,
+				   hrt_elapsed_time(&start));
+		}
+	}
+
+	/* a copied topic must not be reported again */
+	if (ret == OK && px4_pollset_wait(&pollset, 0) != 0) {
+		ret = test_fail("poll set still ready after orb_copy");
+	}
+
+	if (pollset_valid) {
+		px4_pollset_destroy(&pollset);
+	}
+
+	for (unsigned i = 0; i < num_fds; i++) {
+		if (fds[i].fd >= 0) {
+			orb_unsubscribe(fds[i].fd);
+		}
+	}
+
+	orb_unadvertise(pub);
+
+	return ret;
+}
+
+#ifdef __PX4_POSIX
+int uORBTest::UnitTest::contention_benchmark(unsigned max_readers, unsigned duration_ms)
+{
+	test_note("benchmarking orb_copy with 1..%u readers, %u ms each", max_readers, duration_ms);
+
+	test_note("single publisher:");
+	int ret = contention_run(ORB_ID(orb_test_contention), 1, max_readers, duration_ms);
+
+	if (ret == OK) {
+		test_note("two publishers:");
+		ret = contention_run(ORB_ID(orb_test_contention_multi), 2, max_readers, duration_ms);
+	}
+
+	return ret;
+}
+
+void *uORBTest::UnitTest::contention_publisher(void *arg)
+{
+	ContentionThread *p = (ContentionThread *)arg;
+	struct orb_test_large t = {};
+
+	/* advertise from this thread, it is the one publishing */
+	orb_advert_t pub = orb_advertise(p->topic, &t);
+
+	if (pub == nullptr) {
+		return nullptr;
+	}
+
+	p->count = 1;
+
+	while (!*p->stop) {
+		/* every byte of the message depends on the value, so that readers can spot torn copies */
+		t.val++;
+		t.time = t.val;
+		memset(t.junk, t.val & 0xff, sizeof(t.junk));
+		orb_publish(p->topic, pub, &t);
+		p->count++;
+	}
+
+	orb_unadvertise(pub);
+	return nullptr;
+}
+
+void *uORBTest::UnitTest::contention_reader(void *arg)
+{
+	ContentionThread *r = (ContentionThread *)arg;
+	struct orb_test_large u;
+	int sub = orb_subscribe(r->topic);
+
+	if (sub < 0) {
+		return nullptr;
+	}
+
+	while (!*r->stop) {
+		if (orb_copy(r->topic, sub, &u) != OK) {
+			continue;
+		}
+
+		bool torn = (u.time != (hrt_abstime)u.val);
+
+		for (unsigned i = 0; i < sizeof(u.junk) && !torn; i++) {
+			torn = (u.junk[i] != (char)(u.val & 0xff));
+		}
+
+		if (torn) {
+			r->torn++;
+		}
+
+		r->count++;
+	}
+
+	orb_unsubscribe(sub);
+	return nullptr;
+}
+
+int uORBTest::UnitTest::contention_run(orb_id_t topic, unsigned num_publishers, unsigned max_readers,
+				       unsigned duration_ms)
+{
+	volatile bool publishers_stop = false;
+	ContentionThread publishers[2] = {};
+	pthread_t publisher_threads[2];
+	int ret = OK;
+
+	for (unsigned i = 0; i < num_publishers; i++) {
+		publishers[i].topic = topic;
+		publishers[i].stop = &publishers_stop;
+
+		if (pthread_create(&publisher_threads[i], nullptr, contention_publisher, &publishers[i]) != 0) {
+			publishers_stop = true;
+
+			for (unsigned j = 0; j < i; j++) {
+				pthread_join(publisher_threads[j], nullptr);
+			}
+
+			return test_fail("cannot start publisher");
+		}
+
+		/* the first publisher advertises alone, the second one joins an existing topic */
+		for (int wait = 0; publishers[i].count == 0 && wait < 1000; wait++) {
+			usleep(1000);
+		}
+	}
+
+	ContentionThread *readers = new ContentionThread[max_readers];
+	pthread_t *reader_threads = new pthread_t[max_readers];
+
+	for (unsigned num_readers = 1; num_readers <= max_readers && ret == OK; num_readers++) {
+		volatile bool readers_stop = false;
+		unsigned started = 0;
+
+		unsigned long published = 0;
+
+		for (unsigned i = 0; i < num_publishers; i++) {
+			published -= publishers[i].count;
+		}
+
+		const hrt_abstime start = hrt_absolute_time();
+
+		for (; started < num_readers; started++) {
+			readers[started].topic = topic;
+			readers[started].stop = &readers_stop;
+			readers[started].count = 0;
+			readers[started].torn = 0;
+
+			if (pthread_create(&reader_threads[started], nullptr, contention_reader, &readers[started]) != 0) {
+				ret = test_fail("cannot start reader %u", started);
+				break;
+			}
+		}
+
+		usleep(duration_ms * 1000);
+		readers_stop = true;
+
+		unsigned long copies = 0;
+		unsigned long torn = 0;
+
+		for (unsigned i = 0; i < started; i++) {
+			pthread_join(reader_threads[i], nullptr);
+			copies += readers[i].count;
+			torn += readers[i].torn;
+		}
+
+		const hrt_abstime elapsed = hrt_elapsed_time(&start);
+
+		for (unsigned i = 0; i < num_publishers; i++) {
+			published += publishers[i].count;
+		}
+
+		const double seconds = (elapsed > 0) ? elapsed / 1e6 : 1.0;
+		test_note("%2u readers: %10.0f copies/s (%9.0f per reader), %9.0f publications/s, %lu torn",
+			  started, copies / seconds, started > 0 ? copies / seconds / started : 0.0, published / seconds, torn);
+
+		if (torn > 0) {
+			ret = test_fail("%lu torn copies with %u readers", torn, started);
+		}
+	}
+
+	publishers_stop = true;
+
+	for (unsigned i = 0; i < num_publishers; i++) {
+		pthread_join(publisher_threads[i], nullptr);
+	}
+
+	delete[] reader_threads;
+	delete[] readers;
+
+	return ret;
+}
+#endif
+
+int uORBTest::UnitTest::print_rate(const char *name, unsigned count, hrt_abstime elapsed)
+{
+	const double rate = (elapsed > 0) ? (double)count * 1e6 / (double)elapsed : 0.0;
+	return test_note("%-28s %6u calls in %8llu us, %9.0f calls/s", name, count, (unsigned long long)elapsed, rate);
+}
+
 int uORBTest::UnitTest::test_single()
 {
 	test_note("try single-topic support");
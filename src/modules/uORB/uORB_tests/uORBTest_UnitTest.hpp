@@ -66,6 +66,10 @@ struct orb_test_large {
 };
 ORB_DEFINE(orb_test_large, struct orb_test_large, sizeof(orb_test_large),
 	   "ORB_TEST_LARGE:int val;hrt_abstime time;char[512] junk;");
+ORB_DEFINE(orb_test_contention, struct orb_test_large, sizeof(orb_test_large),
+	   "ORB_TEST_CONTENTION:int val;hrt_abstime time;char[512] junk;");
+ORB_DEFINE(orb_test_contention_multi, struct orb_test_large, sizeof(orb_test_large),
+	   "ORB_TEST_CONTENTION_MULTI:int val;hrt_abstime time;char[512] junk;");
 
 
 namespace uORBTest
@@ -84,6 +88,34 @@ public:
 	template<typename S> int latency_test(orb_id_t T, bool print);
 	int info();
 
+	/**
+	 * Measure topic lookup: bringing up every declared topic once, orb_exists()
+	 * over all instances, and orb_subscribe()/orb_advertise() calls per second.
+	 */
+	int benchmark(unsigned iterations);
+
+	/**
+	 * Compare publishing and reading a large topic with orb_publish()/orb_copy()
+	 * against orb_loan()/orb_commit() and orb_borrow().
+	 */
+	int loan_benchmark(unsigned iterations);
+
+	/**
+	 * Compare the per-call cost of px4_poll() against a px4_pollset_t wait
+	 * on a set of subscriptions, with no fd and with one fd ready.
+	 */
+	int poll_benchmark(unsigned iterations);
+
+#ifdef __PX4_POSIX
+	/**
+	 * Measure orb_copy() throughput with 1 to max_readers threads copying a
+	 * large topic while it is published back to back, once with a single
+	 * publisher (lock-free path) and once with two (locked path).
+	 * Also checks that no reader ever gets a torn message.
+	 */
+	int contention_benchmark(unsigned max_readers, unsigned duration_ms);
+#endif
+
 private:
 	UnitTest() : pubsubtest_passed(false), pubsubtest_print(false) {}
 
@@ -119,6 +151,20 @@ private:
 	int test_queue_poll_notify();
 	volatile int _num_messages_sent = 0;
 
+	int print_rate(const char *name, unsigned count, hrt_abstime elapsed);
+
+#ifdef __PX4_POSIX
+	struct ContentionThread {
+		orb_id_t topic;
+		volatile bool *stop;
+		volatile unsigned long count; /**< publications or copies */
+		unsigned long torn; /**< copies mixing two publications */
+	};
+	static void *contention_publisher(void *arg);
+	static void *contention_reader(void *arg);
+	int contention_run(orb_id_t topic, unsigned num_publishers, unsigned max_readers, unsigned duration_ms);
+#endif
+
 	int test_fail(const char *fmt, ...);
 	int test_note(const char *fmt, ...);
 };
@@ -32,6 +32,7 @@
  ****************************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
 #include "../uORBDevices.hpp"
 #include "../uORB.h"
 #include "../uORBCommon.hpp"
@@ -44,7 +45,7 @@ extern "C" { __EXPORT int uorb_tests_main(int argc, char *argv[]); }
 
 static void usage()
 {
-	PX4_INFO("Usage: uorb_test 'latency_test'");
+	PX4_INFO("Usage: uorb_tests ['latency_test' [medium|large] | 'bench' [iterations] | 'loan_bench' [iterations] | 'poll_bench' [iterations] | 'contention' [max_readers] [ms]]");
 }
 
 int
@@ -90,6 +91,47 @@ uorb_tests_main(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * Benchmark topic lookup.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		unsigned iterations = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1000;
+		return t.benchmark(iterations > 0 ? iterations : 1000);
+	}
+
+	/*
+	 * Benchmark zero-copy loan/borrow against orb_publish/orb_copy.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "loan_bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		unsigned iterations = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 10000;
+		return t.loan_benchmark(iterations > 0 ? iterations : 10000);
+	}
+
+	/*
+	 * Benchmark px4_poll against a persistent poll set.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "poll_bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		unsigned iterations = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 10000;
+		return t.poll_benchmark(iterations > 0 ? iterations : 10000);
+	}
+
+#ifdef __PX4_POSIX
+
+	/*
+	 * Benchmark orb_copy with concurrent readers.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "contention")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		unsigned max_readers = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 4;
+		unsigned duration_ms = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 1000;
+		return t.contention_benchmark(max_readers > 0 ? max_readers : 4, duration_ms > 0 ? duration_ms : 1000);
+	}
+
+#endif
+
 #endif
 
 	usage();
@@ -0,0 +1,221 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ulog_export_main.cpp
+ * Export an ULog file into per-field binary columns, see ULogExporter.
+ * 'ulog_export bench' compares the sequential and the parallel export.
+ */
+
+#include <px4_config.h>
+#include <px4_defines.h>
+#include <px4_getopt.h>
+#include <px4_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "ulog_exporter.hpp"
+
+extern "C" __EXPORT int ulog_export_main(int argc, char *argv[]);
+
+using namespace px4;
+
+static void usage()
+{
+	PX4_WARN("usage: ulog_export <file.ulg> <out dir> [-j <threads>]\n"
+		 "       ulog_export bench <file.ulg> <tmp dir> [-j <threads>]\n"
+		 "  -j  number of decoding threads (default: number of cores)");
+}
+
+static void print_statistics(const char *name, const ULogExporter::Statistics &s)
+{
+	const double total = s.split_time + s.count_time + s.decode_time;
+	PX4_INFO("%-10s %3zu chunks (%zu sync), %8.3lf s, %8.1lf MB/s (split %.3lf, count %.3lf, decode %.3lf s)",
+		 name, s.chunks, s.sync_points, total, (double)s.file_size / 1.e6 / total, s.split_time, s.count_time,
+		 s.decode_time);
+}
+
+/**
+ * compare all files of two exports, as listed in columns.csv
+ * @return number of differing files, -1 on error
+ */
+static int compare_exports(const std::string &a, const std::string &b)
+{
+	FILE *index = fopen((a + "/columns.csv").c_str(), "r");
+
+	if (!index) {
+		return -1;
+	}
+
+	int differences = 0;
+	char line[512];
+	std::vector<char> data_a, data_b;
+
+	while (fgets(line, sizeof(line), index)) {
+		const char *file = strrchr(line, ',');
+
+		if (!file || strncmp(line, "topic,", 6) == 0) {
+			continue;
+		}
+
+		std::string name(file + 1);
+		name.erase(name.find_last_not_of("\r\n") + 1);
+
+		for (int i = 0; i < 2; i++) {
+			std::vector<char> &data = i == 0 ? data_a : data_b;
+			FILE *f = fopen(((i == 0 ? a : b) + "/" + name).c_str(), "rb");
+			data.clear();
+
+			if (f) {
+				char buffer[4096];
+				size_t n;
+
+				while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+					data.insert(data.end(), buffer, buffer + n);
+				}
+
+				fclose(f);
+			}
+		}
+
+		if (data_a != data_b) {
+			PX4_WARN("%s differs", name.c_str());
+			++differences;
+		}
+	}
+
+	fclose(index);
+	return differences;
+}
+
+static int benchmark(const char *file_name, const char *tmp_dir, int num_threads)
+{
+	ULogExporter exporter;
+
+	if (!exporter.open(file_name)) {
+		PX4_ERR("cannot open %s", file_name);
+		return 1;
+	}
+
+	const std::string sequential_dir = std::string(tmp_dir) + "/sequential";
+	const std::string parallel_dir = std::string(tmp_dir) + "/parallel";
+
+	if (!exporter.exportTo(sequential_dir.c_str(), 1)) {
+		PX4_ERR("export failed: %s", exporter.error());
+		return 1;
+	}
+
+	const ULogExporter::Statistics sequential = exporter.statistics();
+	PX4_INFO("%zu bytes, %zu samples, %zu topics, %zu columns", sequential.file_size, sequential.data_messages,
+		 sequential.topics, sequential.columns);
+	print_statistics("sequential", sequential);
+
+	if (!exporter.exportTo(parallel_dir.c_str(), num_threads)) {
+		PX4_ERR("export failed: %s", exporter.error());
+		return 1;
+	}
+
+	const ULogExporter::Statistics parallel = exporter.statistics();
+	print_statistics("parallel", parallel);
+
+	const double sequential_time = sequential.split_time + sequential.count_time + sequential.decode_time;
+	const double parallel_time = parallel.split_time + parallel.count_time + parallel.decode_time;
+	PX4_INFO("speedup %.2lf, %zu deferred delta samples", sequential_time / parallel_time, parallel.deferred);
+
+	const int differences = compare_exports(sequential_dir, parallel_dir);
+
+	if (differences != 0 || sequential.decode_errors != parallel.decode_errors) {
+		PX4_ERR("parallel export differs from the sequential one");
+		return 1;
+	}
+
+	return 0;
+}
+
+int ulog_export_main(int argc, char *argv[])
+{
+	int num_threads = 0;
+	int myoptind = 1;
+	const char *myoptarg = nullptr;
+	int ch;
+
+	while ((ch = px4_getopt(argc, argv, "j:", &myoptind, &myoptarg)) != EOF) {
+		switch (ch) {
+		case 'j':
+			num_threads = atoi(myoptarg);
+			break;
+
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	/* px4_getopt moves the options to the front */
+	char **args = argv + myoptind;
+	const int num_args = argc - myoptind;
+
+	if (num_args == 3 && !strcmp(args[0], "bench")) {
+		return benchmark(args[1], args[2], num_threads);
+	}
+
+	if (num_args != 2) {
+		usage();
+		return 1;
+	}
+
+	ULogExporter exporter;
+
+	if (!exporter.open(args[0])) {
+		PX4_ERR("cannot open %s", args[0]);
+		return 1;
+	}
+
+	if (!exporter.exportTo(args[1], num_threads)) {
+		PX4_ERR("export failed: %s", exporter.error());
+		return 1;
+	}
+
+	const ULogExporter::Statistics &s = exporter.statistics();
+	PX4_INFO("%zu samples of %zu topics into %zu columns", s.data_messages, s.topics, s.columns);
+	print_statistics("export", s);
+
+	if (s.decode_errors > 0) {
+		PX4_WARN("%zu samples could not be decoded (written as zeros)", s.decode_errors);
+	}
+
+	return 0;
+}
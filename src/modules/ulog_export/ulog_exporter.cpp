@@ -0,0 +1,786 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file ulog_exporter.cpp
+ * Parallel ULog to columnar export.
+ */
+
+#include "ulog_exporter.hpp"
+
+#include <logger/messages.h>
+#include <logger/encoding.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace px4
+{
+
+static const int MAX_NESTING = 8;
+
+static double monotonicTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline uint16_t read16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+/**
+ * size of a builtin ULog type, 0 for nested types
+ */
+static int builtinSize(const std::string &type)
+{
+	static const struct {
+		const char *name;
+		int size;
+	} types[] = {
+		{"int8_t", 1}, {"uint8_t", 1}, {"bool", 1}, {"char", 1},
+		{"int16_t", 2}, {"uint16_t", 2},
+		{"int32_t", 4}, {"uint32_t", 4}, {"float", 4},
+		{"int64_t", 8}, {"uint64_t", 8}, {"double", 8}
+	};
+
+	for (unsigned i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		if (type == types[i].name) {
+			return types[i].size;
+		}
+	}
+
+	return 0;
+}
+
+bool ULogExporter::open(const char *file_name)
+{
+	close();
+
+	int fd = ::open(file_name, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	/* every chunk is read twice, by different threads */
+	madvise(data, st.st_size, MADV_WILLNEED);
+
+	_data = (const uint8_t *)data;
+	_size = st.st_size;
+	_mapped = true;
+	return true;
+}
+
+void ULogExporter::open(const uint8_t *data, size_t size)
+{
+	close();
+	_data = data;
+	_size = size;
+}
+
+void ULogExporter::close()
+{
+	releaseColumns();
+
+	if (_mapped) {
+		munmap((void *)_data, _size);
+	}
+
+	_data = nullptr;
+	_size = 0;
+	_mapped = false;
+	_formats.clear();
+	_topics.clear();
+	_chunks.clear();
+}
+
+bool ULogExporter::exportTo(const char *out_dir, int num_threads)
+{
+	_statistics = Statistics();
+	_statistics.file_size = _size;
+	_error.clear();
+	_formats.clear();
+	_topics.clear();
+	_chunks.clear();
+
+	if (!_data) {
+		_error = "no file";
+		return false;
+	}
+
+	if (num_threads <= 0) {
+		num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	if (!parseDefinitions()) {
+		return false;
+	}
+
+	double start = monotonicTime();
+
+	/* more chunks than threads, so that a slow chunk does not hold up the others */
+	split(num_threads > 1 ? num_threads * 4 : 1);
+	_statistics.chunks = _chunks.size();
+
+	double split_done = monotonicTime();
+	forEachChunk(&ULogExporter::countChunk, num_threads);
+
+	/* subscriptions, in file order */
+	for (const Chunk &chunk : _chunks) {
+		for (size_t offset : chunk.added) {
+			const uint8_t *msg = _data + offset;
+			const uint16_t msg_size = read16(msg);
+
+			if (msg_size < 4) {
+				continue;
+			}
+
+			const uint16_t msg_id = read16(msg + 4);
+
+			if (_topics.size() <= msg_id) {
+				_topics.resize(msg_id + 1);
+			}
+
+			Topic &topic = _topics[msg_id];
+			topic.name.assign((const char *)msg + 6, msg_size - 3);
+			topic.multi_id = msg[3];
+			topic.added = true;
+		}
+	}
+
+	/* the rows of each chunk follow the ones of the chunks before it */
+	for (Chunk &chunk : _chunks) {
+		chunk.counts.resize(_topics.size(), 0);
+		chunk.first_row.resize(_topics.size());
+
+		for (size_t msg_id = 0; msg_id < _topics.size(); msg_id++) {
+			chunk.first_row[msg_id] = _topics[msg_id].rows;
+			_topics[msg_id].rows += chunk.counts[msg_id];
+			_statistics.data_messages += chunk.counts[msg_id];
+		}
+	}
+
+	double count_done = monotonicTime();
+
+	if (!createColumns(out_dir)) {
+		releaseColumns();
+		return false;
+	}
+
+	forEachChunk(&ULogExporter::decodeChunk, num_threads);
+	resolveDeferred();
+
+	for (const Chunk &chunk : _chunks) {
+		_statistics.decode_errors += chunk.errors;
+		_statistics.deferred += chunk.deferred.size();
+	}
+
+	releaseColumns();
+
+	_statistics.split_time = split_done - start;
+	_statistics.count_time = count_done - split_done;
+	_statistics.decode_time = monotonicTime() - count_done;
+	return true;
+}
+
+bool ULogExporter::parseDefinitions()
+{
+	if (_size < sizeof(ulog_file_header_s) || memcmp(_data, "ULog", 4) != 0) {
+		_error = "not an ULog file";
+		return false;
+	}
+
+	size_t pos = sizeof(ulog_file_header_s);
+
+	/* the definitions end with the first subscription or data message */
+	while (pos + ULOG_MSG_HEADER_LEN <= _size) {
+		const uint16_t msg_size = read16(_data + pos);
+		const uint8_t msg_type = _data[pos + 2];
+
+		if (pos + ULOG_MSG_HEADER_LEN + msg_size > _size) {
+			break;
+		}
+
+		if (msg_type == (uint8_t)ULogMessageType::FORMAT) {
+			const char *format = (const char *)_data + pos + ULOG_MSG_HEADER_LEN;
+			const char *colon = (const char *)memchr(format, ':', msg_size);
+
+			if (colon) {
+				Format f;
+				f.name.assign(format, colon - format);
+				f.fields.assign(colon + 1, format + msg_size - colon - 1);
+				_formats.push_back(f);
+			}
+
+		} else if (msg_type != (uint8_t)ULogMessageType::INFO && msg_type != (uint8_t)ULogMessageType::PARAMETER) {
+			break;
+		}
+
+		pos += ULOG_MSG_HEADER_LEN + msg_size;
+	}
+
+	_data_start = pos;
+	return true;
+}
+
+void ULogExporter::split(int num_chunks)
+{
+	std::vector<size_t> starts;
+	starts.push_back(_data_start);
+	const size_t section = _size - _data_start;
+
+	if (num_chunks > 1) {
+		const ulog_message_sync_s sync;
+		const size_t window = section / num_chunks;
+
+		/* the first SYNC message after each target; the 11 byte pattern does not
+		 * occur by chance in practice */
+		for (int k = 1; k < num_chunks; k++) {
+			const size_t target = _data_start + section * k / num_chunks;
+
+			if (target <= starts.back()) {
+				continue;
+			}
+
+			const void *found = memmem(_data + target, window, &sync, sizeof(sync));
+
+			if (found) {
+				starts.push_back((const uint8_t *)found - _data);
+				++_statistics.sync_points;
+			}
+		}
+
+		if (starts.size() == 1 && section > 0) {
+			/* no SYNC messages: walk the message headers to find the boundaries */
+			size_t pos = _data_start;
+			size_t target = _data_start + window;
+
+			while (pos + ULOG_MSG_HEADER_LEN <= _size) {
+				if (pos >= target) {
+					starts.push_back(pos);
+					target = _data_start + section * starts.size() / num_chunks;
+				}
+
+				pos += ULOG_MSG_HEADER_LEN + read16(_data + pos);
+			}
+		}
+	}
+
+	_chunks.resize(starts.size());
+
+	for (size_t i = 0; i < starts.size(); i++) {
+		_chunks[i].begin = starts[i];
+		_chunks[i].end = (i + 1 < starts.size()) ? starts[i + 1] : _size;
+	}
+}
+
+void ULogExporter::countChunk(Chunk &chunk)
+{
+	size_t pos = chunk.begin;
+
+	while (pos + ULOG_MSG_HEADER_LEN <= chunk.end) {
+		const uint8_t *msg = _data + pos;
+		const uint16_t msg_size = read16(msg);
+
+		if (pos + ULOG_MSG_HEADER_LEN + msg_size > _size) {
+			break; // truncated last message
+		}
+
+		switch (msg[2]) {
+		case (uint8_t)ULogMessageType::DATA:
+		case (uint8_t)ULogMessageType::ENCODED_DATA:
+			if (msg_size >= 2) {
+				const uint16_t msg_id = read16(msg + ULOG_MSG_HEADER_LEN);
+
+				if (chunk.counts.size() <= msg_id) {
+					chunk.counts.resize(msg_id + 1, 0);
+				}
+
+				++chunk.counts[msg_id];
+			}
+
+			break;
+
+		case (uint8_t)ULogMessageType::ADD_LOGGED_MSG:
+			chunk.added.push_back(pos);
+			break;
+
+		default:
+			break;
+		}
+
+		pos += ULOG_MSG_HEADER_LEN + msg_size;
+	}
+}
+
+bool ULogExporter::createColumns(const char *out_dir)
+{
+	if (mkdir(out_dir, 0755) != 0 && errno != EEXIST) {
+		_error = std::string("cannot create ") + out_dir;
+		return false;
+	}
+
+	std::string index_name = std::string(out_dir) + "/columns.csv";
+	FILE *index = fopen(index_name.c_str(), "w");
+
+	if (!index) {
+		_error = "cannot create " + index_name;
+		return false;
+	}
+
+	fprintf(index, "topic,multi_id,column,type,element_size,rows,file\n");
+	bool ok = true;
+
+	for (size_t msg_id = 0; ok && msg_id < _topics.size(); msg_id++) {
+		Topic &topic = _topics[msg_id];
+
+		if (!topic.added) {
+			continue;
+		}
+
+		const int payload_size = flattenFormat(topic.name, "", 0, topic, 0);
+
+		if (payload_size < 0) {
+			fprintf(stderr, "skipping %s: invalid or missing format\n", topic.name.c_str());
+			topic.columns.clear();
+			continue;
+		}
+
+		topic.payload_size = payload_size;
+
+		char dir_name[300];
+		snprintf(dir_name, sizeof(dir_name), "%s_%i", topic.name.c_str(), topic.multi_id);
+		std::string dir = std::string(out_dir) + "/" + dir_name;
+
+		if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+			_error = "cannot create " + dir;
+			ok = false;
+			break;
+		}
+
+		++_statistics.topics;
+
+		for (Column &column : topic.columns) {
+			std::string file_name = dir + "/" + column.name + ".bin";
+			const size_t file_size = topic.rows * column.size;
+			int fd = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+			if (fd < 0 || ftruncate(fd, file_size) != 0) {
+				_error = "cannot create " + file_name;
+				ok = false;
+
+				if (fd >= 0) {
+					::close(fd);
+				}
+
+				break;
+			}
+
+			if (file_size > 0) {
+				void *data = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+				if (data == MAP_FAILED) {
+					_error = "cannot map " + file_name;
+					ok = false;
+					::close(fd);
+					break;
+				}
+
+				column.data = (uint8_t *)data;
+				_mappings.push_back(std::make_pair(column.data, file_size));
+			}
+
+			::close(fd);
+			++_statistics.columns;
+
+			fprintf(index, "%s,%i,%s,%s,%i,%llu,%s/%s.bin\n", topic.name.c_str(), topic.multi_id, column.name.c_str(),
+				column.type.c_str(), column.size, (unsigned long long)topic.rows, dir_name, column.name.c_str());
+		}
+	}
+
+	fclose(index);
+	return ok;
+}
+
+int ULogExporter::flattenFormat(const std::string &format_name, const std::string &prefix, int base_offset,
+				Topic &topic, int depth)
+{
+	if (depth > MAX_NESTING) {
+		return -1;
+	}
+
+	const Format *format = nullptr;
+
+	for (const Format &f : _formats) {
+		if (f.name == format_name) {
+			format = &f;
+			break;
+		}
+	}
+
+	if (!format) {
+		return -1;
+	}
+
+	int offset = 0;
+	size_t begin = 0;
+
+	while (begin < format->fields.size()) {
+		size_t end = format->fields.find(';', begin);
+
+		if (end == std::string::npos) {
+			end = format->fields.size();
+		}
+
+		const std::string field = format->fields.substr(begin, end - begin);
+		begin = end + 1;
+
+		const size_t space = field.find(' ');
+
+		if (field.empty()) {
+			continue;
+		}
+
+		if (space == std::string::npos) {
+			return -1;
+		}
+
+		/* "type name" or "type[N] name" */
+		std::string type = field.substr(0, space);
+		const std::string name = field.substr(space + 1);
+		int count = 1;
+		bool is_array = false;
+		const size_t bracket = type.find('[');
+
+		if (bracket != std::string::npos) {
+			count = atoi(type.c_str() + bracket + 1);
+			type.resize(bracket);
+			is_array = true;
+		}
+
+		const int type_size = builtinSize(type);
+
+		if (name.compare(0, 8, "_padding") == 0) {
+			if (type_size == 0) {
+				return -1;
+			}
+
+			offset += type_size * count;
+			continue;
+		}
+
+		if (type_size > 0 && type == "char" && is_array) {
+			/* strings stay one column */
+			Column column;
+			column.name = prefix + name;
+			column.type = "char[" + std::to_string(count) + "]";
+			column.offset = base_offset + offset;
+			column.size = count;
+			topic.columns.push_back(column);
+			offset += count;
+
+		} else if (type_size > 0) {
+			for (int i = 0; i < count; i++) {
+				Column column;
+				column.name = is_array ? prefix + name + "_" + std::to_string(i) : prefix + name;
+				column.type = type;
+				column.offset = base_offset + offset + i * type_size;
+				column.size = type_size;
+				topic.columns.push_back(column);
+			}
+
+			offset += type_size * count;
+
+		} else {
+			for (int i = 0; i < count; i++) {
+				const std::string nested_prefix = (is_array ? prefix + name + "_" + std::to_string(i) : prefix + name) + ".";
+				const int nested_size = flattenFormat(type, nested_prefix, base_offset + offset, topic, depth + 1);
+
+				if (nested_size < 0) {
+					return -1;
+				}
+
+				offset += nested_size;
+			}
+		}
+
+		if (base_offset + offset > 0xffff) {
+			return -1;
+		}
+	}
+
+	return offset;
+}
+
+int ULogExporter::decodePayload(const uint8_t *msg, const std::vector<uint8_t> *previous,
+				std::vector<uint8_t> &scratch, const uint8_t **payload) const
+{
+	const uint16_t msg_size = read16(msg);
+
+	if (msg[2] == (uint8_t)ULogMessageType::DATA) {
+		*payload = msg + sizeof(ulog_message_data_header_s);
+		return msg_size - 2;
+	}
+
+	if (msg_size < sizeof(ulog_message_encoded_data_header_s) - ULOG_MSG_HEADER_LEN) {
+		return -1;
+	}
+
+	const uint8_t encoding = msg[5];
+	const int decoded_size = read16(msg + 6);
+	const uint8_t *src = msg + sizeof(ulog_message_encoded_data_header_s);
+	const int src_len = msg_size + ULOG_MSG_HEADER_LEN - sizeof(ulog_message_encoded_data_header_s);
+
+	if (scratch.size() < (size_t)decoded_size) {
+		scratch.resize(decoded_size);
+	}
+
+	if (encoding & ULOG_ENCODING_LZ) {
+		if (logger::ulog_lz_decompress(src, src_len, scratch.data(), decoded_size) != decoded_size) {
+			return -1;
+		}
+
+		src = scratch.data();
+
+	} else if (src_len != decoded_size) {
+		return -1;
+	}
+
+	if (encoding & ULOG_ENCODING_DELTA) {
+		if (!previous || previous->size() != (size_t)decoded_size) {
+			return -1;
+		}
+
+		logger::ulog_delta(src, previous->data(), scratch.data(), decoded_size);
+		src = scratch.data();
+	}
+
+	*payload = src;
+	return decoded_size;
+}
+
+void ULogExporter::store(uint16_t msg_id, uint64_t row, const uint8_t *payload, int payload_size)
+{
+	for (const Column &column : _topics[msg_id].columns) {
+		/* a shorter sample leaves the missing fields zero */
+		if (column.data && column.offset + column.size <= payload_size) {
+			memcpy(column.data + row * column.size, payload + column.offset, column.size);
+		}
+	}
+}
+
+void ULogExporter::decodeChunk(Chunk &chunk)
+{
+	const size_t num_ids = _topics.size();
+	std::vector<uint64_t> rows = chunk.first_row;
+	chunk.last.resize(num_ids);
+	chunk.last_state.assign(num_ids, PreviousUnknown);
+
+	size_t pos = chunk.begin;
+
+	while (pos + ULOG_MSG_HEADER_LEN <= chunk.end) {
+		const uint8_t *msg = _data + pos;
+		const uint16_t msg_size = read16(msg);
+		const uint8_t msg_type = msg[2];
+
+		if (pos + ULOG_MSG_HEADER_LEN + msg_size > _size) {
+			break;
+		}
+
+		const size_t offset = pos;
+		pos += ULOG_MSG_HEADER_LEN + msg_size;
+
+		if ((msg_type != (uint8_t)ULogMessageType::DATA && msg_type != (uint8_t)ULogMessageType::ENCODED_DATA)
+		    || msg_size < 2) {
+			continue;
+		}
+
+		const uint16_t msg_id = read16(msg + ULOG_MSG_HEADER_LEN);
+
+		if (msg_id >= num_ids) {
+			continue;
+		}
+
+		const uint64_t row = rows[msg_id]++;
+
+		if (_topics[msg_id].columns.empty()) {
+			continue;
+		}
+
+		const bool is_delta = msg_type == (uint8_t)ULogMessageType::ENCODED_DATA && msg_size >= 3
+				      && (msg[5] & ULOG_ENCODING_DELTA);
+
+		if (is_delta && chunk.last_state[msg_id] == PreviousUnknown) {
+			/* the previous sample is in an earlier chunk */
+			Deferred deferred;
+			deferred.msg_id = msg_id;
+			deferred.row = row;
+			deferred.offset = offset;
+			chunk.deferred.push_back(deferred);
+			continue;
+		}
+
+		const uint8_t *payload;
+		const int payload_size = (is_delta && chunk.last_state[msg_id] == PreviousLost) ? -1 :
+					 decodePayload(msg, is_delta ? &chunk.last[msg_id] : nullptr, chunk.scratch, &payload);
+
+		if (payload_size < 0) {
+			/* the following deltas are lost as well, until the next keyframe */
+			++chunk.errors;
+			chunk.last_state[msg_id] = PreviousLost;
+			continue;
+		}
+
+		store(msg_id, row, payload, payload_size);
+		chunk.last[msg_id].assign(payload, payload + payload_size);
+		chunk.last_state[msg_id] = PreviousValid;
+	}
+}
+
+void ULogExporter::resolveDeferred()
+{
+	const size_t num_ids = _topics.size();
+	std::vector<std::vector<uint8_t>> previous(num_ids);
+	std::vector<uint8_t> state(num_ids, PreviousUnknown);
+	std::vector<uint8_t> scratch;
+
+	for (Chunk &chunk : _chunks) {
+		for (const Deferred &deferred : chunk.deferred) {
+			const uint8_t *payload;
+			const int payload_size = (state[deferred.msg_id] != PreviousValid) ? -1 :
+						 decodePayload(_data + deferred.offset, &previous[deferred.msg_id], scratch, &payload);
+
+			if (payload_size < 0) {
+				++chunk.errors;
+				state[deferred.msg_id] = PreviousLost;
+				continue;
+			}
+
+			store(deferred.msg_id, deferred.row, payload, payload_size);
+			previous[deferred.msg_id].assign(payload, payload + payload_size);
+		}
+
+		/* the last sample of this chunk is the previous one of the next chunk */
+		for (size_t msg_id = 0; msg_id < num_ids; msg_id++) {
+			if (chunk.last_state[msg_id] != PreviousUnknown) {
+				previous[msg_id].swap(chunk.last[msg_id]);
+				state[msg_id] = chunk.last_state[msg_id];
+			}
+		}
+	}
+}
+
+void ULogExporter::releaseColumns()
+{
+	for (const auto &mapping : _mappings) {
+		munmap(mapping.first, mapping.second);
+	}
+
+	_mappings.clear();
+
+	for (Topic &topic : _topics) {
+		for (Column &column : topic.columns) {
+			column.data = nullptr;
+		}
+	}
+}
+
+void *ULogExporter::workerHelper(void *context)
+{
+	ULogExporter *exporter = static_cast<ULogExporter *>(context);
+
+	while (true) {
+		const size_t index = __atomic_fetch_add(&exporter->_next_chunk, 1, __ATOMIC_RELAXED);
+
+		if (index >= exporter->_chunks.size()) {
+			break;
+		}
+
+		(exporter->*(exporter->_work_function))(exporter->_chunks[index]);
+	}
+
+	return nullptr;
+}
+
+void ULogExporter::forEachChunk(void (ULogExporter::*function)(Chunk &), int num_threads)
+{
+	_work_function = function;
+	_next_chunk = 0;
+
+	if (num_threads > (int)_chunks.size()) {
+		num_threads = _chunks.size();
+	}
+
+	std::vector<pthread_t> threads(num_threads > 1 ? num_threads - 1 : 0);
+	std::vector<bool> started(threads.size(), false);
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		started[i] = pthread_create(&threads[i], nullptr, &ULogExporter::workerHelper, this) == 0;
+	}
+
+	/* this thread works as well, and alone if no thread could be started */
+	workerHelper(this);
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		if (started[i]) {
+			pthread_join(threads[i], nullptr);
+		}
+	}
+}
+
+} // namespace px4
@@ -0,0 +1,203 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace px4
+{
+
+/**
+ * @class ULogExporter
+ * Converts an ULog file into one directory per logged topic instance, holding a raw
+ * little endian array per field (<out>/<topic>_<multi_id>/<field>.bin, nested fields
+ * as <field>.<subfield>, array elements as <field>_<i>). All arrays of a topic instance
+ * have one entry per logged sample, in file order, so row i of the timestamp column
+ * belongs to row i of every other column. <out>/columns.csv lists the files with their
+ * type and number of rows, so that they can be mapped directly (e.g. numpy.memmap).
+ *
+ * The data section is split at SYNC messages (or at message boundaries found by a header
+ * walk, for logs without them) and the chunks are decoded in parallel, straight into the
+ * memory mapped output files: a first pass counts the samples per chunk, which gives each
+ * chunk its rows, and a second pass fills them. Delta encoded samples at the start of a
+ * chunk need the last sample of the previous chunk; they are decoded in a short
+ * sequential pass at the end.
+ */
+class ULogExporter
+{
+public:
+	struct Statistics {
+		size_t file_size = 0;
+		size_t data_messages = 0;
+		size_t decode_errors = 0;	///< samples that could not be decoded (written as zeros)
+		size_t chunks = 0;
+		size_t sync_points = 0;		///< SYNC messages used as chunk starts
+		size_t topics = 0;		///< exported topic instances
+		size_t columns = 0;
+		size_t deferred = 0;		///< delta samples decoded after the parallel pass
+		double split_time = 0.;		///< [s]
+		double count_time = 0.;
+		double decode_time = 0.;
+	};
+
+	ULogExporter() = default;
+	~ULogExporter() { close(); }
+
+	ULogExporter(const ULogExporter &) = delete;
+	ULogExporter &operator=(const ULogExporter &) = delete;
+
+	/**
+	 * map a file (read-only). Closes a previously opened file.
+	 * @return true on success
+	 */
+	bool open(const char *file_name);
+
+	/**
+	 * use a log that is already in memory. It must stay valid until close().
+	 */
+	void open(const uint8_t *data, size_t size);
+
+	void close();
+
+	/**
+	 * Export the log into out_dir (created if necessary).
+	 * @param num_threads number of decoding threads, 1 decodes the whole file sequentially
+	 * @return true on success
+	 */
+	bool exportTo(const char *out_dir, int num_threads);
+
+	const Statistics &statistics() const { return _statistics; }
+
+	/** error description if exportTo() failed */
+	const char *error() const { return _error.c_str(); }
+
+private:
+	struct Column {
+		std::string name;
+		std::string type;	///< ULog type of one element (char[N] for strings)
+		uint16_t offset;	///< in the payload
+		uint16_t size;		///< of one element
+		uint8_t *data = nullptr;	///< mapped output file
+	};
+
+	struct Format {
+		std::string name;
+		std::string fields;	///< "type name;type name;..."
+	};
+
+	struct Topic {
+		std::string name;
+		uint8_t multi_id = 0;
+		bool added = false;
+		uint32_t payload_size = 0;	///< from the format, without msg_id
+		uint64_t rows = 0;
+		std::vector<Column> columns;
+	};
+
+	/** a delta sample whose previous sample is in an earlier chunk */
+	struct Deferred {
+		uint16_t msg_id;
+		uint64_t row;
+		size_t offset;		///< of the message
+	};
+
+	struct Chunk {
+		size_t begin;
+		size_t end;
+		std::vector<uint64_t> counts;		///< per msg_id, first pass
+		std::vector<uint64_t> first_row;	///< per msg_id, row of the first sample
+		std::vector<std::vector<uint8_t>> last;	///< per msg_id, last decoded sample
+		std::vector<uint8_t> last_state;	///< per msg_id, PreviousState
+		std::vector<Deferred> deferred;
+		std::vector<size_t> added;		///< offsets of the ADD_LOGGED_MSG messages
+		size_t errors = 0;
+		std::vector<uint8_t> scratch;
+	};
+
+	enum PreviousState : uint8_t {
+		PreviousUnknown = 0,	///< no sample of the msg_id in this chunk yet
+		PreviousValid,
+		PreviousLost		///< a sample could not be decoded, deltas fail until a keyframe
+	};
+
+	bool parseDefinitions();
+	void split(int num_chunks);
+	bool createColumns(const char *out_dir);
+	/**
+	 * append the columns of a format to topic.columns, recursing into nested types
+	 * @return size of the format, -1 if it is unknown or invalid
+	 */
+	int flattenFormat(const std::string &format_name, const std::string &prefix, int base_offset,
+			  Topic &topic, int depth);
+	void countChunk(Chunk &chunk);
+	void decodeChunk(Chunk &chunk);
+	void resolveDeferred();
+	void releaseColumns();
+
+	/**
+	 * decode the payload of a DATA or ENCODED_DATA message against previous
+	 * @return decoded payload size, -1 on error
+	 */
+	int decodePayload(const uint8_t *msg, const std::vector<uint8_t> *previous, std::vector<uint8_t> &scratch,
+			  const uint8_t **payload) const;
+
+	void store(uint16_t msg_id, uint64_t row, const uint8_t *payload, int payload_size);
+
+	/** run function(chunk) for all chunks on num_threads threads */
+	void forEachChunk(void (ULogExporter::*function)(Chunk &), int num_threads);
+
+	static void *workerHelper(void *context);
+
+	const uint8_t *_data = nullptr;
+	size_t _size = 0;
+	bool _mapped = false;
+	size_t _data_start = 0;		///< first message after the definitions
+
+	std::vector<Format> _formats;
+	std::vector<Topic> _topics;	///< indexed by msg_id
+	std::vector<Chunk> _chunks;
+	std::vector<std::pair<uint8_t *, size_t>> _mappings;
+
+	/* work distribution of forEachChunk() */
+	void (ULogExporter::*_work_function)(Chunk &) = nullptr;
+	size_t _next_chunk = 0;
+
+	Statistics _statistics;
+	std::string _error;
+};
+
+} // namespace px4
@@ -76,6 +76,7 @@ AirspeedSim::AirspeedSim(int bus, int address, unsigned conversion_interval, con
 	_reports(nullptr),
 	_buffer_overflows(perf_alloc(PC_COUNT, "airspeed_buffer_overflows")),
 	_retries(0),
+	_work_queue(HPWORK),
 	_max_differential_pressure_pa(0),
 	_sensor_ok(false),
 	_last_published_sensor_ok(true), /* initialize differently to force publication */
@@ -121,6 +122,15 @@ AirspeedSim::init()
 {
 	int ret = ERROR;
 
+	/* run on the queue of the simulated sensors, so that they can use another
+	 * CPU than HPWORK. It can be placed with "work_queue create simwork ..."
+	 * before the driver starts. */
+	_work_queue = work_queue_create("simwork", SCHED_PRIORITY_MAX - 1, -1);
+
+	if (_work_queue < 0) {
+		_work_queue = HPWORK;
+	}
+
 	/* init base class */
 	if (VDev::init() != OK) {
 		DEVICE_DEBUG("VDev init failed");
@@ -357,13 +367,13 @@ AirspeedSim::start()
 	_reports->flush();
 
 	/* schedule a cycle to start things */
-	work_queue(HPWORK, &_work, (worker_t)&AirspeedSim::cycle_trampoline, this, 1);
+	work_queue(_work_queue, &_work, (worker_t)&AirspeedSim::cycle_trampoline, this, 1);
 }
 
 void
 AirspeedSim::stop()
 {
-	work_cancel(HPWORK, &_work);
+	work_cancel(_work_queue, &_work);
 }
 
 void
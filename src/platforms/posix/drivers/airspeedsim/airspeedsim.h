@@ -135,6 +135,7 @@ protected:
 	void update_status();
 
 	struct work_s			_work;
+	int				_work_queue;
 	float			_max_differential_pressure_pa;
 	bool			_sensor_ok;
 	bool			_last_published_sensor_ok;
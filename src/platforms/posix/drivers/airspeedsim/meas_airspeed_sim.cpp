@@ -251,7 +251,7 @@ MEASAirspeedSim::cycle()
 		if (_measure_ticks > USEC2TICK(CONVERSION_INTERVAL)) {
 
 			/* schedule a fresh cycle call when we are ready to measure again */
-			work_queue(HPWORK,
+			work_queue(_work_queue,
 				   &_work,
 				   (worker_t)&AirspeedSim::cycle_trampoline,
 				   this,
@@ -274,7 +274,7 @@ MEASAirspeedSim::cycle()
 	_collect_phase = true;
 
 	/* schedule a fresh cycle call when the measurement is done */
-	work_queue(HPWORK,
+	work_queue(_work_queue,
 		   &_work,
 		   (worker_t)&AirspeedSim::cycle_trampoline,
 		   this,
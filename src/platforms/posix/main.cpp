@@ -46,6 +46,7 @@
 #include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <time.h>
 #include "apps.h"
 #include "px4_middleware.h"
 #include "DriverFramework.hpp"
@@ -182,6 +183,10 @@ int main(int argc, char **argv)
 	bool daemon_mode = false;
 	bool chroot_on = false;
 
+	// boot time: from here until the startup script has started all the modules
+	struct timespec boot_start;
+	clock_gettime(CLOCK_MONOTONIC, &boot_start);
+
 	tcgetattr(0, &orig_term);
 	atexit(restore_term);
 
@@ -260,6 +265,11 @@ int main(int argc, char **argv)
 				process_line(line, false);
 			}
 
+			struct timespec boot_end;
+			clock_gettime(CLOCK_MONOTONIC, &boot_end);
+			PX4_INFO("Startup script done in %.1f ms", (boot_end.tv_sec - boot_start.tv_sec) * 1e3 +
+				 (boot_end.tv_nsec - boot_start.tv_nsec) * 1e-6);
+
 		} else {
 			PX4_WARN("Error opening file: %s", commands_file);
 		}
@@ -70,9 +70,35 @@ static hrt_abstime px4_timestart = 0;
 #else
 static int32_t dsp_offset = 0;
 #endif
+
+/* Clock used by hrt_absolute_time(). CLOCK_MONOTONIC is read through the vDSO on Linux,
+ * without a system call. CLOCK_MONOTONIC_RAW is not slewed by NTP, but then the HRT
+ * drifts against the timeouts of sleeps and semaphores, which use CLOCK_MONOTONIC. */
+#ifndef PX4_HRT_CLOCK
+#define PX4_HRT_CLOCK CLOCK_MONOTONIC
+#endif
+
+/* backward steps of the time that are reported [us]. Smaller steps happen when threads
+ * race between reading the clock and the clamp, and are not an error. */
+#define HRT_BACKSTEP_WARN	10000
+
+/* lock-free reads of the offsets before a reader falls back to _hrt_mutex */
+#define HRT_SEQ_TRIES		4
+
+/*
+ * The delay and lockstep state is only changed by the simulator and replay, but read
+ * on every hrt_absolute_time() call: writers serialize on _hrt_mutex and bump
+ * _hrt_seq before and after an update (odd while updating), readers take a consistent
+ * snapshot without a lock and retry if the sequence changed meanwhile. After
+ * HRT_SEQ_TRIES retries a reader takes _hrt_mutex.
+ */
 static hrt_abstime _start_delay_time = 0;
 static hrt_abstime _delay_interval = 0;
-static hrt_abstime max_time = 0;
+static hrt_abstime max_time = 0; ///< latest returned time, updated with a CAS
+static bool _lockstep_enabled = false;
+static hrt_abstime _lockstep_time = 0;
+static hrt_abstime _lockstep_offset = 0; ///< simulated time gained while in lockstep
+static uint32_t _hrt_seq = 0;
 pthread_mutex_t _hrt_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void
@@ -83,6 +109,21 @@ _hrt_absolute_time_internal(void);
 
 __EXPORT hrt_abstime hrt_reset(void);
 
+static void hrt_offsets_write_begin(void)
+{
+	pthread_mutex_lock(&_hrt_mutex);
+	__atomic_store_n(&_hrt_seq, _hrt_seq + 1, __ATOMIC_RELAXED);
+	/* the odd sequence must be visible before the new values are written and before the
+	 * writer reads the clock, so that no reader validates a later clock reading */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void hrt_offsets_write_end(void)
+{
+	__atomic_store_n(&_hrt_seq, _hrt_seq + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&_hrt_mutex);
+}
+
 static void hrt_lock(void)
 {
 	px4_sem_wait(&_hrt_lock);
@@ -172,13 +213,22 @@ hrt_abstime _hrt_absolute_time_internal(void)
 
 #else
 
-	if (!px4_timestart) {
-		px4_clock_gettime(CLOCK_MONOTONIC, &ts);
-		px4_timestart = ts_to_abstime(&ts);
+	hrt_abstime timestart = __atomic_load_n(&px4_timestart, __ATOMIC_RELAXED);
+
+	if (!timestart) {
+		/* the first caller sets the start, concurrent first callers use the same one */
+		px4_clock_gettime(PX4_HRT_CLOCK, &ts);
+		hrt_abstime expected = 0;
+		timestart = ts_to_abstime(&ts);
+
+		if (!__atomic_compare_exchange_n(&px4_timestart, &expected, timestart, false,
+						 __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			timestart = expected;
+		}
 	}
 
-	px4_clock_gettime(CLOCK_MONOTONIC, &ts);
-	return ts_to_abstime(&ts) - px4_timestart;
+	px4_clock_gettime(PX4_HRT_CLOCK, &ts);
+	return ts_to_abstime(&ts) - timestart;
 #endif
 }
 
@@ -191,40 +241,91 @@ int hrt_set_absolute_time_offset(int32_t time_diff_us)
 #endif
 
 /*
- * Get absolute time.
+ * Apply the delay and lockstep offsets to the clock. Called within a snapshot of
+ * _hrt_seq, or with _hrt_mutex held.
  */
-hrt_abstime hrt_absolute_time(void)
+static hrt_abstime hrt_offsets_apply(void)
 {
-	pthread_mutex_lock(&_hrt_mutex);
+	if (__atomic_load_n(&_lockstep_enabled, __ATOMIC_RELAXED)) {
+		return __atomic_load_n(&_lockstep_time, __ATOMIC_RELAXED);
+	}
 
+	hrt_abstime start_delay_time = __atomic_load_n(&_start_delay_time, __ATOMIC_RELAXED);
+	hrt_abstime ret = (start_delay_time > 0) ? start_delay_time : _hrt_absolute_time_internal();
+	return ret - __atomic_load_n(&_delay_interval, __ATOMIC_RELAXED)
+	       + __atomic_load_n(&_lockstep_offset, __ATOMIC_RELAXED);
+}
+
+/*
+ * Get absolute time, without the monotonic clamp. The clock is read within the
+ * snapshot of the offsets, so that it is consistent with them. A writer keeps the
+ * sequence odd across a clock read, and spinning on it while the writer is preempted
+ * (e.g. by a SCHED_FIFO reader) would never end: after a few retries the reader
+ * waits for the writer on _hrt_mutex.
+ */
+static hrt_abstime hrt_absolute_time_unclamped(void)
+{
 	hrt_abstime ret;
 
-	if (_start_delay_time > 0) {
-		ret = _start_delay_time;
+	for (int tries = 0; tries < HRT_SEQ_TRIES; tries++) {
+		uint32_t seq = __atomic_load_n(&_hrt_seq, __ATOMIC_ACQUIRE);
 
-	} else {
-		ret = _hrt_absolute_time_internal();
-	}
+		if (seq & 1) {
+			continue;
+		}
 
-	ret -= _delay_interval;
+		ret = hrt_offsets_apply();
 
-	if (ret < max_time) {
-		PX4_ERR("WARNING! TIME IS NEGATIVE! %d vs %d", (int)ret, (int)max_time);
-		ret = max_time;
+		/* everything must be read before the sequence is checked again */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (seq == __atomic_load_n(&_hrt_seq, __ATOMIC_RELAXED)) {
+			return ret;
+		}
 	}
 
-	max_time = ret;
+	pthread_mutex_lock(&_hrt_mutex);
+	ret = hrt_offsets_apply();
 	pthread_mutex_unlock(&_hrt_mutex);
 
 	return ret;
 }
 
+/*
+ * Get absolute time.
+ */
+hrt_abstime hrt_absolute_time(void)
+{
+	hrt_abstime ret = hrt_absolute_time_unclamped();
+
+	/* never go backwards, across all threads */
+	hrt_abstime latest = __atomic_load_n(&max_time, __ATOMIC_RELAXED);
+
+	while (ret > latest) {
+		if (__atomic_compare_exchange_n(&max_time, &latest, ret, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			return ret;
+		}
+	}
+
+	/* a thread preempted after reading the clock is behind by the time it was preempted:
+	 * only a fresh reading that is still behind means that the time went backwards */
+	if (ret + HRT_BACKSTEP_WARN < latest) {
+		ret = hrt_absolute_time_unclamped();
+
+		if (ret + HRT_BACKSTEP_WARN < latest) {
+			PX4_ERR("WARNING! TIME IS NEGATIVE! %d vs %d", (int)ret, (int)latest);
+		}
+	}
+
+	return latest;
+}
+
 __EXPORT hrt_abstime hrt_reset(void)
 {
 #ifndef __PX4_QURT
-	px4_timestart = 0;
+	__atomic_store_n(&px4_timestart, 0, __ATOMIC_RELAXED);
 #endif
-	max_time = 0;
+	__atomic_store_n(&max_time, 0, __ATOMIC_RELAXED);
 	return _hrt_absolute_time_internal();
 }
 
@@ -332,24 +433,65 @@ void	hrt_init(void)
 
 void	hrt_start_delay()
 {
-	pthread_mutex_lock(&_hrt_mutex);
-	_start_delay_time = _hrt_absolute_time_internal();
-	pthread_mutex_unlock(&_hrt_mutex);
+	hrt_offsets_write_begin();
+	__atomic_store_n(&_start_delay_time, _hrt_absolute_time_internal(), __ATOMIC_RELAXED);
+	hrt_offsets_write_end();
 }
 
 void	hrt_stop_delay()
 {
-	pthread_mutex_lock(&_hrt_mutex);
+	hrt_offsets_write_begin();
 	uint64_t delta = _hrt_absolute_time_internal() - _start_delay_time;
-	_delay_interval += delta;
-	_start_delay_time = 0;
+	__atomic_store_n(&_delay_interval, _delay_interval + delta, __ATOMIC_RELAXED);
+	__atomic_store_n(&_start_delay_time, 0, __ATOMIC_RELAXED);
+	hrt_offsets_write_end();
 
 	if (delta > 10000) {
 		PX4_INFO("simulator is slow. Delay added: %" PRIu64 " us", delta);
 	}
+}
 
-	pthread_mutex_unlock(&_hrt_mutex);
+void	hrt_lockstep_enable()
+{
+	hrt_abstime now = hrt_absolute_time();
+
+	hrt_offsets_write_begin();
+	__atomic_store_n(&_lockstep_time, now, __ATOMIC_RELAXED);
+	__atomic_store_n(&_lockstep_enabled, true, __ATOMIC_RELAXED);
+	hrt_offsets_write_end();
+}
+
+void	hrt_lockstep_set_time(hrt_abstime time)
+{
+	hrt_offsets_write_begin();
+
+	if (_lockstep_enabled && time > _lockstep_time) {
+		__atomic_store_n(&_lockstep_time, time, __ATOMIC_RELAXED);
+	}
+
+	hrt_offsets_write_end();
+
+	/* run the callouts that are due now, instead of waiting for the simulated timer interrupt */
+	hrt_call_invoke();
+}
+
+void	hrt_lockstep_disable()
+{
+	hrt_offsets_write_begin();
+
+	if (_lockstep_enabled) {
+		__atomic_store_n(&_lockstep_enabled, false, __ATOMIC_RELAXED);
+
+		/* continue in real time from where the simulated time stopped */
+		hrt_abstime base = (_start_delay_time > 0) ? _start_delay_time : _hrt_absolute_time_internal();
+		hrt_abstime now = base - _delay_interval + _lockstep_offset;
+
+		if (_lockstep_time > now) {
+			__atomic_store_n(&_lockstep_offset, _lockstep_offset + _lockstep_time - now, __ATOMIC_RELAXED);
+		}
+	}
 
+	hrt_offsets_write_end();
 }
 
 static void
@@ -44,6 +44,9 @@
 #include "hrt_test.h"
 #include <unistd.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
 
 px4::AppState HRTTest::appState;
 
@@ -89,3 +92,120 @@ int HRTTest::main()
 
 	return 0;
 }
+
+struct BenchThread {
+	pthread_t thread;
+	int calls;
+	bool use_mutex;
+	hrt_abstime backsteps;	///< times the clock went backwards in this thread
+};
+
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+static hrt_abstime bench_max_time = 0;
+static volatile bool bench_go = false;
+
+/* the previous hrt_absolute_time(): clock read and clamp under one global mutex */
+static hrt_abstime mutex_absolute_time()
+{
+	struct timespec ts;
+	pthread_mutex_lock(&bench_mutex);
+	px4_clock_gettime(CLOCK_MONOTONIC, &ts);
+	hrt_abstime ret = ts_to_abstime(&ts);
+
+	if (ret < bench_max_time) {
+		ret = bench_max_time;
+	}
+
+	bench_max_time = ret;
+	pthread_mutex_unlock(&bench_mutex);
+	return ret;
+}
+
+static void *bench_thread(void *arg)
+{
+	BenchThread *t = (BenchThread *)arg;
+	hrt_abstime last = 0;
+
+	while (!bench_go) {
+		sched_yield();
+	}
+
+	for (int i = 0; i < t->calls; i++) {
+		hrt_abstime now = t->use_mutex ? mutex_absolute_time() : hrt_absolute_time();
+
+		if (now < last) {
+			++t->backsteps;
+		}
+
+		last = now;
+	}
+
+	return nullptr;
+}
+
+/**
+ * @return wall time of num_threads threads doing calls each [s], < 0 on error
+ */
+static double bench_run(int num_threads, int calls, bool use_mutex, hrt_abstime &backsteps)
+{
+	BenchThread *threads = new BenchThread[num_threads];
+	int started = 0;
+	bench_go = false;
+
+	for (int i = 0; i < num_threads; i++) {
+		threads[i].calls = calls;
+		threads[i].use_mutex = use_mutex;
+		threads[i].backsteps = 0;
+
+		if (pthread_create(&threads[i].thread, nullptr, bench_thread, &threads[i]) != 0) {
+			break;
+		}
+
+		++started;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bench_go = true;
+
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i].thread, nullptr);
+		backsteps += threads[i].backsteps;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	delete[] threads;
+
+	if (started != num_threads) {
+		return -1.;
+	}
+
+	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+int HRTTest::benchmark(int max_threads, int calls)
+{
+	hrt_abstime backsteps = 0;
+	PX4_INFO("%d calls per thread, %ld cores", calls, sysconf(_SC_NPROCESSORS_ONLN));
+	PX4_INFO("threads   mutex [Mcalls/s]   lock-free [Mcalls/s]   lock-free [ns/call/thread]");
+
+	for (int n = 1; n <= max_threads; n *= 2) {
+		double t_mutex = bench_run(n, calls, true, backsteps);
+		double t_free = bench_run(n, calls, false, backsteps);
+
+		if (t_mutex < 0. || t_free < 0.) {
+			PX4_ERR("failed to start %d threads", n);
+			return 1;
+		}
+
+		const double total = (double)n * calls;
+		PX4_INFO("%7d   %17.2f   %20.2f   %26.1f", n, total / t_mutex / 1e6, total / t_free / 1e6, t_free / calls * 1e9);
+	}
+
+	if (backsteps > 0) {
+		PX4_ERR("time went backwards %llu times", (unsigned long long)backsteps);
+		return 1;
+	}
+
+	return 0;
+}
@@ -50,5 +50,12 @@ public:
 
 	int main();
 
+	/**
+	 * Measure hrt_absolute_time() with 1, 2, 4... max_threads threads calling it
+	 * concurrently, against a mutex protected clock read (the previous implementation).
+	 * @return 0 on success, 1 if the time went backwards in a thread
+	 */
+	static int benchmark(int max_threads, int calls);
+
 	static px4::AppState appState; /* track requests to terminate app */
 };
@@ -41,6 +41,7 @@
 #include <px4_app.h>
 #include <px4_tasks.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sched.h>
 
@@ -50,10 +51,16 @@ extern "C" __EXPORT int hrttest_main(int argc, char *argv[]);
 int hrttest_main(int argc, char *argv[])
 {
 	if (argc < 2) {
-		PX4_WARN("usage: hrttest_main {start|stop|status}\n");
+		PX4_WARN("usage: hrttest_main {start|stop|status|bench [threads] [calls]}\n");
 		return 1;
 	}
 
+	if (!strcmp(argv[1], "bench")) {
+		int max_threads = (argc > 2) ? atoi(argv[2]) : 8;
+		int calls = (argc > 3) ? atoi(argv[3]) : 1000000;
+		return HRTTest::benchmark(max_threads > 0 ? max_threads : 1, calls > 0 ? calls : 1);
+	}
+
 	if (!strcmp(argv[1], "start")) {
 
 		if (HRTTest::appState.isRunning()) {
@@ -88,6 +95,6 @@ int hrttest_main(int argc, char *argv[])
 		return 0;
 	}
 
-	PX4_WARN("usage: hrttest_main {start|stop|status}\n");
+	PX4_WARN("usage: hrttest_main {start|stop|status|bench [threads] [calls]}\n");
 	return 1;
 }
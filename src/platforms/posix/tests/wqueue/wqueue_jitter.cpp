@@ -0,0 +1,291 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file wqueue_jitter.cpp
+ *
+ * Dispatch jitter of HRT callouts and work queue items, compared with a copy
+ * of the previous list scanning scheduler.
+ */
+
+#include <px4_log.h>
+#include <px4_workqueue.h>
+#include <drivers/drv_hrt.h>
+#include "wqueue_test.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+
+class JitterStats
+{
+public:
+	void reset() { memset(this, 0, sizeof(*this)); }
+
+	void add(hrt_abstime now, hrt_abstime deadline)
+	{
+		uint64_t late = (now > deadline) ? now - deadline : 0;
+		unsigned bucket = late / BUCKET_WIDTH;
+		_hist[bucket < BUCKETS ? bucket : BUCKETS]++;
+		_count++;
+		_total += late;
+
+		if (late > _max) {
+			_max = late;
+		}
+	}
+
+	void print(const char *name) const
+	{
+		PX4_INFO("%-22s %7llu dispatches, mean %7.1f us, p99 %6u us, max %7llu us", name,
+			 (unsigned long long)_count, _count > 0 ? (double)_total / _count : 0.0,
+			 percentile(0.99), (unsigned long long)_max);
+	}
+
+private:
+	/* upper bound of the bucket holding the fraction p of the dispatches */
+	unsigned percentile(double p) const
+	{
+		uint64_t n = 0;
+
+		for (unsigned i = 0; i <= BUCKETS; i++) {
+			n += _hist[i];
+
+			if (n >= p * _count) {
+				return (i + 1) * BUCKET_WIDTH;
+			}
+		}
+
+		return (BUCKETS + 1) * BUCKET_WIDTH;
+	}
+
+	static constexpr unsigned BUCKET_WIDTH = 10;	///< [us]
+	static constexpr unsigned BUCKETS = 2000;
+
+	unsigned _hist[BUCKETS + 1];
+	uint64_t _count;
+	uint64_t _total;
+	uint64_t _max;
+};
+
+struct Item {
+	uint32_t period;	///< [us]
+	hrt_abstime deadline;
+	JitterStats *stats;
+	struct hrt_call call;
+	struct work_s work;
+	bool queued;		///< reference scheduler
+};
+
+JitterStats stats;
+volatile bool running;
+
+/* work queue delays are in ticks, never zero */
+uint32_t work_ticks(uint32_t period)
+{
+	return (period > USEC_PER_TICK) ? period / USEC_PER_TICK : 1;
+}
+
+void item_hrt_callout(void *arg)
+{
+	Item *item = (Item *)arg;
+	item->stats->add(hrt_absolute_time(), item->deadline);
+	item->deadline += item->period;
+}
+
+void item_work_callout(void *arg)
+{
+	Item *item = (Item *)arg;
+	item->stats->add(hrt_absolute_time(), item->deadline);
+
+	if (running) {
+		const uint32_t ticks = work_ticks(item->period);
+		work_queue(HPWORK, &item->work, (worker_t)&item_work_callout, item, ticks);
+		item->deadline = item->work.qtime + ticks * USEC_PER_TICK;
+	}
+}
+
+/**
+ * Copy of the previous work queue scheduler: the whole list is scanned on
+ * every pass, the thread sleeps for the shortest remaining delay and new work
+ * wakes it up with a signal.
+ */
+class ReferenceScheduler
+{
+public:
+	ReferenceScheduler(Item *items, int num) : _items(items), _num(num)
+	{
+		pthread_mutex_init(&_lock, nullptr);
+	}
+
+	~ReferenceScheduler() { pthread_mutex_destroy(&_lock); }
+
+	void start()
+	{
+		_run = true;
+		pthread_create(&_thread, nullptr, &ReferenceScheduler::thread_trampoline, this);
+
+		for (int i = 0; i < _num; i++) {
+			queue(&_items[i]);
+		}
+	}
+
+	void stop()
+	{
+		_run = false;
+		pthread_kill(_thread, SIGCONT);
+		pthread_join(_thread, nullptr);
+	}
+
+private:
+	void queue(Item *item)
+	{
+		pthread_mutex_lock(&_lock);
+		item->deadline = hrt_absolute_time() + item->period;
+		item->queued = true;
+		pthread_kill(_thread, SIGCONT);
+		pthread_mutex_unlock(&_lock);
+	}
+
+	static void *thread_trampoline(void *arg)
+	{
+		((ReferenceScheduler *)arg)->thread_run();
+		return nullptr;
+	}
+
+	void thread_run()
+	{
+		while (_run) {
+			uint32_t next = 1000000;
+			pthread_mutex_lock(&_lock);
+			int i = 0;
+
+			while (i < _num) {
+				Item *item = &_items[i];
+				hrt_abstime now = hrt_absolute_time();
+
+				if (item->queued && now >= item->deadline) {
+					item->queued = false;
+					pthread_mutex_unlock(&_lock);
+					item->stats->add(now, item->deadline);
+					queue(item);
+					pthread_mutex_lock(&_lock);
+
+					/* start over at the head, as the previous implementation did */
+					i = 0;
+					continue;
+
+				} else if (item->queued && item->deadline - now < next) {
+					next = item->deadline - now;
+				}
+
+				i++;
+			}
+
+			pthread_mutex_unlock(&_lock);
+			usleep(next);
+		}
+	}
+
+	Item *_items;
+	int _num;
+	pthread_mutex_t _lock;
+	pthread_t _thread;
+	volatile bool _run = false;
+};
+
+} // namespace
+
+int WQueueTest::jitter_benchmark(int seconds, int items)
+{
+	Item *item = new Item[items];
+	memset(item, 0, sizeof(Item) * items);
+
+	for (int i = 0; i < items; i++) {
+		item[i].period = 1000 + (items > 1 ? (19000 * i) / (items - 1) : 0);
+		item[i].stats = &stats;
+	}
+
+	PX4_INFO("dispatch jitter of %d periodic items over %d s each", items, seconds);
+
+	/* HRT callouts */
+	stats.reset();
+
+	for (int i = 0; i < items; i++) {
+		hrt_call_every(&item[i].call, item[i].period, item[i].period, &item_hrt_callout, &item[i]);
+		item[i].deadline = item[i].call.deadline;
+	}
+
+	sleep(seconds);
+
+	for (int i = 0; i < items; i++) {
+		hrt_cancel(&item[i].call);
+	}
+
+	stats.print("hrt_call_every");
+
+	/* HP work queue, each item queues itself again */
+	stats.reset();
+	running = true;
+
+	for (int i = 0; i < items; i++) {
+		const uint32_t ticks = work_ticks(item[i].period);
+		work_queue(HPWORK, &item[i].work, (worker_t)&item_work_callout, &item[i], ticks);
+		item[i].deadline = item[i].work.qtime + ticks * USEC_PER_TICK;
+	}
+
+	sleep(seconds);
+	running = false;
+
+	for (int i = 0; i < items; i++) {
+		work_cancel(HPWORK, &item[i].work);
+	}
+
+	stats.print("work_queue(HPWORK)");
+
+	/* previous scheduler, with the same periods */
+	stats.reset();
+	ReferenceScheduler reference(item, items);
+	reference.start();
+	sleep(seconds);
+	reference.stop();
+	stats.print("previous scheduler");
+
+	delete[] item;
+
+	return 0;
+}
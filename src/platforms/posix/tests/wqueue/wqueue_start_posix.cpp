@@ -42,6 +42,7 @@
 #include <px4_log.h>
 #include <px4_tasks.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sched.h>
 
@@ -54,10 +55,16 @@ int wqueue_test_main(int argc, char *argv[])
 {
 
 	if (argc < 2) {
-		PX4_INFO("usage: wqueue_test {start|stop|status}\n");
+		PX4_INFO("usage: wqueue_test {start|stop|status|jitter [seconds] [items]}\n");
 		return 1;
 	}
 
+	if (!strcmp(argv[1], "jitter")) {
+		int seconds = (argc > 2) ? atoi(argv[2]) : 5;
+		int items = (argc > 3) ? atoi(argv[3]) : 20;
+		return WQueueTest::jitter_benchmark(seconds > 0 ? seconds : 1, items > 0 ? items : 1);
+	}
+
 	if (!strcmp(argv[1], "start")) {
 
 		if (WQueueTest::appState.isRunning()) {
@@ -92,6 +99,6 @@ int wqueue_test_main(int argc, char *argv[])
 		return 0;
 	}
 
-	PX4_INFO("usage: wqueue_test {start|stop|status}\n");
+	PX4_INFO("usage: wqueue_test {start|stop|status|jitter [seconds] [items]}\n");
 	return 1;
 }
@@ -58,6 +58,13 @@ public:
 
 	int main();
 
+	/**
+	 * Measure the dispatch jitter (dispatch time - deadline) of periodic items
+	 * with periods spread over 1..20 ms: as HRT callouts, as HP work queue items
+	 * and on a copy of the previous list scanning scheduler.
+	 */
+	static int jitter_benchmark(int seconds, int items);
+
 	static px4::AppState appState; /* track requests to terminate app */
 private:
 	static void hp_worker_cb(void *p);
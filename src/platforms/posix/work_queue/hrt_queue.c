@@ -48,6 +48,7 @@
 #include <drivers/drv_hrt.h>
 #include <px4_workqueue.h>
 #include "hrt_work.h"
+#include "work_sched.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -120,14 +121,15 @@ int hrt_work_queue(struct work_s *work, worker_t worker, void *arg, uint32_t del
 	work->qtime  = hrt_absolute_time(); /* Time work queued */
 	//PX4_INFO("hrt work_queue adding work delay=%u time=%lu", delay, work->qtime);
 
-	dq_addlast((dq_entry_t *)work, &wqueue->q);
-#ifdef __PX4_QURT
-	px4_task_kill(wqueue->pid, SIGALRM);      /* Wake up the worker thread */
-#else
-	px4_task_kill(wqueue->pid, SIGCONT);      /* Wake up the worker thread */
-#endif
+	/* The worker thread is woken up if this is the earliest deadline */
+
+	int ret = work_sched_add(wqueue, work, work->qtime + delay);
+
+	if (ret != PX4_OK) {
+		work->worker = NULL;
+	}
 
 	hrt_work_unlock();
-	return PX4_OK;
+	return ret;
 }
 
@@ -49,6 +49,7 @@
 #include <px4_workqueue.h>
 #include <drivers/drv_hrt.h>
 #include "hrt_work.h"
+#include "work_sched.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -112,12 +113,10 @@ static void _sighandler(int sig_num)
 static void hrt_work_process()
 {
 	struct wqueue_s *wqueue = &g_hrt_work;
-	volatile struct work_s *work;
+	struct work_s *work;
 	worker_t  worker;
 	void *arg;
-	uint64_t elapsed;
-	uint32_t remaining;
-	uint32_t next;
+	uint64_t next;
 
 	// set the threads name
 #ifdef __PX4_DARWIN
@@ -131,92 +130,47 @@ static void hrt_work_process()
 	 * we process items in the work list.
 	 */
 
-	/* Default to sleeping for 1 sec */
-	next  = 1000000;
-
 	hrt_work_lock();
 
-	work  = (struct work_s *)wqueue->q.head;
-
-	while (work) {
-		/* Is this work ready?  It is ready if there is no delay or if
-		 * the delay has elapsed. qtime is the time that the work was added
-		 * to the work queue.  It will always be greater than or equal to
-		 * zero.  Therefore a delay of zero will always execute immediately.
-		 */
-
-		elapsed = hrt_absolute_time() - work->qtime;
-
-		//PX4_INFO("hrt work_process: in usec elapsed=%lu delay=%u work=%p", elapsed, work->delay, work);
-		if (elapsed >= work->delay) {
-			/* Remove the ready-to-execute work from the list */
+	/* Take the work that is due, earliest deadline first */
 
-			(void)dq_rem((struct dq_entry_s *) & (work->dq), &(wqueue->q));
-			//PX4_INFO("Dequeued work=%p", work);
+	while ((work = work_sched_next(wqueue, hrt_absolute_time(), &next)) != NULL) {
+		//PX4_INFO("Dequeued work=%p", work);
 
-			/* Extract the work description from the entry (in case the work
-			 * instance by the re-used after it has been de-queued).
-			 */
-
-			worker = work->worker;
-			arg    = work->arg;
-
-			/* Mark the work as no longer being queued */
-
-			work->worker = NULL;
+		/* Extract the work description from the entry (in case the work
+		 * instance by the re-used after it has been de-queued).
+		 */
 
-			/* Do the work.  Re-enable interrupts while the work is being
-			 * performed... we don't have any idea how long that will take!
-			 */
+		worker = work->worker;
+		arg    = work->arg;
 
-			hrt_work_unlock();
+		/* Mark the work as no longer being queued */
 
-			if (!worker) {
-				PX4_ERR("MESSED UP: worker = 0");
-				PX4_BACKTRACE();
+		work->worker = NULL;
 
-			} else {
-				worker(arg);
-			}
+		/* Do the work.  Re-enable interrupts while the work is being
+		 * performed... we don't have any idea how long that will take!
+		 */
 
-			/* Now, unfortunately, since we re-enabled interrupts we don't
-			 * know the state of the work list and we will have to start
-			 * back at the head of the list.
-			 */
+		hrt_work_unlock();
 
-			hrt_work_lock();
-			work  = (struct work_s *)wqueue->q.head;
+		if (!worker) {
+			PX4_ERR("MESSED UP: worker = 0");
+			PX4_BACKTRACE();
 
 		} else {
-			/* This one is not ready.. will it be ready before the next
-			 * scheduled wakeup interval?
-			 */
-
-			/* Here: elapsed < work->delay */
-			remaining = work->delay - elapsed;
-
-			//PX4_INFO("remaining=%u delay=%u elapsed=%lu", remaining, work->delay, elapsed);
-			if (remaining < next) {
-				/* Yes.. Then schedule to wake up when the work is ready */
-
-				next = remaining;
-			}
-
-			/* Then try the next in the list. */
-
-			work = (struct work_s *)work->dq.flink;
-			//PX4_INFO("next %u work %p", next, work);
+			work_sched_run(wqueue, worker, arg);
 		}
+
+		hrt_work_lock();
 	}
 
-	/* Wait awhile to check the work list.  We will wait here until either
-	 * the time elapses or until we are awakened by a signal.
-	 */
 	hrt_work_unlock();
 
-	/* might sleep less if a signal received and new item was queued */
-	//PX4_INFO("Sleeping for %u usec", next);
-	usleep(next);
+	/* Wait until the next work is due, at most 1 sec.  We are woken up
+	 * earlier if work with an earlier deadline is queued.
+	 */
+	work_sched_wait(wqueue, next, 1000000);
 }
 
 /****************************************************************************
@@ -246,6 +200,8 @@ static void hrt_work_process()
 
 static int work_hrtthread(int argc, char *argv[])
 {
+	work_sched_thread_start(&g_hrt_work);
+
 	/* Loop forever */
 
 	for (;;) {
@@ -274,11 +230,14 @@ void hrt_work_queue_init(void)
 {
 	px4_sem_init(&_hrt_work_lock, 0, 1);
 	memset(&g_hrt_work, 0, sizeof(g_hrt_work));
+	work_sched_init(&g_hrt_work, "wkr_hrt");
+	g_hrt_work.priority = SCHED_PRIORITY_MAX;
+	g_hrt_work.cpu = -1;
 
 	// Create high priority worker thread
 	g_hrt_work.pid = px4_task_spawn_cmd("wkr_hrt",
 					    SCHED_DEFAULT,
-					    SCHED_PRIORITY_MAX,
+					    g_hrt_work.priority,
 					    2000,
 					    work_hrtthread,
 					    (char *const *)NULL);
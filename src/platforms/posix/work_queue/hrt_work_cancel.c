@@ -42,6 +42,7 @@
 #include <queue.h>
 #include <px4_workqueue.h>
 #include "hrt_work.h"
+#include "work_sched.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -94,16 +95,11 @@ void hrt_work_cancel(struct work_s *work)
 	hrt_work_lock();
 
 	if (work->worker != NULL) {
-		/* A little test of the integrity of the work queue */
-
-		//DEBUGASSERT(work->dq.flink ||(dq_entry_t *)work == wqueue->q.tail);
-		//DEBUGASSERT(work->dq.blink ||(dq_entry_t *)work == wqueue->q.head);
-
 		/* Remove the entry from the work queue and make sure that it is
 		 * mark as availalbe (i.e., the worker field is nullified).
 		 */
 
-		dq_rem((dq_entry_t *)work, &wqueue->q);
+		work_sched_remove(wqueue, work);
 		work->worker = NULL;
 	}
 
@@ -39,9 +39,11 @@
 
 #include <px4_config.h>
 #include <px4_defines.h>
+#include <errno.h>
 #include <queue.h>
 #include <px4_workqueue.h>
 #include "work_lock.h"
+#include "work_sched.h"
 
 #ifdef CONFIG_SCHED_WORKQUEUE
 
@@ -88,9 +90,11 @@
 
 int work_cancel(int qid, struct work_s *work)
 {
-	struct wqueue_s *wqueue = &g_work[qid];
+	if ((unsigned)qid >= WORK_QUEUES_MAX || g_work[qid].name[0] == '\0') {
+		return -EINVAL;
+	}
 
-	//DEBUGASSERT(work != NULL && (unsigned)qid < NWORKERS);
+	struct wqueue_s *wqueue = &g_work[qid];
 
 	/* Cancelling the work is simply a matter of removing the work structure
 	 * from the work queue.  This must be done with interrupts disabled because
@@ -100,16 +104,11 @@ int work_cancel(int qid, struct work_s *work)
 	work_lock(qid);
 
 	if (work->worker != NULL) {
-		/* A little test of the integrity of the work queue */
-
-		//DEBUGASSERT(work->dq.flink ||(dq_entry_t *)work == wqueue->q.tail);
-		//DEBUGASSERT(work->dq.blink ||(dq_entry_t *)work == wqueue->q.head);
-
 		/* Remove the entry from the work queue and make sure that it is
 		 * mark as availalbe (i.e., the worker field is nullified).
 		 */
 
-		dq_rem((dq_entry_t *)work, &wqueue->q);
+		work_sched_remove(wqueue, work);
 		work->worker = NULL;
 	}
 
@@ -40,13 +40,16 @@
 #include <px4_config.h>
 #include <px4_defines.h>
 
+#include <errno.h>
 #include <signal.h>
 #include <stdint.h>
 #include <queue.h>
 #include <stdio.h>
 #include <semaphore.h>
 #include <px4_workqueue.h>
+#include <drivers/drv_hrt.h>
 #include "work_lock.h"
+#include "work_sched.h"
 
 #ifdef CONFIG_SCHED_WORKQUEUE
 
@@ -105,9 +108,11 @@
 
 int work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_t delay)
 {
-	struct wqueue_s *wqueue = &g_work[qid];
+	if ((unsigned)qid >= WORK_QUEUES_MAX || g_work[qid].name[0] == '\0') {
+		return -EINVAL;
+	}
 
-	//DEBUGASSERT(work != NULL && (unsigned)qid < NWORKERS);
+	struct wqueue_s *wqueue = &g_work[qid];
 
 	/* First, initialize the work structure */
 
@@ -121,17 +126,18 @@ int work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_
 	 */
 
 	work_lock(qid);
-	work->qtime  = clock_systimer(); /* Time work queued */
+	work->qtime  = hrt_absolute_time(); /* Time work queued */
+
+	/* The worker thread is woken up if this is the earliest deadline */
+
+	int ret = work_sched_add(wqueue, work, work->qtime + (uint64_t)delay * USEC_PER_TICK);
 
-	dq_addlast((dq_entry_t *)work, &wqueue->q);
-#ifdef __PX4_QURT
-	px4_task_kill(wqueue->pid, SIGALRM);      /* Wake up the worker thread */
-#else
-	px4_task_kill(wqueue->pid, SIGCONT);      /* Wake up the worker thread */
-#endif
+	if (ret != PX4_OK) {
+		work->worker = NULL;
+	}
 
 	work_unlock(qid);
-	return PX4_OK;
+	return ret;
 }
 
 #endif /* CONFIG_SCHED_WORKQUEUE */
@@ -0,0 +1,345 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file work_sched.c
+ *
+ * Deadline scheduling of the work queues, see work_sched.h.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifdef __PX4_LINUX
+#define _GNU_SOURCE	/* pthread_setaffinity_np() */
+#endif
+
+#include <px4_config.h>
+#include <px4_defines.h>
+#include <px4_log.h>
+#include <px4_time.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __PX4_LINUX
+#include <sched.h>
+#endif
+#include "work_sched.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Clock of the wake condition: the monotonic clock where it can be selected */
+#ifdef __PX4_LINUX
+#define WORK_SCHED_CLOCK CLOCK_MONOTONIC
+#else
+#define WORK_SCHED_CLOCK CLOCK_REALTIME
+#endif
+
+#define WORK_SCHED_MIN_CAPACITY 16
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void heap_set(struct wqueue_s *wqueue, unsigned i, struct work_s *work)
+{
+	wqueue->heap[i] = work;
+	work->index = i;
+}
+
+static void heap_sift_up(struct wqueue_s *wqueue, unsigned i)
+{
+	struct work_s *work = wqueue->heap[i];
+
+	while (i > 0) {
+		unsigned parent = (i - 1) / 2;
+
+		if (work->deadline >= wqueue->heap[parent]->deadline) {
+			break;
+		}
+
+		heap_set(wqueue, i, wqueue->heap[parent]);
+		i = parent;
+	}
+
+	heap_set(wqueue, i, work);
+}
+
+static void heap_sift_down(struct wqueue_s *wqueue, unsigned i)
+{
+	struct work_s *work = wqueue->heap[i];
+
+	for (;;) {
+		unsigned child = 2 * i + 1;
+
+		if (child >= wqueue->count) {
+			break;
+		}
+
+		if (child + 1 < wqueue->count && wqueue->heap[child + 1]->deadline < wqueue->heap[child]->deadline) {
+			child++;
+		}
+
+		if (wqueue->heap[child]->deadline >= work->deadline) {
+			break;
+		}
+
+		heap_set(wqueue, i, wqueue->heap[child]);
+		i = child;
+	}
+
+	heap_set(wqueue, i, work);
+}
+
+static void heap_remove(struct wqueue_s *wqueue, unsigned i)
+{
+	struct work_s *last = wqueue->heap[--wqueue->count];
+
+	if (i < wqueue->count) {
+		heap_set(wqueue, i, last);
+
+		if (i > 0 && last->deadline < wqueue->heap[(i - 1) / 2]->deadline) {
+			heap_sift_up(wqueue, i);
+
+		} else {
+			heap_sift_down(wqueue, i);
+		}
+	}
+}
+
+/* work structures are not always initialized, so do not trust work->index alone */
+static bool is_queued(const struct wqueue_s *wqueue, const struct work_s *work)
+{
+	return work->index < wqueue->count && wqueue->heap[work->index] == work;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void work_sched_init(struct wqueue_s *wqueue, const char *name)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#ifdef __PX4_LINUX
+	pthread_condattr_setclock(&attr, WORK_SCHED_CLOCK);
+#endif
+	pthread_cond_init(&wqueue->wake_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&wqueue->wake_lock, NULL);
+
+	wqueue->heap     = NULL;
+	wqueue->count    = 0;
+	wqueue->capacity = 0;
+	wqueue->wake     = false;
+
+	strncpy(wqueue->name, name, sizeof(wqueue->name) - 1);
+	snprintf(wqueue->perf_name, sizeof(wqueue->perf_name), "%s jitter", wqueue->name);
+	wqueue->jitter   = perf_alloc(PC_ELAPSED, wqueue->perf_name);
+}
+
+int work_sched_add(struct wqueue_s *wqueue, struct work_s *work, uint64_t deadline)
+{
+	if (is_queued(wqueue, work)) {
+		heap_remove(wqueue, work->index);
+	}
+
+	if (wqueue->count == wqueue->capacity) {
+		unsigned capacity = (wqueue->capacity > 0) ? 2 * wqueue->capacity : WORK_SCHED_MIN_CAPACITY;
+		struct work_s **heap = (struct work_s **)realloc(wqueue->heap, capacity * sizeof(struct work_s *));
+
+		if (heap == NULL) {
+			return -ENOMEM;
+		}
+
+		wqueue->heap = heap;
+		wqueue->capacity = capacity;
+	}
+
+	work->deadline = deadline;
+	heap_set(wqueue, wqueue->count++, work);
+	heap_sift_up(wqueue, work->index);
+
+	/* the worker sleeps until the previous head, wake it up */
+	if (work->index == 0) {
+		pthread_mutex_lock(&wqueue->wake_lock);
+		wqueue->wake = true;
+		pthread_cond_signal(&wqueue->wake_cond);
+		pthread_mutex_unlock(&wqueue->wake_lock);
+	}
+
+	return PX4_OK;
+}
+
+void work_sched_remove(struct wqueue_s *wqueue, struct work_s *work)
+{
+	/* the worker might wake up for nothing, which is harmless */
+	if (is_queued(wqueue, work)) {
+		heap_remove(wqueue, work->index);
+	}
+}
+
+struct work_s *work_sched_next(struct wqueue_s *wqueue, uint64_t now, uint64_t *next)
+{
+	if (wqueue->count == 0) {
+		*next = UINT64_MAX;
+		return NULL;
+	}
+
+	struct work_s *work = wqueue->heap[0];
+
+	if (work->deadline > now) {
+		*next = work->deadline;
+		return NULL;
+	}
+
+	heap_remove(wqueue, 0);
+	perf_set_elapsed(wqueue->jitter, now - work->deadline);
+
+	return work;
+}
+
+static int apply_affinity(struct wqueue_s *wqueue)
+{
+#ifdef __PX4_LINUX
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+
+	if (wqueue->cpu >= 0) {
+		CPU_SET(wqueue->cpu, &cpus);
+
+	} else {
+		for (int i = 0; i < CPU_SETSIZE; i++) {
+			CPU_SET(i, &cpus);
+		}
+	}
+
+	return -pthread_setaffinity_np(wqueue->thread, sizeof(cpus), &cpus);
+#else
+	return 0;
+#endif
+}
+
+void work_sched_thread_start(struct wqueue_s *wqueue)
+{
+	pthread_mutex_lock(&wqueue->wake_lock);
+	wqueue->thread  = pthread_self();
+	wqueue->started = true;
+
+	if (wqueue->cpu >= 0 && apply_affinity(wqueue) != 0) {
+		PX4_WARN("%s: could not pin to CPU %d", wqueue->name, wqueue->cpu);
+	}
+
+	pthread_mutex_unlock(&wqueue->wake_lock);
+}
+
+bool work_sched_cpu_valid(int cpu)
+{
+#ifdef __PX4_LINUX
+	return cpu >= -1 && cpu < CPU_SETSIZE && cpu < sysconf(_SC_NPROCESSORS_CONF);
+#else
+	return cpu == -1;
+#endif
+}
+
+int work_sched_set_affinity(struct wqueue_s *wqueue, int cpu)
+{
+	int ret = 0;
+
+	if (!work_sched_cpu_valid(cpu)) {
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&wqueue->wake_lock);
+	int prev = wqueue->cpu;
+	wqueue->cpu = cpu;
+
+	if (wqueue->started) {
+		ret = apply_affinity(wqueue);
+
+		if (ret != 0) {
+			wqueue->cpu = prev;
+		}
+	}
+
+	pthread_mutex_unlock(&wqueue->wake_lock);
+	return ret;
+}
+
+void work_sched_run(struct wqueue_s *wqueue, worker_t worker, void *arg)
+{
+	hrt_abstime start = hrt_absolute_time();
+
+	worker(arg);
+
+	/* only written by the worker thread */
+	wqueue->busy += hrt_absolute_time() - start;
+	wqueue->runs++;
+}
+
+void work_sched_wait(struct wqueue_s *wqueue, uint64_t deadline, uint32_t max_wait)
+{
+	pthread_mutex_lock(&wqueue->wake_lock);
+
+	if (!wqueue->wake) {
+		uint64_t now = hrt_absolute_time();
+
+		if (deadline > now) {
+			uint64_t wait = deadline - now;
+
+			if (wait > max_wait) {
+				wait = max_wait;
+			}
+
+			/* hrt time can be offset or paused, only the interval carries over */
+			struct timespec ts;
+			px4_clock_gettime(WORK_SCHED_CLOCK, &ts);
+			uint64_t nsecs = ts.tv_nsec + wait * 1000;
+			ts.tv_sec += nsecs / 1000000000;
+			ts.tv_nsec = nsecs % 1000000000;
+
+			pthread_cond_timedwait(&wqueue->wake_cond, &wqueue->wake_lock, &ts);
+		}
+	}
+
+	wqueue->wake = false;
+	pthread_mutex_unlock(&wqueue->wake_lock);
+}
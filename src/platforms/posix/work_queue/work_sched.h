@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file work_sched.h
+ *
+ * Deadline scheduling shared by the work queues and the HRT queue: the
+ * pending work of a queue is a min-heap on the deadline and the worker
+ * thread sleeps until the earliest deadline or until an earlier one is queued.
+ * The queue's own lock must be held around work_sched_add(),
+ * work_sched_remove() and work_sched_next().
+ */
+
+#pragma once
+
+#include <px4_workqueue.h>
+
+__BEGIN_DECLS
+
+/**
+ * Initialize the scheduling state of a queue
+ * @param name name of the queue, its dispatch jitter is the perf counter "<name> jitter"
+ */
+void work_sched_init(struct wqueue_s *wqueue, const char *name);
+
+/**
+ * Queue work to run at deadline [us, hrt time]
+ * @return 0, or -ENOMEM if the heap could not grow
+ */
+int work_sched_add(struct wqueue_s *wqueue, struct work_s *work, uint64_t deadline);
+
+/**
+ * Remove queued work (work->worker != NULL)
+ */
+void work_sched_remove(struct wqueue_s *wqueue, struct work_s *work);
+
+/**
+ * Take the earliest work if it is due at now
+ * @param next set to the earliest deadline if none is due, UINT64_MAX if idle
+ * @return the work, removed from the queue, or NULL
+ */
+struct work_s *work_sched_next(struct wqueue_s *wqueue, uint64_t now, uint64_t *next);
+
+/**
+ * Called by the worker thread when it starts: records the thread and pins
+ * it to the CPU of the queue
+ */
+void work_sched_thread_start(struct wqueue_s *wqueue);
+
+/**
+ * @return true if cpu is a CPU a worker thread can be pinned to, or -1
+ */
+bool work_sched_cpu_valid(int cpu);
+
+/**
+ * Set the CPU of the queue (-1: any) and apply it if the worker thread runs
+ * @return 0, or a negated errno
+ */
+int work_sched_set_affinity(struct wqueue_s *wqueue, int cpu);
+
+/**
+ * Run a work callback, accounting its run time to the queue
+ */
+void work_sched_run(struct wqueue_s *wqueue, worker_t worker, void *arg);
+
+/**
+ * Sleep until the deadline [us, hrt time], at most max_wait [us], or until
+ * work_sched_add() queued work with an earlier deadline. Called without the
+ * queue lock.
+ */
+void work_sched_wait(struct wqueue_s *wqueue, uint64_t deadline, uint32_t max_wait);
+
+__END_DECLS
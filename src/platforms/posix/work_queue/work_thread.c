@@ -41,14 +41,19 @@
 #include <px4_defines.h>
 #include <px4_posix.h>
 #include <px4_time.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <queue.h>
 #include <pthread.h>
 #include <px4_workqueue.h>
 #include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
 #include "work_lock.h"
+#include "work_sched.h"
 
 #ifdef CONFIG_SCHED_WORKQUEUE
 
@@ -65,12 +70,17 @@
  ****************************************************************************/
 
 /* The state of each work queue. */
-struct wqueue_s g_work[NWORKERS];
+struct wqueue_s g_work[WORK_QUEUES_MAX];
+
+extern struct wqueue_s g_hrt_work;
 
 /****************************************************************************
  * Private Variables
  ****************************************************************************/
-px4_sem_t _work_lock[NWORKERS];
+px4_sem_t _work_lock[WORK_QUEUES_MAX];
+
+/* Serializes creating work queues and work_queue_status() */
+static pthread_mutex_t g_work_pool_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /****************************************************************************
  * Private Functions
@@ -92,96 +102,107 @@ px4_sem_t _work_lock[NWORKERS];
 
 static void work_process(struct wqueue_s *wqueue, int lock_id)
 {
-	volatile struct work_s *work;
+	struct work_s *work;
 	worker_t  worker;
 	void *arg;
-	uint64_t elapsed;
-	uint32_t remaining;
-	uint32_t next;
+	uint64_t next;
 
 	/* Then process queued work.  We need to keep interrupts disabled while
 	 * we process items in the work list.
 	 */
 
-	next  = CONFIG_SCHED_WORKPERIOD;
-
 	work_lock(lock_id);
 
-	work  = (struct work_s *)wqueue->q.head;
+	/* Take the work that is due, earliest deadline first */
 
-	while (work) {
-		/* Is this work ready?  It is ready if there is no delay or if
-		 * the delay has elapsed. qtime is the time that the work was added
-		 * to the work queue.  It will always be greater than or equal to
-		 * zero.  Therefore a delay of zero will always execute immediately.
+	while ((work = work_sched_next(wqueue, hrt_absolute_time(), &next)) != NULL) {
+		/* Extract the work description from the entry (in case the work
+		 * instance by the re-used after it has been de-queued).
 		 */
 
-		elapsed = USEC2TICK(clock_systimer() - work->qtime);
-
-		//printf("work_process: in ticks elapsed=%lu delay=%u\n", elapsed, work->delay);
-		if (elapsed >= work->delay) {
-			/* Remove the ready-to-execute work from the list */
-
-			(void)dq_rem((struct dq_entry_s *)work, &wqueue->q);
+		worker = work->worker;
+		arg    = work->arg;
 
-			/* Extract the work description from the entry (in case the work
-			 * instance by the re-used after it has been de-queued).
-			 */
+		/* Mark the work as no longer being queued */
 
-			worker = work->worker;
-			arg    = work->arg;
+		work->worker = NULL;
 
-			/* Mark the work as no longer being queued */
+		/* Do the work.  Re-enable interrupts while the work is being
+		 * performed... we don't have any idea how long that will take!
+		 */
 
-			work->worker = NULL;
+		work_unlock(lock_id);
 
-			/* Do the work.  Re-enable interrupts while the work is being
-			 * performed... we don't have any idea how long that will take!
-			 */
+		if (!worker) {
+			PX4_WARN("MESSED UP: worker = 0\n");
 
-			work_unlock(lock_id);
+		} else {
+			work_sched_run(wqueue, worker, arg);
+		}
 
-			if (!worker) {
-				PX4_WARN("MESSED UP: worker = 0\n");
+		work_lock(lock_id);
+	}
 
-			} else {
-				worker(arg);
-			}
+	work_unlock(lock_id);
 
-			/* Now, unfortunately, since we re-enabled interrupts we don't
-			 * know the state of the work list and we will have to start
-			 * back at the head of the list.
-			 */
+	/* Wait until the next work is due.  We are woken up earlier if work
+	 * with an earlier deadline is queued.
+	 */
 
-			work_lock(lock_id);
-			work  = (struct work_s *)wqueue->q.head;
+	work_sched_wait(wqueue, next, CONFIG_SCHED_WORKPERIOD);
+}
 
-		} else {
-			/* This one is not ready.. will it be ready before the next
-			 * scheduled wakeup interval?
-			 */
+/****************************************************************************
+ * Name: work_poolthread
+ *
+ * Description:
+ *   Worker thread of a queue created with work_queue_create().
+ *
+ * Input parameters:
+ *   argv - the last argument is the work queue ID
+ *
+ * Returned Value:
+ *   Does not return
+ *
+ ****************************************************************************/
 
-			/* Here: elapsed < work->delay */
-			remaining = USEC_PER_TICK * (work->delay - elapsed);
+static int work_poolthread(int argc, char *argv[])
+{
+	int qid = atoi(argv[argc - 1]);
 
-			if (remaining < next) {
-				/* Yes.. Then schedule to wake up when the work is ready */
+	work_sched_thread_start(&g_work[qid]);
 
-				next = remaining;
-			}
+	for (;;) {
+		work_process(&g_work[qid], qid);
+	}
 
-			/* Then try the next in the list. */
+	return PX4_OK; /* To keep some compilers happy */
+}
 
-			work = (struct work_s *)work->dq.flink;
+static int work_queue_find_locked(const char *name)
+{
+	for (int qid = 0; qid < WORK_QUEUES_MAX; qid++) {
+		if (g_work[qid].name[0] != '\0' && strcmp(g_work[qid].name, name) == 0) {
+			return qid;
 		}
 	}
 
-	/* Wait awhile to check the work list.  We will wait here until either
-	 * the time elapses or until we are awakened by a signal.
-	 */
-	work_unlock(lock_id);
+	return -ENOENT;
+}
+
+static void work_queue_print(struct wqueue_s *wqueue, uint64_t *last_busy, uint64_t interval)
+{
+	uint64_t busy = wqueue->busy;
+	float load = (interval > 0) ? 100.0f * (busy - *last_busy) / interval : 0.0f;
+	char cpu[8] = "any";
 
-	usleep(next);
+	if (wqueue->cpu >= 0) {
+		snprintf(cpu, sizeof(cpu), "%d", wqueue->cpu);
+	}
+
+	PX4_INFO("%-15s %4d %4s %6u %10llu %6.2f%%", wqueue->name, wqueue->priority, cpu,
+		 wqueue->count, (unsigned long long)wqueue->runs, (double)load);
+	*last_busy = busy;
 }
 
 /****************************************************************************
@@ -191,14 +212,22 @@ void work_queues_init(void)
 {
 	px4_sem_init(&_work_lock[HPWORK], 0, 1);
 	px4_sem_init(&_work_lock[LPWORK], 0, 1);
+	work_sched_init(&g_work[HPWORK], "hpwork");
+	work_sched_init(&g_work[LPWORK], "lpwork");
+	g_work[HPWORK].priority = SCHED_PRIORITY_MAX - 1;
+	g_work[HPWORK].cpu = -1;
+	g_work[LPWORK].priority = SCHED_PRIORITY_MIN;
+	g_work[LPWORK].cpu = -1;
 #ifdef CONFIG_SCHED_USRWORK
 	px4_sem_init(&_work_lock[USRWORK], 0, 1);
+	work_sched_init(&g_work[USRWORK], "usrwork");
+	g_work[USRWORK].cpu = -1;
 #endif
 
 	// Create high priority worker thread
 	g_work[HPWORK].pid = px4_task_spawn_cmd("hpwork",
 						SCHED_DEFAULT,
-						SCHED_PRIORITY_MAX - 1,
+						g_work[HPWORK].priority,
 						2000,
 						work_hpthread,
 						(char *const *)NULL);
@@ -206,7 +235,7 @@ void work_queues_init(void)
 	// Create low priority worker thread
 	g_work[LPWORK].pid = px4_task_spawn_cmd("lpwork",
 						SCHED_DEFAULT,
-						SCHED_PRIORITY_MIN,
+						g_work[LPWORK].priority,
 						2000,
 						work_lpthread,
 						(char *const *)NULL);
@@ -248,6 +277,8 @@ void work_queues_init(void)
 
 int work_hpthread(int argc, char *argv[])
 {
+	work_sched_thread_start(&g_work[HPWORK]);
+
 	/* Loop forever */
 
 	for (;;) {
@@ -276,6 +307,8 @@ int work_hpthread(int argc, char *argv[])
 
 int work_lpthread(int argc, char *argv[])
 {
+	work_sched_thread_start(&g_work[LPWORK]);
+
 	/* Loop forever */
 
 	for (;;) {
@@ -314,6 +347,7 @@ int work_usrthread(int argc, char *argv[])
 #else
 	rv = pthread_setname_np(pthread_self(), "USR");
 #endif
+	work_sched_thread_start(&g_work[USRWORK]);
 
 	for (;;) {
 		/* Then process queued work.  We need to keep interrupts disabled while
@@ -328,6 +362,113 @@ int work_usrthread(int argc, char *argv[])
 
 #endif /* CONFIG_SCHED_USRWORK */
 
+int work_queue_create(const char *name, int priority, int cpu)
+{
+	if (name == NULL || name[0] == '\0' || strlen(name) >= WORK_QUEUE_NAME_LEN) {
+		return -EINVAL;
+	}
+
+	if (!work_sched_cpu_valid(cpu)) {
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&g_work_pool_lock);
+
+	int qid = work_queue_find_locked(name);
+
+	if (qid >= 0) {
+		pthread_mutex_unlock(&g_work_pool_lock);
+		return qid;
+	}
+
+	for (qid = NWORKERS; qid < WORK_QUEUES_MAX; qid++) {
+		if (g_work[qid].name[0] == '\0') {
+			break;
+		}
+	}
+
+	if (qid == WORK_QUEUES_MAX) {
+		pthread_mutex_unlock(&g_work_pool_lock);
+		PX4_ERR("no free work queue for %s", name);
+		return -ENOSPC;
+	}
+
+	struct wqueue_s *wqueue = &g_work[qid];
+
+	memset(wqueue, 0, sizeof(*wqueue));
+	px4_sem_init(&_work_lock[qid], 0, 1);
+	work_sched_init(wqueue, name);
+	wqueue->priority = priority;
+	wqueue->cpu = cpu;
+
+	char qid_arg[8];
+	snprintf(qid_arg, sizeof(qid_arg), "%d", qid);
+	char *const argv[] = { qid_arg, NULL };
+
+	wqueue->pid = px4_task_spawn_cmd(wqueue->name,
+					 SCHED_DEFAULT,
+					 priority,
+					 2000,
+					 work_poolthread,
+					 argv);
+
+	if (wqueue->pid < 0) {
+		int ret = wqueue->pid;
+		perf_free(wqueue->jitter);
+		pthread_cond_destroy(&wqueue->wake_cond);
+		pthread_mutex_destroy(&wqueue->wake_lock);
+		px4_sem_destroy(&_work_lock[qid]);
+		wqueue->name[0] = '\0';
+		pthread_mutex_unlock(&g_work_pool_lock);
+		return ret;
+	}
+
+	pthread_mutex_unlock(&g_work_pool_lock);
+	return qid;
+}
+
+int work_queue_find(const char *name)
+{
+	pthread_mutex_lock(&g_work_pool_lock);
+	int qid = work_queue_find_locked(name);
+	pthread_mutex_unlock(&g_work_pool_lock);
+	return qid;
+}
+
+int work_queue_affinity(int qid, int cpu)
+{
+	if ((unsigned)qid >= WORK_QUEUES_MAX || g_work[qid].name[0] == '\0') {
+		return -EINVAL;
+	}
+
+	return work_sched_set_affinity(&g_work[qid], cpu);
+}
+
+void work_queue_status(void)
+{
+	/* utilization is reported since the previous call */
+	static uint64_t last_time;
+	static uint64_t last_busy[WORK_QUEUES_MAX + 1];
+
+	pthread_mutex_lock(&g_work_pool_lock);
+
+	uint64_t now = hrt_absolute_time();
+	uint64_t interval = now - last_time;
+
+	PX4_INFO("%-15s %4s %4s %6s %10s %7s", "queue", "prio", "cpu", "queued", "runs", "load");
+
+	work_queue_print(&g_hrt_work, &last_busy[WORK_QUEUES_MAX], interval);
+
+	for (int qid = 0; qid < WORK_QUEUES_MAX; qid++) {
+		if (g_work[qid].name[0] != '\0') {
+			work_queue_print(&g_work[qid], &last_busy[qid], interval);
+		}
+	}
+
+	last_time = now;
+	pthread_mutex_unlock(&g_work_pool_lock);
+}
+
 uint32_t clock_systimer()
 {
 	//printf("clock_systimer: %0lx\n", hrt_absolute_time());
@@ -77,6 +77,25 @@ typedef struct pollfd px4_pollfd_struct_t;
 #define px4_access 	_GLOBAL access
 #define px4_getpid 	_GLOBAL getpid
 
+typedef struct {
+	px4_pollfd_struct_t	*fds;
+	nfds_t			nfds;
+} px4_pollset_t;
+
+static inline int px4_pollset_init(px4_pollset_t *set, px4_pollfd_struct_t *fds, nfds_t nfds)
+{
+	set->fds = fds;
+	set->nfds = nfds;
+	return 0;
+}
+
+static inline int px4_pollset_wait(px4_pollset_t *set, int timeout)
+{
+	return px4_poll(set->fds, set->nfds, timeout);
+}
+
+static inline void px4_pollset_destroy(px4_pollset_t *set) {}
+
 #elif defined(__PX4_POSIX)
 
 #define  PX4_F_RDONLY O_RDONLY
@@ -96,6 +115,27 @@ typedef struct {
 	void   *priv;     	/* For use by drivers */
 } px4_pollfd_struct_t;
 
+/*
+ * Poll set: the fds are registered with their devices once, in
+ * px4_pollset_init(), and stay registered between the waits. A wait only
+ * re-arms the fds that the previous wait reported, so its cost does not grow
+ * with the number of idle fds. fds must stay allocated and open until
+ * px4_pollset_destroy() and must not be passed to px4_poll() meanwhile. A set
+ * must only be used by one thread.
+ *
+ * px4_pollset_init() returns 0, or a negative value if none of the fds can be
+ * polled. px4_pollset_wait() returns the number of ready fds, 0 on timeout, or a
+ * negative value (and errno) if a ready fd could not be re-armed: that fd is dropped
+ * from the set.
+ * px4_poll() is a set that lives for a single wait.
+ */
+typedef struct {
+	px4_pollfd_struct_t	*fds;
+	nfds_t			nfds;
+	px4_sem_t		sem;	/* posted by the devices of all the fds */
+	bool			rearm;	/* revents are from the previous wait */
+} px4_pollset_t;
+
 __BEGIN_DECLS
 
 __EXPORT int 		px4_open(const char *path, int flags, ...);
@@ -104,6 +144,9 @@ __EXPORT ssize_t	px4_read(int fd, void *buffer, size_t buflen);
 __EXPORT ssize_t	px4_write(int fd, const void *buffer, size_t buflen);
 __EXPORT int		px4_ioctl(int fd, int cmd, unsigned long arg);
 __EXPORT int		px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout);
+__EXPORT int		px4_pollset_init(px4_pollset_t *set, px4_pollfd_struct_t *fds, nfds_t nfds);
+__EXPORT int		px4_pollset_wait(px4_pollset_t *set, int timeout);
+__EXPORT void		px4_pollset_destroy(px4_pollset_t *set);
 __EXPORT int		px4_fsync(int fd);
 __EXPORT int		px4_access(const char *pathname, int mode);
 __EXPORT unsigned long	px4_getpid(void);
@@ -113,6 +156,15 @@ __EXPORT void		px4_sim_start_delay(void);
 __EXPORT void		px4_sim_stop_delay(void);
 __EXPORT bool		px4_sim_delay_enabled(void);
 
+/*
+ * Poll lockstep: count the px4_poll() wakeups until the woken thread calls
+ * px4_poll() again, so that a driver (e.g. lockstep replay) can wait until
+ * all the topic driven tasks have processed what it published.
+ */
+__EXPORT void		px4_enable_poll_lockstep(bool enable);
+__EXPORT void		px4_poll_lockstep_notify(void);
+__EXPORT bool		px4_poll_lockstep_wait_idle(int timeout_ms);
+
 __END_DECLS
 #else
 #error "No TARGET OS Provided"
@@ -44,6 +44,8 @@
 #elif defined(__PX4_POSIX)
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include <queue.h>
 #include <px4_platform_types.h>
 
@@ -57,23 +59,43 @@ __BEGIN_DECLS
 #define LPWORK 1
 #define NWORKERS 2
 
+/* Built-in queues plus the ones created with work_queue_create() */
+
+#define WORK_QUEUES_MAX 8
+#define WORK_QUEUE_NAME_LEN 16
+
 struct wqueue_s {
-	pid_t             pid; /* The task ID of the worker thread */
-	struct dq_queue_s q;   /* The queue of pending work */
+	pid_t             pid;       /* The task ID of the worker thread */
+	char              name[WORK_QUEUE_NAME_LEN]; /* Empty if the queue is unused */
+	char              perf_name[WORK_QUEUE_NAME_LEN + 8];
+	int               priority;  /* Scheduling priority of the worker thread */
+	int               cpu;       /* CPU the worker thread is pinned to, -1: any */
+	pthread_t         thread;
+	bool              started;   /* thread is valid */
+	uint64_t          busy;      /* Time spent in work callbacks [us] */
+	uint64_t          runs;      /* Number of work callbacks */
+	struct work_s   **heap;      /* Pending work, a min-heap on the deadline */
+	unsigned          count;     /* Number of pending work items */
+	unsigned          capacity;  /* Allocated size of heap */
+	pthread_mutex_t   wake_lock; /* Protects wake */
+	pthread_cond_t    wake_cond; /* Signalled when the earliest deadline changed */
+	bool              wake;
+	struct perf_ctr_header *jitter; /* Dispatch time - deadline */
 };
 
-extern struct wqueue_s g_work[NWORKERS];
+extern struct wqueue_s g_work[WORK_QUEUES_MAX];
 
 /* Defines the work callback */
 
 typedef void (*worker_t)(void *arg);
 
 struct work_s {
-	struct dq_entry_s dq;  /* Implements a doubly linked list */
 	worker_t  worker;      /* Work callback */
 	void *arg;             /* Callback argument */
 	uint64_t  qtime;       /* Time work queued */
 	uint32_t  delay;       /* Delay until work performed */
+	uint64_t  deadline;    /* Time the work is due [us] */
+	unsigned  index;       /* Position in the heap of its queue while queued */
 };
 
 /****************************************************************************
@@ -100,7 +122,7 @@ void work_queues_init(void);
  *   and remove it from the work queue.
  *
  * Input parameters:
- *   qid    - The work queue ID
+ *   qid    - The work queue ID: HPWORK, LPWORK or from work_queue_create()
  *   work   - The work structure to queue
  *   worker - The worker callback to be invoked.  The callback will invoked
  *            on the worker thread of execution.
@@ -135,6 +157,62 @@ int work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_
 
 int work_cancel(int qid, struct work_s *work);
 
+/****************************************************************************
+ * Name: work_queue_create
+ *
+ * Description:
+ *   Get the work queue with the given name, creating it with its own worker
+ *   thread if it does not exist yet.  This lets drivers place their work on
+ *   a dedicated queue (e.g. one per bus) instead of HPWORK or LPWORK.  The
+ *   priority and CPU of an existing queue are not changed, so a queue can be
+ *   configured by the startup script before the drivers using it start.
+ *
+ * Input parameters:
+ *   name     - Name of the queue and its thread, at most 15 characters
+ *   priority - Scheduling priority of the worker thread
+ *   cpu      - CPU to run the worker thread on, -1 for no affinity
+ *
+ * Returned Value:
+ *   The work queue ID, or a negated errno on failure
+ *
+ ****************************************************************************/
+
+int work_queue_create(const char *name, int priority, int cpu);
+
+/****************************************************************************
+ * Name: work_queue_find
+ *
+ * Returned Value:
+ *   The ID of the work queue with the given name, or -ENOENT
+ *
+ ****************************************************************************/
+
+int work_queue_find(const char *name);
+
+/****************************************************************************
+ * Name: work_queue_affinity
+ *
+ * Description:
+ *   Pin the worker thread of a work queue to a CPU, -1 to allow all CPUs.
+ *   Only supported on Linux.
+ *
+ * Returned Value:
+ *   Zero on success, a negated errno on failure
+ *
+ ****************************************************************************/
+
+int work_queue_affinity(int qid, int cpu);
+
+/****************************************************************************
+ * Name: work_queue_status
+ *
+ * Description:
+ *   Print the work queues with their utilization since the last call.
+ *
+ ****************************************************************************/
+
+void work_queue_status(void);
+
 uint32_t clock_systimer(void);
 
 int work_hpthread(int argc, char *argv[]);
@@ -0,0 +1,200 @@
+#include <math.h>
+#include <string.h>
+
+#include <lib/impact_recovery/ImpactDetector.hpp>
+#include <lib/impact_recovery/ImpactCharacterizer.hpp>
+#include <lib/impact_recovery/RecoveryStageMachine.hpp>
+
+#include "gtest/gtest.h"
+
+using namespace impact_recovery;
+
+/*
+ * Synthetic flight: level, armed, no attitude error, spinning about x
+ */
+class ImpactRecoveryTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		memset(&accel, 0, sizeof(accel));
+		memset(&gyro, 0, sizeof(gyro));
+		memset(&ctrl_state, 0, sizeof(ctrl_state));
+		memset(&armed, 0, sizeof(armed));
+		memset(&recovery_control, 0, sizeof(recovery_control));
+
+		accel.z = -9.81f;
+		gyro.x = 2.0f;
+		ctrl_state.q[0] = 1.0f;
+		armed.armed = true;
+		recovery_control.quatError[0] = 1.0f;
+	}
+
+	/*
+	 * One step of the fused pipeline, detection and characterization see the previous stage
+	 */
+	void step(float accel_x)
+	{
+		accel.x = accel_x;
+		const impact_recovery_stage_s previous_stage = stage_machine.get();
+		detector.update(accel, ctrl_state, previous_stage, armed);
+		characterizer.update(accel, gyro, ctrl_state, detector.get(), previous_stage);
+		stage_machine.update(ctrl_state, detector.get(), characterizer.get(), recovery_control);
+	}
+
+	sensor_accel_s accel;
+	sensor_gyro_s gyro;
+	control_state_s ctrl_state;
+	actuator_armed_s armed;
+	recovery_control_s recovery_control;
+
+	ImpactDetector detector;
+	ImpactCharacterizer characterizer;
+	RecoveryStageMachine stage_machine;
+};
+
+TEST_F(ImpactRecoveryTest, DetectorIgnoresSpikeWhenDisarmed)
+{
+	impact_recovery_stage_s stage;
+	memset(&stage, 0, sizeof(stage));
+	armed.armed = false;
+	accel.x = 20.0f;
+
+	ASSERT_FALSE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+}
+
+TEST_F(ImpactRecoveryTest, DetectorLatchesUntilReset)
+{
+	impact_recovery_stage_s stage;
+	memset(&stage, 0, sizeof(stage));
+
+	accel.x = 5.0f;
+	ASSERT_FALSE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+
+	accel.x = 20.0f;
+	ASSERT_TRUE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+
+	accel.x = 0.0f;
+	ASSERT_TRUE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+
+	stage.recoveryIsReset = true;
+	ASSERT_FALSE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+}
+
+TEST_F(ImpactRecoveryTest, DetectorWaitsForSpikeToEnd)
+{
+	impact_recovery_stage_s stage;
+	memset(&stage, 0, sizeof(stage));
+
+	accel.x = 20.0f;
+	ASSERT_TRUE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+
+	// reset while the spike is still going on must not trigger a second impact
+	stage.recoveryIsReset = true;
+	ASSERT_FALSE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+	stage.recoveryIsReset = false;
+	ASSERT_FALSE(detector.update(accel, ctrl_state, stage, armed).inRecovery);
+}
+
+TEST_F(ImpactRecoveryTest, StageMachineRunsOneTwoZero)
+{
+	impact_detection_s detection;
+	impact_characterization_s characterization;
+	memset(&detection, 0, sizeof(detection));
+	memset(&characterization, 0, sizeof(characterization));
+
+	detection.inRecovery = true;
+	characterization.accelRefIsComputed = true;
+
+	ASSERT_EQ(1, stage_machine.update(ctrl_state, detection, characterization, recovery_control).recoveryStage);
+
+	// three samples with small attitude error and rates
+	ASSERT_EQ(1, stage_machine.update(ctrl_state, detection, characterization, recovery_control).recoveryStage);
+	ASSERT_EQ(1, stage_machine.update(ctrl_state, detection, characterization, recovery_control).recoveryStage);
+	ASSERT_EQ(2, stage_machine.update(ctrl_state, detection, characterization, recovery_control).recoveryStage);
+
+	// level and still: back to normal flight
+	const impact_recovery_stage_s &stage = stage_machine.update(ctrl_state, detection, characterization, recovery_control);
+	ASSERT_EQ(0, stage.recoveryStage);
+	ASSERT_TRUE(stage.recoveryIsReset);
+
+	// reset handshake completes once detection and characterization have cleared
+	detection.inRecovery = false;
+	characterization.accelRefIsComputed = false;
+	ASSERT_FALSE(stage_machine.update(ctrl_state, detection, characterization, recovery_control).recoveryIsReset);
+}
+
+TEST_F(ImpactRecoveryTest, FusedPipelineRecoversFromImpact)
+{
+	ASSERT_TRUE(characterizer.init());
+
+	for (int i = 0; i < 10; i++) {
+		step(0.0f);
+	}
+
+	step(20.0f);
+	ASSERT_TRUE(detector.get().inRecovery);
+	ASSERT_FALSE(characterizer.get().accelRefIsComputed);
+
+	// the slowest fuzzy input is available three samples after the impact
+	int samples = 0;
+
+	while (!characterizer.get().accelRefIsComputed && samples < 10) {
+		step(0.0f);
+		samples++;
+	}
+
+	ASSERT_EQ(3, samples);
+	ASSERT_EQ(1, stage_machine.get().recoveryStage);
+	ASSERT_FLOAT_EQ(1.0f, characterizer.get().wallNormal[0]);
+
+	// stage 1 -> 2 -> 0 and the reset handshake
+	for (int i = 0; i < 10; i++) {
+		step(0.0f);
+	}
+
+	ASSERT_EQ(0, stage_machine.get().recoveryStage);
+	ASSERT_FALSE(stage_machine.get().recoveryIsReset);
+	ASSERT_FALSE(detector.get().inRecovery);
+	ASSERT_FALSE(characterizer.get().accelRefIsComputed);
+}
+
+TEST(FuzzyLookupTableTest, CheckedAgainstTheEngine)
+{
+	Fuzzy *fuzzy = new Fuzzy();
+	init_flp_params(fuzzy);
+	FuzzyCompiled engine;
+	ASSERT_TRUE(engine.compile(fuzzy));
+	delete fuzzy;
+
+	FuzzyLookupTable table;
+	const bool valid = table.generate(engine);
+	EXPECT_EQ(valid, table.is_valid());
+	EXPECT_EQ(table.max_error() <= FUZZY_LUT_MAX_ERROR, valid);
+
+	float worst = 0.0f;
+	unsigned seed = 7;
+
+	for (int i = 0; i < 20000; i++) {
+		float input[FUZZY_LUT_INPUTS];
+
+		for (int k = 0; k < FUZZY_LUT_INPUTS; k++) {
+			int count;
+			const float *nodes = FuzzyLookupTable::axis(k, &count);
+			seed = seed * 1103515245 + 12345;
+			input[k] = nodes[0] + (nodes[count - 1] - nodes[0]) * ((seed >> 8) & 0xffff) / 65535.0f;
+			engine.setInput(k + 1, input[k]);
+		}
+
+		engine.fuzzify();
+		const float error = fabsf(engine.defuzzify(1) - table.evaluate(input));
+		worst = (error > worst) ? error : worst;
+	}
+
+	// a table that passed the check must hold on other inputs too
+	if (valid) {
+		EXPECT_LE(worst, FUZZY_LUT_MAX_ERROR);
+	}
+
+	EXPECT_GT(worst, 0.0f);
+}
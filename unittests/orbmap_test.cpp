@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <map>
+#include <string>
+
+#include <modules/uORB/ORBMap.hpp>
+#include <modules/uORB/ORBSet.hpp>
+
+#include "gtest/gtest.h"
+
+using uORB::ORBMap;
+
+/*
+ * Nodes are only compared by address, never dereferenced
+ */
+static uORB::DeviceNode *fake_node(uintptr_t i)
+{
+	return reinterpret_cast<uORB::DeviceNode *>(0x1000 + i * 16);
+}
+
+TEST(ORBMapTest, InsertFindGet)
+{
+	ORBMap map;
+	EXPECT_FALSE(map.find("/obj/sensor_accel0"));
+	EXPECT_EQ(nullptr, map.get("/obj/sensor_accel0"));
+	EXPECT_EQ(0u, map.capacity());
+
+	EXPECT_TRUE(map.insert("/obj/sensor_accel0", fake_node(0)));
+	EXPECT_TRUE(map.insert("/obj/sensor_accel1", fake_node(1)));
+	EXPECT_EQ((unsigned)ORBMap::DEFAULT_CAPACITY, map.capacity());
+	EXPECT_EQ(2u, map.size());
+
+	EXPECT_TRUE(map.find("/obj/sensor_accel0"));
+	EXPECT_EQ(fake_node(1), map.get("/obj/sensor_accel1"));
+	EXPECT_FALSE(map.find("/obj/sensor_accel2"));
+	EXPECT_FALSE(map.find("/obj/sensor_accel"));
+
+	// re-inserting replaces the node, as the posix std::map did
+	EXPECT_TRUE(map.insert("/obj/sensor_accel0", fake_node(7)));
+	EXPECT_EQ(2u, map.size());
+	EXPECT_EQ(fake_node(7), map.get("/obj/sensor_accel0"));
+}
+
+TEST(ORBMapTest, GrowsWhenFull)
+{
+	ORBMap map;
+	EXPECT_TRUE(map.reserve(180));
+	EXPECT_EQ(256u, map.capacity());
+	EXPECT_EQ(192u, map.max_size());
+
+	// a second reserve does not change the table
+	EXPECT_TRUE(map.reserve(1000));
+	EXPECT_EQ(256u, map.capacity());
+
+	char name[32];
+
+	for (unsigned i = 0; i < 192; i++) {
+		snprintf(name, sizeof(name), "/obj/topic_%u", i);
+		ASSERT_TRUE(map.insert(name, fake_node(i)));
+	}
+
+	// replacing an existing entry does not grow a full table
+	EXPECT_TRUE(map.insert("/obj/topic_3", fake_node(3)));
+	EXPECT_EQ(256u, map.capacity());
+
+	// more instances than reserved for
+	for (unsigned i = 192; i < 1000; i++) {
+		snprintf(name, sizeof(name), "/obj/topic_%u", i);
+		ASSERT_TRUE(map.insert(name, fake_node(i)));
+	}
+
+	EXPECT_EQ(1000u, map.size());
+	EXPECT_EQ(2048u, map.capacity());
+
+	for (unsigned i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "/obj/topic_%u", i);
+		ASSERT_EQ(fake_node(i), map.get(name));
+	}
+
+	EXPECT_TRUE(map.erase("/obj/topic_500"));
+	EXPECT_FALSE(map.find("/obj/topic_500"));
+	EXPECT_EQ(fake_node(501), map.get("/obj/topic_501"));
+}
+
+TEST(ORBMapTest, EraseKeepsProbeSequences)
+{
+	// small table so that probe sequences collide and wrap around
+	ORBMap map;
+	ASSERT_TRUE(map.reserve(12));
+	ASSERT_EQ(16u, map.capacity());
+
+	std::map<std::string, uORB::DeviceNode *> reference;
+	unsigned seed = 1;
+	char name[32];
+
+	for (int step = 0; step < 20000; step++) {
+		seed = seed * 1103515245 + 12345;
+		const unsigned key = (seed >> 8) % 24;
+		snprintf(name, sizeof(name), "/obj/t%u", key);
+
+		if ((seed >> 20) & 1) {
+			ASSERT_TRUE(map.insert(name, fake_node(step)));
+			reference[name] = fake_node(step);
+
+		} else {
+			ASSERT_EQ(reference.erase(name) > 0, map.erase(name));
+		}
+
+		ASSERT_EQ(reference.size(), map.size());
+
+		for (unsigned k = 0; k < 24; k++) {
+			snprintf(name, sizeof(name), "/obj/t%u", k);
+			auto it = reference.find(name);
+			ASSERT_EQ(it != reference.end() ? it->second : nullptr, map.get(name));
+		}
+	}
+}
+
+TEST(ORBMapTest, SlotIteration)
+{
+	ORBMap map;
+	EXPECT_EQ(nullptr, map.slot(0));
+
+	std::map<std::string, uORB::DeviceNode *> reference;
+	char name[32];
+
+	for (unsigned i = 0; i < 20; i++) {
+		snprintf(name, sizeof(name), "/obj/topic_%u", i);
+		ASSERT_TRUE(map.insert(name, fake_node(i)));
+		reference[name] = fake_node(i);
+	}
+
+	for (unsigned i = 0; i < map.capacity(); i++) {
+		const ORBMap::Node *entry = map.slot(i);
+
+		if (entry != nullptr) {
+			EXPECT_EQ(1u, reference.count(entry->node_name));
+			EXPECT_EQ(reference[entry->node_name], entry->node);
+			reference.erase(entry->node_name);
+		}
+	}
+
+	EXPECT_TRUE(reference.empty());
+	EXPECT_EQ(nullptr, map.slot(map.capacity()));
+}
+
+TEST(ORBMapTest, SetEraseMiddleEntry)
+{
+	ORBSet set;
+	set.insert("sensor_combined");
+	set.insert("vehicle_attitude");
+	set.insert("actuator_outputs");
+
+	EXPECT_TRUE(set.erase("vehicle_attitude"));
+	EXPECT_FALSE(set.erase("vehicle_attitude"));
+	EXPECT_TRUE(set.find("sensor_combined"));
+	EXPECT_FALSE(set.find("vehicle_attitude"));
+	EXPECT_TRUE(set.find("actuator_outputs"));
+}
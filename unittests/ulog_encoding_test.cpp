@@ -0,0 +1,156 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <modules/logger/messages.h>
+#include <modules/logger/encoding.h>
+
+#include "gtest/gtest.h"
+
+using px4::logger::ULogCompressor;
+using px4::logger::ULogDeltaReference;
+
+static const int NUM_SAMPLES = 200;
+static const int KEYFRAME_INTERVAL = 50;
+
+struct __attribute__((packed)) TestSample {
+	uint64_t timestamp;
+	float x;
+	float y;
+	int32_t counter;
+	uint8_t flags[12];
+};
+
+static TestSample make_sample(int i)
+{
+	TestSample sample;
+	memset(&sample, 0, sizeof(sample));
+	sample.timestamp = 1000000 + i * 4000;
+	sample.x = 0.25f * (i / 10);
+	sample.y = -3.f;
+	sample.counter = i;
+	sample.flags[i % 12] = 1;
+	return sample;
+}
+
+struct EncodedSample {
+	uint8_t encoding;
+	std::vector<uint8_t> payload;
+};
+
+/**
+ * Encode a sample the way Logger::encode() does
+ */
+static EncodedSample encode(ULogDeltaReference &reference, ULogCompressor &compressor, const TestSample &sample,
+			    uint16_t generation)
+{
+	const int len = sizeof(sample);
+	uint8_t delta[sizeof(TestSample)];
+	const uint8_t *source = (const uint8_t *)&sample;
+	EncodedSample encoded;
+	encoded.encoding = ULOG_ENCODING_LZ;
+
+	if (reference.encode((const uint8_t *)&sample, delta, len, generation, KEYFRAME_INTERVAL) > 0) {
+		source = delta;
+		encoded.encoding |= ULOG_ENCODING_DELTA;
+	}
+
+	encoded.payload.resize(2 * len);
+	const int encoded_len = compressor.compress(source, len, encoded.payload.data(), encoded.payload.size());
+	EXPECT_GT(encoded_len, 0);
+	encoded.payload.resize(encoded_len);
+	return encoded;
+}
+
+/**
+ * Decode a message the way replay does
+ */
+static bool decode(const EncodedSample &encoded, TestSample &previous)
+{
+	uint8_t decoded[sizeof(TestSample)];
+
+	if (px4::logger::ulog_lz_decompress(encoded.payload.data(), encoded.payload.size(), decoded,
+					    sizeof(decoded)) != sizeof(decoded)) {
+		return false;
+	}
+
+	if (encoded.encoding & ULOG_ENCODING_DELTA) {
+		px4::logger::ulog_delta(decoded, (const uint8_t *)&previous, (uint8_t *)&previous, sizeof(decoded));
+
+	} else {
+		memcpy(&previous, decoded, sizeof(decoded));
+	}
+
+	return true;
+}
+
+TEST(ULogEncodingTest, DeltaChainFromFirstSample)
+{
+	// a fresh reference, as for instance 0 which is subscribed before logging starts
+	ULogDeltaReference reference;
+	reference.init();
+	ULogCompressor compressor;
+	TestSample decoded;
+	memset(&decoded, 0, sizeof(decoded));
+	int deltas = 0;
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		const TestSample sample = make_sample(i);
+		const EncodedSample encoded = encode(reference, compressor, sample, 1);
+
+		// keyframes: the first sample and then after every KEYFRAME_INTERVAL deltas
+		const bool keyframe = (i % (KEYFRAME_INTERVAL + 1)) == 0;
+		EXPECT_EQ(keyframe, !(encoded.encoding & ULOG_ENCODING_DELTA)) << "sample " << i;
+
+		if (!keyframe) {
+			++deltas;
+		}
+
+		ASSERT_TRUE(decode(encoded, decoded)) << "sample " << i;
+		ASSERT_EQ(0, memcmp(&sample, &decoded, sizeof(sample))) << "sample " << i;
+	}
+
+	EXPECT_EQ(NUM_SAMPLES - (NUM_SAMPLES + KEYFRAME_INTERVAL) / (KEYFRAME_INTERVAL + 1), deltas);
+	reference.release();
+	EXPECT_EQ(nullptr, reference.previous);
+}
+
+TEST(ULogEncodingTest, GenerationChangeForcesKeyframe)
+{
+	ULogDeltaReference reference;
+	reference.init();
+	ULogCompressor compressor;
+
+	EXPECT_FALSE(encode(reference, compressor, make_sample(0), 1).encoding & ULOG_ENCODING_DELTA);
+	EXPECT_TRUE(encode(reference, compressor, make_sample(1), 1).encoding & ULOG_ENCODING_DELTA);
+
+	// logged data was lost: the previous sample may not be in the file
+	EXPECT_FALSE(encode(reference, compressor, make_sample(2), 2).encoding & ULOG_ENCODING_DELTA);
+	EXPECT_TRUE(encode(reference, compressor, make_sample(3), 2).encoding & ULOG_ENCODING_DELTA);
+
+	reference.release();
+}
+
+TEST(ULogEncodingTest, LZRoundTrip)
+{
+	ULogCompressor compressor;
+	std::vector<uint8_t> src(1000);
+	std::vector<uint8_t> encoded(1100);
+	std::vector<uint8_t> decoded(src.size());
+	srand(1);
+
+	for (size_t i = 0; i < src.size(); i++) {
+		src[i] = (i % 7 == 0) ? rand() : i / 50;
+	}
+
+	const int len = compressor.compress(src.data(), src.size(), encoded.data(), encoded.size());
+	ASSERT_GT(len, 0);
+	EXPECT_LT(len, (int)src.size());
+	ASSERT_EQ((int)src.size(), px4::logger::ulog_lz_decompress(encoded.data(), len, decoded.data(), decoded.size()));
+	EXPECT_EQ(src, decoded);
+
+	// does not fit
+	EXPECT_EQ(-1, compressor.compress(src.data(), src.size(), encoded.data(), 10));
+}
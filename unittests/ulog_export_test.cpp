@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <modules/logger/messages.h>
+#include <modules/logger/encoding.h>
+#include <modules/ulog_export/ulog_exporter.hpp>
+
+#include "gtest/gtest.h"
+
+using px4::ULogExporter;
+
+static const int NUM_SAMPLES = 2000;
+static const int KEYFRAME_INTERVAL = 50;
+
+struct __attribute__((packed)) TestSample {
+	uint64_t timestamp;
+	float v[2];
+	float x;
+	float y;
+	int8_t k;
+	char s[4];
+	uint8_t _padding0[3];
+};
+
+static TestSample make_sample(int i, int instance)
+{
+	TestSample sample;
+	memset(&sample, 0, sizeof(sample));
+	sample.timestamp = i * 1000 + instance;
+	sample.v[0] = i * 0.5f;
+	sample.v[1] = -i;
+	sample.x = i + instance;
+	sample.y = 2 * i;
+	sample.k = i % 100 - 50;
+	sample.s[0] = 'a';
+	sample.s[1] = 'b';
+	sample.s[2] = '0' + i % 10;
+	return sample;
+}
+
+static void append(std::vector<uint8_t> &log, uint8_t type, const void *body, size_t size)
+{
+	log.push_back(size & 0xff);
+	log.push_back(size >> 8);
+	log.push_back(type);
+	log.insert(log.end(), (const uint8_t *)body, (const uint8_t *)body + size);
+}
+
+static void append_string(std::vector<uint8_t> &log, uint8_t type, const std::string &s)
+{
+	append(log, type, s.data(), s.size());
+}
+
+/**
+ * test_topic instance 0 as DATA, instance 1 delta and LZ encoded
+ */
+static std::vector<uint8_t> make_log(bool with_sync)
+{
+	std::vector<uint8_t> log;
+	ulog_file_header_s header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "ULog\x01\x12\x35\x00", 8);
+	log.insert(log.end(), (const uint8_t *)&header, (const uint8_t *)&header + sizeof(header));
+
+	append_string(log, (uint8_t)ULogMessageType::FORMAT, "nested:float x;float y");
+	append_string(log, (uint8_t)ULogMessageType::FORMAT,
+		      "test_topic:uint64_t timestamp;float[2] v;nested n;int8_t k;char[4] s;uint8_t[3] _padding0");
+
+	for (int instance = 0; instance < 2; instance++) {
+		uint8_t add[3] = { (uint8_t)instance, (uint8_t)instance, 0 };
+		std::string body((const char *)add, sizeof(add));
+		append_string(log, (uint8_t)ULogMessageType::ADD_LOGGED_MSG, body + "test_topic");
+	}
+
+	px4::logger::ULogCompressor compressor;
+	TestSample previous;
+	int messages = 0;
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		TestSample sample = make_sample(i, 0);
+		uint8_t data[2 + sizeof(TestSample)] = { 0, 0 };
+		memcpy(data + 2, &sample, sizeof(sample));
+		append(log, (uint8_t)ULogMessageType::DATA, data, sizeof(data));
+
+		sample = make_sample(i, 1);
+		uint8_t delta[sizeof(TestSample)];
+		uint8_t encoded[5 + 2 * sizeof(TestSample)];
+		uint8_t encoding = ULOG_ENCODING_LZ;
+
+		if (i % KEYFRAME_INTERVAL == 0) {
+			memcpy(delta, &sample, sizeof(sample));
+
+		} else {
+			px4::logger::ulog_delta((const uint8_t *)&sample, (const uint8_t *)&previous, delta, sizeof(sample));
+			encoding |= ULOG_ENCODING_DELTA;
+		}
+
+		const int len = compressor.compress(delta, sizeof(delta), encoded + 5, sizeof(encoded) - 5);
+		EXPECT_GT(len, 0);
+		encoded[0] = 1;
+		encoded[1] = 0;
+		encoded[2] = encoding;
+		encoded[3] = sizeof(TestSample);
+		encoded[4] = 0;
+		append(log, (uint8_t)ULogMessageType::ENCODED_DATA, encoded, 5 + len);
+		previous = sample;
+
+		if (with_sync && ++messages % 37 == 0) {
+			ulog_message_sync_s sync;
+			log.insert(log.end(), (const uint8_t *)&sync, (const uint8_t *)&sync + sizeof(sync));
+		}
+	}
+
+	return log;
+}
+
+static std::vector<uint8_t> read_file(const std::string &name)
+{
+	std::vector<uint8_t> data;
+	FILE *f = fopen(name.c_str(), "rb");
+
+	if (f) {
+		uint8_t buffer[4096];
+		size_t n;
+
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+			data.insert(data.end(), buffer, buffer + n);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+template<typename T>
+static std::vector<T> read_column(const std::string &name)
+{
+	std::vector<uint8_t> data = read_file(name);
+	std::vector<T> values(data.size() / sizeof(T));
+	memcpy(values.data(), data.data(), values.size() * sizeof(T));
+	return values;
+}
+
+class ULogExportTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		char dir[] = "/tmp/ulog_export_testXXXXXX";
+		ASSERT_NE(nullptr, mkdtemp(dir));
+		_dir = dir;
+	}
+
+	void TearDown() override
+	{
+		EXPECT_EQ(0, system(("rm -rf " + _dir).c_str()));
+	}
+
+	void check_export(const std::string &out)
+	{
+		for (int instance = 0; instance < 2; instance++) {
+			const std::string dir = out + "/test_topic_" + std::to_string(instance) + "/";
+			std::vector<uint64_t> timestamp = read_column<uint64_t>(dir + "timestamp.bin");
+			std::vector<float> v1 = read_column<float>(dir + "v_1.bin");
+			std::vector<float> x = read_column<float>(dir + "n.x.bin");
+			std::vector<int8_t> k = read_column<int8_t>(dir + "k.bin");
+			std::vector<uint8_t> s = read_file(dir + "s.bin");
+
+			ASSERT_EQ((size_t)NUM_SAMPLES, timestamp.size());
+			ASSERT_EQ((size_t)NUM_SAMPLES, v1.size());
+			ASSERT_EQ((size_t)NUM_SAMPLES, x.size());
+			ASSERT_EQ((size_t)NUM_SAMPLES, k.size());
+			ASSERT_EQ((size_t)NUM_SAMPLES * 4, s.size());
+
+			for (int i = 0; i < NUM_SAMPLES; i++) {
+				const TestSample expected = make_sample(i, instance);
+				ASSERT_EQ(expected.timestamp, timestamp[i]);
+				ASSERT_EQ(expected.v[1], v1[i]);
+				ASSERT_EQ(expected.x, x[i]);
+				ASSERT_EQ(expected.k, k[i]);
+				ASSERT_EQ(0, memcmp(expected.s, &s[i * 4], 4));
+			}
+
+			// padding is not exported
+			EXPECT_TRUE(read_file(dir + "_padding0.bin").empty());
+		}
+	}
+
+	std::string _dir;
+};
+
+TEST_F(ULogExportTest, SequentialAndParallelMatch)
+{
+	std::vector<uint8_t> log = make_log(true);
+	ULogExporter exporter;
+	exporter.open(log.data(), log.size());
+
+	ASSERT_TRUE(exporter.exportTo((_dir + "/sequential").c_str(), 1));
+	EXPECT_EQ(1u, exporter.statistics().chunks);
+	EXPECT_EQ(0u, exporter.statistics().decode_errors);
+	EXPECT_EQ((size_t)NUM_SAMPLES * 2, exporter.statistics().data_messages);
+	EXPECT_EQ(2u, exporter.statistics().topics);
+	EXPECT_EQ(14u, exporter.statistics().columns);
+	check_export(_dir + "/sequential");
+
+	ASSERT_TRUE(exporter.exportTo((_dir + "/parallel").c_str(), 4));
+	EXPECT_GT(exporter.statistics().chunks, 1u);
+	EXPECT_GT(exporter.statistics().sync_points, 0u);
+	EXPECT_GT(exporter.statistics().deferred, 0u);
+	EXPECT_EQ(0u, exporter.statistics().decode_errors);
+	check_export(_dir + "/parallel");
+
+	EXPECT_EQ(read_file(_dir + "/sequential/columns.csv"), read_file(_dir + "/parallel/columns.csv"));
+}
+
+TEST_F(ULogExportTest, SplitWithoutSync)
+{
+	std::vector<uint8_t> log = make_log(false);
+	ULogExporter exporter;
+	exporter.open(log.data(), log.size());
+
+	ASSERT_TRUE(exporter.exportTo(_dir.c_str(), 3));
+	EXPECT_GT(exporter.statistics().chunks, 1u);
+	EXPECT_EQ(0u, exporter.statistics().sync_points);
+	EXPECT_EQ(0u, exporter.statistics().decode_errors);
+	check_export(_dir);
+}
+
+TEST_F(ULogExportTest, TruncatedLog)
+{
+	std::vector<uint8_t> log = make_log(true);
+	log.resize(log.size() - 5);
+	ULogExporter exporter;
+	exporter.open(log.data(), log.size());
+
+	ASSERT_TRUE(exporter.exportTo(_dir.c_str(), 4));
+	// the last (encoded) sample is cut off
+	EXPECT_EQ((size_t)NUM_SAMPLES * 2 - 1, exporter.statistics().data_messages);
+	EXPECT_EQ(0u, exporter.statistics().decode_errors);
+
+	const std::vector<uint8_t> not_ulog(100, 0);
+	exporter.open(not_ulog.data(), not_ulog.size());
+	EXPECT_FALSE(exporter.exportTo(_dir.c_str(), 1));
+}